@@ -126,6 +126,10 @@ gst_rtp_h264_depay_class_init (GstRtpH264DepayClass * klass)
 static void
 gst_rtp_h264_depay_init (GstRtpH264Depay * rtph264depay)
 {
+  /* the start code shared by all the NAL units of byte-stream output */
+  rtph264depay->sync_bytes = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+      (gpointer) sync_bytes, sizeof (sync_bytes), 0, sizeof (sync_bytes), NULL,
+      NULL);
   rtph264depay->adapter = gst_adapter_new ();
   rtph264depay->picture_adapter = gst_adapter_new ();
   rtph264depay->byte_stream = DEFAULT_BYTE_STREAM;
@@ -140,8 +144,10 @@ static void
 gst_rtp_h264_depay_reset (GstRtpH264Depay * rtph264depay)
 {
   gst_adapter_clear (rtph264depay->adapter);
+  rtph264depay->adapter_n_mem = 0;
   rtph264depay->wait_start = TRUE;
   gst_adapter_clear (rtph264depay->picture_adapter);
+  rtph264depay->picture_n_mem = 0;
   rtph264depay->picture_start = FALSE;
   rtph264depay->last_keyframe = FALSE;
   rtph264depay->last_ts = 0;
@@ -161,6 +167,7 @@ gst_rtp_h264_depay_finalize (GObject * object)
   if (rtph264depay->codec_data)
     gst_buffer_unref (rtph264depay->codec_data);
 
+  gst_memory_unref (rtph264depay->sync_bytes);
   g_object_unref (rtph264depay->adapter);
   g_object_unref (rtph264depay->picture_adapter);
 
@@ -729,17 +736,47 @@ incomplete_caps:
   }
 }
 
+/* the start code or the length prefix of a NAL unit of @size bytes */
+static GstMemory *
+gst_rtp_h264_depay_nal_prefix (GstRtpH264Depay * rtph264depay, guint size)
+{
+  GstMemory *mem;
+  GstMapInfo map;
+
+  if (rtph264depay->byte_stream)
+    return gst_memory_ref (rtph264depay->sync_bytes);
+
+  mem = gst_allocator_alloc (NULL, sizeof (sync_bytes), NULL);
+  gst_memory_map (mem, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT32_BE (map.data, size);
+  gst_memory_unmap (mem, &map);
+
+  return mem;
+}
+
+/* a buffer of the @size bytes at @data in the payload of @rtp, sharing the
+ * memory of the packet */
+static GstBuffer *
+gst_rtp_h264_depay_share (GstRtpH264Depay * rtph264depay, GstRTPBuffer * rtp,
+    const guint8 * data, guint size)
+{
+  guint offset = data - (const guint8 *) gst_rtp_buffer_get_payload (rtp);
+
+  return gst_rtp_share_payload (GST_ELEMENT_CAST (rtph264depay), rtp, offset,
+      size, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+}
+
 static GstBuffer *
 gst_rtp_h264_complete_au (GstRtpH264Depay * rtph264depay,
     GstClockTime * out_timestamp, gboolean * out_keyframe)
 {
-  guint outsize;
   GstBuffer *outbuf;
 
   /* we had a picture in the adapter and we completed it */
   GST_DEBUG_OBJECT (rtph264depay, "taking completed AU");
-  outsize = gst_adapter_available (rtph264depay->picture_adapter);
-  outbuf = gst_adapter_take_buffer (rtph264depay->picture_adapter, outsize);
+  outbuf = gst_rtp_adapter_take_all (rtph264depay->picture_adapter,
+      rtph264depay->picture_n_mem);
+  rtph264depay->picture_n_mem = 0;
 
   *out_timestamp = rtph264depay->last_ts;
   *out_keyframe = rtph264depay->last_keyframe;
@@ -760,16 +797,18 @@ gst_rtp_h264_depay_handle_nal (GstRtpH264Depay * rtph264depay, GstBuffer * nal,
 {
   GstRTPBaseDepayload *depayload = GST_RTP_BASE_DEPAYLOAD (rtph264depay);
   gint nal_type;
-  GstMapInfo map;
+  guint8 header[6] = { 0, };
   GstBuffer *outbuf = NULL;
   GstClockTime out_timestamp;
   gboolean keyframe, out_keyframe;
 
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  if (G_UNLIKELY (map.size < 5))
+  if (G_UNLIKELY (gst_buffer_get_size (nal) < 5))
     goto short_nal;
 
-  nal_type = map.data[4] & 0x1f;
+  /* the NAL unit spans several memories, only read the headers */
+  gst_buffer_extract (nal, 0, header, sizeof (header));
+
+  nal_type = header[4] & 0x1f;
   GST_DEBUG_OBJECT (rtph264depay, "handle NAL type %d", nal_type);
 
   keyframe = NAL_TYPE_IS_KEY (nal_type);
@@ -782,7 +821,6 @@ gst_rtp_h264_depay_handle_nal (GstRtpH264Depay * rtph264depay, GstBuffer * nal,
       gst_rtp_h264_depay_add_sps_pps (rtph264depay,
           gst_buffer_copy_region (nal, GST_BUFFER_COPY_ALL,
               4, gst_buffer_get_size (nal) - 4));
-      gst_buffer_unmap (nal, &map);
       gst_buffer_unref (nal);
       return NULL;
     } else if (rtph264depay->sps->len == 0 || rtph264depay->pps->len == 0) {
@@ -793,7 +831,6 @@ gst_rtp_h264_depay_handle_nal (GstRtpH264Depay * rtph264depay, GstBuffer * nal,
           gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
               gst_structure_new ("GstForceKeyUnit",
                   "all-headers", G_TYPE_BOOLEAN, TRUE, NULL)));
-      gst_buffer_unmap (nal, &map);
       gst_buffer_unref (nal);
       return NULL;
     }
@@ -822,7 +859,7 @@ gst_rtp_h264_depay_handle_nal (GstRtpH264Depay * rtph264depay, GstBuffer * nal,
       if (nal_type == 1 || nal_type == 2 || nal_type == 5) {
         /* we have a picture start */
         start = TRUE;
-        if (map.data[5] & 0x80) {
+        if (header[5] & 0x80) {
           /* first_mb_in_slice == 0 completes a picture */
           complete = TRUE;
         }
@@ -837,9 +874,8 @@ gst_rtp_h264_depay_handle_nal (GstRtpH264Depay * rtph264depay, GstBuffer * nal,
             &out_keyframe);
     }
     /* add to adapter */
-    gst_buffer_unmap (nal, &map);
-
     GST_DEBUG_OBJECT (depayload, "adding NAL to picture adapter");
+    rtph264depay->picture_n_mem += gst_buffer_n_memory (nal);
     gst_adapter_push (rtph264depay->picture_adapter, nal);
     rtph264depay->last_ts = in_timestamp;
     rtph264depay->last_keyframe |= keyframe;
@@ -852,7 +888,6 @@ gst_rtp_h264_depay_handle_nal (GstRtpH264Depay * rtph264depay, GstBuffer * nal,
     /* no merge, output is input nal */
     GST_DEBUG_OBJECT (depayload, "using NAL as output");
     outbuf = nal;
-    gst_buffer_unmap (nal, &map);
   }
 
   if (outbuf) {
@@ -885,7 +920,6 @@ gst_rtp_h264_depay_handle_nal (GstRtpH264Depay * rtph264depay, GstBuffer * nal,
 short_nal:
   {
     GST_WARNING_OBJECT (depayload, "dropping short NAL");
-    gst_buffer_unmap (nal, &map);
     gst_buffer_unref (nal);
     return NULL;
   }
@@ -896,25 +930,18 @@ gst_rtp_h264_push_fragmentation_unit (GstRtpH264Depay * rtph264depay,
     gboolean send)
 {
   guint outsize;
-  GstMapInfo map;
   GstBuffer *outbuf;
 
-  outsize = gst_adapter_available (rtph264depay->adapter);
-  outbuf = gst_adapter_take_buffer (rtph264depay->adapter, outsize);
+  /* keep room for the prefix */
+  outbuf = gst_rtp_adapter_take_all (rtph264depay->adapter,
+      rtph264depay->adapter_n_mem + 1);
+  rtph264depay->adapter_n_mem = 0;
 
-  gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
+  outsize = gst_buffer_get_size (outbuf);
   GST_DEBUG_OBJECT (rtph264depay, "output %d bytes", outsize);
 
-  if (rtph264depay->byte_stream) {
-    memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-  } else {
-    outsize -= 4;
-    map.data[0] = (outsize >> 24);
-    map.data[1] = (outsize >> 16);
-    map.data[2] = (outsize >> 8);
-    map.data[3] = (outsize);
-  }
-  gst_buffer_unmap (outbuf, &map);
+  gst_buffer_prepend_memory (outbuf,
+      gst_rtp_h264_depay_nal_prefix (rtph264depay, outsize));
 
   rtph264depay->current_fu_type = 0;
 
@@ -940,6 +967,7 @@ gst_rtp_h264_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
   /* flush remaining data on discont */
   if (GST_BUFFER_IS_DISCONT (rtp->buffer)) {
     gst_adapter_clear (rtph264depay->adapter);
+    rtph264depay->adapter_n_mem = 0;
     rtph264depay->wait_start = TRUE;
     rtph264depay->current_fu_type = 0;
   }
@@ -949,6 +977,7 @@ gst_rtp_h264_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
     guint8 *payload;
     guint header_len;
     guint8 nal_ref_idc;
+    GstMemory *mem;
     GstMapInfo map;
     guint outsize, nalu_size;
     GstClockTime timestamp;
@@ -1023,41 +1052,33 @@ gst_rtp_h264_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           if (nalu_size > (payload_len - 2))
             nalu_size = payload_len - 2;
 
-          outsize = nalu_size + sizeof (sync_bytes);
-          outbuf = gst_buffer_new_and_alloc (outsize);
-
-          gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-          if (rtph264depay->byte_stream) {
-            memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-          } else {
-            map.data[0] = map.data[1] = 0;
-            map.data[2] = payload[0];
-            map.data[3] = payload[1];
-          }
-
           /* strip NALU size */
           payload += 2;
           payload_len -= 2;
 
-          memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-          gst_buffer_unmap (outbuf, &map);
-
-          gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph264depay), outbuf,
-              rtp->buffer, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+          outbuf = gst_rtp_h264_depay_share (rtph264depay, rtp, payload,
+              nalu_size);
+          gst_buffer_prepend_memory (outbuf,
+              gst_rtp_h264_depay_nal_prefix (rtph264depay, nalu_size));
 
           outbuf =
               gst_rtp_h264_depay_handle_nal (rtph264depay, outbuf, timestamp,
               marker);
-          if (outbuf)
+          if (outbuf) {
+            rtph264depay->adapter_n_mem += gst_buffer_n_memory (outbuf);
             gst_adapter_push (rtph264depay->adapter, outbuf);
+          }
 
           payload += nalu_size;
           payload_len -= nalu_size;
         }
 
         outsize = gst_adapter_available (rtph264depay->adapter);
-        if (outsize > 0)
-          outbuf = gst_adapter_take_buffer (rtph264depay->adapter, outsize);
+        if (outsize > 0) {
+          outbuf = gst_rtp_adapter_take_all (rtph264depay->adapter,
+              rtph264depay->adapter_n_mem);
+          rtph264depay->adapter_n_mem = 0;
+        }
         break;
       }
       case 26:
@@ -1084,6 +1105,9 @@ gst_rtp_h264_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
          *
          * R is reserved and always 0
          */
+        if (payload_len < 2)
+          goto short_fu;
+
         S = (payload[1] & 0x80) == 0x80;
         E = (payload[1] & 0x40) == 0x40;
 
@@ -1110,26 +1134,25 @@ gst_rtp_h264_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           /* reconstruct NAL header */
           nal_header = (payload[0] & 0xe0) | (payload[1] & 0x1f);
 
-          /* strip type header, keep FU header, we'll reuse it to reconstruct
-           * the NAL header. */
-          payload += 1;
-          payload_len -= 1;
-
-          nalu_size = payload_len;
-          outsize = nalu_size + sizeof (sync_bytes);
-          outbuf = gst_buffer_new_and_alloc (outsize);
+          /* strip FU indicator and FU header, the data follows the
+           * reconstructed NAL header */
+          payload += 2;
+          payload_len -= 2;
 
-          gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-          memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-          map.data[sizeof (sync_bytes)] = nal_header;
-          gst_buffer_unmap (outbuf, &map);
+          outbuf = gst_rtp_h264_depay_share (rtph264depay, rtp, payload,
+              payload_len);
 
-          gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph264depay), outbuf,
-              rtp->buffer, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+          mem = gst_allocator_alloc (NULL, 1, NULL);
+          gst_memory_map (mem, &map, GST_MAP_WRITE);
+          map.data[0] = nal_header;
+          gst_memory_unmap (mem, &map);
+          gst_buffer_prepend_memory (outbuf, mem);
 
+          outsize = payload_len + 1;
           GST_DEBUG_OBJECT (rtph264depay, "queueing %d bytes", outsize);
 
           /* and assemble in the adapter */
+          rtph264depay->adapter_n_mem += gst_buffer_n_memory (outbuf);
           gst_adapter_push (rtph264depay->adapter, outbuf);
         } else {
           /* strip off FU indicator and FU header bytes */
@@ -1137,15 +1160,13 @@ gst_rtp_h264_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           payload_len -= 2;
 
           outsize = payload_len;
-          outbuf = gst_buffer_new_and_alloc (outsize);
-          gst_buffer_fill (outbuf, 0, payload, outsize);
-
-          gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph264depay), outbuf,
-              rtp->buffer, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+          outbuf = gst_rtp_h264_depay_share (rtph264depay, rtp, payload,
+              outsize);
 
           GST_DEBUG_OBJECT (rtph264depay, "queueing %d bytes", outsize);
 
           /* and assemble in the adapter */
+          rtph264depay->adapter_n_mem += gst_buffer_n_memory (outbuf);
           gst_adapter_push (rtph264depay->adapter, outbuf);
         }
 
@@ -1164,22 +1185,10 @@ gst_rtp_h264_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
         /* 1-23   NAL unit  Single NAL unit packet per H.264   5.6 */
         /* the entire payload is the output buffer */
         nalu_size = payload_len;
-        outsize = nalu_size + sizeof (sync_bytes);
-        outbuf = gst_buffer_new_and_alloc (outsize);
-
-        gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-        if (rtph264depay->byte_stream) {
-          memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-        } else {
-          map.data[0] = map.data[1] = 0;
-          map.data[2] = nalu_size >> 8;
-          map.data[3] = nalu_size & 0xff;
-        }
-        memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-        gst_buffer_unmap (outbuf, &map);
-
-        gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph264depay), outbuf,
-            rtp->buffer, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+        outbuf = gst_rtp_h264_depay_share (rtph264depay, rtp, payload,
+            nalu_size);
+        gst_buffer_prepend_memory (outbuf,
+            gst_rtp_h264_depay_nal_prefix (rtph264depay, nalu_size));
 
         outbuf = gst_rtp_h264_depay_handle_nal (rtph264depay, outbuf, timestamp,
             marker);
@@ -1202,6 +1211,11 @@ undefined_type:
         (NULL), ("Undefined packet type"));
     return NULL;
   }
+short_fu:
+  {
+    GST_DEBUG_OBJECT (rtph264depay, "dropping short FU");
+    return NULL;
+  }
 waiting_start:
   {
     GST_DEBUG_OBJECT (rtph264depay, "waiting for start");
@@ -722,17 +722,17 @@ gst_rtp_h264_pay_decode_nal (GstRtpH264Pay * payloader,
   return updated;
 }
 
-static GstFlowReturn
+static void
 gst_rtp_h264_pay_payload_nal (GstRTPBasePayload * basepayload,
-    GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au,
-    gboolean delta_unit, gboolean discont);
+    GstBufferList * list, GstBuffer * paybuf, GstClockTime dts,
+    GstClockTime pts, gboolean end_of_au, gboolean delta_unit,
+    gboolean discont);
 
-static GstFlowReturn
+static void
 gst_rtp_h264_pay_send_sps_pps (GstRTPBasePayload * basepayload,
-    GstRtpH264Pay * rtph264pay, GstClockTime dts, GstClockTime pts)
+    GstRtpH264Pay * rtph264pay, GstBufferList * list, GstClockTime dts,
+    GstClockTime pts)
 {
-  GstFlowReturn ret = GST_FLOW_OK;
-  gboolean sent_all_sps_pps = TRUE;
   guint i;
 
   for (i = 0; i < rtph264pay->sps->len; i++) {
@@ -741,13 +741,8 @@ gst_rtp_h264_pay_send_sps_pps (GstRTPBasePayload * basepayload,
 
     GST_DEBUG_OBJECT (rtph264pay, "inserting SPS in the stream");
     /* resend SPS */
-    ret = gst_rtp_h264_pay_payload_nal (basepayload, gst_buffer_ref (sps_buf),
+    gst_rtp_h264_pay_payload_nal (basepayload, list, gst_buffer_ref (sps_buf),
         dts, pts, FALSE, FALSE, FALSE);
-    /* Not critical here; but throw a warning */
-    if (ret != GST_FLOW_OK) {
-      sent_all_sps_pps = FALSE;
-      GST_WARNING_OBJECT (basepayload, "Problem pushing SPS");
-    }
   }
   for (i = 0; i < rtph264pay->pps->len; i++) {
     GstBuffer *pps_buf =
@@ -755,41 +750,80 @@ gst_rtp_h264_pay_send_sps_pps (GstRTPBasePayload * basepayload,
 
     GST_DEBUG_OBJECT (rtph264pay, "inserting PPS in the stream");
     /* resend PPS */
-    ret = gst_rtp_h264_pay_payload_nal (basepayload, gst_buffer_ref (pps_buf),
+    gst_rtp_h264_pay_payload_nal (basepayload, list, gst_buffer_ref (pps_buf),
         dts, pts, FALSE, FALSE, FALSE);
-    /* Not critical here; but throw a warning */
-    if (ret != GST_FLOW_OK) {
-      sent_all_sps_pps = FALSE;
-      GST_WARNING_OBJECT (basepayload, "Problem pushing PPS");
-    }
   }
 
-  if (pts != -1 && sent_all_sps_pps)
+  if (pts != -1)
     rtph264pay->last_spspps = pts;
+}
 
-  return ret;
+typedef struct
+{
+  GstClockTime dts, pts;
+  guint8 nal_header;
+  gboolean fragmented;
+  gboolean end_of_au;
+  gboolean delta_unit;
+  gboolean discont;
+} GstRtpH264PayNal;
+
+static void
+gst_rtp_h264_pay_write_packet (GstElement * element, GstRTPBuffer * rtp,
+    gsize offset, gboolean last, GstRtpH264PayNal * nal)
+{
+  GstBuffer *outbuf = rtp->buffer;
+  guint8 nalType = nal->nal_header & 0x1f;
+
+  /* timestamp the outbuffer */
+  GST_BUFFER_PTS (outbuf) = nal->pts;
+  GST_BUFFER_DTS (outbuf) = nal->dts;
+
+  /* only set the marker bit on packets containing access units */
+  if (IS_ACCESS_UNIT (nalType))
+    gst_rtp_buffer_set_marker (rtp, last && nal->end_of_au);
+
+  if (nal->fragmented) {
+    guint8 *payload = gst_rtp_buffer_get_payload (rtp);
+
+    /* FU indicator */
+    payload[0] = (nal->nal_header & 0x60) | 28;
+
+    /* FU Header, the first fragment starts after the NAL header */
+    payload[1] = ((offset == 1) << 7) | (last << 6) | nalType;
+  }
+
+  if (!nal->delta_unit)
+    /* Only the first packet sent should not have the flag */
+    nal->delta_unit = TRUE;
+  else
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  if (nal->discont) {
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+    /* Only the first packet sent should have the flag */
+    nal->discont = FALSE;
+  }
 }
 
-/* @delta_unit: if %FALSE the first packet sent won't have the
+/* @list: the list receiving the packets of the NAL unit
+ * @delta_unit: if %FALSE the first packet sent won't have the
  * GST_BUFFER_FLAG_DELTA_UNIT flag.
  * @discont: if %TRUE the first packet sent will have the
  * GST_BUFFER_FLAG_DISCONT flag.
  */
-static GstFlowReturn
+static void
 gst_rtp_h264_pay_payload_nal (GstRTPBasePayload * basepayload,
-    GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au,
-    gboolean delta_unit, gboolean discont)
+    GstBufferList * list, GstBuffer * paybuf, GstClockTime dts,
+    GstClockTime pts, gboolean end_of_au, gboolean delta_unit,
+    gboolean discont)
 {
   GstRtpH264Pay *rtph264pay;
-  GstFlowReturn ret;
   guint8 nalHeader;
   guint8 nalType;
-  guint packet_len, payload_len, mtu;
-  GstBuffer *outbuf;
-  guint8 *payload;
-  GstBufferList *list = NULL;
+  guint packet_len, mtu;
   gboolean send_spspps;
-  GstRTPBuffer rtp = { NULL };
+  GstRtpH264PayNal nal;
   guint size = gst_buffer_get_size (paybuf);
 
   rtph264pay = GST_RTP_H264_PAY (basepayload);
@@ -847,13 +881,16 @@ gst_rtp_h264_pay_payload_nal (GstRTPBasePayload * basepayload,
     /* we need to send SPS/PPS now first. FIXME, don't use the pts for
      * checking when we need to send SPS/PPS but convert to running_time first. */
     rtph264pay->send_spspps = FALSE;
-    ret = gst_rtp_h264_pay_send_sps_pps (basepayload, rtph264pay, dts, pts);
-    if (ret != GST_FLOW_OK) {
-      gst_buffer_unref (paybuf);
-      return ret;
-    }
+    gst_rtp_h264_pay_send_sps_pps (basepayload, rtph264pay, list, dts, pts);
   }
 
+  nal.dts = dts;
+  nal.pts = pts;
+  nal.nal_header = nalHeader;
+  nal.end_of_au = end_of_au;
+  nal.delta_unit = delta_unit;
+  nal.discont = discont;
+
   packet_len = gst_rtp_buffer_calc_packet_len (size, 0, 0);
 
   if (packet_len < mtu) {
@@ -861,128 +898,28 @@ gst_rtp_h264_pay_payload_nal (GstRTPBasePayload * basepayload,
     GST_DEBUG_OBJECT (basepayload,
         "NAL Unit fit in one packet datasize=%d mtu=%d", size, mtu);
 
-    /* create buffer without payload containing only the RTP header
-     * (memory block at index 0) */
-    outbuf = gst_rtp_buffer_new_allocate (0, 0, 0);
-
-    gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
-
-    /* only set the marker bit on packets containing access units */
-    if (IS_ACCESS_UNIT (nalType) && end_of_au) {
-      gst_rtp_buffer_set_marker (&rtp, 1);
-    }
-
-    /* timestamp the outbuffer */
-    GST_BUFFER_PTS (outbuf) = pts;
-    GST_BUFFER_DTS (outbuf) = dts;
-
-    if (!delta_unit)
-      /* Only the first packet sent should not have the flag */
-      delta_unit = TRUE;
-    else
-      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DELTA_UNIT);
-
-    if (discont) {
-      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
-      /* Only the first packet sent should have the flag */
-      discont = FALSE;
-    }
-
-    gst_rtp_buffer_unmap (&rtp);
-
-    /* insert payload memory block */
-    gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph264pay), outbuf, paybuf,
-        g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
-    outbuf = gst_buffer_append (outbuf, paybuf);
-
-    /* push the buffer to the next element */
-    ret = gst_rtp_base_payload_push (basepayload, outbuf);
+    nal.fragmented = FALSE;
+    gst_rtp_fragment_buffer (GST_ELEMENT_CAST (rtph264pay), list, paybuf, 0,
+        size, mtu, 0, 0, g_quark_from_static_string (GST_META_TAG_VIDEO_STR),
+        (GstRtpFragmentFunc) gst_rtp_h264_pay_write_packet, &nal);
   } else {
     /* fragmentation Units FU-A */
-    guint limitedSize;
-    int ii = 0, start = 1, end = 0, pos = 0;
-
     GST_DEBUG_OBJECT (basepayload,
         "NAL Unit DOES NOT fit in one packet datasize=%d mtu=%d", size, mtu);
 
-    pos++;
-    size--;
-
-    ret = GST_FLOW_OK;
-
     GST_DEBUG_OBJECT (basepayload, "Using FU-A fragmentation for data size=%d",
-        size);
-
-    /* We keep 2 bytes for FU indicator and FU Header */
-    payload_len = gst_rtp_buffer_calc_payload_len (mtu - 2, 0, 0);
-
-    list = gst_buffer_list_new_sized ((size / payload_len) + 1);
-
-    while (end == 0) {
-      limitedSize = size < payload_len ? size : payload_len;
-      GST_DEBUG_OBJECT (basepayload,
-          "Inside  FU-A fragmentation limitedSize=%d iteration=%d", limitedSize,
-          ii);
-
-      /* use buffer lists
-       * create buffer without payload containing only the RTP header
-       * (memory block at index 0) */
-      outbuf = gst_rtp_buffer_new_allocate (2, 0, 0);
-
-      gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
-
-      GST_BUFFER_DTS (outbuf) = dts;
-      GST_BUFFER_PTS (outbuf) = pts;
-      payload = gst_rtp_buffer_get_payload (&rtp);
-
-      if (limitedSize == size) {
-        GST_DEBUG_OBJECT (basepayload, "end size=%d iteration=%d", size, ii);
-        end = 1;
-      }
-      if (IS_ACCESS_UNIT (nalType)) {
-        gst_rtp_buffer_set_marker (&rtp, end && end_of_au);
-      }
-
-      /* FU indicator */
-      payload[0] = (nalHeader & 0x60) | 28;
-
-      /* FU Header */
-      payload[1] = (start << 7) | (end << 6) | (nalHeader & 0x1f);
-
-      gst_rtp_buffer_unmap (&rtp);
-
-      /* insert payload memory block */
-      gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph264pay), outbuf, paybuf,
-          g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
-      gst_buffer_copy_into (outbuf, paybuf, GST_BUFFER_COPY_MEMORY, pos,
-          limitedSize);
-
-      if (!delta_unit)
-        /* Only the first packet sent should not have the flag */
-        delta_unit = TRUE;
-      else
-        GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DELTA_UNIT);
-
-      if (discont) {
-        GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
-        /* Only the first packet sent should have the flag */
-        discont = FALSE;
-      }
-
-      /* add the buffer to the buffer list */
-      gst_buffer_list_add (list, outbuf);
-
-
-      size -= limitedSize;
-      pos += limitedSize;
-      ii++;
-      start = 0;
-    }
-
-    ret = gst_rtp_base_payload_push_list (basepayload, list);
-    gst_buffer_unref (paybuf);
+        size - 1);
+
+    /* We keep 2 bytes for FU indicator and FU Header, the NAL header is
+     * carried by them */
+    nal.fragmented = TRUE;
+    gst_rtp_fragment_buffer (GST_ELEMENT_CAST (rtph264pay), list, paybuf, 1,
+        size - 1, mtu, 2, 2,
+        g_quark_from_static_string (GST_META_TAG_VIDEO_STR),
+        (GstRtpFragmentFunc) gst_rtp_h264_pay_write_packet, &nal);
   }
-  return ret;
+
+  gst_buffer_unref (paybuf);
 }
 
 static GstFlowReturn
@@ -999,6 +936,7 @@ gst_rtp_h264_pay_handle_buffer (GstRTPBasePayload * basepayload,
   GArray *nal_queue;
   gboolean avc;
   GstBuffer *paybuf = NULL;
+  GstBufferList *list;
   gsize skip;
   gboolean delayed_not_delta_unit = FALSE;
   gboolean delayed_discont = FALSE;
@@ -1065,6 +1003,9 @@ gst_rtp_h264_pay_handle_buffer (GstRTPBasePayload * basepayload,
 
   ret = GST_FLOW_OK;
 
+  /* the packets of all the NAL units are pushed at once */
+  list = gst_buffer_list_new ();
+
   /* now loop over all NAL units and put them in a packet
    * FIXME, we should really try to pack multiple NAL units into one RTP packet
    * if we can, especially for the config packets that wont't cause decoder 
@@ -1107,8 +1048,7 @@ gst_rtp_h264_pay_handle_buffer (GstRTPBasePayload * basepayload,
 
       paybuf = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL, offset,
           nal_len);
-      ret =
-          gst_rtp_h264_pay_payload_nal (basepayload, paybuf, dts, pts,
+      gst_rtp_h264_pay_payload_nal (basepayload, list, paybuf, dts, pts,
           end_of_au, rtph264pay->delta_unit, rtph264pay->discont);
 
       if (!rtph264pay->delta_unit)
@@ -1119,9 +1059,6 @@ gst_rtp_h264_pay_handle_buffer (GstRTPBasePayload * basepayload,
         /* Only the first outgoing packet have the DISCONT flag */
         rtph264pay->discont = FALSE;
 
-      if (ret != GST_FLOW_OK)
-        break;
-
       data += nal_len;
       offset += nal_len;
       size -= nal_len;
@@ -1249,8 +1186,7 @@ gst_rtp_h264_pay_handle_buffer (GstRTPBasePayload * basepayload,
       g_assert (paybuf);
 
       /* put the data in one or more RTP packets */
-      ret =
-          gst_rtp_h264_pay_payload_nal (basepayload, paybuf, dts, pts,
+      gst_rtp_h264_pay_payload_nal (basepayload, list, paybuf, dts, pts,
           end_of_au, rtph264pay->delta_unit, rtph264pay->discont);
 
       if (delayed_not_delta_unit) {
@@ -1269,10 +1205,6 @@ gst_rtp_h264_pay_handle_buffer (GstRTPBasePayload * basepayload,
         rtph264pay->discont = FALSE;
       }
 
-      if (ret != GST_FLOW_OK) {
-        break;
-      }
-
       /* move to next NAL packet */
       /* Skips the trailing zeros */
       gst_adapter_flush (rtph264pay->adapter, nal_len - size);
@@ -1288,6 +1220,11 @@ done:
     gst_adapter_unmap (rtph264pay->adapter);
   }
 
+  if (ret == GST_FLOW_OK && gst_buffer_list_length (list) > 0)
+    ret = gst_rtp_base_payload_push_list (basepayload, list);
+  else
+    gst_buffer_list_unref (list);
+
   return ret;
 
 caps_rejected:
@@ -143,6 +143,10 @@ gst_rtp_h265_depay_class_init (GstRtpH265DepayClass * klass)
 static void
 gst_rtp_h265_depay_init (GstRtpH265Depay * rtph265depay)
 {
+  /* the start code shared by all the NAL units of byte-stream output */
+  rtph265depay->sync_bytes = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+      (gpointer) sync_bytes, sizeof (sync_bytes), 0, sizeof (sync_bytes), NULL,
+      NULL);
   rtph265depay->adapter = gst_adapter_new ();
   rtph265depay->picture_adapter = gst_adapter_new ();
   rtph265depay->byte_stream = DEFAULT_BYTE_STREAM;
@@ -160,8 +164,10 @@ static void
 gst_rtp_h265_depay_reset (GstRtpH265Depay * rtph265depay)
 {
   gst_adapter_clear (rtph265depay->adapter);
+  rtph265depay->adapter_n_mem = 0;
   rtph265depay->wait_start = TRUE;
   gst_adapter_clear (rtph265depay->picture_adapter);
+  rtph265depay->picture_n_mem = 0;
   rtph265depay->picture_start = FALSE;
   rtph265depay->last_keyframe = FALSE;
   rtph265depay->last_ts = 0;
@@ -184,6 +190,7 @@ gst_rtp_h265_depay_finalize (GObject * object)
 
   g_free (rtph265depay->stream_format);
 
+  gst_memory_unref (rtph265depay->sync_bytes);
   g_object_unref (rtph265depay->adapter);
   g_object_unref (rtph265depay->picture_adapter);
 
@@ -885,17 +892,29 @@ incomplete_caps:
   }
 }
 
+/* a buffer of the @size bytes at @data in the payload of @rtp, sharing the
+ * memory of the packet */
+static GstBuffer *
+gst_rtp_h265_depay_share (GstRtpH265Depay * rtph265depay, GstRTPBuffer * rtp,
+    const guint8 * data, guint size)
+{
+  guint offset = data - (const guint8 *) gst_rtp_buffer_get_payload (rtp);
+
+  return gst_rtp_share_payload (GST_ELEMENT_CAST (rtph265depay), rtp, offset,
+      size, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+}
+
 static GstBuffer *
 gst_rtp_h265_complete_au (GstRtpH265Depay * rtph265depay,
     GstClockTime * out_timestamp, gboolean * out_keyframe)
 {
-  guint outsize;
   GstBuffer *outbuf;
 
   /* we had a picture in the adapter and we completed it */
   GST_DEBUG_OBJECT (rtph265depay, "taking completed AU");
-  outsize = gst_adapter_available (rtph265depay->picture_adapter);
-  outbuf = gst_adapter_take_buffer (rtph265depay->picture_adapter, outsize);
+  outbuf = gst_rtp_adapter_take_all (rtph265depay->picture_adapter,
+      rtph265depay->picture_n_mem);
+  rtph265depay->picture_n_mem = 0;
 
   *out_timestamp = rtph265depay->last_ts;
   *out_keyframe = rtph265depay->last_keyframe;
@@ -936,16 +955,18 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
 {
   GstRTPBaseDepayload *depayload = GST_RTP_BASE_DEPAYLOAD (rtph265depay);
   gint nal_type;
-  GstMapInfo map;
+  guint8 header[7] = { 0, };
   GstBuffer *outbuf = NULL;
   GstClockTime out_timestamp;
   gboolean keyframe, out_keyframe;
 
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  if (G_UNLIKELY (map.size < 5))
+  if (G_UNLIKELY (gst_buffer_get_size (nal) < 5))
     goto short_nal;
 
-  nal_type = (map.data[4] >> 1) & 0x3f;
+  /* the NAL unit spans several memories, only read the headers */
+  gst_buffer_extract (nal, 0, header, sizeof (header));
+
+  nal_type = (header[4] >> 1) & 0x3f;
   GST_DEBUG_OBJECT (rtph265depay, "handle NAL type %d (RTP marker bit %d)",
       nal_type, marker);
 
@@ -959,7 +980,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
       gst_rtp_h265_depay_add_vps_sps_pps (rtph265depay,
           gst_buffer_copy_region (nal, GST_BUFFER_COPY_ALL,
               4, gst_buffer_get_size (nal) - 4));
-      gst_buffer_unmap (nal, &map);
       gst_buffer_unref (nal);
       return NULL;
     } else if (rtph265depay->sps->len == 0 || rtph265depay->pps->len == 0) {
@@ -970,7 +990,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
           gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
               gst_structure_new ("GstForceKeyUnit",
                   "all-headers", G_TYPE_BOOLEAN, TRUE, NULL)));
-      gst_buffer_unmap (nal, &map);
       gst_buffer_unref (nal);
       return NULL;
     }
@@ -989,7 +1008,7 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
       if (NAL_TYPE_IS_CODED_SLICE_SEGMENT (nal_type)) {
         /* A NAL unit (X) ends an access unit if the next-occurring VCL NAL unit (Y) has the high-order bit of the first byte after its NAL unit header equal to 1 */
         start = TRUE;
-        if (((map.data[6] >> 7) & 0x01) == 1) {
+        if (((header[6] >> 7) & 0x01) == 1) {
           complete = TRUE;
         }
       } else if ((nal_type >= 32 && nal_type <= 35)
@@ -1005,9 +1024,8 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
             &out_keyframe);
     }
     /* add to adapter */
-    gst_buffer_unmap (nal, &map);
-
     GST_DEBUG_OBJECT (depayload, "adding NAL to picture adapter");
+    rtph265depay->picture_n_mem += gst_buffer_n_memory (nal);
     gst_adapter_push (rtph265depay->picture_adapter, nal);
     rtph265depay->last_ts = in_timestamp;
     rtph265depay->last_keyframe |= keyframe;
@@ -1020,7 +1038,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
     /* no merge, output is input nal */
     GST_DEBUG_OBJECT (depayload, "using NAL as output");
     outbuf = nal;
-    gst_buffer_unmap (nal, &map);
   }
 
   if (outbuf) {
@@ -1053,7 +1070,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
 short_nal:
   {
     GST_WARNING_OBJECT (depayload, "dropping short NAL");
-    gst_buffer_unmap (nal, &map);
     gst_buffer_unref (nal);
     return NULL;
   }
@@ -1064,21 +1080,22 @@ gst_rtp_h265_push_fragmentation_unit (GstRtpH265Depay * rtph265depay,
     gboolean send)
 {
   guint outsize;
-  GstMapInfo map;
   GstBuffer *outbuf;
 
-  outsize = gst_adapter_available (rtph265depay->adapter);
-  outbuf = gst_adapter_take_buffer (rtph265depay->adapter, outsize);
+  /* keep room for the start code */
+  outbuf = gst_rtp_adapter_take_all (rtph265depay->adapter,
+      rtph265depay->adapter_n_mem + 1);
+  rtph265depay->adapter_n_mem = 0;
 
-  gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
+  outsize = gst_buffer_get_size (outbuf);
   GST_DEBUG_OBJECT (rtph265depay, "output %d bytes", outsize);
 
   if (rtph265depay->byte_stream) {
-    memcpy (map.data, sync_bytes, sizeof (sync_bytes));
+    gst_buffer_prepend_memory (outbuf,
+        gst_memory_ref (rtph265depay->sync_bytes));
   } else {
     goto not_implemented;
   }
-  gst_buffer_unmap (outbuf, &map);
 
   rtph265depay->current_fu_type = 0;
 
@@ -1095,7 +1112,7 @@ not_implemented:
   {
     GST_ERROR_OBJECT (rtph265depay,
         ("Only bytestream format is currently supported."));
-    gst_buffer_unmap (outbuf, &map);
+    gst_buffer_unref (outbuf);
     return NULL;
   }
 }
@@ -1112,6 +1129,7 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
   /* flush remaining data on discont */
   if (GST_BUFFER_IS_DISCONT (rtp->buffer)) {
     gst_adapter_clear (rtph265depay->adapter);
+    rtph265depay->adapter_n_mem = 0;
     rtph265depay->wait_start = TRUE;
     rtph265depay->current_fu_type = 0;
   }
@@ -1120,6 +1138,7 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
     gint payload_len;
     guint8 *payload;
     guint header_len;
+    GstMemory *mem;
     GstMapInfo map;
     guint outsize, nalu_size;
     GstClockTime timestamp;
@@ -1218,6 +1237,7 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
 #endif
 
         while (payload_len > 2) {
+          gboolean last;
 
           nalu_size = (payload[0] << 8) | payload[1];
 
@@ -1225,39 +1245,40 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           if (nalu_size > (payload_len - 2))
             nalu_size = payload_len - 2;
 
-          outsize = nalu_size + sizeof (sync_bytes);
-          outbuf = gst_buffer_new_and_alloc (outsize);
+          /* the marker bit applies to the last NAL unit of the packet, the
+           * others don't end the access unit */
+          last = payload_len - 2 - nalu_size <= 2;
 
-          gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-          if (rtph265depay->byte_stream) {
-            memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-          } else {
+          if (!rtph265depay->byte_stream)
             goto not_implemented;
-          }
 
           /* strip NALU size */
           payload += 2;
           payload_len -= 2;
 
-          memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-          gst_buffer_unmap (outbuf, &map);
-
-          gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf,
-              rtp->buffer, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+          outbuf = gst_rtp_h265_depay_share (rtph265depay, rtp, payload,
+              nalu_size);
+          gst_buffer_prepend_memory (outbuf,
+              gst_memory_ref (rtph265depay->sync_bytes));
 
           outbuf =
               gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf, timestamp,
-              marker);
-          if (outbuf)
+              marker && last);
+          if (outbuf) {
+            rtph265depay->adapter_n_mem += gst_buffer_n_memory (outbuf);
             gst_adapter_push (rtph265depay->adapter, outbuf);
+          }
 
           payload += nalu_size;
           payload_len -= nalu_size;
         }
 
         outsize = gst_adapter_available (rtph265depay->adapter);
-        if (outsize > 0)
-          outbuf = gst_adapter_take_buffer (rtph265depay->adapter, outsize);
+        if (outsize > 0) {
+          outbuf = gst_rtp_adapter_take_all (rtph265depay->adapter,
+              rtph265depay->adapter_n_mem);
+          rtph265depay->adapter_n_mem = 0;
+        }
         break;
       }
       case 49:
@@ -1287,6 +1308,9 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
         payload += header_len;
         payload_len -= header_len;
 
+        if (payload_len < 1)
+          goto short_fu;
+
         /* processing FU header */
         S = (payload[0] & 0x80) == 0x80;
         E = (payload[0] & 0x40) == 0x40;
@@ -1323,28 +1347,25 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
               ((payload[0] & 0x3f) << 9) | (nuh_layer_id << 3) |
               nuh_temporal_id_plus1;
 
-          /* go back one byte so we can copy the payload + two bytes more in the front which
-           * will be overwritten by the nal_header
-           */
-          payload -= 1;
-          payload_len += 1;
-
-          nalu_size = payload_len;
-          outsize = nalu_size + sizeof (sync_bytes);
-          outbuf = gst_buffer_new_and_alloc (outsize);
+          /* strip off FU header byte, the data follows the reconstructed
+           * NAL header */
+          payload += 1;
+          payload_len -= 1;
 
-          gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-          memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-          map.data[sizeof (sync_bytes)] = nal_header >> 8;
-          map.data[sizeof (sync_bytes) + 1] = nal_header & 0xff;
-          gst_buffer_unmap (outbuf, &map);
+          outbuf = gst_rtp_h265_depay_share (rtph265depay, rtp, payload,
+              payload_len);
 
-          gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf,
-              rtp->buffer, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+          mem = gst_allocator_alloc (NULL, 2, NULL);
+          gst_memory_map (mem, &map, GST_MAP_WRITE);
+          GST_WRITE_UINT16_BE (map.data, nal_header);
+          gst_memory_unmap (mem, &map);
+          gst_buffer_prepend_memory (outbuf, mem);
 
+          outsize = payload_len + 2;
           GST_DEBUG_OBJECT (rtph265depay, "queueing %d bytes", outsize);
 
           /* and assemble in the adapter */
+          rtph265depay->adapter_n_mem += gst_buffer_n_memory (outbuf);
           gst_adapter_push (rtph265depay->adapter, outbuf);
         } else {
 
@@ -1356,15 +1377,13 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           payload_len -= 1;
 
           outsize = payload_len;
-          outbuf = gst_buffer_new_and_alloc (outsize);
-          gst_buffer_fill (outbuf, 0, payload, outsize);
-
-          gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf,
-              rtp->buffer, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+          outbuf = gst_rtp_h265_depay_share (rtph265depay, rtp, payload,
+              outsize);
 
           GST_DEBUG_OBJECT (rtph265depay, "queueing %d bytes", outsize);
 
           /* and assemble in the adapter */
+          rtph265depay->adapter_n_mem += gst_buffer_n_memory (outbuf);
           gst_adapter_push (rtph265depay->adapter, outbuf);
         }
 
@@ -1392,21 +1411,14 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           goto not_implemented_donl_present;
 #endif
 
-        nalu_size = payload_len;
-        outsize = nalu_size + sizeof (sync_bytes);
-        outbuf = gst_buffer_new_and_alloc (outsize);
-
-        gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-        if (rtph265depay->byte_stream) {
-          memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-        } else {
+        if (!rtph265depay->byte_stream)
           goto not_implemented;
-        }
-        memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-        gst_buffer_unmap (outbuf, &map);
 
-        gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf,
-            rtp->buffer, g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+        nalu_size = payload_len;
+        outbuf = gst_rtp_h265_depay_share (rtph265depay, rtp, payload,
+            nalu_size);
+        gst_buffer_prepend_memory (outbuf,
+            gst_memory_ref (rtph265depay->sync_bytes));
 
         outbuf = gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf, timestamp,
             marker);
@@ -1423,6 +1435,11 @@ empty_packet:
     GST_DEBUG_OBJECT (rtph265depay, "empty packet");
     return NULL;
   }
+short_fu:
+  {
+    GST_DEBUG_OBJECT (rtph265depay, "dropping short FU");
+    return NULL;
+  }
 waiting_start:
   {
     GST_DEBUG_OBJECT (rtph265depay, "waiting for start");
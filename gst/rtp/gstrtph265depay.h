@@ -60,12 +60,15 @@ struct _GstRtpH265Depay
   gboolean byte_stream;
 
   GstBuffer *codec_data;
+  GstMemory *sync_bytes;
   GstAdapter *adapter;
+  guint adapter_n_mem;
   gboolean wait_start;
 
   /* nal merging */
   gboolean merge;
   GstAdapter *picture_adapter;
+  guint picture_n_mem;
   gboolean picture_start;
   GstClockTime last_ts;
   gboolean last_keyframe;
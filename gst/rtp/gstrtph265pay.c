@@ -102,13 +102,38 @@ GST_STATIC_PAD_TEMPLATE ("src",
     );
 
 #define DEFAULT_CONFIG_INTERVAL		      0
+#define DEFAULT_AGGREGATE_MODE		      GST_H265_AGGREGATE_NONE
 
 enum
 {
   PROP_0,
-  PROP_CONFIG_INTERVAL
+  PROP_CONFIG_INTERVAL,
+  PROP_AGGREGATE_MODE
 };
 
+#define GST_TYPE_RTP_H265_AGGREGATE_MODE \
+  (gst_rtp_h265_aggregate_mode_get_type ())
+
+static GType
+gst_rtp_h265_aggregate_mode_get_type (void)
+{
+  static GType type = 0;
+  static const GEnumValue values[] = {
+    {GST_H265_AGGREGATE_NONE, "Do not aggregate NAL units", "none"},
+    {GST_H265_AGGREGATE_ZERO_LATENCY,
+        "Aggregate the NAL units of an input buffer", "zero-latency"},
+    {GST_H265_AGGREGATE_MAX,
+        "Aggregate the NAL units of an access unit, even across input buffers",
+        "max"},
+    {0, NULL, NULL},
+  };
+
+  if (!type) {
+    type = g_enum_register_static ("GstRtpH265AggregateMode", values);
+  }
+  return type;
+}
+
 #define IS_ACCESS_UNIT(x) (((x) >= 0x00) && ((x) < 0x20))
 
 static void gst_rtp_h265_pay_finalize (GObject * object);
@@ -157,6 +182,22 @@ gst_rtp_h265_pay_class_init (GstRtpH265PayClass * klass)
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
       );
 
+  /**
+   * GstRtpH265Pay:aggregate-mode:
+   *
+   * Send the NAL units smaller than the MTU in Aggregation Packets (RFC 7798
+   * section 4.4.2). An aggregation packet holds as many NAL units of the same
+   * access unit as fit in the MTU.
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_AGGREGATE_MODE,
+      g_param_spec_enum ("aggregate-mode",
+          "Attempt to use aggregation packets",
+          "Bundle suitable NAL units into aggregation packets",
+          GST_TYPE_RTP_H265_AGGREGATE_MODE, DEFAULT_AGGREGATE_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+      );
+
   gobject_class->finalize = gst_rtp_h265_pay_finalize;
 
   gst_element_class_add_static_pad_template (gstelement_class,
@@ -193,6 +234,9 @@ gst_rtp_h265_pay_init (GstRtpH265Pay * rtph265pay)
       (GDestroyNotify) gst_buffer_unref);
   rtph265pay->last_vps_sps_pps = -1;
   rtph265pay->vps_sps_pps_interval = DEFAULT_CONFIG_INTERVAL;
+  rtph265pay->aggregate_mode = DEFAULT_AGGREGATE_MODE;
+  rtph265pay->bundle = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
 
   rtph265pay->adapter = gst_adapter_new ();
 }
@@ -205,6 +249,14 @@ gst_rtp_h265_pay_clear_vps_sps_pps (GstRtpH265Pay * rtph265pay)
   g_ptr_array_set_size (rtph265pay->pps, 0);
 }
 
+static void
+gst_rtp_h265_pay_reset_bundle (GstRtpH265Pay * rtph265pay)
+{
+  g_ptr_array_set_size (rtph265pay->bundle, 0);
+  rtph265pay->bundle_size = 0;
+  rtph265pay->bundle_end_of_au = FALSE;
+}
+
 static void
 gst_rtp_h265_pay_finalize (GObject * object)
 {
@@ -217,6 +269,7 @@ gst_rtp_h265_pay_finalize (GObject * object)
   g_ptr_array_free (rtph265pay->sps, TRUE);
   g_ptr_array_free (rtph265pay->pps, TRUE);
   g_ptr_array_free (rtph265pay->vps, TRUE);
+  g_ptr_array_free (rtph265pay->bundle, TRUE);
 
   g_object_unref (rtph265pay->adapter);
 
@@ -806,16 +859,16 @@ gst_rtp_h265_pay_decode_nal (GstRtpH265Pay * payloader,
   return updated;
 }
 
-static GstFlowReturn
-gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
-    GPtrArray * paybufs, GstClockTime dts, GstClockTime pts);
+static void
+gst_rtp_h265_pay_add_nals (GstRTPBasePayload * basepayload,
+    GstBufferList * list, GPtrArray * paybufs, GstClockTime dts,
+    GstClockTime pts);
 
-static GstFlowReturn
+static void
 gst_rtp_h265_pay_send_vps_sps_pps (GstRTPBasePayload * basepayload,
-    GstRtpH265Pay * rtph265pay, GstClockTime dts, GstClockTime pts)
+    GstRtpH265Pay * rtph265pay, GstBufferList * list, GstClockTime dts,
+    GstClockTime pts)
 {
-  GstFlowReturn ret = GST_FLOW_OK;
-  gboolean sent_all_vps_sps_pps = TRUE;
   guint i;
   GPtrArray *bufs;
 
@@ -843,27 +896,209 @@ gst_rtp_h265_pay_send_vps_sps_pps (GstRTPBasePayload * basepayload,
     g_ptr_array_add (bufs, gst_buffer_ref (pps_buf));
   }
 
-  ret = gst_rtp_h265_pay_payload_nal (basepayload, bufs, dts, pts);
-  if (ret != GST_FLOW_OK) {
-    /* not critical but warn */
-    GST_WARNING_OBJECT (basepayload, "failed pushing VPS/SPS/PPS");
+  gst_rtp_h265_pay_add_nals (basepayload, list, bufs, dts, pts);
+
+  if (pts != -1)
+    rtph265pay->last_vps_sps_pps = pts;
+}
+
+typedef struct
+{
+  GstClockTime dts, pts;
+  guint8 nal_header[2];
+  gboolean fragmented;
+  gboolean end_of_au;
+} GstRtpH265PayNal;
+
+static void
+gst_rtp_h265_pay_write_packet (GstElement * element, GstRTPBuffer * rtp,
+    gsize offset, gboolean last, GstRtpH265PayNal * nal)
+{
+  /* timestamp the outbuffer */
+  GST_BUFFER_PTS (rtp->buffer) = nal->pts;
+  GST_BUFFER_DTS (rtp->buffer) = nal->dts;
+
+  /* set the marker bit on the last packet of an access unit */
+  gst_rtp_buffer_set_marker (rtp, last && nal->end_of_au);
 
-    sent_all_vps_sps_pps = FALSE;
+  if (nal->fragmented) {
+    guint8 *payload = gst_rtp_buffer_get_payload (rtp);
+
+    /* PayloadHdr (type = 49) */
+    payload[0] = (nal->nal_header[0] & 0x81) | (49 << 1);
+    payload[1] = nal->nal_header[1];
+
+    /* FU Header, the first fragment starts after the NAL header */
+    payload[2] = ((offset == 2) << 7) | (last << 6) |
+        ((nal->nal_header[0] >> 1) & 0x3f);
   }
+}
 
-  if (pts != -1 && sent_all_vps_sps_pps)
-    rtph265pay->last_vps_sps_pps = pts;
+/* add the packets of the NAL unit @paybuf to @list */
+static void
+gst_rtp_h265_pay_add_nal (GstRtpH265Pay * rtph265pay, GstBufferList * list,
+    GstBuffer * paybuf, GstRtpH265PayNal * nal)
+{
+  guint mtu, size, packet_len;
 
-  return ret;
+  mtu = GST_RTP_BASE_PAYLOAD_MTU (rtph265pay);
+  size = gst_buffer_get_size (paybuf);
+  gst_buffer_extract (paybuf, 0, nal->nal_header, 2);
+
+  packet_len = gst_rtp_buffer_calc_packet_len (size, 0, 0);
+
+  if (packet_len < mtu) {
+    GST_DEBUG_OBJECT (rtph265pay,
+        "NAL Unit fit in one packet datasize=%d mtu=%d", size, mtu);
+    /* will fit in one packet */
+    nal->fragmented = FALSE;
+    gst_rtp_fragment_buffer (GST_ELEMENT_CAST (rtph265pay), list, paybuf, 0,
+        size, mtu, 0, 0, g_quark_from_static_string (GST_META_TAG_VIDEO_STR),
+        (GstRtpFragmentFunc) gst_rtp_h265_pay_write_packet, nal);
+  } else {
+    /* fragmentation Units */
+    GST_DEBUG_OBJECT (rtph265pay,
+        "NAL Unit DOES NOT fit in one packet datasize=%d mtu=%d", size, mtu);
+
+    GST_DEBUG_OBJECT (rtph265pay, "Using FU fragmentation for data size=%d",
+        size - 2);
+
+    /* We keep 3 bytes for PayloadHdr and FU Header, the NAL header is
+     * carried by them */
+    nal->fragmented = TRUE;
+    gst_rtp_fragment_buffer (GST_ELEMENT_CAST (rtph265pay), list, paybuf, 2,
+        size - 2, mtu, 3, 3,
+        g_quark_from_static_string (GST_META_TAG_VIDEO_STR),
+        (GstRtpFragmentFunc) gst_rtp_h265_pay_write_packet, nal);
+  }
+
+  gst_buffer_unref (paybuf);
+}
+
+/* add the waiting NAL units to @list, in an aggregation packet when there is
+ * more than one */
+static void
+gst_rtp_h265_pay_add_bundle (GstRtpH265Pay * rtph265pay, GstBufferList * list)
+{
+  GPtrArray *bundle = rtph265pay->bundle;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *outbuf;
+  guint8 *payload;
+  guint8 f = 0, layer_id = 0x3f, tid = 0x07;
+  guint i, pos;
+
+  if (bundle->len == 0)
+    return;
+
+  if (bundle->len == 1) {
+    GstRtpH265PayNal nal;
+
+    nal.dts = rtph265pay->bundle_dts;
+    nal.pts = rtph265pay->bundle_pts;
+    nal.end_of_au = rtph265pay->bundle_end_of_au;
+    gst_rtp_h265_pay_add_nal (rtph265pay, list,
+        gst_buffer_ref (g_ptr_array_index (bundle, 0)), &nal);
+    gst_rtp_h265_pay_reset_bundle (rtph265pay);
+    return;
+  }
+
+  GST_DEBUG_OBJECT (rtph265pay, "aggregating %u NAL units in %u bytes",
+      bundle->len, rtph265pay->bundle_size);
+
+  /* the NAL units are small, they are copied after their size */
+  outbuf = gst_rtp_buffer_new_allocate (2 + rtph265pay->bundle_size, 0, 0);
+  gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+
+  pos = 2;
+  for (i = 0; i < bundle->len; i++) {
+    GstBuffer *paybuf = g_ptr_array_index (bundle, i);
+    guint8 *nal_header = payload + pos + 2;
+    gsize size = gst_buffer_get_size (paybuf);
+
+    GST_WRITE_UINT16_BE (payload + pos, size);
+    gst_buffer_extract (paybuf, 0, nal_header, size);
+
+    /* F is set if any NAL unit has it, LayerId and TID are the lowest of
+     * the NAL units */
+    f |= nal_header[0] & 0x80;
+    layer_id = MIN (layer_id,
+        ((nal_header[0] & 0x01) << 5) | (nal_header[1] >> 3));
+    tid = MIN (tid, nal_header[1] & 0x07);
+
+    gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265pay), outbuf, paybuf,
+        g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+
+    pos += 2 + size;
+  }
+
+  /* PayloadHdr (type = 48) */
+  payload[0] = f | (48 << 1) | (layer_id >> 5);
+  payload[1] = ((layer_id & 0x1f) << 3) | tid;
+
+  gst_rtp_buffer_set_marker (&rtp, rtph265pay->bundle_end_of_au);
+  gst_rtp_buffer_unmap (&rtp);
+
+  GST_BUFFER_PTS (outbuf) = rtph265pay->bundle_pts;
+  GST_BUFFER_DTS (outbuf) = rtph265pay->bundle_dts;
+
+  gst_buffer_list_add (list, outbuf);
+
+  gst_rtp_h265_pay_reset_bundle (rtph265pay);
 }
 
+/* queue @paybuf for an aggregation packet, the waiting NAL units are sent
+ * first when it would not fit in the MTU with them */
+static void
+gst_rtp_h265_pay_bundle_nal (GstRtpH265Pay * rtph265pay, GstBufferList * list,
+    GstBuffer * paybuf, GstRtpH265PayNal * nal)
+{
+  guint mtu = GST_RTP_BASE_PAYLOAD_MTU (rtph265pay);
+  /* NALU size field and NAL unit */
+  guint size = 2 + gst_buffer_get_size (paybuf);
+
+  if (rtph265pay->bundle->len > 0 &&
+      gst_rtp_buffer_calc_packet_len (2 + rtph265pay->bundle_size + size, 0,
+          0) > mtu)
+    gst_rtp_h265_pay_add_bundle (rtph265pay, list);
+
+  if (rtph265pay->bundle->len == 0) {
+    rtph265pay->bundle_dts = nal->dts;
+    rtph265pay->bundle_pts = nal->pts;
+  }
+  g_ptr_array_add (rtph265pay->bundle, paybuf);
+  rtph265pay->bundle_size += size;
+  rtph265pay->bundle_end_of_au = nal->end_of_au;
+
+  /* the last NAL unit of an access unit completes the packet */
+  if (nal->end_of_au)
+    gst_rtp_h265_pay_add_bundle (rtph265pay, list);
+}
+
+/* push the waiting NAL units on their own */
 static GstFlowReturn
-gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
-    GPtrArray * paybufs, GstClockTime dts, GstClockTime pts)
+gst_rtp_h265_pay_push_bundle (GstRtpH265Pay * rtph265pay)
+{
+  GstBufferList *list;
+
+  if (rtph265pay->bundle->len == 0)
+    return GST_FLOW_OK;
+
+  list = gst_buffer_list_new_sized (1);
+  gst_rtp_h265_pay_add_bundle (rtph265pay, list);
+
+  return gst_rtp_base_payload_push_list (GST_RTP_BASE_PAYLOAD (rtph265pay),
+      list);
+}
+
+/* add the packets of @paybufs, the NAL units of an access unit, to @list */
+static void
+gst_rtp_h265_pay_add_nals (GstRTPBasePayload * basepayload,
+    GstBufferList * list, GPtrArray * paybufs, GstClockTime dts,
+    GstClockTime pts)
 {
   GstRtpH265Pay *rtph265pay;
   guint mtu;
-  GstFlowReturn ret;
   gint i;
   gboolean sent_ps;
 
@@ -876,28 +1111,17 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
               (basepayload))))
     gst_rtp_h265_pay_set_vps_sps_pps (basepayload);
 
-  ret = GST_FLOW_OK;
   sent_ps = FALSE;
   for (i = 0; i < paybufs->len; i++) {
     guint8 nalHeader[2];
     guint8 nalType;
-    guint packet_len, payload_len;
     GstBuffer *paybuf;
-    GstBuffer *outbuf;
-    guint8 *payload;
-    GstBufferList *outlist = NULL;
     gboolean send_ps;
-    GstRTPBuffer rtp = { NULL };
+    GstRtpH265PayNal nal;
     guint size;
 
     paybuf = g_ptr_array_index (paybufs, i);
 
-    if (ret != GST_FLOW_OK) {
-      /* unref buffers that will not be payloaded after a flow error */
-      gst_buffer_unref (paybuf);
-      continue;
-    }
-
     size = gst_buffer_get_size (paybuf);
     gst_buffer_extract (paybuf, 0, nalHeader, 2);
     nalType = (nalHeader[0] >> 1) & 0x3f;
@@ -967,130 +1191,58 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
       rtph265pay->send_vps_sps_pps = FALSE;
       sent_ps = TRUE;
       GST_DEBUG_OBJECT (rtph265pay, "sending VPS/SPS/PPS before current frame");
-      ret =
-          gst_rtp_h265_pay_send_vps_sps_pps (basepayload, rtph265pay, dts, pts);
-      if (ret != GST_FLOW_OK) {
-        gst_buffer_unref (paybuf);
-        continue;
-      }
+      gst_rtp_h265_pay_send_vps_sps_pps (basepayload, rtph265pay, list, dts,
+          pts);
     }
 
-    packet_len = gst_rtp_buffer_calc_packet_len (size, 0, 0);
-
-    if (packet_len < mtu) {
-      GST_DEBUG_OBJECT (rtph265pay,
-          "NAL Unit fit in one packet datasize=%d mtu=%d", size, mtu);
-      /* will fit in one packet */
-
-      /* use buffer lists
-       * create buffer without payload containing only the RTP header
-       * (memory block at index 0) */
-      outbuf = gst_rtp_buffer_new_allocate (0, 0, 0);
-
-      gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
-
-      /* only set the marker bit on packets containing access units */
-      if (i == paybufs->len - 1
-          && rtph265pay->alignment == GST_H265_ALIGNMENT_AU
-          && IS_ACCESS_UNIT (nalType)) {
-        gst_rtp_buffer_set_marker (&rtp, 1);
-      }
-
-      /* timestamp the outbuffer */
-      GST_BUFFER_PTS (outbuf) = pts;
-      GST_BUFFER_DTS (outbuf) = dts;
-
-      /* insert payload memory block */
-      gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265pay), outbuf, paybuf,
-          g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
-      outbuf = gst_buffer_append (outbuf, paybuf);
-
-      outlist = gst_buffer_list_new ();
-
-      /* add the buffer to the buffer list */
-      gst_buffer_list_add (outlist, outbuf);
+    nal.dts = dts;
+    nal.pts = pts;
+    /* only set the marker bit on packets containing access units */
+    nal.end_of_au = i == paybufs->len - 1
+        && rtph265pay->alignment == GST_H265_ALIGNMENT_AU
+        && IS_ACCESS_UNIT (nalType);
 
-      gst_rtp_buffer_unmap (&rtp);
-
-      /* push the list to the next element in the pipe */
-      ret = gst_rtp_base_payload_push_list (basepayload, outlist);
+    if (rtph265pay->aggregate_mode != GST_H265_AGGREGATE_NONE &&
+        gst_rtp_buffer_calc_packet_len (2 + 2 + size, 0, 0) <= mtu) {
+      gst_rtp_h265_pay_bundle_nal (rtph265pay, list, paybuf, &nal);
     } else {
-      /* fragmentation Units */
-      guint limitedSize;
-      int ii = 0, start = 1, end = 0, pos = 0;
-
-      GST_DEBUG_OBJECT (basepayload,
-          "NAL Unit DOES NOT fit in one packet datasize=%d mtu=%d", size, mtu);
-
-      pos += 2;
-      size -= 2;
-
-      GST_DEBUG_OBJECT (basepayload, "Using FU fragmentation for data size=%d",
-          size);
-
-      /* We keep 3 bytes for PayloadHdr and FU Header */
-      payload_len = gst_rtp_buffer_calc_payload_len (mtu - 3, 0, 0);
-
-      outlist = gst_buffer_list_new ();
-
-      while (end == 0) {
-        limitedSize = size < payload_len ? size : payload_len;
-        GST_DEBUG_OBJECT (basepayload,
-            "Inside  FU fragmentation limitedSize=%d iteration=%d", limitedSize,
-            ii);
-
-        /* use buffer lists
-         * create buffer without payload containing only the RTP header
-         * (memory block at index 0), and with space for PayloadHdr and FU header */
-        outbuf = gst_rtp_buffer_new_allocate (3, 0, 0);
-
-        gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
-
-        GST_BUFFER_DTS (outbuf) = dts;
-        GST_BUFFER_PTS (outbuf) = pts;
-        payload = gst_rtp_buffer_get_payload (&rtp);
-
-        if (limitedSize == size) {
-          GST_DEBUG_OBJECT (basepayload, "end size=%d iteration=%d", size, ii);
-          end = 1;
-        }
-
-        /* PayloadHdr (type = 49) */
-        payload[0] = (nalHeader[0] & 0x81) | (49 << 1);
-        payload[1] = nalHeader[1];
-
-        /* set the marker bit on the last packet of an access unit */
-        if (IS_ACCESS_UNIT (nalType)) {
-          gst_rtp_buffer_set_marker (&rtp,
-              end && i == paybufs->len - 1
-              && rtph265pay->alignment == GST_H265_ALIGNMENT_AU);
-        }
+      /* send the waiting NAL units first to keep the order */
+      gst_rtp_h265_pay_add_bundle (rtph265pay, list);
+      gst_rtp_h265_pay_add_nal (rtph265pay, list, paybuf, &nal);
+    }
+  }
 
-        /* FU Header */
-        payload[2] = (start << 7) | (end << 6) | (nalType & 0x3f);
+  g_ptr_array_free (paybufs, TRUE);
+}
 
-        gst_rtp_buffer_unmap (&rtp);
+/* push the NAL units of @paybufs in one list */
+static GstFlowReturn
+gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
+    GPtrArray * paybufs, GstClockTime dts, GstClockTime pts, gboolean discont)
+{
+  GstRtpH265Pay *rtph265pay = GST_RTP_H265_PAY (basepayload);
+  GstBufferList *list;
+  GstFlowReturn ret = GST_FLOW_OK;
 
-        /* insert payload memory block */
-        gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265pay), outbuf, paybuf,
-            g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
-        gst_buffer_copy_into (outbuf, paybuf, GST_BUFFER_COPY_MEMORY, pos,
-            limitedSize);
-        /* add the buffer to the buffer list */
-        gst_buffer_list_add (outlist, outbuf);
+  /* the NAL units of an aggregation packet have the same timestamp, and a
+   * list gets the timestamp of its first packet. Without a timestamp the
+   * waiting NAL units may belong to another frame, so send them too, as
+   * after a discontinuity */
+  if (rtph265pay->bundle->len > 0 && (discont
+          || !GST_CLOCK_TIME_IS_VALID (pts) || rtph265pay->bundle_pts != pts))
+    ret = gst_rtp_h265_pay_push_bundle (rtph265pay);
 
-        size -= limitedSize;
-        pos += limitedSize;
-        ii++;
-        start = 0;
-      }
+  list = gst_buffer_list_new_sized (paybufs->len);
+  gst_rtp_h265_pay_add_nals (basepayload, list, paybufs, dts, pts);
 
-      ret = gst_rtp_base_payload_push_list (basepayload, outlist);
-      gst_buffer_unref (paybuf);
-    }
-  }
+  /* in zero-latency mode, nothing waits for the next buffer */
+  if (rtph265pay->aggregate_mode == GST_H265_AGGREGATE_ZERO_LATENCY)
+    gst_rtp_h265_pay_add_bundle (rtph265pay, list);
 
-  g_ptr_array_free (paybufs, TRUE);
+  if (ret == GST_FLOW_OK && gst_buffer_list_length (list) > 0)
+    ret = gst_rtp_base_payload_push_list (basepayload, list);
+  else
+    gst_buffer_list_unref (list);
 
   return ret;
 }
@@ -1107,7 +1259,7 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
   const guint8 *data;
   GstClockTime dts, pts;
   GArray *nal_queue;
-  gboolean hevc;
+  gboolean hevc, discont;
   GstBuffer *paybuf = NULL;
   gsize skip;
 
@@ -1117,6 +1269,7 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
 
   hevc = (rtph265pay->stream_format == GST_H265_STREAM_FORMAT_HEV1)
       || (rtph265pay->stream_format == GST_H265_STREAM_FORMAT_HVC1);
+  discont = buffer != NULL && GST_BUFFER_IS_DISCONT (buffer);
 
   if (hevc) {
     /* In hevc mode, there is no adapter, so nothing to flush */
@@ -1192,7 +1345,8 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
       offset += nal_len;
       size -= nal_len;
     }
-    ret = gst_rtp_h265_pay_payload_nal (basepayload, paybufs, dts, pts);
+    ret = gst_rtp_h265_pay_payload_nal (basepayload, paybufs, dts, pts,
+        discont);
   } else {
     guint next;
     gboolean update = FALSE;
@@ -1297,7 +1451,8 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
       gst_adapter_flush (rtph265pay->adapter, nal_len - size);
     }
     /* put the data in one or more RTP packets */
-    ret = gst_rtp_h265_pay_payload_nal (basepayload, paybufs, dts, pts);
+    ret = gst_rtp_h265_pay_payload_nal (basepayload, paybufs, dts, pts,
+        discont);
     g_array_set_size (nal_queue, 0);
   }
 
@@ -1330,6 +1485,7 @@ gst_rtp_h265_pay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_FLUSH_STOP:
       gst_adapter_clear (rtph265pay->adapter);
+      gst_rtp_h265_pay_reset_bundle (rtph265pay);
       break;
     case GST_EVENT_CUSTOM_DOWNSTREAM:
       s = gst_event_get_structure (event);
@@ -1347,6 +1503,8 @@ gst_rtp_h265_pay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
        * in byte-stream mode
        */
       gst_rtp_h265_pay_handle_buffer (payload, NULL);
+      /* and the NAL units waiting for an aggregation packet */
+      gst_rtp_h265_pay_push_bundle (rtph265pay);
       break;
     }
     case GST_EVENT_STREAM_START:
@@ -1373,6 +1531,7 @@ gst_rtp_h265_pay_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_READY_TO_PAUSED:
       rtph265pay->send_vps_sps_pps = FALSE;
       gst_adapter_clear (rtph265pay->adapter);
+      gst_rtp_h265_pay_reset_bundle (rtph265pay);
       break;
     default:
       break;
@@ -1404,6 +1563,9 @@ gst_rtp_h265_pay_set_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       rtph265pay->vps_sps_pps_interval = g_value_get_int (value);
       break;
+    case PROP_AGGREGATE_MODE:
+      rtph265pay->aggregate_mode = g_value_get_enum (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1422,6 +1584,9 @@ gst_rtp_h265_pay_get_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       g_value_set_int (value, rtph265pay->vps_sps_pps_interval);
       break;
+    case PROP_AGGREGATE_MODE:
+      g_value_set_enum (value, rtph265pay->aggregate_mode);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -47,6 +47,13 @@ typedef enum
   GST_H265_ALIGNMENT_AU
 } GstH265Alignment;
 
+typedef enum
+{
+  GST_H265_AGGREGATE_NONE,
+  GST_H265_AGGREGATE_ZERO_LATENCY,
+  GST_H265_AGGREGATE_MAX
+} GstH265AggregateMode;
+
 struct _GstRtpH265Pay
 {
   GstRTPBasePayload payload;
@@ -63,6 +70,13 @@ struct _GstRtpH265Pay
   gint vps_sps_pps_interval;
   gboolean send_vps_sps_pps;
   GstClockTime last_vps_sps_pps;
+
+  GstH265AggregateMode aggregate_mode;
+  /* NAL units waiting to be sent in an aggregation packet */
+  GPtrArray *bundle;
+  guint bundle_size;
+  gboolean bundle_end_of_au;
+  GstClockTime bundle_dts, bundle_pts;
 };
 
 struct _GstRtpH265PayClass
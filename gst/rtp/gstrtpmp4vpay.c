@@ -227,11 +227,18 @@ gst_rtp_mp4v_pay_empty (GstRtpMP4VPay * rtpmp4vpay)
 
 #define RTP_HEADER_LEN 12
 
+static void
+gst_rtp_mp4v_pay_write_header (GstRtpMP4VPay * rtpmp4vpay,
+    GstRTPBuffer * rtp, gsize offset, gboolean last, gpointer user_data)
+{
+  gst_rtp_buffer_set_marker (rtp, last);
+  GST_BUFFER_PTS (rtp->buffer) = rtpmp4vpay->first_timestamp;
+}
+
 static GstFlowReturn
 gst_rtp_mp4v_pay_flush (GstRtpMP4VPay * rtpmp4vpay)
 {
   guint avail, mtu;
-  GstBuffer *outbuf;
   GstBuffer *outbuf_data = NULL;
   GstFlowReturn ret;
   GstBufferList *list = NULL;
@@ -259,43 +266,15 @@ gst_rtp_mp4v_pay_flush (GstRtpMP4VPay * rtpmp4vpay)
    * at once */
   list = gst_buffer_list_new_sized ((avail / (mtu - RTP_HEADER_LEN)) + 1);
 
-  while (avail > 0) {
-    guint towrite;
-    guint payload_len;
-    guint packet_len;
-    GstRTPBuffer rtp = { NULL };
-
-    /* this will be the total lenght of the packet */
-    packet_len = gst_rtp_buffer_calc_packet_len (avail, 0, 0);
-
-    /* fill one MTU or all available bytes */
-    towrite = MIN (packet_len, mtu);
-
-    /* this is the payload length */
-    payload_len = gst_rtp_buffer_calc_payload_len (towrite, 0, 0);
+  /* Take buffer with the payload from the adapter, the packets share its
+   * memory */
+  outbuf_data = gst_adapter_take_buffer_fast (rtpmp4vpay->adapter, avail);
 
-    /* create buffer without payload. The payload will be put
-     * in next buffer instead. Both buffers will be merged */
-    outbuf = gst_rtp_buffer_new_allocate (0, 0, 0);
-
-    /* Take buffer with the payload from the adapter */
-    outbuf_data = gst_adapter_take_buffer_fast (rtpmp4vpay->adapter,
-        payload_len);
-
-    avail -= payload_len;
-
-    gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
-    gst_rtp_buffer_set_marker (&rtp, avail == 0);
-    gst_rtp_buffer_unmap (&rtp);
-    gst_rtp_copy_meta (GST_ELEMENT_CAST (rtpmp4vpay), outbuf, outbuf_data,
-        g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
-    outbuf = gst_buffer_append (outbuf, outbuf_data);
-
-    GST_BUFFER_PTS (outbuf) = rtpmp4vpay->first_timestamp;
-
-    /* add to list */
-    gst_buffer_list_insert (list, -1, outbuf);
-  }
+  /* fill one MTU or all available bytes in each packet */
+  gst_rtp_fragment_buffer (GST_ELEMENT_CAST (rtpmp4vpay), list, outbuf_data, 0,
+      avail, mtu, 0, 0, g_quark_from_static_string (GST_META_TAG_VIDEO_STR),
+      (GstRtpFragmentFunc) gst_rtp_mp4v_pay_write_header, NULL);
+  gst_buffer_unref (outbuf_data);
 
   /* push the whole buffer list at once */
   ret =
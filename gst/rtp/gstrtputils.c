@@ -19,6 +19,8 @@
 
 #include "gstrtputils.h"
 
+#include <string.h>
+
 typedef struct
 {
   GstElement *element;
@@ -96,6 +98,228 @@ gst_rtp_drop_meta (GstElement * element, GstBuffer * buf, GQuark keep_tag)
   gst_buffer_foreach_meta (buf, foreach_metadata_drop, &data);
 }
 
+/**
+ * gst_rtp_fragment_buffer:
+ * @element: the payloader
+ * @list: the list of the packets of the frame
+ * @buffer: the buffer to payload
+ * @offset: the offset of the data to payload in @buffer
+ * @size: the size of the data to payload
+ * @mtu: the maximum size of a packet
+ * @first_header_len: the size of the payload header of the first packet
+ * @header_len: the size of the payload header of the other packets
+ * @copy_tag: the tag of the metas to copy from @buffer to the packets
+ * @func: the function writing the headers of each packet
+ * @user_data: user data passed to @func
+ *
+ * Split @size bytes of @buffer at @offset in as few packets of at most @mtu
+ * bytes as possible and add them to @list. The packets are made of a new
+ * memory with the RTP header and the payload header, followed by the
+ * memories of @buffer, so the data of the frame is not copied.
+ *
+ * Returns: the number of packets added to @list.
+ */
+guint
+gst_rtp_fragment_buffer (GstElement * element, GstBufferList * list,
+    GstBuffer * buffer, gsize offset, gsize size, guint mtu,
+    guint first_header_len, guint header_len, GQuark copy_tag,
+    GstRtpFragmentFunc func, gpointer user_data)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  gsize end = offset + size;
+  guint hdr_len = first_header_len;
+  guint n_packets = 0;
+
+  do {
+    GstBuffer *outbuf;
+    gsize len;
+
+    g_return_val_if_fail (gst_rtp_buffer_calc_packet_len (hdr_len, 0,
+            0) < mtu, n_packets);
+
+    len = gst_rtp_buffer_calc_payload_len (mtu - hdr_len, 0, 0);
+    len = MIN (len, end - offset);
+
+    outbuf = gst_rtp_buffer_new_allocate (hdr_len, 0, 0);
+    gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
+    func (element, &rtp, offset, offset + len == end, user_data);
+    gst_rtp_buffer_unmap (&rtp);
+
+    gst_rtp_copy_meta (element, outbuf, buffer, copy_tag);
+    gst_buffer_copy_into (outbuf, buffer, GST_BUFFER_COPY_MEMORY, offset, len);
+    gst_buffer_list_add (list, outbuf);
+
+    GST_LOG_OBJECT (element, "fragment of %" G_GSIZE_FORMAT " bytes at %"
+        G_GSIZE_FORMAT, len, offset);
+
+    offset += len;
+    hdr_len = header_len;
+    n_packets++;
+  } while (offset < end);
+
+  return n_packets;
+}
+
+/**
+ * gst_rtp_share_payload:
+ * @element: the depayloader
+ * @rtp: the packet
+ * @offset: the offset of the data in the payload of @rtp
+ * @size: the size of the data
+ * @copy_tag: the tag of the metas to copy from the packet
+ *
+ * Make a buffer of @size bytes of the payload of @rtp at @offset. The buffer
+ * shares the memory of the packet, the data is not copied.
+ *
+ * Returns: a new #GstBuffer.
+ */
+GstBuffer *
+gst_rtp_share_payload (GstElement * element, GstRTPBuffer * rtp,
+    guint offset, guint size, GQuark copy_tag)
+{
+  GstBuffer *outbuf;
+
+  outbuf = gst_buffer_copy_region (rtp->buffer, GST_BUFFER_COPY_MEMORY,
+      gst_rtp_buffer_get_header_len (rtp) + offset, size);
+  gst_rtp_copy_meta (element, outbuf, rtp->buffer, copy_tag);
+
+  return outbuf;
+}
+
+static gint
+compare_memory_size (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const gsize *sizes = user_data;
+  guint idx_a = *(const guint *) a, idx_b = *(const guint *) b;
+
+  /* biggest first, and in order for the same size so that neighbours are
+   * kept together */
+  if (sizes[idx_a] != sizes[idx_b])
+    return sizes[idx_a] < sizes[idx_b] ? 1 : -1;
+
+  return idx_a < idx_b ? -1 : idx_a > idx_b;
+}
+
+/* copy @mems from @start to @end in one new memory */
+static GstMemory *
+merge_memories (GstMemory ** mems, const gsize * sizes, guint start,
+    guint end)
+{
+  GstMemory *mem;
+  GstMapInfo map, src_map;
+  gsize size = 0, offset = 0;
+  guint i;
+
+  for (i = start; i < end; i++)
+    size += sizes[i];
+
+  mem = gst_allocator_alloc (NULL, size, NULL);
+  gst_memory_map (mem, &map, GST_MAP_WRITE);
+  for (i = start; i < end; i++) {
+    gst_memory_map (mems[i], &src_map, GST_MAP_READ);
+    memcpy (map.data + offset, src_map.data, src_map.size);
+    offset += src_map.size;
+    gst_memory_unmap (mems[i], &src_map);
+  }
+  gst_memory_unmap (mem, &map);
+
+  return mem;
+}
+
+/**
+ * gst_rtp_adapter_take_all:
+ * @adapter: a #GstAdapter
+ * @n_mem: the number of memories of the buffers queued in @adapter, plus the
+ *   ones the caller will add to the buffer
+ *
+ * Take all the data queued in @adapter as one buffer. The buffer is made of
+ * the memories of the queued buffers when they fit in one buffer. Else the
+ * biggest memories are kept and the runs of memories between them are copied
+ * once each in a new memory, so that only the smallest part of the data is
+ * copied.
+ *
+ * Returns: a new #GstBuffer.
+ */
+GstBuffer *
+gst_rtp_adapter_take_all (GstAdapter * adapter, guint n_mem)
+{
+  gsize size = gst_adapter_available (adapter);
+  guint max_mem = gst_buffer_get_max_memory ();
+  GstBufferList *list;
+  GstBuffer *buf, *outbuf;
+  GstMemory **mems;
+  gsize *sizes;
+  guint *order;
+  gboolean *shared;
+  guint i, j, n, len, reserve, room, n_out;
+
+  if (n_mem <= max_mem)
+    return gst_adapter_take_buffer_fast (adapter, size);
+
+  /* a buffer with too many memories merges them on every addition */
+  list = gst_adapter_take_buffer_list (adapter, size);
+  len = gst_buffer_list_length (list);
+
+  for (i = 0, n = 0; i < len; i++)
+    n += gst_buffer_n_memory (gst_buffer_list_get (list, i));
+
+  /* leave room for the memories the caller adds */
+  reserve = n_mem > n ? n_mem - n : 0;
+  room = max_mem - MIN (reserve, max_mem - 1);
+
+  mems = g_new (GstMemory *, n);
+  sizes = g_new (gsize, n);
+  order = g_new (guint, n);
+  shared = g_new0 (gboolean, n);
+
+  for (i = 0, n = 0; i < len; i++) {
+    buf = gst_buffer_list_get (list, i);
+    for (j = 0; j < gst_buffer_n_memory (buf); j++, n++) {
+      mems[n] = gst_buffer_peek_memory (buf, j);
+      sizes[n] = gst_memory_get_sizes (mems[n], NULL, NULL);
+      order[n] = n;
+    }
+  }
+  g_qsort_with_data (order, n, sizeof (guint), compare_memory_size, sizes);
+
+  /* keep the biggest memories while the copied runs between them still fit,
+   * keeping a memory adds one to the count and splits, shortens or removes
+   * the run it was in */
+  n_out = 1;
+  for (i = 0; i < n; i++) {
+    guint idx = order[i];
+    guint add = (idx > 0 && !shared[idx - 1])
+        + (idx + 1 < n && !shared[idx + 1]);
+
+    if (n_out + add > room)
+      continue;
+
+    shared[idx] = TRUE;
+    n_out += add;
+  }
+
+  outbuf = gst_buffer_new ();
+  gst_buffer_copy_into (outbuf, gst_buffer_list_get (list, 0),
+      GST_BUFFER_COPY_METADATA, 0, -1);
+  for (i = 0; i < n; i = j) {
+    if (shared[i]) {
+      gst_buffer_append_memory (outbuf, gst_memory_ref (mems[i]));
+      j = i + 1;
+    } else {
+      for (j = i + 1; j < n && !shared[j]; j++);
+      gst_buffer_append_memory (outbuf, merge_memories (mems, sizes, i, j));
+    }
+  }
+
+  g_free (shared);
+  g_free (order);
+  g_free (sizes);
+  g_free (mems);
+  gst_buffer_list_unref (list);
+
+  return outbuf;
+}
+
 /* Stolen from bad/gst/mpegtsdemux/payloader_parsers.c */
 /* variable length Exp-Golomb parsing according to H.265 spec section 9.2*/
 gboolean
@@ -21,16 +21,45 @@
 #define __GST_RTP_UTILS_H__
 
 #include <gst/gst.h>
+#include <gst/base/gstadapter.h>
 #include <gst/base/gstbitreader.h>
+#include <gst/rtp/gstrtpbuffer.h>
 
 G_BEGIN_DECLS
 
+/**
+ * GstRtpFragmentFunc:
+ * @element: the payloader
+ * @rtp: the packet of a fragment, mapped for writing
+ * @offset: the offset of the fragment payload in the input buffer
+ * @last: %TRUE for the last fragment
+ * @user_data: the user data passed to gst_rtp_fragment_buffer()
+ *
+ * Writes the payload header, the marker bit, the timestamps and the flags of
+ * a packet made by gst_rtp_fragment_buffer().
+ */
+typedef void (*GstRtpFragmentFunc) (GstElement * element, GstRTPBuffer * rtp,
+    gsize offset, gboolean last, gpointer user_data);
+
 G_GNUC_INTERNAL
 void gst_rtp_copy_meta (GstElement * element, GstBuffer *outbuf, GstBuffer *inbuf, GQuark copy_tag);
 
 G_GNUC_INTERNAL
 void gst_rtp_drop_meta (GstElement * element, GstBuffer *buf, GQuark keep_tag);
 
+G_GNUC_INTERNAL
+guint gst_rtp_fragment_buffer (GstElement * element, GstBufferList * list,
+    GstBuffer * buffer, gsize offset, gsize size, guint mtu,
+    guint first_header_len, guint header_len, GQuark copy_tag,
+    GstRtpFragmentFunc func, gpointer user_data);
+
+G_GNUC_INTERNAL
+GstBuffer * gst_rtp_share_payload (GstElement * element, GstRTPBuffer * rtp,
+    guint offset, guint size, GQuark copy_tag);
+
+G_GNUC_INTERNAL
+GstBuffer * gst_rtp_adapter_take_all (GstAdapter * adapter, guint n_mem);
+
 G_GNUC_INTERNAL
 gboolean gst_rtp_read_golomb (GstBitReader * br, guint32 * value);
 
@@ -375,19 +375,21 @@ gst_rtp_vp8_calc_header_len (GstRtpVP8Pay * self)
 }
 
 /* When growing the vp8 header keep max payload len calculation in sync */
-static GstBuffer *
-gst_rtp_vp8_create_header_buffer (GstRtpVP8Pay * self, guint8 partid,
-    gboolean start, gboolean mark, GstBuffer * in)
+static void
+gst_rtp_vp8_write_header (GstRtpVP8Pay * self, GstRTPBuffer * rtp,
+    gsize offset, gboolean last, GstBuffer * in)
 {
-  GstBuffer *out;
   guint8 *p;
-  GstRTPBuffer rtpbuffer = GST_RTP_BUFFER_INIT;
+  guint partition;
+  gboolean start;
+
+  partition = gst_rtp_vp8_offset_to_partition (self, offset);
+  g_assert (partition < self->n_partitions);
+  start = offset == self->partition_offset[partition];
 
-  out = gst_rtp_buffer_new_allocate (gst_rtp_vp8_calc_header_len (self), 0, 0);
-  gst_rtp_buffer_map (out, GST_MAP_READWRITE, &rtpbuffer);
-  p = gst_rtp_buffer_get_payload (&rtpbuffer);
+  p = gst_rtp_buffer_get_payload (rtp);
   /* X=0,R=0,N=0,S=start,PartID=partid */
-  p[0] = (start << 4) | partid;
+  p[0] = (start << 4) | partition;
   if (self->picture_id_mode != VP8_PAY_NO_PICTURE_ID) {
     /* Enable X=1 */
     p[0] |= 0x80;
@@ -403,52 +405,12 @@ gst_rtp_vp8_create_header_buffer (GstRtpVP8Pay * self, guint8 partid,
     }
   }
 
-  gst_rtp_buffer_set_marker (&rtpbuffer, mark);
-
-  gst_rtp_buffer_unmap (&rtpbuffer);
+  gst_rtp_buffer_set_marker (rtp, last);
 
-  GST_BUFFER_DURATION (out) = GST_BUFFER_DURATION (in);
-  GST_BUFFER_PTS (out) = GST_BUFFER_PTS (in);
-
-  return out;
+  GST_BUFFER_DURATION (rtp->buffer) = GST_BUFFER_DURATION (in);
+  GST_BUFFER_PTS (rtp->buffer) = GST_BUFFER_PTS (in);
 }
 
-static guint
-gst_rtp_vp8_payload_next (GstRtpVP8Pay * self, GstBufferList * list,
-    guint offset, GstBuffer * buffer, gsize buffer_size, gsize max_payload_len)
-{
-  guint partition;
-  GstBuffer *header;
-  GstBuffer *sub;
-  GstBuffer *out;
-  gboolean mark;
-  gsize remaining;
-  gsize available;
-
-  remaining = buffer_size - offset;
-  available = max_payload_len;
-  if (available > remaining)
-    available = remaining;
-
-  partition = gst_rtp_vp8_offset_to_partition (self, offset);
-  g_assert (partition < self->n_partitions);
-
-  mark = (remaining == available);
-  /* whole set of partitions, payload them and done */
-  header = gst_rtp_vp8_create_header_buffer (self, partition,
-      offset == self->partition_offset[partition], mark, buffer);
-  sub = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL, offset, available);
-
-  gst_rtp_copy_meta (GST_ELEMENT_CAST (self), header, buffer,
-      g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
-  out = gst_buffer_append (header, sub);
-
-  gst_buffer_list_insert (list, -1, out);
-
-  return available;
-}
-
-
 static GstFlowReturn
 gst_rtp_vp8_pay_handle_buffer (GstRTPBasePayload * payload, GstBuffer * buffer)
 {
@@ -456,7 +418,7 @@ gst_rtp_vp8_pay_handle_buffer (GstRTPBasePayload * payload, GstBuffer * buffer)
   GstFlowReturn ret;
   GstBufferList *list;
   gsize size, max_paylen;
-  guint offset, mtu, vp8_hdr_len;
+  guint mtu, vp8_hdr_len;
 
   size = gst_buffer_get_size (buffer);
 
@@ -472,11 +434,11 @@ gst_rtp_vp8_pay_handle_buffer (GstRTPBasePayload * payload, GstBuffer * buffer)
 
   list = gst_buffer_list_new_sized ((size / max_paylen) + 1);
 
-  offset = 0;
-  while (offset < size) {
-    offset +=
-        gst_rtp_vp8_payload_next (self, list, offset, buffer, size, max_paylen);
-  }
+  /* the packets share the memory of the frame */
+  gst_rtp_fragment_buffer (GST_ELEMENT_CAST (self), list, buffer, 0, size,
+      mtu, vp8_hdr_len, vp8_hdr_len,
+      g_quark_from_static_string (GST_META_TAG_VIDEO_STR),
+      (GstRtpFragmentFunc) gst_rtp_vp8_write_header, buffer);
 
   ret = gst_rtp_base_payload_push_list (payload, list);
 
@@ -374,19 +374,16 @@ gst_rtp_vp9_calc_header_len (GstRtpVP9Pay * self, gboolean start)
 **/
 
 /* When growing the vp9 header keep max payload len calculation in sync */
-static GstBuffer *
-gst_rtp_vp9_create_header_buffer (GstRtpVP9Pay * self,
-    gboolean start, gboolean mark, GstBuffer * in)
+static void
+gst_rtp_vp9_write_header (GstRtpVP9Pay * self, GstRTPBuffer * rtp,
+    gsize offset, gboolean mark, GstBuffer * in)
 {
-  GstBuffer *out;
   guint8 *p;
-  GstRTPBuffer rtpbuffer = GST_RTP_BUFFER_INIT;
   guint off = 1;
+  gboolean start = (offset == 0);
   guint hdrlen = gst_rtp_vp9_calc_header_len (self, start);
 
-  out = gst_rtp_buffer_new_allocate (hdrlen, 0, 0);
-  gst_rtp_buffer_map (out, GST_MAP_READWRITE, &rtpbuffer);
-  p = gst_rtp_buffer_get_payload (&rtpbuffer);
+  p = gst_rtp_buffer_get_payload (rtp);
   p[0] = 0x0;
 
   if (self->picture_id_mode != VP9_PAY_NO_PICTURE_ID) {
@@ -424,46 +421,12 @@ gst_rtp_vp9_create_header_buffer (GstRtpVP9Pay * self,
 
   g_assert_cmpint (off, ==, hdrlen);
 
-  gst_rtp_buffer_set_marker (&rtpbuffer, mark);
-
-  gst_rtp_buffer_unmap (&rtpbuffer);
+  gst_rtp_buffer_set_marker (rtp, mark);
 
-  GST_BUFFER_DURATION (out) = GST_BUFFER_DURATION (in);
-  GST_BUFFER_PTS (out) = GST_BUFFER_PTS (in);
-
-  return out;
+  GST_BUFFER_DURATION (rtp->buffer) = GST_BUFFER_DURATION (in);
+  GST_BUFFER_PTS (rtp->buffer) = GST_BUFFER_PTS (in);
 }
 
-static guint
-gst_rtp_vp9_payload_next (GstRtpVP9Pay * self, GstBufferList * list,
-    guint offset, GstBuffer * buffer, gsize buffer_size, gsize max_payload_len)
-{
-  GstBuffer *header;
-  GstBuffer *sub;
-  GstBuffer *out;
-  gboolean mark;
-  gsize remaining;
-  gsize available;
-
-  remaining = buffer_size - offset;
-  available = max_payload_len;
-  if (available > remaining)
-    available = remaining;
-
-  mark = (remaining == available);
-  header = gst_rtp_vp9_create_header_buffer (self, offset == 0, mark, buffer);
-  sub = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL, offset, available);
-
-  gst_rtp_copy_meta (GST_ELEMENT_CAST (self), header, buffer,
-      g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
-  out = gst_buffer_append (header, sub);
-
-  gst_buffer_list_insert (list, -1, out);
-
-  return available;
-}
-
-
 static GstFlowReturn
 gst_rtp_vp9_pay_handle_buffer (GstRTPBasePayload * payload, GstBuffer * buffer)
 {
@@ -471,7 +434,7 @@ gst_rtp_vp9_pay_handle_buffer (GstRTPBasePayload * payload, GstBuffer * buffer)
   GstFlowReturn ret;
   GstBufferList *list;
   gsize size, max_paylen;
-  guint offset, mtu, vp9_hdr_len;
+  guint mtu, vp9_hdr_len;
 
   size = gst_buffer_get_size (buffer);
 
@@ -487,11 +450,12 @@ gst_rtp_vp9_pay_handle_buffer (GstRTPBasePayload * payload, GstBuffer * buffer)
 
   list = gst_buffer_list_new_sized ((size / max_paylen) + 1);
 
-  offset = 0;
-  while (offset < size) {
-    offset +=
-        gst_rtp_vp9_payload_next (self, list, offset, buffer, size, max_paylen);
-  }
+  /* only the first packet of a key frame has the scalability structure, the
+   * packets share the memory of the frame */
+  gst_rtp_fragment_buffer (GST_ELEMENT_CAST (self), list, buffer, 0, size,
+      mtu, vp9_hdr_len, gst_rtp_vp9_calc_header_len (self, FALSE),
+      g_quark_from_static_string (GST_META_TAG_VIDEO_STR),
+      (GstRtpFragmentFunc) gst_rtp_vp9_write_header, buffer);
 
   ret = gst_rtp_base_payload_push_list (payload, list);
 
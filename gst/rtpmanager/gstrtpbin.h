@@ -75,6 +75,7 @@ struct _GstRtpBin {
   guint32         max_misorder_time;
   gboolean        rfc7273_sync;
   guint           max_streams;
+  gboolean        shared_threads;
 
   /* a list of session */
   GSList         *sessions;
@@ -110,6 +110,7 @@
 
 #include "gstrtpjitterbuffer.h"
 #include "rtpjitterbuffer.h"
+#include "rtpscheduler.h"
 #include "rtpstats.h"
 
 #include <gst/glib-compat-private.h>
@@ -149,6 +150,7 @@ enum
 #define DEFAULT_MAX_DROPOUT_TIME    60000
 #define DEFAULT_MAX_MISORDER_TIME   2000
 #define DEFAULT_RFC7273_SYNC        FALSE
+#define DEFAULT_SHARED_THREADS      FALSE
 
 #define DEFAULT_AUTO_RTX_DELAY (20 * GST_MSECOND)
 #define DEFAULT_AUTO_RTX_TIMEOUT (40 * GST_MSECOND)
@@ -177,7 +179,8 @@ enum
   PROP_MAX_RTCP_RTP_TIME_DIFF,
   PROP_MAX_DROPOUT_TIME,
   PROP_MAX_MISORDER_TIME,
-  PROP_RFC7273_SYNC
+  PROP_RFC7273_SYNC,
+  PROP_SHARED_THREADS
 };
 
 #define JBUF_LOCK(priv)   G_STMT_START {			\
@@ -206,7 +209,12 @@ enum
 #define JBUF_SIGNAL_TIMER(priv) G_STMT_START {            \
   if (G_UNLIKELY ((priv)->waiting_timer)) {               \
     GST_DEBUG ("signal timer");                           \
-    g_cond_signal (&(priv)->jbuf_timer);                  \
+    if ((priv)->timer_task) {                             \
+      (priv)->waiting_timer = FALSE;                      \
+      rtp_scheduler_task_wakeup ((priv)->timer_task);     \
+    } else {                                              \
+      g_cond_signal (&(priv)->jbuf_timer);                \
+    }                                                     \
   }                                                       \
 } G_STMT_END
 
@@ -222,7 +230,12 @@ enum
 #define JBUF_SIGNAL_EVENT(priv) G_STMT_START {           \
   if (G_UNLIKELY ((priv)->waiting_event)) {              \
     GST_DEBUG ("signal event");                          \
-    g_cond_signal (&(priv)->jbuf_event);                 \
+    if ((priv)->output_task) {                           \
+      (priv)->waiting_event = FALSE;                     \
+      rtp_scheduler_task_wakeup ((priv)->output_task);   \
+    } else {                                             \
+      g_cond_signal (&(priv)->jbuf_event);               \
+    }                                                    \
   }                                                      \
 } G_STMT_END
 
@@ -274,6 +287,13 @@ struct _GstRtpJitterBufferPrivate
   gboolean timer_running;
   GThread *timer_thread;
 
+  /* with shared-threads, the timers and the output run as tasks on the
+   * shared thread pools instead of timer_thread and the srcpad task */
+  gboolean shared_threads;
+  RTPSchedulerTask *timer_task;
+  RTPSchedulerTask *output_task;
+  GstClockID async_clock_id;
+
   /* properties */
   guint latency_ms;
   guint64 latency_ns;
@@ -315,7 +335,24 @@ struct _GstRtpJitterBufferPrivate
   GstClockTime last_in_pts;
   guint32 next_in_seqnum;
 
-  GArray *timers;
+  /* binary heap of the pending timers, the next one to expire first, with
+   * the timers of each seqnum chained in timers_by_seqnum. Removed timers
+   * are recycled through free_timers. */
+  GPtrArray *timers;
+  GHashTable *timers_by_seqnum;
+  GPtrArray *free_timers;
+  /* the LOST timers of more than one seqnum, looked up by already_lost() */
+  GPtrArray *lost_ranges;
+  /* scratch arrays of the timer thread */
+  GPtrArray *late_timers;
+  GArray *late_stack;
+  /* scratch array of unschedule_reordered_timers() */
+  GPtrArray *reorder_timers;
+  /* the seqnums below reorder_scan_seqnum that got an EXPECTED timer since
+   * the last reorder scan */
+  GArray *reorder_pending;
+  gboolean reorder_scan_valid;
+  guint16 reorder_scan_seqnum;
   TimerQueue *rtx_stats_timers;
 
   /* start and stop ranges */
@@ -356,6 +393,7 @@ struct _GstRtpJitterBufferPrivate
   guint64 num_lost;
   guint64 num_late;
   guint64 num_duplicates;
+  guint64 num_out_of_range;
   guint64 num_rtx_requests;
   guint64 num_rtx_success;
   guint64 num_rtx_failed;
@@ -377,7 +415,7 @@ typedef enum
   TIMER_TYPE_EOS
 } TimerType;
 
-typedef struct
+typedef struct TimerData
 {
   guint idx;
   guint16 seqnum;
@@ -391,6 +429,11 @@ typedef struct
   GstClockTime rtx_last;
   guint num_rtx_retry;
   guint num_rtx_received;
+
+  /* heap key, get_timeout() when the timer was last updated */
+  GstClockTime sort_timeout;
+  /* next timer with the same seqnum */
+  struct TimerData *next_same;
 } TimerData;
 
 #define GST_RTP_JITTER_BUFFER_GET_PRIVATE(o) \
@@ -486,6 +529,8 @@ static void do_handle_sync (GstRtpJitterBuffer * jitterbuffer);
 
 static void unschedule_current_timer (GstRtpJitterBuffer * jitterbuffer);
 static void remove_all_timers (GstRtpJitterBuffer * jitterbuffer);
+static void free_timer (TimerData * timer);
+static void update_timer_keys (GstRtpJitterBuffer * jitterbuffer);
 
 static void wait_next_timeout (GstRtpJitterBuffer * jitterbuffer);
 
@@ -795,6 +840,14 @@ gst_rtp_jitter_buffer_class_init (GstRtpJitterBufferClass * klass)
    * <listitem>
    *   <para>
    *   #guint64
+   *   <classname>&quot;num-out-of-range&quot;</classname>:
+   *   the number of packets dropped because they were too far from the
+   *   queued packets.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #guint64
    *   <classname>&quot;rtx-count&quot;</classname>:
    *   the number of retransmissions requested.
    *   </para>
@@ -851,6 +904,25 @@ gst_rtp_jitter_buffer_class_init (GstRtpJitterBufferClass * klass)
           "(requires clock and offset to be provided)", DEFAULT_RFC7273_SYNC,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRtpJitterBuffer:shared-threads:
+   *
+   * Run the timers and push the output from pools of threads shared by all
+   * the jitterbuffers of the process instead of two threads per element.
+   * This saves a lot of threads when receiving many streams. The order of
+   * the output of each jitterbuffer is kept but a downstream element that
+   * blocks holds a thread of the output pool, so this works best when
+   * downstream does not sync or block for long. The timers run on a pool of
+   * their own and keep running meanwhile.
+   *
+   * Takes effect on the next READY to PAUSED state change.
+   */
+  g_object_class_install_property (gobject_class, PROP_SHARED_THREADS,
+      g_param_spec_boolean ("shared-threads", "Shared threads",
+          "Use a process-wide thread pool for the timers and the output",
+          DEFAULT_SHARED_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstRtpJitterBuffer::request-pt-map:
    * @buffer: the object which received the signal
@@ -975,11 +1047,19 @@ gst_rtp_jitter_buffer_init (GstRtpJitterBuffer * jitterbuffer)
   priv->max_rtcp_rtp_time_diff = DEFAULT_MAX_RTCP_RTP_TIME_DIFF;
   priv->max_dropout_time = DEFAULT_MAX_DROPOUT_TIME;
   priv->max_misorder_time = DEFAULT_MAX_MISORDER_TIME;
+  priv->shared_threads = DEFAULT_SHARED_THREADS;
 
   priv->last_dts = -1;
   priv->last_rtptime = -1;
   priv->avg_jitter = 0;
-  priv->timers = g_array_new (FALSE, TRUE, sizeof (TimerData));
+  priv->timers = g_ptr_array_new ();
+  priv->timers_by_seqnum = g_hash_table_new (NULL, NULL);
+  priv->free_timers = g_ptr_array_new ();
+  priv->lost_ranges = g_ptr_array_new ();
+  priv->late_timers = g_ptr_array_new ();
+  priv->late_stack = g_array_new (FALSE, FALSE, sizeof (guint));
+  priv->reorder_timers = g_ptr_array_new ();
+  priv->reorder_pending = g_array_new (FALSE, FALSE, sizeof (guint16));
   priv->rtx_stats_timers = timer_queue_new ();
   priv->jbuf = rtp_jitter_buffer_new ();
   g_mutex_init (&priv->jbuf_lock);
@@ -1031,12 +1111,13 @@ gst_rtp_jitter_buffer_init (GstRtpJitterBuffer * jitterbuffer)
 #define ITEM_TYPE_QUERY         3
 
 static RTPJitterBufferItem *
-alloc_item (gpointer data, guint type, GstClockTime dts, GstClockTime pts,
-    guint seqnum, guint count, guint rtptime)
+alloc_item (GstRtpJitterBuffer * jitterbuffer, gpointer data, guint type,
+    GstClockTime dts, GstClockTime pts, guint seqnum, guint count,
+    guint rtptime)
 {
   RTPJitterBufferItem *item;
 
-  item = g_slice_new (RTPJitterBufferItem);
+  item = rtp_jitter_buffer_alloc_item (jitterbuffer->priv->jbuf);
   item->data = data;
   item->next = NULL;
   item->prev = NULL;
@@ -1051,17 +1132,25 @@ alloc_item (gpointer data, guint type, GstClockTime dts, GstClockTime pts,
 }
 
 static void
-free_item (RTPJitterBufferItem * item)
+free_item_data (RTPJitterBufferItem * item, gpointer user_data)
 {
-  g_return_if_fail (item != NULL);
-
   if (item->data && item->type != ITEM_TYPE_QUERY)
     gst_mini_object_unref (item->data);
-  g_slice_free (RTPJitterBufferItem, item);
+  item->data = NULL;
 }
 
 static void
-free_item_and_retain_events (RTPJitterBufferItem * item, gpointer user_data)
+free_item (GstRtpJitterBuffer * jitterbuffer, RTPJitterBufferItem * item)
+{
+  g_return_if_fail (item != NULL);
+
+  free_item_data (item, NULL);
+  rtp_jitter_buffer_free_item (jitterbuffer->priv->jbuf, item);
+}
+
+static void
+free_item_data_and_retain_events (RTPJitterBufferItem * item,
+    gpointer user_data)
 {
   GList **l = user_data;
 
@@ -1071,7 +1160,7 @@ free_item_and_retain_events (RTPJitterBufferItem * item, gpointer user_data)
   } else if (item->data && item->type != ITEM_TYPE_QUERY) {
     gst_mini_object_unref (item->data);
   }
-  g_slice_free (RTPJitterBufferItem, item);
+  item->data = NULL;
 }
 
 static void
@@ -1083,14 +1172,23 @@ gst_rtp_jitter_buffer_finalize (GObject * object)
   jitterbuffer = GST_RTP_JITTER_BUFFER (object);
   priv = jitterbuffer->priv;
 
-  g_array_free (priv->timers, TRUE);
+  remove_all_timers (jitterbuffer);
+  g_ptr_array_foreach (priv->free_timers, (GFunc) free_timer, NULL);
+  g_ptr_array_free (priv->free_timers, TRUE);
+  g_ptr_array_free (priv->timers, TRUE);
+  g_hash_table_destroy (priv->timers_by_seqnum);
+  g_ptr_array_free (priv->lost_ranges, TRUE);
+  g_ptr_array_free (priv->late_timers, TRUE);
+  g_array_free (priv->late_stack, TRUE);
+  g_ptr_array_free (priv->reorder_timers, TRUE);
+  g_array_free (priv->reorder_pending, TRUE);
   timer_queue_free (priv->rtx_stats_timers);
   g_mutex_clear (&priv->jbuf_lock);
   g_cond_clear (&priv->jbuf_timer);
   g_cond_clear (&priv->jbuf_event);
   g_cond_clear (&priv->jbuf_query);
 
-  rtp_jitter_buffer_flush (priv->jbuf, (GFunc) free_item, NULL);
+  rtp_jitter_buffer_flush (priv->jbuf, (GFunc) free_item_data, NULL);
   g_queue_foreach (&priv->gap_packets, (GFunc) gst_buffer_unref, NULL);
   g_queue_clear (&priv->gap_packets);
   g_object_unref (priv->jbuf);
@@ -1290,6 +1388,7 @@ gst_rtp_jitter_buffer_set_active (GstRtpJitterBuffer * jbuf, gboolean active,
     priv->out_offset = offset;
     GST_DEBUG_OBJECT (jbuf, "out offset %" GST_TIME_FORMAT,
         GST_TIME_ARGS (priv->out_offset));
+    update_timer_keys (jbuf);
     priv->active = active;
     JBUF_SIGNAL_EVENT (priv);
   }
@@ -1569,7 +1668,7 @@ gst_rtp_jitter_buffer_flush_stop (GstRtpJitterBuffer * jitterbuffer)
   priv->last_in_pts = 0;
   priv->equidistant = 0;
   GST_DEBUG_OBJECT (jitterbuffer, "flush and reset jitterbuffer");
-  rtp_jitter_buffer_flush (priv->jbuf, (GFunc) free_item, NULL);
+  rtp_jitter_buffer_flush (priv->jbuf, (GFunc) free_item_data, NULL);
   rtp_jitter_buffer_disable_buffering (priv->jbuf, FALSE);
   rtp_jitter_buffer_reset_skew (priv->jbuf);
   remove_all_timers (jitterbuffer);
@@ -1594,17 +1693,30 @@ gst_rtp_jitter_buffer_src_activate_mode (GstPad * pad, GstObject * parent,
         gst_rtp_jitter_buffer_flush_stop (jitterbuffer);
 
         /* start pushing out buffers */
-        GST_DEBUG_OBJECT (jitterbuffer, "Starting task on srcpad");
-        result = gst_pad_start_task (jitterbuffer->priv->srcpad,
-            (GstTaskFunction) gst_rtp_jitter_buffer_loop, jitterbuffer, NULL);
+        if (jitterbuffer->priv->output_task) {
+          GST_DEBUG_OBJECT (jitterbuffer, "Starting shared output task");
+          rtp_scheduler_task_start (jitterbuffer->priv->output_task);
+          result = TRUE;
+        } else {
+          GST_DEBUG_OBJECT (jitterbuffer, "Starting task on srcpad");
+          result = gst_pad_start_task (jitterbuffer->priv->srcpad,
+              (GstTaskFunction) gst_rtp_jitter_buffer_loop, jitterbuffer,
+              NULL);
+        }
       } else {
         /* make sure all data processing stops ASAP */
         gst_rtp_jitter_buffer_flush_start (jitterbuffer);
 
         /* NOTE this will hardlock if the state change is called from the src pad
          * task thread because we will _join() the thread. */
-        GST_DEBUG_OBJECT (jitterbuffer, "Stopping task on srcpad");
-        result = gst_pad_stop_task (pad);
+        if (jitterbuffer->priv->output_task) {
+          GST_DEBUG_OBJECT (jitterbuffer, "Stopping shared output task");
+          rtp_scheduler_task_stop (jitterbuffer->priv->output_task);
+          result = TRUE;
+        } else {
+          GST_DEBUG_OBJECT (jitterbuffer, "Stopping task on srcpad");
+          result = gst_pad_stop_task (pad);
+        }
       }
       break;
     default:
@@ -1638,8 +1750,21 @@ gst_rtp_jitter_buffer_change_state (GstElement * element,
       /* block until we go to PLAYING */
       priv->blocked = TRUE;
       priv->timer_running = TRUE;
-      priv->timer_thread =
-          g_thread_new ("timer", (GThreadFunc) wait_next_timeout, jitterbuffer);
+      if (priv->shared_threads) {
+        priv->timer_task =
+            rtp_scheduler_task_new (RTP_SCHEDULER_POOL_TIMERS,
+            (RTPSchedulerFunc) wait_next_timeout, jitterbuffer);
+        if (priv->timer_task)
+          priv->output_task =
+              rtp_scheduler_task_new (RTP_SCHEDULER_POOL_OUTPUT,
+              (RTPSchedulerFunc) gst_rtp_jitter_buffer_loop, jitterbuffer);
+      }
+      if (priv->timer_task)
+        rtp_scheduler_task_start (priv->timer_task);
+      else
+        priv->timer_thread =
+            g_thread_new ("timer", (GThreadFunc) wait_next_timeout,
+            jitterbuffer);
       JBUF_UNLOCK (priv);
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
@@ -1673,6 +1798,9 @@ gst_rtp_jitter_buffer_change_state (GstElement * element,
         ret = GST_STATE_CHANGE_NO_PREROLL;
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+    {
+      RTPSchedulerTask *timer_task, *output_task;
+
       JBUF_LOCK (priv);
       gst_buffer_replace (&priv->last_sr, NULL);
       priv->timer_running = FALSE;
@@ -1680,9 +1808,30 @@ gst_rtp_jitter_buffer_change_state (GstElement * element,
       JBUF_SIGNAL_TIMER (priv);
       JBUF_SIGNAL_QUERY (priv, FALSE);
       JBUF_UNLOCK (priv);
-      g_thread_join (priv->timer_thread);
-      priv->timer_thread = NULL;
+      if (priv->timer_task) {
+        rtp_scheduler_task_stop (priv->timer_task);
+      } else {
+        g_thread_join (priv->timer_thread);
+        priv->timer_thread = NULL;
+      }
+
+      JBUF_LOCK (priv);
+      if (priv->async_clock_id) {
+        gst_clock_id_unref (priv->async_clock_id);
+        priv->async_clock_id = NULL;
+      }
+      timer_task = priv->timer_task;
+      output_task = priv->output_task;
+      priv->timer_task = NULL;
+      priv->output_task = NULL;
+      JBUF_UNLOCK (priv);
+
+      if (timer_task)
+        rtp_scheduler_task_free (timer_task);
+      if (output_task)
+        rtp_scheduler_task_free (output_task);
       break;
+    }
     case GST_STATE_CHANGE_READY_TO_NULL:
       break;
     default:
@@ -1781,7 +1930,8 @@ queue_event (GstRtpJitterBuffer * jitterbuffer, GstEvent * event)
 
 
   GST_DEBUG_OBJECT (jitterbuffer, "adding event");
-  item = alloc_item (event, ITEM_TYPE_EVENT, -1, -1, -1, 0, -1);
+  item =
+      alloc_item (jitterbuffer, event, ITEM_TYPE_EVENT, -1, -1, -1, 0, -1);
   rtp_jitter_buffer_insert (priv->jbuf, item, &head, NULL);
   if (head)
     JBUF_SIGNAL_EVENT (priv);
@@ -1807,7 +1957,10 @@ gst_rtp_jitter_buffer_sink_event (GstPad * pad, GstObject * parent,
       ret = gst_pad_push_event (priv->srcpad, event);
       gst_rtp_jitter_buffer_flush_start (jitterbuffer);
       /* wait for the loop to go into PAUSED */
-      gst_pad_pause_task (priv->srcpad);
+      if (priv->output_task)
+        rtp_scheduler_task_stop (priv->output_task);
+      else
+        gst_pad_pause_task (priv->srcpad);
       break;
     case GST_EVENT_FLUSH_STOP:
       ret = gst_pad_push_event (priv->srcpad, event);
@@ -2020,6 +2173,7 @@ timer_queue_append (TimerQueue * queue, const TimerData * timer,
   copy->timeout = timeout;
   copy->type = lost ? TIMER_TYPE_LOST : TIMER_TYPE_EXPECTED;
   copy->idx = -1;
+  copy->next_same = NULL;
 
   GST_LOG ("Append rtx-stats timer #%d, %" GST_TIME_FORMAT,
       copy->seqnum, GST_TIME_ARGS (copy->timeout));
@@ -2049,22 +2203,133 @@ timer_queue_find (TimerQueue * queue, guint16 seqnum)
   return g_hash_table_lookup (queue->hashtable, GINT_TO_POINTER (seqnum));
 }
 
+static void
+free_timer (TimerData * timer)
+{
+  g_slice_free (TimerData, timer);
+}
+
+/* returns the oldest timer of @seqnum */
 static TimerData *
 find_timer (GstRtpJitterBuffer * jitterbuffer, guint16 seqnum)
 {
   GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
-  TimerData *timer = NULL;
-  gint i, len;
 
-  len = priv->timers->len;
-  for (i = 0; i < len; i++) {
-    TimerData *test = &g_array_index (priv->timers, TimerData, i);
-    if (test->seqnum == seqnum) {
-      timer = test;
+  return g_hash_table_lookup (priv->timers_by_seqnum,
+      GUINT_TO_POINTER (seqnum));
+}
+
+static void
+timer_index_add (GstRtpJitterBufferPrivate * priv, TimerData * timer)
+{
+  TimerData *head;
+
+  timer->next_same = NULL;
+
+  head = g_hash_table_lookup (priv->timers_by_seqnum,
+      GUINT_TO_POINTER (timer->seqnum));
+  if (head == NULL) {
+    g_hash_table_insert (priv->timers_by_seqnum,
+        GUINT_TO_POINTER (timer->seqnum), timer);
+    return;
+  }
+
+  while (head->next_same)
+    head = head->next_same;
+  head->next_same = timer;
+}
+
+static void
+timer_index_remove (GstRtpJitterBufferPrivate * priv, TimerData * timer)
+{
+  TimerData *head;
+
+  head = g_hash_table_lookup (priv->timers_by_seqnum,
+      GUINT_TO_POINTER (timer->seqnum));
+
+  if (head == timer) {
+    if (timer->next_same)
+      g_hash_table_insert (priv->timers_by_seqnum,
+          GUINT_TO_POINTER (timer->seqnum), timer->next_same);
+    else
+      g_hash_table_remove (priv->timers_by_seqnum,
+          GUINT_TO_POINTER (timer->seqnum));
+  } else {
+    while (head && head->next_same != timer)
+      head = head->next_same;
+    if (head)
+      head->next_same = timer->next_same;
+  }
+
+  timer->next_same = NULL;
+}
+
+/* heap order: immediate timers first, then by timeout, then by seqnum */
+static gboolean
+timer_before (const TimerData * a, const TimerData * b)
+{
+  if (a->sort_timeout == b->sort_timeout)
+    return gst_rtp_buffer_compare_seqnum (a->seqnum, b->seqnum) > 0;
+  if (a->sort_timeout == -1)
+    return TRUE;
+  if (b->sort_timeout == -1)
+    return FALSE;
+
+  return a->sort_timeout < b->sort_timeout;
+}
+
+static inline void
+timer_heap_set (GPtrArray * heap, guint idx, TimerData * timer)
+{
+  g_ptr_array_index (heap, idx) = timer;
+  timer->idx = idx;
+}
+
+static void
+timer_heap_sift_up (GPtrArray * heap, guint idx)
+{
+  TimerData *timer = g_ptr_array_index (heap, idx);
+
+  while (idx > 0) {
+    guint parent = (idx - 1) / 2;
+    TimerData *test = g_ptr_array_index (heap, parent);
+
+    if (!timer_before (timer, test))
+      break;
+
+    timer_heap_set (heap, idx, test);
+    idx = parent;
+  }
+  timer_heap_set (heap, idx, timer);
+}
+
+static void
+timer_heap_sift_down (GPtrArray * heap, guint idx)
+{
+  TimerData *timer = g_ptr_array_index (heap, idx);
+  guint len = heap->len;
+
+  while (TRUE) {
+    guint child = 2 * idx + 1;
+    TimerData *test;
+
+    if (child >= len)
       break;
+
+    test = g_ptr_array_index (heap, child);
+    if (child + 1 < len &&
+        timer_before (g_ptr_array_index (heap, child + 1), test)) {
+      child++;
+      test = g_ptr_array_index (heap, child);
     }
+
+    if (!timer_before (test, timer))
+      break;
+
+    timer_heap_set (heap, idx, test);
+    idx = child;
   }
-  return timer;
+  timer_heap_set (heap, idx, timer);
 }
 
 static void
@@ -2076,6 +2341,9 @@ unschedule_current_timer (GstRtpJitterBuffer * jitterbuffer)
     GST_DEBUG_OBJECT (jitterbuffer, "unschedule current timer");
     gst_clock_id_unschedule (priv->clock_id);
     priv->clock_id = NULL;
+    /* nobody waits on an async clock id, run the timers again */
+    if (priv->timer_task)
+      rtp_scheduler_task_wakeup (priv->timer_task);
   }
 }
 
@@ -2112,6 +2380,82 @@ recalculate_timer (GstRtpJitterBuffer * jitterbuffer, TimerData * timer)
   }
 }
 
+/* move @timer to its place after its timeout or type changed */
+static void
+update_timer_key (GstRtpJitterBuffer * jitterbuffer, TimerData * timer)
+{
+  GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+
+  /* timers kept for the rtx stats are not in the heap */
+  if (timer->idx == -1)
+    return;
+
+  timer->sort_timeout = get_timeout (jitterbuffer, timer);
+  timer_heap_sift_up (priv->timers, timer->idx);
+  timer_heap_sift_down (priv->timers, timer->idx);
+}
+
+/* the latency or an offset changed, which moves all the timers but the
+ * EXPECTED ones, recompute the keys and rebuild the heap */
+static void
+update_timer_keys (GstRtpJitterBuffer * jitterbuffer)
+{
+  GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+  guint i, len = priv->timers->len;
+
+  for (i = 0; i < len; i++) {
+    TimerData *timer = g_ptr_array_index (priv->timers, i);
+    timer->sort_timeout = get_timeout (jitterbuffer, timer);
+  }
+
+  for (i = len / 2; i > 0; i--)
+    timer_heap_sift_down (priv->timers, i - 1);
+}
+
+/* the reorder scan in update_timers() only looks at the seqnums it did not
+ * see yet, remember the EXPECTED timers that show up behind it. Rescan all
+ * the timers when there are more of those than timers. */
+static inline void
+check_reorder_scan (GstRtpJitterBufferPrivate * priv, TimerData * timer)
+{
+  if (!priv->reorder_scan_valid || timer->type != TIMER_TYPE_EXPECTED ||
+      gst_rtp_buffer_compare_seqnum (timer->seqnum,
+          priv->reorder_scan_seqnum) < 0)
+    return;
+
+  if (priv->reorder_pending->len >= priv->timers->len) {
+    g_array_set_size (priv->reorder_pending, 0);
+    priv->reorder_scan_valid = FALSE;
+  } else {
+    g_array_append_val (priv->reorder_pending, timer->seqnum);
+  }
+}
+
+static inline gboolean
+is_lost_range (TimerData * timer)
+{
+  return timer->type == TIMER_TYPE_LOST && timer->num > 1;
+}
+
+static void
+set_timer_type (GstRtpJitterBuffer * jitterbuffer, TimerData * timer,
+    TimerType type)
+{
+  GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+
+  if (timer->type == type)
+    return;
+
+  if (timer->idx != -1 && is_lost_range (timer))
+    g_ptr_array_remove_fast (priv->lost_ranges, timer);
+  timer->type = type;
+  if (timer->idx != -1 && is_lost_range (timer))
+    g_ptr_array_add (priv->lost_ranges, timer);
+
+  check_reorder_scan (priv, timer);
+  update_timer_key (jitterbuffer, timer);
+}
+
 static TimerData *
 add_timer (GstRtpJitterBuffer * jitterbuffer, TimerType type,
     guint16 seqnum, guint num, GstClockTime timeout, GstClockTime delay,
@@ -2119,17 +2463,20 @@ add_timer (GstRtpJitterBuffer * jitterbuffer, TimerType type,
 {
   GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
   TimerData *timer;
-  gint len;
 
   GST_DEBUG_OBJECT (jitterbuffer,
       "add timer %d for seqnum %d to %" GST_TIME_FORMAT ", delay %"
       GST_TIME_FORMAT, type, seqnum, GST_TIME_ARGS (timeout),
       GST_TIME_ARGS (delay));
 
-  len = priv->timers->len;
-  g_array_set_size (priv->timers, len + 1);
-  timer = &g_array_index (priv->timers, TimerData, len);
-  timer->idx = len;
+  if (priv->free_timers->len > 0) {
+    timer = g_ptr_array_remove_index_fast (priv->free_timers,
+        priv->free_timers->len - 1);
+    memset (timer, 0, sizeof (TimerData));
+  } else {
+    timer = g_slice_new0 (TimerData);
+  }
+
   timer->type = type;
   timer->seqnum = seqnum;
   timer->num = num;
@@ -2143,6 +2490,15 @@ add_timer (GstRtpJitterBuffer * jitterbuffer, TimerType type,
   timer->rtx_last = GST_CLOCK_TIME_NONE;
   timer->num_rtx_retry = 0;
   timer->num_rtx_received = 0;
+
+  timer->sort_timeout = get_timeout (jitterbuffer, timer);
+  g_ptr_array_add (priv->timers, timer);
+  timer_heap_sift_up (priv->timers, priv->timers->len - 1);
+  timer_index_add (priv, timer);
+  if (is_lost_range (timer))
+    g_ptr_array_add (priv->lost_ranges, timer);
+  check_reorder_scan (priv, timer);
+
   recalculate_timer (jitterbuffer, timer);
   JBUF_SIGNAL_TIMER (priv);
 
@@ -2175,8 +2531,15 @@ reschedule_timer (GstRtpJitterBuffer * jitterbuffer, TimerData * timer,
       "->%" GST_TIME_FORMAT, timer->type, oldseq, seqnum,
       GST_TIME_ARGS (timer->timeout), GST_TIME_ARGS (new_timeout));
 
+  if (seqchange && timer->idx != -1) {
+    timer_index_remove (priv, timer);
+    timer->seqnum = seqnum;
+    timer_index_add (priv, timer);
+    check_reorder_scan (priv, timer);
+  }
   timer->timeout = new_timeout;
   timer->seqnum = seqnum;
+  update_timer_key (jitterbuffer, timer);
   if (reset) {
     GST_DEBUG_OBJECT (jitterbuffer, "reset rtx delay %" GST_TIME_FORMAT
         "->%" GST_TIME_FORMAT, GST_TIME_ARGS (timer->rtx_delay),
@@ -2232,16 +2595,44 @@ remove_timer (GstRtpJitterBuffer * jitterbuffer, TimerData * timer)
 
   idx = timer->idx;
   GST_DEBUG_OBJECT (jitterbuffer, "removed index %d", idx);
-  g_array_remove_index_fast (priv->timers, idx);
-  timer->idx = idx;
+
+  /* the last timer takes the free slot and is moved to its place */
+  g_ptr_array_remove_index_fast (priv->timers, idx);
+  if (idx < priv->timers->len) {
+    TimerData *moved = g_ptr_array_index (priv->timers, idx);
+
+    timer_heap_sift_up (priv->timers, idx);
+    timer_heap_sift_down (priv->timers, moved->idx);
+  }
+
+  timer_index_remove (priv, timer);
+  if (is_lost_range (timer))
+    g_ptr_array_remove_fast (priv->lost_ranges, timer);
+
+  /* keep the memory, callers may still look at the removed timer */
+  timer->idx = -1;
+  g_ptr_array_add (priv->free_timers, timer);
 }
 
 static void
 remove_all_timers (GstRtpJitterBuffer * jitterbuffer)
 {
   GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+  guint i;
+
   GST_DEBUG_OBJECT (jitterbuffer, "removed all timers");
-  g_array_set_size (priv->timers, 0);
+  for (i = 0; i < priv->timers->len; i++) {
+    TimerData *timer = g_ptr_array_index (priv->timers, i);
+
+    timer->idx = -1;
+    timer->next_same = NULL;
+    g_ptr_array_add (priv->free_timers, timer);
+  }
+  g_ptr_array_set_size (priv->timers, 0);
+  g_hash_table_remove_all (priv->timers_by_seqnum);
+  g_ptr_array_set_size (priv->lost_ranges, 0);
+  g_array_set_size (priv->reorder_pending, 0);
+  priv->reorder_scan_valid = FALSE;
   unschedule_current_timer (jitterbuffer);
 }
 
@@ -2274,15 +2665,14 @@ static gboolean
 already_lost (GstRtpJitterBuffer * jitterbuffer, guint16 seqnum)
 {
   GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
-  gint i, len;
+  guint i;
 
-  len = priv->timers->len;
-  for (i = 0; i < len; i++) {
-    TimerData *test = &g_array_index (priv->timers, TimerData, i);
+  /* only the multi-packet lost timers are looked at, usually none */
+  for (i = 0; i < priv->lost_ranges->len; i++) {
+    TimerData *test = g_ptr_array_index (priv->lost_ranges, i);
     gint gap = gst_rtp_buffer_compare_seqnum (test->seqnum, seqnum);
 
-    if (test->num > 1 && test->type == TIMER_TYPE_LOST && gap >= 0 &&
-        gap < test->num) {
+    if (gap >= 0 && gap < test->num) {
       GST_DEBUG ("seqnum #%d already considered definitely lost (#%d->#%d)",
           seqnum, test->seqnum, (test->seqnum + test->num - 1) & 0xffff);
       return TRUE;
@@ -2292,6 +2682,81 @@ already_lost (GstRtpJitterBuffer * jitterbuffer, guint16 seqnum)
   return FALSE;
 }
 
+/* unschedule the EXPECTED timers that are more than rtx-delay-reorder behind
+ * @seqnum, we don't expect the missing packets to be this reordered.
+ *
+ * Only the seqnums that fell behind the reorder distance since the last call
+ * and the seqnums that got a timer behind the previous scan are looked up in
+ * the seqnum index. All the timers are scanned when the reorder distance
+ * changed, when that is fewer lookups or when too many timers were set
+ * behind the scan. */
+static void
+unschedule_reordered_timers (GstRtpJitterBuffer * jitterbuffer,
+    guint16 seqnum)
+{
+  GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+  GPtrArray *found = priv->reorder_timers;
+  GArray *pending = priv->reorder_pending;
+  guint16 limit;
+  gint i, j, len, n;
+
+  limit = seqnum - priv->rtx_delay_reorder - 1;
+
+  len = priv->timers->len;
+  n = gst_rtp_buffer_compare_seqnum (priv->reorder_scan_seqnum, limit);
+
+  if (priv->reorder_scan_valid && n < len) {
+    /* the pending seqnums that are not behind yet stay pending */
+    for (i = 0, j = 0; i < pending->len; i++) {
+      guint16 pseq = g_array_index (pending, guint16, i);
+      TimerData *test;
+
+      if (gst_rtp_buffer_compare_seqnum (pseq, limit) < 0) {
+        g_array_index (pending, guint16, j++) = pseq;
+        continue;
+      }
+      test = find_timer (jitterbuffer, pseq);
+      for (; test; test = test->next_same)
+        g_ptr_array_add (found, test);
+    }
+    g_array_set_size (pending, j);
+
+    for (i = 1; i <= n; i++) {
+      TimerData *test;
+
+      test = find_timer (jitterbuffer, priv->reorder_scan_seqnum + i);
+      for (; test; test = test->next_same)
+        g_ptr_array_add (found, test);
+    }
+  } else {
+    for (i = 0; i < len; i++) {
+      TimerData *test = g_ptr_array_index (priv->timers, i);
+
+      if (gst_rtp_buffer_compare_seqnum (test->seqnum, seqnum) >
+          priv->rtx_delay_reorder)
+        g_ptr_array_add (found, test);
+    }
+    g_array_set_size (pending, 0);
+  }
+
+  for (i = 0; i < found->len; i++) {
+    TimerData *test = g_ptr_array_index (found, i);
+
+    GST_DEBUG_OBJECT (jitterbuffer, "%d, #%d<->#%d gap %d",
+        test->type, test->seqnum, seqnum,
+        gst_rtp_buffer_compare_seqnum (test->seqnum, seqnum));
+
+    if (test->num_rtx_retry == 0 && test->type == TIMER_TYPE_EXPECTED)
+      reschedule_timer (jitterbuffer, test, test->seqnum, -1, 0, FALSE);
+  }
+  g_ptr_array_set_size (found, 0);
+
+  if (!priv->reorder_scan_valid || n > 0) {
+    priv->reorder_scan_seqnum = limit;
+    priv->reorder_scan_valid = TRUE;
+  }
+}
+
 /* we just received a packet with seqnum and dts.
  *
  * First check for old seqnum that we are still expecting. If the gap with the
@@ -2309,27 +2774,9 @@ update_timers (GstRtpJitterBuffer * jitterbuffer, guint16 seqnum,
 {
   GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
 
-  /* go through all timers and unschedule the ones with a large gap */
-  if (priv->do_retransmission && priv->rtx_delay_reorder > 0) {
-    gint i, len;
-    len = priv->timers->len;
-    for (i = 0; i < len; i++) {
-      TimerData *test = &g_array_index (priv->timers, TimerData, i);
-      gint gap;
-
-      gap = gst_rtp_buffer_compare_seqnum (test->seqnum, seqnum);
-
-      GST_DEBUG_OBJECT (jitterbuffer, "%d, #%d<->#%d gap %d",
-          test->type, test->seqnum, seqnum, gap);
-
-      if (gap > priv->rtx_delay_reorder) {
-        /* max gap, we exceeded the max reorder distance and we don't expect the
-         * missing packet to be this reordered */
-        if (test->num_rtx_retry == 0 && test->type == TIMER_TYPE_EXPECTED)
-          reschedule_timer (jitterbuffer, test, test->seqnum, -1, 0, FALSE);
-      }
-    }
-  }
+  /* unschedule the timers with a large gap */
+  if (priv->do_retransmission && priv->rtx_delay_reorder > 0)
+    unschedule_reordered_timers (jitterbuffer, seqnum);
 
   do_next_seqnum = do_next_seqnum && priv->packet_spacing > 0
       && priv->do_retransmission && priv->rtx_next_seqnum;
@@ -2372,7 +2819,7 @@ update_timers (GstRtpJitterBuffer * jitterbuffer, guint16 seqnum,
         GST_TIME_ARGS (priv->packet_spacing), GST_TIME_ARGS (priv->avg_jitter));
 
     if (timer) {
-      timer->type = TIMER_TYPE_EXPECTED;
+      set_timer_type (jitterbuffer, timer, TIMER_TYPE_EXPECTED);
       reschedule_timer (jitterbuffer, timer, priv->next_in_seqnum, expected,
           delay, TRUE);
     } else {
@@ -2724,7 +3171,7 @@ gst_rtp_jitter_buffer_reset (GstRtpJitterBuffer * jitterbuffer,
 
   GST_DEBUG_OBJECT (jitterbuffer, "flush and reset jitterbuffer");
   rtp_jitter_buffer_flush (priv->jbuf,
-      (GFunc) free_item_and_retain_events, &events);
+      (GFunc) free_item_data_and_retain_events, &events);
   rtp_jitter_buffer_reset_skew (priv->jbuf);
   remove_all_timers (jitterbuffer);
   priv->discont = TRUE;
@@ -2751,7 +3198,8 @@ gst_rtp_jitter_buffer_reset (GstRtpJitterBuffer * jitterbuffer,
   for (l = events; l; l = l->next) {
     RTPJitterBufferItem *item;
 
-    item = alloc_item (l->data, ITEM_TYPE_EVENT, -1, -1, -1, 0, -1);
+    item = alloc_item (jitterbuffer, l->data, ITEM_TYPE_EVENT, -1, -1, -1, 0,
+        -1);
     rtp_jitter_buffer_insert (priv->jbuf, item, &head, NULL);
   }
   g_list_free (events);
@@ -3064,7 +3512,7 @@ gst_rtp_jitter_buffer_chain (GstPad * pad, GstObject * parent,
         GST_DEBUG_OBJECT (jitterbuffer, "Queue full, dropping old packet %p",
             old_item);
         priv->next_seqnum = (old_item->seqnum + old_item->count) & 0xffff;
-        free_item (old_item);
+        free_item (jitterbuffer, old_item);
       }
       /* we might have removed some head buffers, signal the pushing thread to
        * see if it can push now */
@@ -3078,16 +3526,19 @@ gst_rtp_jitter_buffer_chain (GstPad * pad, GstObject * parent,
    * dts that both are unknown */
   if (estimated_dts)
     item =
-        alloc_item (buffer, ITEM_TYPE_BUFFER, GST_CLOCK_TIME_NONE,
-        pts, seqnum, 1, rtptime);
+        alloc_item (jitterbuffer, buffer, ITEM_TYPE_BUFFER,
+        GST_CLOCK_TIME_NONE, pts, seqnum, 1, rtptime);
   else
-    item = alloc_item (buffer, ITEM_TYPE_BUFFER, dts, pts, seqnum, 1, rtptime);
+    item = alloc_item (jitterbuffer, buffer, ITEM_TYPE_BUFFER, dts, pts,
+        seqnum, 1, rtptime);
 
   /* now insert the packet into the queue in sorted order. This function returns
    * FALSE if a packet with the same seqnum was already in the queue, meaning we
-   * have a duplicate. */
+   * have a duplicate, or if it is too far from the queued packets. */
   if (G_UNLIKELY (!rtp_jitter_buffer_insert (priv->jbuf, item, &head,
               &percent))) {
+    if (!rtp_jitter_buffer_fits (priv->jbuf, seqnum))
+      goto out_of_range;
     if (GST_BUFFER_IS_RETRANSMISSION (buffer) && timer)
       update_rtx_stats (jitterbuffer, timer, dts, FALSE);
     goto duplicate;
@@ -3179,7 +3630,15 @@ duplicate:
     GST_DEBUG_OBJECT (jitterbuffer, "Duplicate packet #%d detected, dropping",
         seqnum);
     priv->num_duplicates++;
-    free_item (item);
+    free_item (jitterbuffer, item);
+    goto finished;
+  }
+out_of_range:
+  {
+    GST_WARNING_OBJECT (jitterbuffer, "Packet #%d too far from the queued "
+        "packets, dropping", seqnum);
+    priv->num_out_of_range++;
+    free_item (jitterbuffer, item);
     goto finished;
   }
 rtx_duplicate:
@@ -3284,7 +3743,75 @@ update_estimated_eos (GstRtpJitterBuffer * jitterbuffer,
   }
 }
 
-/* take a buffer from the queue and push it */
+/* maximum number of packets pushed in one buffer list */
+#define MAX_PUSH_BATCH 32
+
+/* set the flags and timestamps of the buffer of @item for pushing, the data
+ * of @item is taken */
+static GstBuffer *
+prepare_output_buffer (GstRtpJitterBuffer * jitterbuffer,
+    RTPJitterBufferItem * item)
+{
+  GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+  GstBuffer *outbuf;
+  GstClockTime dts, pts;
+
+  /* we need to make writable to change the flags and timestamps */
+  outbuf = gst_buffer_make_writable (item->data);
+  item->data = NULL;
+
+  if (G_UNLIKELY (priv->discont)) {
+    /* set DISCONT flag when we missed a packet. We pushed the buffer writable
+     * into the jitterbuffer so we can modify now. */
+    GST_DEBUG_OBJECT (jitterbuffer, "mark output buffer discont");
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+    priv->discont = FALSE;
+  }
+  if (G_UNLIKELY (priv->ts_discont)) {
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_RESYNC);
+    priv->ts_discont = FALSE;
+  }
+
+  dts =
+      gst_segment_position_from_running_time (&priv->segment,
+      GST_FORMAT_TIME, item->dts);
+  pts =
+      gst_segment_position_from_running_time (&priv->segment,
+      GST_FORMAT_TIME, item->pts);
+
+  /* apply timestamp with offset to buffer now */
+  GST_BUFFER_DTS (outbuf) = apply_offset (jitterbuffer, dts);
+  GST_BUFFER_PTS (outbuf) = apply_offset (jitterbuffer, pts);
+
+  /* update the elapsed time when we need to check against the npt stop time. */
+  update_estimated_eos (jitterbuffer, item);
+
+  priv->last_out_time = GST_BUFFER_PTS (outbuf);
+
+  return outbuf;
+}
+
+/* the next packet when it can be pushed right away */
+static RTPJitterBufferItem *
+peek_ready_buffer (GstRtpJitterBuffer * jitterbuffer)
+{
+  GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+  RTPJitterBufferItem *item;
+
+  if (priv->blocked || !priv->active ||
+      rtp_jitter_buffer_is_buffering (priv->jbuf))
+    return NULL;
+
+  item = rtp_jitter_buffer_peek (priv->jbuf);
+  if (item == NULL || item->type != ITEM_TYPE_BUFFER ||
+      item->seqnum != priv->next_seqnum)
+    return NULL;
+
+  return item;
+}
+
+/* take a buffer from the queue and push it. The consecutive packets that are
+ * ready too are pushed with it in a buffer list. */
 static GstFlowReturn
 pop_and_push_next (GstRtpJitterBuffer * jitterbuffer, guint seqnum)
 {
@@ -3292,9 +3819,9 @@ pop_and_push_next (GstRtpJitterBuffer * jitterbuffer, guint seqnum)
   GstFlowReturn result = GST_FLOW_OK;
   RTPJitterBufferItem *item;
   GstBuffer *outbuf = NULL;
+  GstBufferList *outlist = NULL;
   GstEvent *outevent = NULL;
   GstQuery *outquery = NULL;
-  GstClockTime dts, pts;
   gint percent = -1;
   gboolean do_push = TRUE;
   guint type;
@@ -3306,37 +3833,7 @@ pop_and_push_next (GstRtpJitterBuffer * jitterbuffer, guint seqnum)
 
   switch (type) {
     case ITEM_TYPE_BUFFER:
-
-      /* we need to make writable to change the flags and timestamps */
-      outbuf = gst_buffer_make_writable (item->data);
-
-      if (G_UNLIKELY (priv->discont)) {
-        /* set DISCONT flag when we missed a packet. We pushed the buffer writable
-         * into the jitterbuffer so we can modify now. */
-        GST_DEBUG_OBJECT (jitterbuffer, "mark output buffer discont");
-        GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
-        priv->discont = FALSE;
-      }
-      if (G_UNLIKELY (priv->ts_discont)) {
-        GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_RESYNC);
-        priv->ts_discont = FALSE;
-      }
-
-      dts =
-          gst_segment_position_from_running_time (&priv->segment,
-          GST_FORMAT_TIME, item->dts);
-      pts =
-          gst_segment_position_from_running_time (&priv->segment,
-          GST_FORMAT_TIME, item->pts);
-
-      /* apply timestamp with offset to buffer now */
-      GST_BUFFER_DTS (outbuf) = apply_offset (jitterbuffer, dts);
-      GST_BUFFER_PTS (outbuf) = apply_offset (jitterbuffer, pts);
-
-      /* update the elapsed time when we need to check against the npt stop time. */
-      update_estimated_eos (jitterbuffer, item);
-
-      priv->last_out_time = GST_BUFFER_PTS (outbuf);
+      outbuf = prepare_output_buffer (jitterbuffer, item);
       break;
     case ITEM_TYPE_LOST:
       priv->discont = TRUE;
@@ -3357,24 +3854,55 @@ pop_and_push_next (GstRtpJitterBuffer * jitterbuffer, guint seqnum)
     priv->last_popped_seqnum = seqnum;
     priv->next_seqnum = (seqnum + item->count) & 0xffff;
   }
-  msg = check_buffering_percent (jitterbuffer, percent);
-  JBUF_UNLOCK (priv);
 
+  /* the data was taken above, recycle the item while we hold the lock */
   item->data = NULL;
-  free_item (item);
+  free_item (jitterbuffer, item);
+
+  /* collect the packets that follow without gap */
+  if (type == ITEM_TYPE_BUFFER) {
+    while ((item = peek_ready_buffer (jitterbuffer))) {
+      if (outlist == NULL) {
+        outlist = gst_buffer_list_new_sized (MAX_PUSH_BATCH);
+        gst_buffer_list_add (outlist, outbuf);
+        outbuf = NULL;
+      } else if (gst_buffer_list_length (outlist) >= MAX_PUSH_BATCH) {
+        break;
+      }
+
+      item = rtp_jitter_buffer_pop (priv->jbuf, &percent);
+      gst_buffer_list_add (outlist, prepare_output_buffer (jitterbuffer,
+              item));
+      priv->last_popped_seqnum = item->seqnum;
+      priv->next_seqnum = (item->seqnum + item->count) & 0xffff;
+      free_item (jitterbuffer, item);
+    }
+  }
+  msg = check_buffering_percent (jitterbuffer, percent);
+  JBUF_UNLOCK (priv);
 
   if (msg)
     gst_element_post_message (GST_ELEMENT_CAST (jitterbuffer), msg);
 
   switch (type) {
     case ITEM_TYPE_BUFFER:
-      /* push buffer */
-      GST_DEBUG_OBJECT (jitterbuffer,
-          "Pushing buffer %d, dts %" GST_TIME_FORMAT ", pts %" GST_TIME_FORMAT,
-          seqnum, GST_TIME_ARGS (GST_BUFFER_DTS (outbuf)),
-          GST_TIME_ARGS (GST_BUFFER_PTS (outbuf)));
-      priv->num_pushed++;
-      result = gst_pad_push (priv->srcpad, outbuf);
+      if (outlist) {
+        guint len = gst_buffer_list_length (outlist);
+
+        /* push the run of packets at once */
+        GST_DEBUG_OBJECT (jitterbuffer, "Pushing buffers %d to %d",
+            seqnum, (seqnum + len - 1) & 0xffff);
+        priv->num_pushed += len;
+        result = gst_pad_push_list (priv->srcpad, outlist);
+      } else {
+        /* push buffer */
+        GST_DEBUG_OBJECT (jitterbuffer,
+            "Pushing buffer %d, dts %" GST_TIME_FORMAT ", pts %"
+            GST_TIME_FORMAT, seqnum, GST_TIME_ARGS (GST_BUFFER_DTS (outbuf)),
+            GST_TIME_ARGS (GST_BUFFER_PTS (outbuf)));
+        priv->num_pushed++;
+        result = gst_pad_push (priv->srcpad, outbuf);
+      }
 
       JBUF_LOCK_CHECK (priv, out_flushing);
       break;
@@ -3480,7 +4008,7 @@ handle_next_buffer (GstRtpJitterBuffer * jitterbuffer)
       GST_DEBUG_OBJECT (jitterbuffer, "Old packet #%d, next #%d dropping",
           seqnum, next_seqnum);
       item = rtp_jitter_buffer_pop (priv->jbuf, NULL);
-      free_item (item);
+      free_item (jitterbuffer, item);
       result = GST_FLOW_OK;
     } else {
       /* the chain function has scheduled timers to request retransmission or
@@ -3692,7 +4220,7 @@ do_expected_timeout (GstRtpJitterBuffer * jitterbuffer, TimerData * timer,
     GST_DEBUG_OBJECT (jitterbuffer, "reschedule as LOST timer");
     /* too many retransmission request, we now convert the timer
      * to a lost timer, leave the num_rtx_retry as it is for stats */
-    timer->type = TIMER_TYPE_LOST;
+    set_timer_type (jitterbuffer, timer, TIMER_TYPE_LOST);
     timer->rtx_delay = 0;
     timer->rtx_retry = 0;
   }
@@ -3756,10 +4284,11 @@ do_lost_timeout (GstRtpJitterBuffer * jitterbuffer, TimerData * timer,
             "duration", G_TYPE_UINT64, duration,
             "retry", G_TYPE_UINT, num_rtx_retry, NULL));
   }
-  item = alloc_item (event, ITEM_TYPE_LOST, -1, -1, seqnum, lost_packets, -1);
+  item = alloc_item (jitterbuffer, event, ITEM_TYPE_LOST, -1, -1, seqnum,
+      lost_packets, -1);
   if (!rtp_jitter_buffer_insert (priv->jbuf, item, &head, NULL))
     /* Duplicate */
-    free_item (item);
+    free_item (jitterbuffer, item);
 
   if (GST_CLOCK_TIME_IS_VALID (timer->rtx_last)) {
     /* Store info to update stats if the packet arrives too late */
@@ -3839,17 +4368,102 @@ do_timeout (GstRtpJitterBuffer * jitterbuffer, TimerData * timer,
  *
  * If there are no timers, we wait on a gcond until something new happens.
  */
+static gint
+compare_timers (gconstpointer a, gconstpointer b)
+{
+  const TimerData *ta = *(const TimerData **) a;
+  const TimerData *tb = *(const TimerData **) b;
+
+  if (timer_before (ta, tb))
+    return -1;
+  if (timer_before (tb, ta))
+    return 1;
+  return 0;
+}
+
+/* collect the LOST timers that expired in @late, in timeout order. Only the
+ * part of the heap that expired is visited. */
+static void
+collect_late_lost_timers (GstRtpJitterBuffer * jitterbuffer, GPtrArray * late,
+    GstClockTime now)
+{
+  GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+  GArray *stack = priv->late_stack;
+  guint idx;
+
+  if (priv->timers->len == 0)
+    return;
+
+  idx = 0;
+  g_array_append_val (stack, idx);
+
+  while (stack->len > 0) {
+    TimerData *test;
+    guint child;
+
+    idx = g_array_index (stack, guint, stack->len - 1);
+    g_array_set_size (stack, stack->len - 1);
+
+    test = g_ptr_array_index (priv->timers, idx);
+    /* the children of a timer never expire before it */
+    if (test->sort_timeout != -1 && test->sort_timeout > now)
+      continue;
+
+    if (test->type == TIMER_TYPE_LOST)
+      g_ptr_array_add (late, test);
+
+    for (child = 2 * idx + 1; child <= 2 * idx + 2; child++) {
+      if (child < priv->timers->len)
+        g_array_append_val (stack, child);
+    }
+  }
+
+  g_ptr_array_sort (late, compare_timers);
+}
+
+static gboolean
+timer_clock_cb (GstClock * clock, GstClockTime time, GstClockID id,
+    gpointer user_data)
+{
+  GstRtpJitterBuffer *jitterbuffer = user_data;
+  GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
+
+  JBUF_LOCK (priv);
+  if (priv->timer_task && priv->clock_id == id) {
+    GST_DEBUG_OBJECT (jitterbuffer, "sync done, #%d", priv->timer_seqnum);
+    rtp_scheduler_task_wakeup (priv->timer_task);
+  }
+  JBUF_UNLOCK (priv);
+
+  return TRUE;
+}
+
+/* runs in the timer thread or, with shared-threads, as a task of the shared
+ * pool that returns when it needs to wait */
 static void
 wait_next_timeout (GstRtpJitterBuffer * jitterbuffer)
 {
   GstRtpJitterBufferPrivate *priv = jitterbuffer->priv;
   GstClockTime now = 0;
+  GPtrArray *late = priv->late_timers;
+  gboolean running;
 
   JBUF_LOCK (priv);
+  if (priv->async_clock_id) {
+    /* we run on the shared pool, forget the clock id of the last run */
+    if (priv->clock_id == priv->async_clock_id) {
+      gst_clock_id_unschedule (priv->clock_id);
+      priv->clock_id = NULL;
+    }
+    gst_clock_id_unref (priv->async_clock_id);
+    priv->async_clock_id = NULL;
+  }
+  priv->waiting_timer = FALSE;
+
   while (priv->timer_running) {
     TimerData *timer = NULL;
     GstClockTime timer_timeout = -1;
-    gint i, len;
+    guint i;
 
     /* If we have a clock, update "now" now with the very
      * latest running time we have. If timers are unscheduled below we
@@ -3872,60 +4486,28 @@ wait_next_timeout (GstRtpJitterBuffer * jitterbuffer)
     if (priv->do_retransmission)
       timer_queue_clear_until (priv->rtx_stats_timers, now);
 
-    /* Iterate "normal" timers */
-    len = priv->timers->len;
-    for (i = 0; i < len;) {
-      TimerData *test = &g_array_index (priv->timers, TimerData, i);
-      GstClockTime test_timeout = get_timeout (jitterbuffer, test);
-      gboolean save_best = FALSE;
+    /* Weed out anything too late */
+    collect_late_lost_timers (jitterbuffer, late, now);
+    for (i = 0; i < late->len; i++) {
+      TimerData *test = g_ptr_array_index (late, i);
 
-      GST_DEBUG_OBJECT (jitterbuffer,
-          "%d, %d, %d, %" GST_TIME_FORMAT " diff:%" GST_STIME_FORMAT, i,
-          test->type, test->seqnum, GST_TIME_ARGS (test_timeout),
-          GST_STIME_ARGS ((gint64) (test_timeout - now)));
-
-      /* Weed out anything too late */
-      if (test->type == TIMER_TYPE_LOST &&
-          (test_timeout == -1 || test_timeout <= now)) {
-        GST_DEBUG_OBJECT (jitterbuffer, "Weeding out late entry");
-        do_lost_timeout (jitterbuffer, test, now);
-        if (!priv->timer_running)
-          break;
-        /* We don't move the iterator forward since we just removed the current entry,
-         * but we update the termination condition */
-        len = priv->timers->len;
-      } else {
-        /* find the smallest timeout */
-        if (timer == NULL) {
-          save_best = TRUE;
-        } else if (timer_timeout == -1) {
-          /* we already have an immediate timeout, the new timer must be an
-           * immediate timer with smaller seqnum to become the best */
-          if (test_timeout == -1
-              && (gst_rtp_buffer_compare_seqnum (test->seqnum,
-                      timer->seqnum) > 0))
-            save_best = TRUE;
-        } else if (test_timeout == -1) {
-          /* first immediate timer */
-          save_best = TRUE;
-        } else if (test_timeout < timer_timeout) {
-          /* earlier timer */
-          save_best = TRUE;
-        } else if (test_timeout == timer_timeout
-            && (gst_rtp_buffer_compare_seqnum (test->seqnum,
-                    timer->seqnum) > 0)) {
-          /* same timer, smaller seqnum */
-          save_best = TRUE;
-        }
+      GST_DEBUG_OBJECT (jitterbuffer, "Weeding out late entry #%d",
+          test->seqnum);
+      do_lost_timeout (jitterbuffer, test, now);
+    }
+    g_ptr_array_set_size (late, 0);
 
-        if (save_best) {
-          GST_DEBUG_OBJECT (jitterbuffer, "new best %d", i);
-          timer = test;
-          timer_timeout = test_timeout;
-        }
-        i++;
-      }
+    /* the best timer is at the top of the heap */
+    if (priv->timers->len > 0) {
+      timer = g_ptr_array_index (priv->timers, 0);
+      timer_timeout = timer->sort_timeout;
+
+      GST_DEBUG_OBJECT (jitterbuffer,
+          "best %d, %d, %" GST_TIME_FORMAT " diff:%" GST_STIME_FORMAT,
+          timer->type, timer->seqnum, GST_TIME_ARGS (timer_timeout),
+          GST_STIME_ARGS ((gint64) (timer_timeout - now)));
     }
+
     if (timer && !priv->blocked) {
       GstClock *clock;
       GstClockTime sync_time;
@@ -3969,6 +4551,14 @@ wait_next_timeout (GstRtpJitterBuffer * jitterbuffer)
       priv->timer_seqnum = timer->seqnum;
       GST_OBJECT_UNLOCK (jitterbuffer);
 
+      if (priv->timer_task) {
+        /* the task runs again when the clock id fires or is unscheduled */
+        priv->async_clock_id = id;
+        gst_clock_id_wait_async (id, timer_clock_cb,
+            gst_object_ref (jitterbuffer), gst_object_unref);
+        break;
+      }
+
       /* release the lock so that the other end can push stuff or unlock */
       JBUF_UNLOCK (priv);
 
@@ -3992,14 +4582,21 @@ wait_next_timeout (GstRtpJitterBuffer * jitterbuffer)
       /* and free the entry */
       gst_clock_id_unref (id);
       priv->clock_id = NULL;
+    } else if (priv->timer_task) {
+      /* no timers, the task runs again when we are signaled */
+      priv->waiting_timer = TRUE;
+      break;
     } else {
       /* no timers, wait for activity */
       JBUF_WAIT_TIMER (priv);
     }
   }
+  running = priv->timer_running;
   JBUF_UNLOCK (priv);
 
-  GST_DEBUG_OBJECT (jitterbuffer, "we are stopping");
+
+  if (!running)
+    GST_DEBUG_OBJECT (jitterbuffer, "we are stopping");
   return;
 }
 
@@ -4021,6 +4618,12 @@ gst_rtp_jitter_buffer_loop (GstRtpJitterBuffer * jitterbuffer)
   do {
     result = handle_next_buffer (jitterbuffer);
     if (G_LIKELY (result == GST_FLOW_WAIT)) {
+      if (priv->output_task) {
+        /* the task runs again on the next event */
+        priv->waiting_event = TRUE;
+        JBUF_UNLOCK (priv);
+        return;
+      }
       /* now wait for the next event */
       JBUF_WAIT_EVENT (priv, flushing);
       result = GST_FLOW_OK;
@@ -4046,7 +4649,10 @@ pause:
 
     GST_DEBUG_OBJECT (jitterbuffer, "pausing task, reason %s",
         gst_flow_get_name (result));
-    gst_pad_pause_task (priv->srcpad);
+    if (priv->output_task)
+      rtp_scheduler_task_stop (priv->output_task);
+    else
+      gst_pad_pause_task (priv->srcpad);
     if (result == GST_FLOW_EOS) {
       event = gst_event_new_eos ();
       gst_pad_push_event (priv->srcpad, event);
@@ -4256,7 +4862,8 @@ gst_rtp_jitter_buffer_sink_query (GstPad * pad, GstObject * parent,
         if (rtp_jitter_buffer_get_mode (priv->jbuf) !=
             RTP_JITTER_BUFFER_MODE_BUFFER) {
           GST_DEBUG_OBJECT (jitterbuffer, "adding serialized query");
-          item = alloc_item (query, ITEM_TYPE_QUERY, -1, -1, -1, 0, -1);
+          item = alloc_item (jitterbuffer, query, ITEM_TYPE_QUERY, -1, -1, -1,
+              0, -1);
           rtp_jitter_buffer_insert (priv->jbuf, item, &head, NULL);
           if (head)
             JBUF_SIGNAL_EVENT (priv);
@@ -4401,6 +5008,7 @@ gst_rtp_jitter_buffer_set_property (GObject * object,
       priv->latency_ms = new_latency;
       priv->latency_ns = priv->latency_ms * GST_MSECOND;
       rtp_jitter_buffer_set_delay (priv->jbuf, priv->latency_ns);
+      update_timer_keys (jitterbuffer);
       JBUF_UNLOCK (priv);
 
       /* post message if latency changed, this will inform the parent pipeline
@@ -4423,6 +5031,7 @@ gst_rtp_jitter_buffer_set_property (GObject * object,
       JBUF_LOCK (priv);
       priv->ts_offset = g_value_get_int64 (value);
       priv->ts_discont = TRUE;
+      update_timer_keys (jitterbuffer);
       JBUF_UNLOCK (priv);
       break;
     case PROP_DO_LOST:
@@ -4458,6 +5067,7 @@ gst_rtp_jitter_buffer_set_property (GObject * object,
     case PROP_RTX_DELAY_REORDER:
       JBUF_LOCK (priv);
       priv->rtx_delay_reorder = g_value_get_int (value);
+      priv->reorder_scan_valid = FALSE;
       JBUF_UNLOCK (priv);
       break;
     case PROP_RTX_RETRY_TIMEOUT:
@@ -4511,6 +5121,11 @@ gst_rtp_jitter_buffer_set_property (GObject * object,
           g_value_get_boolean (value));
       JBUF_UNLOCK (priv);
       break;
+    case PROP_SHARED_THREADS:
+      JBUF_LOCK (priv);
+      priv->shared_threads = g_value_get_boolean (value);
+      JBUF_UNLOCK (priv);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -4647,6 +5262,11 @@ gst_rtp_jitter_buffer_get_property (GObject * object,
           rtp_jitter_buffer_get_rfc7273_sync (priv->jbuf));
       JBUF_UNLOCK (priv);
       break;
+    case PROP_SHARED_THREADS:
+      JBUF_LOCK (priv);
+      g_value_set_boolean (value, priv->shared_threads);
+      JBUF_UNLOCK (priv);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -4665,6 +5285,7 @@ gst_rtp_jitter_buffer_create_stats (GstRtpJitterBuffer * jbuf)
       "num-lost", G_TYPE_UINT64, priv->num_lost,
       "num-late", G_TYPE_UINT64, priv->num_late,
       "num-duplicates", G_TYPE_UINT64, priv->num_duplicates,
+      "num-out-of-range", G_TYPE_UINT64, priv->num_out_of_range,
       "avg-jitter", G_TYPE_UINT64, priv->avg_jitter,
       "rtx-count", G_TYPE_UINT64, priv->num_rtx_requests,
       "rtx-success-count", G_TYPE_UINT64, priv->num_rtx_success,
@@ -53,6 +53,14 @@ GST_DEBUG_CATEGORY_STATIC (gst_rtp_rtx_send_debug);
 #define DEFAULT_MAX_SIZE_TIME    0
 #define DEFAULT_MAX_SIZE_PACKETS 100
 
+/* the history of a stream starts with this many slots when max-size-packets
+ * is unlimited, and never spans more than half the seqnum space */
+#define MIN_HISTORY_SIZE 64
+#define MAX_HISTORY_SIZE 32768
+
+/* most retransmissions pushed at once in a buffer list */
+#define MAX_RTX_BATCH 32
+
 enum
 {
   PROP_0,
@@ -107,26 +115,27 @@ typedef struct
 {
   guint16 seqnum;
   guint32 timestamp;
-  GstBuffer *buffer;
+  GstBuffer *buffer;            /* NULL when the slot is free */
 } BufferQueueItem;
 
-static void
-buffer_queue_item_free (BufferQueueItem * item)
-{
-  gst_buffer_unref (item->buffer);
-  g_slice_free (BufferQueueItem, item);
-}
-
 typedef struct
 {
   guint32 rtx_ssrc;
   guint16 seqnum_base, next_seqnum;
   gint clock_rate;
 
-  /* history of rtp packets */
-  GSequence *queue;
+  /* history of rtp packets, a ring of slots indexed by seqnum. The window
+   * goes from tail_seqnum to head_seqnum, the slots outside of it are free
+   * and the slots at both ends are used when the window is not empty. */
+  BufferQueueItem *history;
+  guint history_size;           /* a power of 2 */
+  guint16 head_seqnum, tail_seqnum;
+  guint window;                 /* number of seqnums in the window */
 } SSRCRtxData;
 
+#define HISTORY_SLOT(data,seqnum) \
+  (&(data)->history[(seqnum) & ((data)->history_size - 1)])
+
 static SSRCRtxData *
 ssrc_rtx_data_new (guint32 rtx_ssrc)
 {
@@ -134,15 +143,63 @@ ssrc_rtx_data_new (guint32 rtx_ssrc)
 
   data->rtx_ssrc = rtx_ssrc;
   data->next_seqnum = data->seqnum_base = g_random_int_range (0, G_MAXUINT16);
-  data->queue = g_sequence_new ((GDestroyNotify) buffer_queue_item_free);
 
   return data;
 }
 
+/* free the oldest slot of the window */
+static void
+history_drop_tail (SSRCRtxData * data)
+{
+  BufferQueueItem *item = HISTORY_SLOT (data, data->tail_seqnum);
+
+  if (item->buffer) {
+    gst_buffer_unref (item->buffer);
+    item->buffer = NULL;
+  }
+  data->tail_seqnum++;
+  data->window--;
+}
+
+/* free the oldest packet and the free slots after it */
+static void
+history_drop_oldest (SSRCRtxData * data)
+{
+  do {
+    history_drop_tail (data);
+  } while (data->window > 0 && !HISTORY_SLOT (data, data->tail_seqnum)->buffer);
+}
+
+static void
+history_clear (SSRCRtxData * data)
+{
+  while (data->window > 0)
+    history_drop_tail (data);
+}
+
+/* move the window to a ring of @size slots */
+static void
+history_resize (SSRCRtxData * data, guint size)
+{
+  BufferQueueItem *old = data->history;
+  guint old_size = data->history_size;
+  guint i;
+
+  data->history = g_new0 (BufferQueueItem, size);
+  data->history_size = size;
+
+  for (i = 0; i < old_size; i++) {
+    if (old[i].buffer)
+      *HISTORY_SLOT (data, old[i].seqnum) = old[i];
+  }
+  g_free (old);
+}
+
 static void
 ssrc_rtx_data_free (SSRCRtxData * data)
 {
-  g_sequence_free (data->queue);
+  history_clear (data);
+  g_free (data->history);
   g_slice_free (SSRCRtxData, data);
 }
 
@@ -433,14 +490,21 @@ gst_rtp_rtx_buffer_new (GstRtpRtxSend * rtx, GstBuffer * buffer)
   return new_buffer;
 }
 
-static gint
-buffer_queue_items_cmp (BufferQueueItem * a, BufferQueueItem * b,
-    gpointer user_data)
+/* the stored packet with @seqnum or NULL */
+static BufferQueueItem *
+history_lookup (SSRCRtxData * data, guint16 seqnum)
 {
-  /* gst_rtp_buffer_compare_seqnum returns the opposite of what we want,
-   * it returns negative when seqnum1 > seqnum2 and we want negative
-   * when b > a, i.e. a is smaller, so it comes first in the sequence */
-  return gst_rtp_buffer_compare_seqnum (b->seqnum, a->seqnum);
+  BufferQueueItem *item;
+
+  if (data->window == 0)
+    return NULL;
+
+  /* only the slots in the window are used, they have distinct seqnums */
+  item = HISTORY_SLOT (data, seqnum);
+  if (item->buffer == NULL || item->seqnum != seqnum)
+    return NULL;
+
+  return item;
 }
 
 static gboolean
@@ -476,19 +540,15 @@ gst_rtp_rtx_send_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
         /* check if request is for us */
         if (g_hash_table_contains (rtx->ssrc_data, GUINT_TO_POINTER (ssrc))) {
           SSRCRtxData *data;
-          GSequenceIter *iter;
-          BufferQueueItem search_item;
+          BufferQueueItem *item;
 
           /* update statistics */
           ++rtx->num_rtx_requests;
 
           data = gst_rtp_rtx_send_get_ssrc_data (rtx, ssrc);
 
-          search_item.seqnum = seqnum;
-          iter = g_sequence_lookup (data->queue, &search_item,
-              (GCompareDataFunc) buffer_queue_items_cmp, NULL);
-          if (iter) {
-            BufferQueueItem *item = g_sequence_get (iter);
+          item = history_lookup (data, seqnum);
+          if (item) {
             GST_DEBUG_OBJECT (rtx, "found %" G_GUINT16_FORMAT, item->seqnum);
             rtx_buf = gst_rtp_rtx_buffer_new (rtx, item->buffer);
           }
@@ -653,14 +713,12 @@ gst_rtp_rtx_send_get_ts_diff (SSRCRtxData * data)
   BufferQueueItem *high_buf, *low_buf;
   guint32 result;
 
-  high_buf =
-      g_sequence_get (g_sequence_iter_prev (g_sequence_get_end_iter
-          (data->queue)));
-  low_buf = g_sequence_get (g_sequence_get_begin_iter (data->queue));
-
-  if (!high_buf || !low_buf || high_buf == low_buf)
+  if (data->window < 2)
     return 0;
 
+  high_buf = HISTORY_SLOT (data, data->head_seqnum);
+  low_buf = HISTORY_SLOT (data, data->tail_seqnum);
+
   high_ts = high_buf->timestamp;
   low_ts = low_buf->timestamp;
 
@@ -675,12 +733,82 @@ gst_rtp_rtx_send_get_ts_diff (SSRCRtxData * data)
   return (guint32) gst_util_uint64_scale_int (result, 1000, data->clock_rate);
 }
 
+/* Must be called with lock */
+static void
+history_store (GstRtpRtxSend * rtx, SSRCRtxData * data, guint16 seqnum,
+    guint32 rtptime, GstBuffer * buffer)
+{
+  BufferQueueItem *item;
+  guint size;
+  gint diff;
+
+  /* the ring holds max-size-packets, or grows up to the maximum when the
+   * number of packets is not limited */
+  if (rtx->max_size_packets)
+    size = 1 << g_bit_storage (rtx->max_size_packets - 1);
+  else
+    size = MIN_HISTORY_SIZE;
+  if (data->history_size < size)
+    history_resize (data, size);
+
+  if (data->window == 0) {
+    data->head_seqnum = data->tail_seqnum = seqnum;
+    data->window = 1;
+  } else {
+    diff = gst_rtp_buffer_compare_seqnum (data->head_seqnum, seqnum);
+
+    if (diff > 0) {
+      /* newer packet, the window moves forward */
+      if (data->window + diff > data->history_size &&
+          rtx->max_size_packets == 0 && data->history_size < MAX_HISTORY_SIZE) {
+        size = 1 << g_bit_storage (data->window + diff);
+        history_resize (data, MIN (size, MAX_HISTORY_SIZE));
+      }
+
+      if (diff >= data->history_size) {
+        history_clear (data);
+        data->tail_seqnum = seqnum;
+        data->window = 1;
+      } else {
+        while (data->window + diff > data->history_size)
+          history_drop_tail (data);
+        data->window += diff;
+      }
+      data->head_seqnum = seqnum;
+    } else if (gst_rtp_buffer_compare_seqnum (data->tail_seqnum, seqnum) < 0) {
+      GST_LOG_OBJECT (rtx, "not storing #%u, older than the history", seqnum);
+      return;
+    } else if (HISTORY_SLOT (data, seqnum)->buffer) {
+      GST_LOG_OBJECT (rtx, "not storing #%u, already stored", seqnum);
+      return;
+    }
+  }
+
+  item = HISTORY_SLOT (data, seqnum);
+  item->seqnum = seqnum;
+  item->timestamp = rtptime;
+  item->buffer = gst_buffer_ref (buffer);
+
+  /* moving the window may have left free slots at the tail */
+  while (!HISTORY_SLOT (data, data->tail_seqnum)->buffer)
+    history_drop_tail (data);
+
+  /* remove oldest packets from history if they are too many */
+  if (rtx->max_size_packets) {
+    while (data->window > rtx->max_size_packets)
+      history_drop_oldest (data);
+  }
+  if (rtx->max_size_time) {
+    while (gst_rtp_rtx_send_get_ts_diff (data) > rtx->max_size_time)
+      history_drop_oldest (data);
+  }
+}
+
 /* Must be called with lock */
 static void
 process_buffer (GstRtpRtxSend * rtx, GstBuffer * buffer)
 {
   GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
-  BufferQueueItem *item;
   SSRCRtxData *data;
   guint16 seqnum;
   guint8 payload_type;
@@ -703,21 +831,7 @@ process_buffer (GstRtpRtxSend * rtx, GstBuffer * buffer)
     data = gst_rtp_rtx_send_get_ssrc_data (rtx, ssrc);
 
     /* add current rtp buffer to queue history */
-    item = g_slice_new0 (BufferQueueItem);
-    item->seqnum = seqnum;
-    item->timestamp = rtptime;
-    item->buffer = gst_buffer_ref (buffer);
-    g_sequence_append (data->queue, item);
-
-    /* remove oldest packets from history if they are too many */
-    if (rtx->max_size_packets) {
-      while (g_sequence_get_length (data->queue) > rtx->max_size_packets)
-        g_sequence_remove (g_sequence_get_begin_iter (data->queue));
-    }
-    if (rtx->max_size_time) {
-      while (gst_rtp_rtx_send_get_ts_diff (data) > rtx->max_size_time)
-        g_sequence_remove (g_sequence_get_begin_iter (data->queue));
-    }
+    history_store (rtx, data, seqnum, rtptime, buffer);
   }
 }
 
@@ -767,12 +881,38 @@ gst_rtp_rtx_send_src_loop (GstRtpRtxSend * rtx)
     GST_LOG_OBJECT (rtx, "pushing rtx buffer %p", data->object);
 
     if (G_LIKELY (GST_IS_BUFFER (data->object))) {
+      GstBufferList *list = NULL;
+      guint len = 1;
+
+      /* the requests of a NACK are queued together, push the retransmissions
+       * that are already waiting in one list */
+      while (len < MAX_RTX_BATCH && !gst_data_queue_is_empty (rtx->queue)) {
+        GstDataQueueItem *next;
+
+        if (!gst_data_queue_peek (rtx->queue, &next) ||
+            !GST_IS_BUFFER (next->object) ||
+            !gst_data_queue_pop (rtx->queue, &next))
+          break;
+
+        if (list == NULL) {
+          list = gst_buffer_list_new_sized (MAX_RTX_BATCH);
+          gst_buffer_list_add (list, GST_BUFFER (data->object));
+        }
+        gst_buffer_list_add (list, GST_BUFFER (next->object));
+        next->object = NULL;
+        next->destroy (next);
+        len++;
+      }
+
       GST_OBJECT_LOCK (rtx);
       /* Update statistics just before pushing. */
-      rtx->num_rtx_packets++;
+      rtx->num_rtx_packets += len;
       GST_OBJECT_UNLOCK (rtx);
 
-      gst_pad_push (rtx->srcpad, GST_BUFFER (data->object));
+      if (list)
+        gst_pad_push_list (rtx->srcpad, list);
+      else
+        gst_pad_push (rtx->srcpad, GST_BUFFER (data->object));
     } else if (GST_IS_EVENT (data->object)) {
       gst_pad_push_event (rtx->srcpad, GST_EVENT (data->object));
 
@@ -147,6 +147,110 @@ struct _GstRtpSsrcDemuxPad
   gboolean pushed_initial_rtcp_events;
 };
 
+/*
+ * Lookup table of the SSRC pads, with open addressing. A table is never
+ * modified once published, adding or removing a pad publishes a new table.
+ */
+struct _GstRtpSsrcDemuxTable
+{
+  guint mask;                   /* number of slots - 1 */
+  GstRtpSsrcDemuxPad *slots[1];
+};
+
+/* SSRCs are random, their low bits are a good enough hash */
+#define SSRC_SLOT(table,ssrc) ((ssrc) & (table)->mask)
+
+static GstRtpSsrcDemuxTable *
+ssrc_table_new (GSList * srcpads)
+{
+  GstRtpSsrcDemuxTable *table;
+  GSList *walk;
+  guint size = 8;
+
+  /* keep the table at most half full */
+  while (size < 2 * g_slist_length (srcpads))
+    size <<= 1;
+
+  table = g_malloc0 (sizeof (GstRtpSsrcDemuxTable) +
+      (size - 1) * sizeof (GstRtpSsrcDemuxPad *));
+  table->mask = size - 1;
+
+  for (walk = srcpads; walk; walk = g_slist_next (walk)) {
+    GstRtpSsrcDemuxPad *dpad = (GstRtpSsrcDemuxPad *) walk->data;
+    guint i = SSRC_SLOT (table, dpad->ssrc);
+
+    while (table->slots[i])
+      i = (i + 1) & table->mask;
+    table->slots[i] = dpad;
+  }
+
+  return table;
+}
+
+/* with the padlock, publish a table of the current srcpads. When this
+ * returns, no lookup uses the previous table or the pads that are not in
+ * srcpads anymore. */
+static void
+update_ssrc_table (GstRtpSsrcDemux * demux)
+{
+  GstRtpSsrcDemuxTable *old;
+  gint epoch;
+
+  old = demux->ssrc_table;
+  g_atomic_pointer_set (&demux->ssrc_table, ssrc_table_new (demux->srcpads));
+
+  /* the lookups started from now on count in the other epoch and see the new
+   * table, wait for the ones that may still see the old table */
+  epoch = g_atomic_int_add (&demux->ssrc_epoch, 1) & 1;
+  while (g_atomic_int_get (&demux->ssrc_readers[epoch]) > 0)
+    g_thread_yield ();
+
+  g_free (old);
+}
+
+/* find the pad of @padtype for @ssrc without taking the padlock. Returns a
+ * ref to the pad, or NULL when there is no pad for @ssrc yet or when the
+ * initial events still need to be pushed on it. */
+static GstPad *
+lookup_demux_pad (GstRtpSsrcDemux * demux, guint32 ssrc, PadType padtype)
+{
+  GstRtpSsrcDemuxTable *table;
+  GstRtpSsrcDemuxPad *dpad;
+  GstPad *pad = NULL;
+  gint epoch;
+  guint i;
+
+  /* a writer that flipped the epoch between our read and our increment may
+   * not wait for us, count ourselves in the epoch that is still current */
+  while (TRUE) {
+    epoch = g_atomic_int_get (&demux->ssrc_epoch);
+    g_atomic_int_inc (&demux->ssrc_readers[epoch & 1]);
+    if (G_LIKELY (g_atomic_int_get (&demux->ssrc_epoch) == epoch))
+      break;
+    g_atomic_int_dec_and_test (&demux->ssrc_readers[epoch & 1]);
+  }
+
+  table = g_atomic_pointer_get (&demux->ssrc_table);
+  for (i = SSRC_SLOT (table, ssrc); (dpad = table->slots[i]);
+      i = (i + 1) & table->mask) {
+    if (dpad->ssrc != ssrc)
+      continue;
+
+    if (padtype == RTP_PAD) {
+      if (g_atomic_int_get (&dpad->pushed_initial_rtp_events))
+        pad = gst_object_ref (dpad->rtp_pad);
+    } else {
+      if (g_atomic_int_get (&dpad->pushed_initial_rtcp_events))
+        pad = gst_object_ref (dpad->rtcp_pad);
+    }
+    break;
+  }
+
+  g_atomic_int_dec_and_test (&demux->ssrc_readers[epoch & 1]);
+
+  return pad;
+}
+
 /* find a src pad for a given SSRC, returns NULL if the SSRC was not found
  */
 static GstRtpSsrcDemuxPad *
@@ -242,6 +346,11 @@ find_or_create_demux_pad_for_ssrc (GstRtpSsrcDemux * demux, guint32 ssrc,
   GstPad *retpad;
   gulong rtp_block, rtcp_block;
 
+  /* the pad exists and is set up in the common case */
+  retpad = lookup_demux_pad (demux, ssrc, padtype);
+  if (retpad)
+    return retpad;
+
   GST_PAD_LOCK (demux);
 
   demuxpad = find_demux_pad_for_ssrc (demux, ssrc);
@@ -253,14 +362,14 @@ find_or_create_demux_pad_for_ssrc (GstRtpSsrcDemux * demux, guint32 ssrc,
         retpad = gst_object_ref (demuxpad->rtp_pad);
         if (!demuxpad->pushed_initial_rtp_events) {
           forward = TRUE;
-          demuxpad->pushed_initial_rtp_events = TRUE;
+          g_atomic_int_set (&demuxpad->pushed_initial_rtp_events, TRUE);
         }
         break;
       case RTCP_PAD:
         retpad = gst_object_ref (demuxpad->rtcp_pad);
         if (!demuxpad->pushed_initial_rtcp_events) {
           forward = TRUE;
-          demuxpad->pushed_initial_rtcp_events = TRUE;
+          g_atomic_int_set (&demuxpad->pushed_initial_rtcp_events, TRUE);
         }
         break;
       default:
@@ -345,6 +454,9 @@ find_or_create_demux_pad_for_ssrc (GstRtpSsrcDemux * demux, guint32 ssrc,
   rtcp_block = gst_pad_add_probe (rtcp_pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,
       NULL, NULL, NULL);
 
+  /* only let the lookups find the pads now that they are blocked */
+  update_ssrc_table (demux);
+
   GST_PAD_UNLOCK (demux);
 
   g_signal_emit (G_OBJECT (demux),
@@ -463,14 +575,21 @@ gst_rtp_ssrc_demux_init (GstRtpSsrcDemux * demux)
   gst_element_add_pad (GST_ELEMENT_CAST (demux), demux->rtcp_sink);
 
   g_rec_mutex_init (&demux->padlock);
+  demux->ssrc_table = ssrc_table_new (NULL);
 }
 
 static void
 gst_rtp_ssrc_demux_reset (GstRtpSsrcDemux * demux)
 {
-  GSList *walk;
+  GSList *srcpads, *walk;
 
-  for (walk = demux->srcpads; walk; walk = g_slist_next (walk)) {
+  GST_PAD_LOCK (demux);
+  srcpads = demux->srcpads;
+  demux->srcpads = NULL;
+  update_ssrc_table (demux);
+  GST_PAD_UNLOCK (demux);
+
+  for (walk = srcpads; walk; walk = g_slist_next (walk)) {
     GstRtpSsrcDemuxPad *dpad = (GstRtpSsrcDemuxPad *) walk->data;
 
     gst_pad_set_active (dpad->rtp_pad, FALSE);
@@ -480,8 +599,7 @@ gst_rtp_ssrc_demux_reset (GstRtpSsrcDemux * demux)
     gst_element_remove_pad (GST_ELEMENT_CAST (demux), dpad->rtcp_pad);
     g_free (dpad);
   }
-  g_slist_free (demux->srcpads);
-  demux->srcpads = NULL;
+  g_slist_free (srcpads);
 }
 
 static void
@@ -502,6 +620,7 @@ gst_rtp_ssrc_demux_finalize (GObject * object)
   GstRtpSsrcDemux *demux;
 
   demux = GST_RTP_SSRC_DEMUX (object);
+  g_free (demux->ssrc_table);
   g_rec_mutex_clear (&demux->padlock);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -522,6 +641,7 @@ gst_rtp_ssrc_demux_clear_ssrc (GstRtpSsrcDemux * demux, guint32 ssrc)
   GST_DEBUG_OBJECT (demux, "clearing pad for SSRC %08x", ssrc);
 
   demux->srcpads = g_slist_remove (demux->srcpads, dpad);
+  update_ssrc_table (demux);
   GST_PAD_UNLOCK (demux);
 
   gst_pad_set_active (dpad->rtp_pad, FALSE);
@@ -31,6 +31,7 @@
 typedef struct _GstRtpSsrcDemux GstRtpSsrcDemux;
 typedef struct _GstRtpSsrcDemuxClass GstRtpSsrcDemuxClass;
 typedef struct _GstRtpSsrcDemuxPad GstRtpSsrcDemuxPad;
+typedef struct _GstRtpSsrcDemuxTable GstRtpSsrcDemuxTable;
 
 struct _GstRtpSsrcDemux
 {
@@ -41,6 +42,12 @@ struct _GstRtpSsrcDemux
 
   GRecMutex padlock;
   GSList *srcpads;
+
+  /* copy of srcpads indexed by SSRC, read without the padlock and replaced
+   * with the padlock when pads are added or removed */
+  GstRtpSsrcDemuxTable *ssrc_table;
+  gint ssrc_epoch;
+  gint ssrc_readers[2];
 };
 
 struct _GstRtpSsrcDemuxClass
@@ -30,6 +30,15 @@ GST_DEBUG_CATEGORY_STATIC (rtp_jitter_buffer_debug);
 #define MAX_WINDOW	RTP_JITTER_BUFFER_MAX_WINDOW
 #define MAX_TIME	(2 * GST_SECOND)
 
+/* the ring of packets grows in powers of two up to the full seqnum range */
+#define RING_MIN_SIZE	64
+#define RING_MAX_SIZE	65536
+
+/* ext_seqnum of the items without seqnum that go before all packets */
+#define EXT_SEQNUM_FIRST	G_MININT64
+
+#define RING_SLOT(jbuf,ext)	((jbuf)->ring[(ext) & ((jbuf)->ring_size - 1)])
+
 /* signals and args */
 enum
 {
@@ -87,7 +96,10 @@ rtp_jitter_buffer_init (RTPJitterBuffer * jbuf)
 {
   g_mutex_init (&jbuf->clock_lock);
 
-  jbuf->packets = g_queue_new ();
+  jbuf->ring_size = RING_MIN_SIZE;
+  jbuf->ring = g_new0 (RTPJitterBufferItem *, jbuf->ring_size);
+  g_queue_init (&jbuf->events);
+  g_queue_init (&jbuf->free_items);
   jbuf->mode = RTP_JITTER_BUFFER_MODE_SLAVE;
 
   rtp_jitter_buffer_reset_skew (jbuf);
@@ -97,6 +109,7 @@ static void
 rtp_jitter_buffer_finalize (GObject * object)
 {
   RTPJitterBuffer *jbuf;
+  GList *item;
 
   jbuf = RTP_JITTER_BUFFER_CAST (object);
 
@@ -109,7 +122,9 @@ rtp_jitter_buffer_finalize (GObject * object)
   if (jbuf->pipeline_clock)
     gst_object_unref (jbuf->pipeline_clock);
 
-  g_queue_free (jbuf->packets);
+  g_free (jbuf->ring);
+  while ((item = g_queue_pop_head_link (&jbuf->free_items)))
+    g_slice_free (RTPJitterBufferItem, (RTPJitterBufferItem *) item);
 
   g_mutex_clear (&jbuf->clock_lock);
 
@@ -381,21 +396,22 @@ get_buffer_level (RTPJitterBuffer * jbuf)
   RTPJitterBufferItem *high_buf = NULL, *low_buf = NULL;
   guint64 level;
 
-  /* first buffer with timestamp */
-  high_buf = (RTPJitterBufferItem *) g_queue_peek_tail_link (jbuf->packets);
-  while (high_buf) {
-    if (high_buf->dts != -1 || high_buf->pts != -1)
-      break;
-
-    high_buf = (RTPJitterBufferItem *) g_list_previous (high_buf);
-  }
-
-  low_buf = (RTPJitterBufferItem *) g_queue_peek_head_link (jbuf->packets);
-  while (low_buf) {
-    if (low_buf->dts != -1 || low_buf->pts != -1)
-      break;
+  /* first buffer with timestamp, only packets have one */
+  if (jbuf->ring_count > 0) {
+    gint64 ext;
 
-    low_buf = (RTPJitterBufferItem *) g_list_next (low_buf);
+    for (ext = jbuf->ring_tail; ext >= jbuf->ring_head; ext--) {
+      high_buf = RING_SLOT (jbuf, ext);
+      if (high_buf && (high_buf->dts != -1 || high_buf->pts != -1))
+        break;
+      high_buf = NULL;
+    }
+    for (ext = jbuf->ring_head; ext <= jbuf->ring_tail; ext++) {
+      low_buf = RING_SLOT (jbuf, ext);
+      if (low_buf && (low_buf->dts != -1 || low_buf->pts != -1))
+        break;
+      low_buf = NULL;
+    }
   }
 
   if (!high_buf || !low_buf || high_buf == low_buf) {
@@ -666,26 +682,137 @@ no_skew:
   return out_time;
 }
 
-static void
-queue_do_insert (RTPJitterBuffer * jbuf, GList * list, GList * item)
+/* make room in the ring for the packets from @head to @tail */
+static gboolean
+ring_reserve (RTPJitterBuffer * jbuf, gint64 head, gint64 tail)
 {
-  GQueue *queue = jbuf->packets;
+  RTPJitterBufferItem **ring;
+  guint64 span;
+  guint size;
+  gint64 ext;
 
-  /* It's more likely that the packet was inserted at the tail of the queue */
-  if (G_LIKELY (list)) {
-    item->prev = list;
-    item->next = list->next;
-    list->next = item;
-  } else {
-    item->prev = NULL;
-    item->next = queue->head;
-    queue->head = item;
+  span = tail - head + 1;
+  if (G_LIKELY (span <= jbuf->ring_size))
+    return TRUE;
+
+  if (span > RING_MAX_SIZE)
+    return FALSE;
+
+  size = jbuf->ring_size;
+  while (size < span)
+    size <<= 1;
+
+  GST_DEBUG ("grow ring from %u to %u packets", jbuf->ring_size, size);
+
+  ring = g_new0 (RTPJitterBufferItem *, size);
+  if (jbuf->ring_count > 0) {
+    for (ext = jbuf->ring_head; ext <= jbuf->ring_tail; ext++)
+      ring[ext & (size - 1)] = RING_SLOT (jbuf, ext);
   }
-  if (item->next)
-    item->next->prev = item;
+  g_free (jbuf->ring);
+  jbuf->ring = ring;
+  jbuf->ring_size = size;
+
+  return TRUE;
+}
+
+/* the extended seqnum of @seqnum, close to the packets in the ring or to the
+ * last packet we saw */
+static gint64
+get_ext_seqnum (RTPJitterBuffer * jbuf, guint16 seqnum)
+{
+  gint64 ref;
+
+  if (jbuf->ring_count > 0)
+    ref = jbuf->ring_head;
+  else if (jbuf->have_ext_seqnum)
+    ref = jbuf->last_ext_seqnum;
   else
-    queue->tail = item;
-  queue->length++;
+    return seqnum;
+
+  return ref + gst_rtp_buffer_compare_seqnum ((guint16) ref, seqnum);
+}
+
+/* the items without seqnum that have no packet before them anymore stay in
+ * front of all the packets that arrive later */
+static void
+pin_events (RTPJitterBuffer * jbuf)
+{
+  GList *l;
+
+  for (l = jbuf->events.head; l; l = l->next) {
+    RTPJitterBufferItem *item = (RTPJitterBufferItem *) l;
+
+    if (jbuf->ring_count > 0 && item->ext_seqnum > jbuf->ring_head)
+      break;
+    item->ext_seqnum = EXT_SEQNUM_FIRST;
+  }
+}
+
+/* the first item without seqnum when it goes before the first packet */
+static RTPJitterBufferItem *
+peek_event (RTPJitterBuffer * jbuf)
+{
+  RTPJitterBufferItem *item;
+
+  item = (RTPJitterBufferItem *) jbuf->events.head;
+  if (item && jbuf->ring_count > 0 && item->ext_seqnum > jbuf->ring_head)
+    item = NULL;
+
+  return item;
+}
+
+/* the last item in order */
+static RTPJitterBufferItem *
+peek_tail (RTPJitterBuffer * jbuf)
+{
+  RTPJitterBufferItem *item;
+
+  item = (RTPJitterBufferItem *) jbuf->events.tail;
+  if (jbuf->ring_count > 0 && (item == NULL
+          || item->ext_seqnum <= jbuf->ring_tail))
+    item = RING_SLOT (jbuf, jbuf->ring_tail);
+
+  return item;
+}
+
+/**
+ * rtp_jitter_buffer_alloc_item:
+ * @jbuf: an #RTPJitterBuffer
+ *
+ * Get an item to insert in @jbuf, from the items that were released with
+ * rtp_jitter_buffer_free_item() when possible. This must be called with the
+ * lock that protects @jbuf.
+ *
+ * Returns: a new #RTPJitterBufferItem, its fields are not initialized.
+ */
+RTPJitterBufferItem *
+rtp_jitter_buffer_alloc_item (RTPJitterBuffer * jbuf)
+{
+  GList *item;
+
+  if ((item = g_queue_pop_head_link (&jbuf->free_items)))
+    return (RTPJitterBufferItem *) item;
+
+  return g_slice_new (RTPJitterBufferItem);
+}
+
+/**
+ * rtp_jitter_buffer_free_item:
+ * @jbuf: an #RTPJitterBuffer
+ * @item: an #RTPJitterBufferItem that is not in @jbuf
+ *
+ * Release @item for reuse by rtp_jitter_buffer_alloc_item(). The data of
+ * @item must have been released by the caller. This must be called with the
+ * lock that protects @jbuf.
+ */
+void
+rtp_jitter_buffer_free_item (RTPJitterBuffer * jbuf, RTPJitterBufferItem * item)
+{
+  g_return_if_fail (item != NULL);
+
+  item->data = NULL;
+  g_queue_push_head_link (&jbuf->free_items, (GList *) item);
 }
 
 GstClockTime
@@ -956,88 +1083,146 @@ rtp_jitter_buffer_calculate_pts (RTPJitterBuffer * jbuf, GstClockTime dts,
  * will be available with the next call to rtp_jitter_buffer_pop() and
  * rtp_jitter_buffer_peek().
  *
- * Returns: %FALSE if a packet with the same number already existed.
+ * Returns: %FALSE if a packet with the same number already existed or if
+ * the packet is too far away from the queued packets.
  */
 gboolean
 rtp_jitter_buffer_insert (RTPJitterBuffer * jbuf, RTPJitterBufferItem * item,
     gboolean * head, gint * percent)
 {
-  GList *list, *event = NULL;
-  guint16 seqnum;
+  gboolean is_head;
+  gint64 ext;
 
   g_return_val_if_fail (jbuf != NULL, FALSE);
   g_return_val_if_fail (item != NULL, FALSE);
 
-  list = jbuf->packets->tail;
-
-  /* no seqnum, simply append then */
-  if (item->seqnum == -1)
-    goto append;
-
-  seqnum = item->seqnum;
-
-  /* loop the list to skip strictly larger seqnum buffers */
-  for (; list; list = g_list_previous (list)) {
-    guint16 qseq;
-    gint gap;
-    RTPJitterBufferItem *qitem = (RTPJitterBufferItem *) list;
-
-    if (qitem->seqnum == -1) {
-      /* keep a pointer to the first consecutive event if not already
-       * set. we will insert the packet after the event if we can't find
-       * a packet with lower sequence number before the event. */
-      if (event == NULL)
-        event = list;
-      continue;
-    }
-
-    qseq = qitem->seqnum;
+  /* no seqnum, simply append then. It goes after all the packets we have
+   * now and before the ones that arrive later with a higher seqnum. */
+  if (item->seqnum == -1) {
+    is_head = jbuf->ring_count == 0 && jbuf->events.length == 0;
+    if (jbuf->ring_count > 0)
+      item->ext_seqnum = jbuf->ring_tail + 1;
+    else
+      item->ext_seqnum = EXT_SEQNUM_FIRST;
+    g_queue_push_tail_link (&jbuf->events, (GList *) item);
+    goto done;
+  }
 
-    /* compare the new seqnum to the one in the buffer */
-    gap = gst_rtp_buffer_compare_seqnum (seqnum, qseq);
+  ext = get_ext_seqnum (jbuf, item->seqnum);
 
+  if (jbuf->ring_count == 0) {
+    jbuf->ring_head = jbuf->ring_tail = ext;
+  } else {
     /* we hit a packet with the same seqnum, notify a duplicate */
-    if (G_UNLIKELY (gap == 0))
+    if (ext >= jbuf->ring_head && ext <= jbuf->ring_tail
+        && RING_SLOT (jbuf, ext) != NULL)
       goto duplicate;
 
-    /* seqnum > qseq, we can stop looking */
-    if (G_LIKELY (gap < 0))
-      break;
-
-    /* if we've found a packet with greater sequence number, cleanup the
-     * event pointer as the packet will be inserted before the event */
-    event = NULL;
+    if (!ring_reserve (jbuf, MIN (ext, jbuf->ring_head),
+            MAX (ext, jbuf->ring_tail)))
+      goto out_of_range;
   }
 
-  /* if event is set it means that packets before the event had smaller
-   * sequence number, so we will insert our packet after the event */
-  if (event)
-    list = event;
-
-append:
-  queue_do_insert (jbuf, list, (GList *) item);
+  /* the packet goes after the items without seqnum that are in front */
+  is_head = (jbuf->ring_count == 0 || ext < jbuf->ring_head);
+  if (jbuf->events.head &&
+      ((RTPJitterBufferItem *) jbuf->events.head)->ext_seqnum <= ext)
+    is_head = FALSE;
+
+  item->ext_seqnum = ext;
+  RING_SLOT (jbuf, ext) = item;
+  if (jbuf->ring_count > 0) {
+    jbuf->ring_head = MIN (ext, jbuf->ring_head);
+    jbuf->ring_tail = MAX (ext, jbuf->ring_tail);
+  }
+  jbuf->ring_count++;
 
+done:
   /* buffering mode, update buffer stats */
   if (jbuf->mode == RTP_JITTER_BUFFER_MODE_BUFFER)
     update_buffer_level (jbuf, percent);
   else if (percent)
     *percent = -1;
 
-  /* head was changed when we did not find a previous packet, we set the return
+  /* head was changed when the new item is the first one, we set the return
    * flag when requested. */
   if (G_LIKELY (head))
-    *head = (list == NULL);
+    *head = is_head;
 
   return TRUE;
 
   /* ERRORS */
 duplicate:
   {
-    GST_DEBUG ("duplicate packet %d found", (gint) seqnum);
+    GST_DEBUG ("duplicate packet %d found", (gint) item->seqnum);
     if (G_LIKELY (head))
       *head = FALSE;
     return FALSE;
   }
+out_of_range:
+  {
+    GST_DEBUG ("packet %d too far from #%d, dropping", (gint) item->seqnum,
+        (gint) (guint16) jbuf->ring_head);
+    if (G_LIKELY (head))
+      *head = FALSE;
+    return FALSE;
+  }
+}
+
+/**
+ * rtp_jitter_buffer_fits:
+ * @jbuf: an #RTPJitterBuffer
+ * @seqnum: a seqnum
+ *
+ * Check if a packet with @seqnum can be kept together with the packets in
+ * @jbuf, the queued packets can not span more than the seqnum range.
+ *
+ * Returns: %FALSE when rtp_jitter_buffer_insert() would refuse the packet
+ * because it is too far from the queued packets.
+ */
+gboolean
+rtp_jitter_buffer_fits (RTPJitterBuffer * jbuf, guint16 seqnum)
+{
+  gint64 ext;
+
+  if (jbuf->ring_count == 0)
+    return TRUE;
+
+  ext = get_ext_seqnum (jbuf, seqnum);
+
+  return MAX (ext, jbuf->ring_tail) - MIN (ext, jbuf->ring_head) <
+      RING_MAX_SIZE;
+}
+
+/* remove the first item, the items without seqnum that are in front go
+ * first */
+static RTPJitterBufferItem *
+pop_item (RTPJitterBuffer * jbuf)
+{
+  RTPJitterBufferItem *item;
+
+  if ((item = peek_event (jbuf))) {
+    g_queue_unlink (&jbuf->events, (GList *) item);
+  } else if (jbuf->ring_count > 0) {
+    item = RING_SLOT (jbuf, jbuf->ring_head);
+    RING_SLOT (jbuf, jbuf->ring_head) = NULL;
+    jbuf->last_ext_seqnum = jbuf->ring_head;
+    jbuf->have_ext_seqnum = TRUE;
+
+    /* skip to the next packet, the slots in between were never filled */
+    if (--jbuf->ring_count > 0) {
+      do {
+        jbuf->ring_head++;
+      } while (RING_SLOT (jbuf, jbuf->ring_head) == NULL);
+    }
+    pin_events (jbuf);
+  }
+  if (item) {
+    item->next = NULL;
+    item->prev = NULL;
+  }
+
+  return item;
 }
 
 /**
@@ -1054,22 +1239,11 @@ duplicate:
 RTPJitterBufferItem *
 rtp_jitter_buffer_pop (RTPJitterBuffer * jbuf, gint * percent)
 {
-  GList *item = NULL;
-  GQueue *queue;
+  RTPJitterBufferItem *item;
 
   g_return_val_if_fail (jbuf != NULL, NULL);
 
-  queue = jbuf->packets;
-
-  item = queue->head;
-  if (item) {
-    queue->head = item->next;
-    if (queue->head)
-      queue->head->prev = NULL;
-    else
-      queue->tail = NULL;
-    queue->length--;
-  }
+  item = pop_item (jbuf);
 
   /* buffering mode, update buffer stats */
   if (jbuf->mode == RTP_JITTER_BUFFER_MODE_BUFFER)
@@ -1077,7 +1251,7 @@ rtp_jitter_buffer_pop (RTPJitterBuffer * jbuf, gint * percent)
   else if (percent)
     *percent = -1;
 
-  return (RTPJitterBufferItem *) item;
+  return item;
 }
 
 /**
@@ -1094,30 +1268,40 @@ rtp_jitter_buffer_pop (RTPJitterBuffer * jbuf, gint * percent)
 RTPJitterBufferItem *
 rtp_jitter_buffer_peek (RTPJitterBuffer * jbuf)
 {
+  RTPJitterBufferItem *item;
+
   g_return_val_if_fail (jbuf != NULL, NULL);
 
-  return (RTPJitterBufferItem *) jbuf->packets->head;
+  if ((item = peek_event (jbuf)))
+    return item;
+  if (jbuf->ring_count > 0)
+    return RING_SLOT (jbuf, jbuf->ring_head);
+
+  return NULL;
 }
 
 /**
  * rtp_jitter_buffer_flush:
  * @jbuf: an #RTPJitterBuffer
- * @free_func: function to free each item
+ * @free_func: function to free the data of each item
  * @user_data: user data passed to @free_func
  *
- * Flush all packets from the jitterbuffer.
+ * Flush all packets from the jitterbuffer. @free_func is called on each item
+ * in order, the items are then recycled.
  */
 void
 rtp_jitter_buffer_flush (RTPJitterBuffer * jbuf, GFunc free_func,
     gpointer user_data)
 {
-  GList *item;
+  RTPJitterBufferItem *item;
 
   g_return_if_fail (jbuf != NULL);
   g_return_if_fail (free_func != NULL);
 
-  while ((item = g_queue_pop_head_link (jbuf->packets)))
-    free_func ((RTPJitterBufferItem *) item, user_data);
+  while ((item = pop_item (jbuf))) {
+    free_func (item, user_data);
+    rtp_jitter_buffer_free_item (jbuf, item);
+  }
 }
 
 /**
@@ -1188,7 +1372,7 @@ rtp_jitter_buffer_num_packets (RTPJitterBuffer * jbuf)
 {
   g_return_val_if_fail (jbuf != NULL, 0);
 
-  return jbuf->packets->length;
+  return jbuf->ring_count + jbuf->events.length;
 }
 
 /**
@@ -1209,8 +1393,8 @@ rtp_jitter_buffer_get_ts_diff (RTPJitterBuffer * jbuf)
 
   g_return_val_if_fail (jbuf != NULL, 0);
 
-  high_buf = (RTPJitterBufferItem *) g_queue_peek_tail_link (jbuf->packets);
-  low_buf = (RTPJitterBufferItem *) g_queue_peek_head_link (jbuf->packets);
+  high_buf = peek_tail (jbuf);
+  low_buf = rtp_jitter_buffer_peek (jbuf);
 
   if (!high_buf || !low_buf || high_buf == low_buf)
     return 0;
@@ -73,7 +73,18 @@ GType rtp_jitter_buffer_mode_get_type (void);
 struct _RTPJitterBuffer {
   GObject        object;
 
-  GQueue        *packets;
+  /* the packets indexed by extended seqnum, from ring_head to ring_tail */
+  RTPJitterBufferItem **ring;
+  guint          ring_size;
+  guint          ring_count;
+  gint64         ring_head;
+  gint64         ring_tail;
+  gint64         last_ext_seqnum;
+  gboolean       have_ext_seqnum;
+  /* the items without seqnum, in order */
+  GQueue         events;
+  /* recycled items */
+  GQueue         free_items;
 
   RTPJitterBufferMode mode;
 
@@ -129,8 +140,13 @@ struct _RTPJitterBufferClass {
  *   append.
  * @count: amount of seqnum in this item
  * @rtptime: rtp timestamp
+ * @ext_seqnum: the extended seqnum of a packet. For an item without
+ *   seqnum, the extended seqnum of the first packet that goes after it.
+ *   Private to the jitterbuffer.
  *
- * An object containing an RTP packet or event.
+ * An object containing an RTP packet or event. Items are allocated with
+ * rtp_jitter_buffer_alloc_item() and recycled with
+ * rtp_jitter_buffer_free_item().
  */
 struct _RTPJitterBufferItem {
   gpointer data;
@@ -142,6 +158,7 @@ struct _RTPJitterBufferItem {
   guint seqnum;
   guint count;
   guint rtptime;
+  gint64 ext_seqnum;
 };
 
 GType rtp_jitter_buffer_get_type (void);
@@ -166,9 +183,15 @@ void                  rtp_jitter_buffer_set_rfc7273_sync (RTPJitterBuffer *jbuf,
 
 void                  rtp_jitter_buffer_reset_skew       (RTPJitterBuffer *jbuf);
 
+RTPJitterBufferItem * rtp_jitter_buffer_alloc_item       (RTPJitterBuffer *jbuf);
+void                  rtp_jitter_buffer_free_item        (RTPJitterBuffer *jbuf,
+                                                          RTPJitterBufferItem *item);
+
 gboolean              rtp_jitter_buffer_insert           (RTPJitterBuffer *jbuf,
                                                           RTPJitterBufferItem *item,
                                                           gboolean *head, gint *percent);
+gboolean              rtp_jitter_buffer_fits             (RTPJitterBuffer *jbuf,
+                                                          guint16 seqnum);
 
 void                  rtp_jitter_buffer_disable_buffering (RTPJitterBuffer *jbuf, gboolean disabled);
 
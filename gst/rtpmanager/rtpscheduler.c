@@ -0,0 +1,250 @@
+/* GStreamer
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Process-wide pools of threads running the tasks of many elements. The
+ * timers and the tasks that push data run on separate pools, so that
+ * downstream elements blocking every thread of the output pool do not stop
+ * the timers.
+ *
+ * A task is woken up with rtp_scheduler_task_wakeup() and then runs its
+ * function once on one of the threads of the pool. Wakeups while the task
+ * is queued are merged, wakeups while it runs make it run once more on the
+ * same thread, so the function of a task never runs concurrently with
+ * itself and sees its wakeups in order.
+ */
+
+#include "rtpscheduler.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtp_scheduler_debug);
+#define GST_CAT_DEFAULT rtp_scheduler_debug
+
+/* each pool has one thread per CPU, but at least this many */
+#define MIN_THREADS 2
+
+struct _RTPSchedulerTask
+{
+  gint refcount;
+
+  GMutex lock;
+  GCond cond;
+
+  GThreadPool *pool;
+  RTPSchedulerFunc func;
+  gpointer user_data;
+
+  gboolean active;
+  gboolean queued;
+  gboolean pending;
+  GThread *thread;              /* the thread running the task or NULL */
+};
+
+static GThreadPool *pools[RTP_SCHEDULER_POOL_LAST];
+
+static RTPSchedulerTask *
+task_ref (RTPSchedulerTask * task)
+{
+  g_atomic_int_inc (&task->refcount);
+  return task;
+}
+
+static void
+task_unref (RTPSchedulerTask * task)
+{
+  if (g_atomic_int_dec_and_test (&task->refcount)) {
+    g_mutex_clear (&task->lock);
+    g_cond_clear (&task->cond);
+    g_slice_free (RTPSchedulerTask, task);
+  }
+}
+
+static void
+task_run (RTPSchedulerTask * task, gpointer unused)
+{
+  g_mutex_lock (&task->lock);
+  task->queued = FALSE;
+  if (!task->active)
+    goto done;
+
+  task->thread = g_thread_self ();
+  do {
+    task->pending = FALSE;
+    g_mutex_unlock (&task->lock);
+
+    task->func (task->user_data);
+
+    g_mutex_lock (&task->lock);
+  } while (task->pending && task->active);
+  task->thread = NULL;
+  g_cond_broadcast (&task->cond);
+
+done:
+  g_mutex_unlock (&task->lock);
+  task_unref (task);
+}
+
+static gpointer
+init_pools (gpointer data)
+{
+  GError *error = NULL;
+  gint i, max_threads;
+
+  GST_DEBUG_CATEGORY_INIT (rtp_scheduler_debug, "rtpscheduler", 0,
+      "RTP shared scheduler");
+
+  max_threads = MAX (g_get_num_processors (), MIN_THREADS);
+  for (i = 0; i < RTP_SCHEDULER_POOL_LAST; i++) {
+    pools[i] = g_thread_pool_new ((GFunc) task_run, NULL, max_threads, FALSE,
+        &error);
+    if (pools[i] == NULL)
+      goto pool_failed;
+  }
+
+  GST_INFO ("created %d pools of %d threads", RTP_SCHEDULER_POOL_LAST,
+      max_threads);
+
+  return GINT_TO_POINTER (TRUE);
+
+pool_failed:
+  {
+    g_critical ("failed to create the RTP thread pool: %s", error->message);
+    g_error_free (error);
+    return GINT_TO_POINTER (FALSE);
+  }
+}
+
+/**
+ * rtp_scheduler_task_new:
+ * @pool: the pool to run the task on
+ * @func: the function to run
+ * @user_data: user data passed to @func
+ *
+ * Create a task running @func on the process-wide thread pool @pool. The
+ * task does nothing until rtp_scheduler_task_start() is called.
+ *
+ * Returns: a new #RTPSchedulerTask, free with rtp_scheduler_task_free().
+ */
+RTPSchedulerTask *
+rtp_scheduler_task_new (RTPSchedulerPool pool, RTPSchedulerFunc func,
+    gpointer user_data)
+{
+  static GOnce once = G_ONCE_INIT;
+  RTPSchedulerTask *task;
+
+  g_return_val_if_fail (pool < RTP_SCHEDULER_POOL_LAST, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  g_once (&once, init_pools, NULL);
+  if (!GPOINTER_TO_INT (once.retval))
+    return NULL;
+
+  task = g_slice_new0 (RTPSchedulerTask);
+  task->refcount = 1;
+  g_mutex_init (&task->lock);
+  g_cond_init (&task->cond);
+  task->pool = pools[pool];
+  task->func = func;
+  task->user_data = user_data;
+
+  return task;
+}
+
+/**
+ * rtp_scheduler_task_free:
+ * @task: an #RTPSchedulerTask
+ *
+ * Stop @task and free it.
+ */
+void
+rtp_scheduler_task_free (RTPSchedulerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  rtp_scheduler_task_stop (task);
+  task_unref (task);
+}
+
+/* with the task lock */
+static void
+task_queue (RTPSchedulerTask * task)
+{
+  if (task->thread) {
+    /* make the thread that runs the task run it again */
+    task->pending = TRUE;
+  } else if (!task->queued) {
+    task->queued = TRUE;
+    g_thread_pool_push (task->pool, task_ref (task), NULL);
+  }
+}
+
+/**
+ * rtp_scheduler_task_start:
+ * @task: an #RTPSchedulerTask
+ *
+ * Allow @task to run and run it once.
+ */
+void
+rtp_scheduler_task_start (RTPSchedulerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  g_mutex_lock (&task->lock);
+  task->active = TRUE;
+  task_queue (task);
+  g_mutex_unlock (&task->lock);
+}
+
+/**
+ * rtp_scheduler_task_stop:
+ * @task: an #RTPSchedulerTask
+ *
+ * Stop @task, the wakeups are ignored until the task is started again. When
+ * called from another thread than the one running @task, this waits for the
+ * function to return.
+ */
+void
+rtp_scheduler_task_stop (RTPSchedulerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  g_mutex_lock (&task->lock);
+  task->active = FALSE;
+  task->pending = FALSE;
+  while (task->thread && task->thread != g_thread_self ())
+    g_cond_wait (&task->cond, &task->lock);
+  g_mutex_unlock (&task->lock);
+}
+
+/**
+ * rtp_scheduler_task_wakeup:
+ * @task: an #RTPSchedulerTask
+ *
+ * Run the function of @task once more if the task is started. This can be
+ * called from any thread, including from the function of @task.
+ */
+void
+rtp_scheduler_task_wakeup (RTPSchedulerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  g_mutex_lock (&task->lock);
+  if (task->active)
+    task_queue (task);
+  g_mutex_unlock (&task->lock);
+}
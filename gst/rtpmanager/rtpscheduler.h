@@ -0,0 +1,58 @@
+/* GStreamer
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RTP_SCHEDULER_H__
+#define __RTP_SCHEDULER_H__
+
+#include <gst/gst.h>
+
+typedef struct _RTPSchedulerTask RTPSchedulerTask;
+
+/**
+ * RTPSchedulerPool:
+ * @RTP_SCHEDULER_POOL_TIMERS: tasks that never block for long, like timers
+ * @RTP_SCHEDULER_POOL_OUTPUT: tasks that push data and may block downstream
+ *
+ * The thread pool a task runs on. The timers have their own pool so that a
+ * blocking downstream element can not delay them.
+ */
+typedef enum {
+  RTP_SCHEDULER_POOL_TIMERS,
+  RTP_SCHEDULER_POOL_OUTPUT,
+  RTP_SCHEDULER_POOL_LAST
+} RTPSchedulerPool;
+
+/**
+ * RTPSchedulerFunc:
+ * @user_data: the user data of the task
+ *
+ * The function of a task, it runs on one of the threads of its process-wide
+ * pool. A task never runs on two threads at the same time.
+ */
+typedef void (*RTPSchedulerFunc) (gpointer user_data);
+
+RTPSchedulerTask * rtp_scheduler_task_new    (RTPSchedulerPool pool, RTPSchedulerFunc func,
+                                              gpointer user_data);
+void               rtp_scheduler_task_free   (RTPSchedulerTask *task);
+
+void               rtp_scheduler_task_start  (RTPSchedulerTask *task);
+void               rtp_scheduler_task_stop   (RTPSchedulerTask *task);
+void               rtp_scheduler_task_wakeup (RTPSchedulerTask *task);
+
+#endif /* __RTP_SCHEDULER_H__ */
@@ -608,6 +608,12 @@ rtp_session_init (RTPSession * sess)
         g_hash_table_new_full (NULL, NULL, NULL,
         (GDestroyNotify) g_object_unref);
   }
+  sess->sources = g_ptr_array_new ();
+  sess->feedback_sources =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+  sess->timeout_sources =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+  sess->timeout_activity = GST_CLOCK_TIME_NONE;
 
   rtp_stats_init_defaults (&sess->stats);
   INIT_AVG (sess->stats.avg_rtcp_packet_size, 100);
@@ -678,6 +684,10 @@ rtp_session_finalize (GObject * object)
   g_list_free_full (sess->conflicting_addresses,
       (GDestroyNotify) rtp_conflicting_address_free);
 
+  g_ptr_array_free (sess->feedback_sources, TRUE);
+  g_ptr_array_free (sess->timeout_sources, TRUE);
+  g_ptr_array_free (sess->sources, TRUE);
+
   /* TODO: Change this again when implementing RFC 2762
    * for (i = 0; i < 32; i++)
    */
@@ -689,6 +699,20 @@ rtp_session_finalize (GObject * object)
   G_OBJECT_CLASS (rtp_session_parent_class)->finalize (object);
 }
 
+/* call @func for all the sources in @sources, @func must not add or remove
+ * sources */
+static void
+foreach_source (GPtrArray * sources, GHFunc func, gpointer user_data)
+{
+  guint i;
+
+  for (i = 0; i < sources->len; i++) {
+    RTPSource *source = g_ptr_array_index (sources, i);
+
+    func (GINT_TO_POINTER (source->ssrc), source, user_data);
+  }
+}
+
 static void
 copy_source (gpointer key, RTPSource * source, GValueArray * arr)
 {
@@ -708,19 +732,19 @@ rtp_session_create_sources (RTPSession * sess)
 
   RTP_SESSION_LOCK (sess);
   /* get number of elements in the table */
-  size = g_hash_table_size (sess->ssrcs[sess->mask_idx]);
+  size = sess->sources->len;
   /* create the result value array */
   res = g_value_array_new (size);
 
   /* and copy all values into the array */
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx], (GHFunc) copy_source, res);
+  foreach_source (sess->sources, (GHFunc) copy_source, res);
   RTP_SESSION_UNLOCK (sess);
 
   return res;
 }
 
 static void
-create_source_stats (gpointer key, RTPSource * source, GValueArray * arr)
+create_source_stats (RTPSource * source, GValueArray * arr)
 {
   GValue value = G_VALUE_INIT;
   GstStructure *s;
@@ -740,7 +764,6 @@ rtp_session_create_stats (RTPSession * sess)
   GstStructure *s;
   GValueArray *source_stats;
   GValue source_stats_v = G_VALUE_INIT;
-  guint size;
 
   RTP_SESSION_LOCK (sess);
   s = gst_structure_new ("application/x-rtp-session-stats",
@@ -748,10 +771,10 @@ rtp_session_create_stats (RTPSession * sess)
       "sent-nack-count", G_TYPE_UINT, sess->stats.nacks_sent,
       "recv-nack-count", G_TYPE_UINT, sess->stats.nacks_received, NULL);
 
-  size = g_hash_table_size (sess->ssrcs[sess->mask_idx]);
-  source_stats = g_value_array_new (size);
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-      (GHFunc) create_source_stats, source_stats);
+  /* the stats of the sources are updated with the session lock */
+  source_stats = g_value_array_new (sess->sources->len);
+  g_ptr_array_foreach (sess->sources, (GFunc) create_source_stats,
+      source_stats);
   RTP_SESSION_UNLOCK (sess);
 
   g_value_init (&source_stats_v, G_TYPE_VALUE_ARRAY);
@@ -1642,15 +1665,15 @@ session_update_ptp (RTPSession * sess)
    */
   data.is_doing_ptp = TRUE;
   data.new_addr = NULL;
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-      (GHFunc) compare_rtp_source_addr, (gpointer) & data);
+  foreach_source (sess->sources, (GHFunc) compare_rtp_source_addr,
+      (gpointer) & data);
   is_doing_rtp_ptp = data.is_doing_ptp;
 
   /* same but about rtcp */
   data.is_doing_ptp = TRUE;
   data.new_addr = NULL;
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-      (GHFunc) compare_rtcp_source_addr, (gpointer) & data);
+  foreach_source (sess->sources, (GHFunc) compare_rtcp_source_addr,
+      (gpointer) & data);
   is_doing_rtcp_ptp = data.is_doing_ptp;
 
   /* the session is doing point-to-point if all rtp remote have the same
@@ -1660,13 +1683,39 @@ session_update_ptp (RTPSession * sess)
   GST_DEBUG ("doing point-to-point: %d", sess->is_doing_ptp);
 }
 
+/* the internal sources, the senders and the sources marked BYE can time out
+ * at any wakeup, the others only when they were inactive for too long */
+static inline gboolean
+source_can_timeout (RTPSource * src)
+{
+  return src->internal || RTP_SOURCE_IS_SENDER (src) || src->marked_bye;
+}
+
+/* with the session lock, put @src in the sources that are checked at every
+ * wakeup or else remember its last activity in the oldest activity of the
+ * other sources */
+static void
+source_update_timeout (RTPSession * sess, RTPSource * src)
+{
+  if (src->timeout_pending)
+    return;
+
+  if (source_can_timeout (src)) {
+    src->timeout_pending = TRUE;
+    g_ptr_array_add (sess->timeout_sources, g_object_ref (src));
+  } else {
+    sess->timeout_activity = MIN (sess->timeout_activity,
+        MAX (src->last_activity, sess->start_time));
+  }
+}
+
 static void
 add_source (RTPSession * sess, RTPSource * src)
 {
   g_hash_table_insert (sess->ssrcs[sess->mask_idx],
       GINT_TO_POINTER (src->ssrc), src);
-  /* report the new source ASAP */
-  src->generation = sess->generation;
+  src->session_idx = sess->sources->len;
+  g_ptr_array_add (sess->sources, src);
   /* we have one more source now */
   sess->total_sources++;
   if (RTP_SOURCE_IS_ACTIVE (src))
@@ -1680,11 +1729,30 @@ add_source (RTPSession * sess, RTPSource * src)
     }
   }
 
+  source_update_timeout (sess, src);
+
   /* update point-to-point status */
   if (!src->internal)
     session_update_ptp (sess);
 }
 
+/* remove @src from the sources, this does not update the counters */
+static void
+remove_source (RTPSession * sess, RTPSource * src)
+{
+  RTPSource *last;
+
+  /* move the last source in the place of @src */
+  last = g_ptr_array_index (sess->sources, sess->sources->len - 1);
+  last->session_idx = src->session_idx;
+  g_ptr_array_remove_index_fast (sess->sources, src->session_idx);
+  src->session_idx = -1;
+
+  /* this drops the ref of the table */
+  g_hash_table_remove (sess->ssrcs[sess->mask_idx],
+      GINT_TO_POINTER (src->ssrc));
+}
+
 static RTPSource *
 find_source (RTPSession * sess, guint32 ssrc)
 {
@@ -1725,7 +1793,6 @@ obtain_source (RTPSession * sess, guint32 ssrc, gboolean * created,
     /* configure a callback on the source */
     rtp_source_set_callbacks (source, &callbacks, sess);
 
-    add_source (sess, source);
     *created = TRUE;
   } else {
     *created = FALSE;
@@ -1742,6 +1809,9 @@ obtain_source (RTPSession * sess, guint32 ssrc, gboolean * created,
   source->last_activity = pinfo->current_time;
   if (rtp)
     source->last_rtp_activity = pinfo->current_time;
+  /* added once its activity is known, for the timeout of the source */
+  if (*created)
+    add_source (sess, source);
   g_object_ref (source);
 
   return source;
@@ -2089,6 +2159,7 @@ source_update_sender (RTPSession * sess, RTPSource * source,
     sess->stats.sender_sources++;
     if (source->internal)
       sess->stats.internal_sender_sources++;
+    source_update_timeout (sess, source);
     GST_DEBUG ("source: %08x became sender, %d sender sources", ssrc,
         sess->stats.sender_sources);
   } else {
@@ -2467,6 +2538,7 @@ rtp_session_process_bye (RTPSession * sess, GstRTCPPacket * packet,
 
     /* mark the source BYE */
     rtp_source_mark_bye (source, reason);
+    source_update_timeout (sess, source);
 
     pmembers = sess->stats.active_sources;
 
@@ -2639,14 +2711,14 @@ rtp_session_process_fir (RTPSession * sess, guint32 sender_ssrc,
 
   /* Hack because Google fails to set the sender_ssrc correctly */
   if (!src && sender_ssrc == 1) {
-    GHashTableIter iter;
+    guint i;
 
     /* we can't find the source if there are multiple */
     if (sess->stats.sender_sources > sess->stats.internal_sender_sources + 1)
       return;
 
-    g_hash_table_iter_init (&iter, sess->ssrcs[sess->mask_idx]);
-    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & src)) {
+    for (i = 0; i < sess->sources->len; i++) {
+      src = g_ptr_array_index (sess->sources, i);
       if (!src->internal && rtp_source_is_sender (src))
         break;
       src = NULL;
@@ -3042,8 +3114,7 @@ calculate_rtcp_interval (RTPSession * sess, gboolean deterministic,
       /* If it is <= 0, then try to estimate the actual bandwidth */
       bandwidth = 0;
 
-      g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-          (GHFunc) add_bitrates, &bandwidth);
+      foreach_source (sess->sources, (GHFunc) add_bitrates, &bandwidth);
     }
     if (bandwidth < RTP_STATS_BANDWIDTH)
       bandwidth = RTP_STATS_BANDWIDTH;
@@ -3097,8 +3168,7 @@ rtp_session_mark_all_bye (RTPSession * sess, const gchar * reason)
   g_return_if_fail (RTP_IS_SESSION (sess));
 
   RTP_SESSION_LOCK (sess);
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-      (GHFunc) source_mark_bye, (gpointer) reason);
+  foreach_source (sess->sources, (GHFunc) source_mark_bye, (gpointer) reason);
   RTP_SESSION_UNLOCK (sess);
 }
 
@@ -3274,7 +3344,7 @@ typedef struct
   GstRTCPBuffer rtcpbuf;
   RTPSession *sess;
   RTPSource *source;
-  guint num_to_report;
+  guint num_closing;
   gboolean have_fir;
   gboolean have_pli;
   gboolean have_nack;
@@ -3333,44 +3403,16 @@ session_start_rtcp (RTPSession * sess, ReportData * data)
   }
 }
 
-/* construct a Sender or Receiver Report */
+/* make a report block about @source */
 static void
-session_report_blocks (const gchar * key, RTPSource * source, ReportData * data)
+session_add_rb (RTPSource * source, ReportData * data)
 {
-  RTPSession *sess = data->sess;
   GstRTCPPacket *packet = &data->packet;
   guint8 fractionlost;
   gint32 packetslost;
   guint32 exthighestseq, jitter;
   guint32 lsr, dlsr;
 
-  /* don't report for sources in future generations */
-  if (((gint16) (source->generation - sess->generation)) > 0) {
-    GST_DEBUG ("source %08x generation %u > %u", source->ssrc,
-        source->generation, sess->generation);
-    return;
-  }
-
-  if (g_hash_table_contains (source->reported_in_sr_of,
-          GUINT_TO_POINTER (data->source->ssrc))) {
-    GST_DEBUG ("source %08x already reported in this generation", source->ssrc);
-    return;
-  }
-
-  if (gst_rtcp_packet_get_rb_count (packet) == GST_RTCP_MAX_RB_COUNT) {
-    GST_DEBUG ("max RB count reached");
-    return;
-  }
-
-  /* only report about other sender */
-  if (source == data->source)
-    goto reported;
-
-  if (!RTP_SOURCE_IS_SENDER (source)) {
-    GST_DEBUG ("source %08x not sender", source->ssrc);
-    goto reported;
-  }
-
   GST_DEBUG ("create RB for SSRC %08x", source->ssrc);
 
   /* get new stats */
@@ -3389,15 +3431,41 @@ session_report_blocks (const gchar * key, RTPSource * source, ReportData * data)
   /* packet is not yet filled, add report block for this source. */
   gst_rtcp_packet_add_rb (packet, source->ssrc, fractionlost, packetslost,
       exthighestseq, jitter, lsr, dlsr);
+}
+
+/* construct the report blocks of a Sender or Receiver Report. When there are
+ * more senders than fit in one report, the next report of the same source
+ * continues where this one stopped, so all senders are reported round-robin
+ * over the intervals. */
+static void
+session_report_blocks (RTPSession * sess, ReportData * data)
+{
+  GstRTCPPacket *packet = &data->packet;
+  RTPSource *own = data->source;
+  guint i;
+
+  for (i = own->rb_cursor; i < sess->sources->len; i++) {
+    RTPSource *source = g_ptr_array_index (sess->sources, i);
 
-reported:
-  g_hash_table_add (source->reported_in_sr_of,
-      GUINT_TO_POINTER (data->source->ssrc));
+    /* only report about other senders */
+    if (source == own || !RTP_SOURCE_IS_SENDER (source))
+      continue;
+
+    if (gst_rtcp_packet_get_rb_count (packet) == GST_RTCP_MAX_RB_COUNT) {
+      GST_DEBUG ("max RB count reached, continue at %u next time", i);
+      break;
+    }
+
+    session_add_rb (source, data);
+  }
+
+  /* start from the first source again when all were reported */
+  own->rb_cursor = i < sess->sources->len ? i : 0;
 }
 
 /* construct FIR */
 static void
-session_add_fir (const gchar * key, RTPSource * source, ReportData * data)
+session_add_fir (gpointer key, RTPSource * source, ReportData * data)
 {
   GstRTCPPacket *packet = &data->packet;
   guint16 len;
@@ -3436,8 +3504,7 @@ session_fir (RTPSession * sess, ReportData * data)
   gst_rtcp_packet_fb_set_sender_ssrc (packet, data->source->ssrc);
   gst_rtcp_packet_fb_set_media_ssrc (packet, 0);
 
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-      (GHFunc) session_add_fir, data);
+  foreach_source (sess->feedback_sources, (GHFunc) session_add_fir, data);
 
   if (gst_rtcp_packet_fb_get_fci_length (packet) == 0)
     gst_rtcp_packet_remove (packet);
@@ -3467,7 +3534,7 @@ has_pli_compare_func (gconstpointer a, gconstpointer ignored)
 
 /* construct PLI */
 static void
-session_pli (const gchar * key, RTPSource * source, ReportData * data)
+session_pli (gpointer key, RTPSource * source, ReportData * data)
 {
   GstRTCPBuffer *rtcp = &data->rtcpbuf;
   GstRTCPPacket *packet = &data->packet;
@@ -3495,7 +3562,7 @@ session_pli (const gchar * key, RTPSource * source, ReportData * data)
 
 /* construct NACK */
 static void
-session_nack (const gchar * key, RTPSource * source, ReportData * data)
+session_nack (gpointer key, RTPSource * source, ReportData * data)
 {
   GstRTCPBuffer *rtcp = &data->rtcpbuf;
   GstRTCPPacket *packet = &data->packet;
@@ -3534,7 +3601,7 @@ session_nack (const gchar * key, RTPSource * source, ReportData * data)
 
 /* perform cleanup of sources that timed out */
 static void
-session_cleanup (const gchar * key, RTPSource * source, ReportData * data)
+session_cleanup (RTPSource * source, ReportData * data)
 {
   gboolean remove = FALSE;
   gboolean byetimeout = FALSE;
@@ -3544,7 +3611,7 @@ session_cleanup (const gchar * key, RTPSource * source, ReportData * data)
   GstClockTime interval, binterval;
   GstClockTime btime;
 
-  GST_DEBUG ("look at %08x, generation %u", source->ssrc, source->generation);
+  GST_DEBUG ("look at %08x", source->ssrc);
 
   /* check for outdated collisions */
   if (source->internal) {
@@ -3651,6 +3718,8 @@ session_cleanup (const gchar * key, RTPSource * source, ReportData * data)
     if (source->internal)
       sess->stats.internal_sources--;
 
+    data->num_closing++;
+
     if (byetimeout)
       on_bye_timeout (sess, source);
     else
@@ -3664,9 +3733,6 @@ session_cleanup (const gchar * key, RTPSource * source, ReportData * data)
 
       on_sender_timeout (sess, source);
     }
-    /* count how many source to report in this generation */
-    if (((gint16) (source->generation - sess->generation)) <= 0)
-      data->num_to_report++;
   }
   source->closing = remove;
 }
@@ -3850,27 +3916,83 @@ is_rtcp_time (RTPSession * sess, GstClockTime current_time, ReportData * data)
   return TRUE;
 }
 
+/* with the session lock, remember that @src has feedback to send so that
+ * only those sources are looked at when making the RTCP packets */
 static void
-clone_ssrcs_hashtable (gchar * key, RTPSource * source, GHashTable * hash_table)
+source_mark_feedback (RTPSession * sess, RTPSource * src)
 {
-  g_hash_table_insert (hash_table, key, g_object_ref (source));
+  if (src->feedback_pending)
+    return;
+
+  src->feedback_pending = TRUE;
+  g_ptr_array_add (sess->feedback_sources, g_object_ref (src));
 }
 
-static gboolean
-remove_closing_sources (const gchar * key, RTPSource * source,
-    ReportData * data)
+/* drop the sources that have no feedback to send anymore or that are
+ * removed and check what kind of feedback is left */
+static void
+update_feedback_sources (RTPSession * sess, ReportData * data)
+{
+  guint i;
+
+  for (i = sess->feedback_sources->len; i > 0; i--) {
+    RTPSource *source = g_ptr_array_index (sess->feedback_sources, i - 1);
+
+    if (!source->closing) {
+      if (source->send_fir)
+        data->have_fir = TRUE;
+      if (source->send_pli)
+        data->have_pli = TRUE;
+      if (source->send_nack)
+        data->have_nack = TRUE;
+
+      if (source->send_fir || source->send_pli || source->send_nack)
+        continue;
+    }
+    source->feedback_pending = FALSE;
+    g_ptr_array_remove_index_fast (sess->feedback_sources, i - 1);
+  }
+}
+
+/* remove the timeout sources marked closing by session_cleanup() and drop
+ * the ones that can now only time out from inactivity */
+static void
+update_timeout_sources (RTPSession * sess, ReportData * data)
+{
+  guint i;
+
+  for (i = sess->timeout_sources->len; i > 0; i--) {
+    RTPSource *source = g_ptr_array_index (sess->timeout_sources, i - 1);
+
+    if (source->closing) {
+      remove_source (sess, source);
+      data->num_closing--;
+    } else if (source_can_timeout (source)) {
+      continue;
+    }
+    source->timeout_pending = FALSE;
+    if (!source->closing)
+      source_update_timeout (sess, source);
+    g_ptr_array_remove_index_fast (sess->timeout_sources, i - 1);
+  }
+}
+
+/* remove the sources marked closing by session_cleanup() */
+static void
+remove_closing_sources (RTPSession * sess, ReportData * data)
 {
-  if (source->closing)
-    return TRUE;
+  guint i;
 
-  if (source->send_fir)
-    data->have_fir = TRUE;
-  if (source->send_pli)
-    data->have_pli = TRUE;
-  if (source->send_nack)
-    data->have_nack = TRUE;
+  /* going backwards, the sources moved in the place of removed ones are
+   * already checked */
+  for (i = sess->sources->len; i > 0 && data->num_closing > 0; i--) {
+    RTPSource *source = g_ptr_array_index (sess->sources, i - 1);
 
-  return FALSE;
+    if (source->closing) {
+      remove_source (sess, source);
+      data->num_closing--;
+    }
+  }
 }
 
 static void
@@ -3896,10 +4018,9 @@ generate_rtcp (const gchar * key, RTPSource * source, ReportData * data)
     /* send BYE */
     make_source_bye (sess, source, data);
   } else if (!data->is_early) {
-    /* loop over all known sources and add report blocks. If we are early, we
-     * just make a minimal RTCP packet and skip this step */
-    g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-        (GHFunc) session_report_blocks, data);
+    /* add report blocks about the next senders. If we are early, we just
+     * make a minimal RTCP packet and skip this step */
+    session_report_blocks (sess, data);
   }
   if (!data->has_sdes && (!data->is_early || !sess->reduced_size_rtcp))
     session_sdes (sess, data);
@@ -3908,12 +4029,10 @@ generate_rtcp (const gchar * key, RTPSource * source, ReportData * data)
     session_fir (sess, data);
 
   if (data->have_pli)
-    g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-        (GHFunc) session_pli, data);
+    foreach_source (sess->feedback_sources, (GHFunc) session_pli, data);
 
   if (data->have_nack)
-    g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-        (GHFunc) session_nack, data);
+    foreach_source (sess->feedback_sources, (GHFunc) session_nack, data);
 
   gst_rtcp_buffer_unmap (&data->rtcpbuf);
 
@@ -3924,28 +4043,6 @@ generate_rtcp (const gchar * key, RTPSource * source, ReportData * data)
   g_queue_push_tail (&data->output, output);
 }
 
-static void
-update_generation (const gchar * key, RTPSource * source, ReportData * data)
-{
-  RTPSession *sess = data->sess;
-
-  if (g_hash_table_size (source->reported_in_sr_of) >=
-      sess->stats.internal_sources) {
-    /* source is reported, move to next generation */
-    source->generation = sess->generation + 1;
-    g_hash_table_remove_all (source->reported_in_sr_of);
-
-    GST_LOG ("reported source %x, new generation: %d", source->ssrc,
-        source->generation);
-
-    /* if we reported all sources in this generation, move to next */
-    if (--data->num_to_report == 0) {
-      sess->generation++;
-      GST_DEBUG ("all reported, generation now %u", sess->generation);
-    }
-  }
-}
-
 /**
  * rtp_session_on_timeout:
  * @sess: an #RTPSession
@@ -3970,9 +4067,11 @@ rtp_session_on_timeout (RTPSession * sess, GstClockTime current_time,
 {
   GstFlowReturn result = GST_FLOW_OK;
   ReportData data = { GST_RTCP_BUFFER_INIT };
-  GHashTable *table_copy;
   ReportOutput *output;
   gboolean all_empty = FALSE;
+  gboolean check_all;
+  GPtrArray *sources;
+  guint i, n_sources;
 
   g_return_val_if_fail (RTP_IS_SESSION (sess), GST_FLOW_ERROR);
 
@@ -3984,7 +4083,7 @@ rtp_session_on_timeout (RTPSession * sess, GstClockTime current_time,
   data.current_time = current_time;
   data.ntpnstime = ntpnstime;
   data.running_time = running_time;
-  data.num_to_report = 0;
+  data.num_closing = 0;
   data.may_suppress = FALSE;
   data.nacked_seqnums = 0;
   g_queue_init (&data.output);
@@ -4013,21 +4112,40 @@ rtp_session_on_timeout (RTPSession * sess, GstClockTime current_time,
   sess->conflicting_addresses =
       timeout_conflicting_addresses (sess->conflicting_addresses, current_time);
 
-  /* Make a local copy of the hashtable. We need to do this because the
-   * cleanup stage below releases the session lock. */
-  table_copy = g_hash_table_new_full (NULL, NULL, NULL,
-      (GDestroyNotify) g_object_unref);
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-      (GHFunc) clone_ssrcs_hashtable, table_copy);
+  /* The sources that are not in the timeout sources only time out after 5
+   * times the deterministic interval without activity, and at least 5
+   * seconds. Only look at all of them when the oldest activity among them
+   * is that old. */
+  check_all = data.interval != GST_CLOCK_TIME_NONE &&
+      sess->timeout_activity != GST_CLOCK_TIME_NONE &&
+      current_time > sess->timeout_activity &&
+      current_time - sess->timeout_activity >
+      MAX (data.interval * 5, 5 * GST_SECOND);
+  if (check_all) {
+    /* the sources that are not timed out give the new oldest activity */
+    sess->timeout_activity = GST_CLOCK_TIME_NONE;
+    sources = sess->sources;
+  } else {
+    sources = sess->timeout_sources;
+  }
 
   /* Clean up the session, mark the source for removing, this might release the
-   * session lock. */
-  g_hash_table_foreach (table_copy, (GHFunc) session_cleanup, &data);
-  g_hash_table_destroy (table_copy);
+   * session lock. Sources are only removed below so the indexes stay valid,
+   * the sources added meanwhile are checked next time. */
+  n_sources = sources->len;
+  for (i = 0; i < n_sources; i++) {
+    RTPSource *source = g_object_ref (g_ptr_array_index (sources, i));
+
+    session_cleanup (source, &data);
+    if (check_all && !source->closing)
+      source_update_timeout (sess, source);
+    g_object_unref (source);
+  }
 
   /* Now remove the marked sources */
-  g_hash_table_foreach_remove (sess->ssrcs[sess->mask_idx],
-      (GHRFunc) remove_closing_sources, &data);
+  update_timeout_sources (sess, &data);
+  remove_closing_sources (sess, &data);
+  update_feedback_sources (sess, &data);
 
   /* update point-to-point status */
   session_update_ptp (sess);
@@ -4039,17 +4157,11 @@ rtp_session_on_timeout (RTPSession * sess, GstClockTime current_time,
   /* check if all the buffers are empty afer generation */
   all_empty = TRUE;
 
-  GST_DEBUG
-      ("doing RTCP generation %u for %u sources, early %d, may suppress %d",
-      sess->generation, data.num_to_report, data.is_early, data.may_suppress);
+  GST_DEBUG ("doing RTCP for %u sources, early %d, may suppress %d",
+      sess->sources->len, data.is_early, data.may_suppress);
 
   /* generate RTCP for all internal sources */
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-      (GHFunc) generate_rtcp, &data);
-
-  /* update the generation for all the sources that have been reported */
-  g_hash_table_foreach (sess->ssrcs[sess->mask_idx],
-      (GHFunc) update_generation, &data);
+  foreach_source (sess->sources, (GHFunc) generate_rtcp, &data);
 
   /* we keep track of the last report time in order to timeout inactive
    * receivers or senders */
@@ -4338,6 +4450,7 @@ rtp_session_request_key_unit (RTPSession * sess, guint32 ssrc,
   } else if (!src->send_fir) {
     src->send_pli = TRUE;
   }
+  source_mark_feedback (sess, src);
   RTP_SESSION_UNLOCK (sess);
 
   return TRUE;
@@ -4379,6 +4492,7 @@ rtp_session_request_nack (RTPSession * sess, guint32 ssrc, guint16 seqnum,
 
   GST_DEBUG ("request NACK for %08x, #%u", ssrc, seqnum);
   rtp_source_register_nack (source, seqnum);
+  source_mark_feedback (sess, source);
   RTP_SESSION_UNLOCK (sess);
 
   return TRUE;
@@ -199,6 +199,8 @@ typedef struct {
  * @lock: lock to protect the session
  * @source: the source of this session
  * @ssrcs: Hashtable of sources indexed by SSRC
+ * @sources: the sources of @ssrcs in an array, for iterating
+ * @feedback_sources: the sources with FIR, PLI or NACK requests to send
  * @num_sources: the number of sources
  * @activecount: the number of active sources
  * @callbacks: callbacks
@@ -242,9 +244,12 @@ struct _RTPSession {
   guint32       mask_idx;
   guint32       mask;
   GHashTable   *ssrcs[32];
+  GPtrArray    *sources;
+  GPtrArray    *feedback_sources;
+  GPtrArray    *timeout_sources;
+  GstClockTime  timeout_activity;
   guint         total_sources;
 
-  guint16       generation;
   GstClockTime  next_rtcp_check_time; /* tn */
   GstClockTime  last_rtcp_check_time; /* tp */
   GstClockTime  last_rtcp_send_time;  /* t_rr_last */
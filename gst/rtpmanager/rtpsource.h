@@ -137,8 +137,10 @@ struct _RTPSource {
   /*< private >*/
   guint32       ssrc;
 
-  guint16       generation;
-  GHashTable    *reported_in_sr_of;     /* set of SSRCs */
+  gint          session_idx;      /* index in the sources of the session */
+  guint         rb_cursor;        /* next source to make a report block for */
+  gboolean      feedback_pending; /* in the feedback sources of the session */
+  gboolean      timeout_pending;  /* in the timeout sources of the session */
 
   guint         probation;
   guint         curr_probation;
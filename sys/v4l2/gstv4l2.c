@@ -34,6 +34,7 @@
 #include <gst/gst.h>
 
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -41,12 +42,15 @@
 
 #include "ext/videodev2.h"
 #include "v4l2-utils.h"
+#include "v4l2-fake.h"
 
 #include "gstv4l2object.h"
 #include "gstv4l2src.h"
+#include "gstv4l2multisrc.h"
 #include "gstv4l2sink.h"
 #include "gstv4l2radio.h"
 #include "gstv4l2videodec.h"
+#include "gstv4l2videoenc.h"
 #include "gstv4l2deviceprovider.h"
 #include "gstv4l2transform.h"
 
@@ -55,10 +59,12 @@ GST_DEBUG_CATEGORY (v4l2_debug);
 #define GST_CAT_DEFAULT v4l2_debug
 
 #ifdef GST_V4L2_ENABLE_PROBE
+typedef gint (*GstV4l2IoctlFunc) (gint fd, gulong request, ...);
+
 /* This is a minimalist probe, for speed, we only enumerate formats */
 static GstCaps *
 gst_v4l2_probe_template_caps (const gchar * device, gint video_fd,
-    enum v4l2_buf_type type)
+    GstV4l2IoctlFunc ioctl_func, enum v4l2_buf_type type)
 {
   gint n;
   struct v4l2_fmtdesc format;
@@ -75,7 +81,7 @@ gst_v4l2_probe_template_caps (const gchar * device, gint video_fd,
     format.index = n;
     format.type = type;
 
-    if (ioctl (video_fd, VIDIOC_ENUM_FMT, &format) < 0)
+    if (ioctl_func (video_fd, VIDIOC_ENUM_FMT, &format) < 0)
       break;                    /* end of enumeration */
 
     GST_LOG ("index:       %u", format.index);
@@ -112,97 +118,371 @@ gst_v4l2_probe_template_caps (const gchar * device, gint video_fd,
   return gst_caps_simplify (caps);
 }
 
+/* Returns FALSE if the device is not a M2M device, otherwise the caps are
+ * returned, possibly empty */
 static gboolean
-gst_v4l2_probe_and_register (GstPlugin * plugin)
+gst_v4l2_probe_device_caps (const gchar * device_path,
+    const gchar * device_name, gint video_fd, GstV4l2IoctlFunc ioctl_func,
+    GstCaps ** sink_caps, GstCaps ** src_caps)
 {
-  GstV4l2Iterator *it;
-  gint video_fd = -1;
   struct v4l2_capability vcap;
-  gboolean ret = TRUE;
   guint32 device_caps;
 
-  it = gst_v4l2_iterator_new ();
+  memset (&vcap, 0, sizeof (vcap));
 
-  while (gst_v4l2_iterator_next (it)) {
-    GstCaps *src_caps, *sink_caps;
-    gchar *basename;
+  if (ioctl_func (video_fd, VIDIOC_QUERYCAP, &vcap) < 0) {
+    GST_DEBUG ("Failed to get device capabilities: %s", g_strerror (errno));
+    return FALSE;
+  }
 
-    if (video_fd >= 0)
-      close (video_fd);
+  if (vcap.capabilities & V4L2_CAP_DEVICE_CAPS)
+    device_caps = vcap.device_caps;
+  else
+    device_caps = vcap.capabilities;
+
+  if (!((device_caps & (V4L2_CAP_VIDEO_M2M | V4L2_CAP_VIDEO_M2M_MPLANE)) ||
+          /* But legacy driver may expose both CAPTURE and OUTPUT */
+          ((device_caps &
+                  (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE)) &&
+              (device_caps &
+                  (V4L2_CAP_VIDEO_OUTPUT | V4L2_CAP_VIDEO_OUTPUT_MPLANE)))))
+    return FALSE;
 
-    video_fd = open (it->device_path, O_RDWR | O_CLOEXEC);
+  GST_DEBUG ("Probing '%s' located at '%s'",
+      device_name ? device_name : (const gchar *) vcap.driver, device_path);
 
-    if (video_fd == -1) {
-      GST_DEBUG ("Failed to open %s: %s", it->device_path, g_strerror (errno));
-      continue;
-    }
+  /* get sink supported format (no MPLANE for codec) */
+  *sink_caps = gst_caps_merge (gst_v4l2_probe_template_caps (device_path,
+          video_fd, ioctl_func, V4L2_BUF_TYPE_VIDEO_OUTPUT),
+      gst_v4l2_probe_template_caps (device_path, video_fd, ioctl_func,
+          V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE));
 
-    memset (&vcap, 0, sizeof (vcap));
+  /* get src supported format */
+  *src_caps = gst_caps_merge (gst_v4l2_probe_template_caps (device_path,
+          video_fd, ioctl_func, V4L2_BUF_TYPE_VIDEO_CAPTURE),
+      gst_v4l2_probe_template_caps (device_path, video_fd, ioctl_func,
+          V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE));
 
-    if (ioctl (video_fd, VIDIOC_QUERYCAP, &vcap) < 0) {
-      GST_DEBUG ("Failed to get device capabilities: %s", g_strerror (errno));
-      continue;
+  return TRUE;
+}
+
+static gboolean
+gst_v4l2_register_device (GstPlugin * plugin, const gchar * basename,
+    const gchar * device_path, GstCaps * sink_caps, GstCaps * src_caps)
+{
+  gboolean ret = TRUE;
+
+  /* Skip devices without any supported formats */
+  if (gst_caps_is_empty (sink_caps) || gst_caps_is_empty (src_caps))
+    return TRUE;
+
+  if (gst_v4l2_is_video_dec (sink_caps, src_caps))
+    ret = gst_v4l2_video_dec_register (plugin, basename, device_path,
+        sink_caps, src_caps);
+  else if (gst_v4l2_is_video_enc (sink_caps, src_caps))
+    ret = gst_v4l2_video_enc_register (plugin, basename, device_path,
+        sink_caps, src_caps);
+  else if (gst_v4l2_is_transform (sink_caps, src_caps))
+    ret = gst_v4l2_transform_register (plugin, basename, device_path,
+        sink_caps, src_caps);
+  /* else if ( ... etc. */
+
+  return ret;
+}
+
+static gboolean
+gst_v4l2_probe_device (GstPlugin * plugin, const gchar * device_path,
+    const gchar * device_name, const gchar * basename, gint video_fd,
+    GstV4l2IoctlFunc ioctl_func)
+{
+  GstCaps *src_caps, *sink_caps;
+  gboolean ret;
+
+  if (!gst_v4l2_probe_device_caps (device_path, device_name, video_fd,
+          ioctl_func, &sink_caps, &src_caps))
+    return TRUE;
+
+  ret = gst_v4l2_register_device (plugin, basename, device_path, sink_caps,
+      src_caps);
+
+  gst_caps_unref (sink_caps);
+  gst_caps_unref (src_caps);
+
+  return ret;
+}
+
+/* Probe results are kept in a key file across registry rebuilds, with one
+ * group per device node. A node is only opened again if its identity
+ * changed: device number, node mtime or sysfs device (the driver was
+ * reloaded or the hardware replaced). Nodes that are not M2M devices are
+ * stored without caps so that they are skipped as well. */
+#define PROBE_CACHE_ENV "GST_V4L2_PROBE_CACHE"
+
+typedef struct
+{
+  gchar *path;
+  GKeyFile *old;
+  GKeyFile *new;
+} GstV4l2ProbeCache;
+
+static GstV4l2ProbeCache *
+gst_v4l2_probe_cache_new (void)
+{
+  GstV4l2ProbeCache *cache;
+  const gchar *env = g_getenv (PROBE_CACHE_ENV);
+  gchar *version;
+
+  /* An empty location disables the cache */
+  if (env && *env == '\0')
+    return NULL;
+
+  cache = g_new0 (GstV4l2ProbeCache, 1);
+
+  if (env)
+    cache->path = g_strdup (env);
+  else
+    cache->path = g_build_filename (g_get_user_cache_dir (),
+        "gstreamer-" GST_API_VERSION, "v4l2-probe.cache", NULL);
+
+  cache->new = g_key_file_new ();
+  g_key_file_set_string (cache->new, "cache", "version", VERSION);
+
+  cache->old = g_key_file_new ();
+  if (!g_key_file_load_from_file (cache->old, cache->path, G_KEY_FILE_NONE,
+          NULL))
+    goto done;
+
+  /* caps mapping may have changed with the plugin version */
+  version = g_key_file_get_string (cache->old, "cache", "version", NULL);
+  if (g_strcmp0 (version, VERSION)) {
+    GST_DEBUG ("discarding probe cache of version %s", version);
+    g_key_file_free (cache->old);
+    cache->old = g_key_file_new ();
+  }
+  g_free (version);
+
+done:
+  return cache;
+}
+
+static void
+gst_v4l2_probe_cache_free (GstV4l2ProbeCache * cache)
+{
+  gchar *old_data, *new_data, *dir;
+  GError *err = NULL;
+
+  old_data = g_key_file_to_data (cache->old, NULL, NULL);
+  new_data = g_key_file_to_data (cache->new, NULL, NULL);
+
+  if (g_strcmp0 (old_data, new_data)) {
+    dir = g_path_get_dirname (cache->path);
+    g_mkdir_with_parents (dir, 0755);
+    g_free (dir);
+
+    if (!g_file_set_contents (cache->path, new_data, -1, &err)) {
+      GST_DEBUG ("Failed to write probe cache: %s", err->message);
+      g_clear_error (&err);
     }
+  }
+
+  g_free (old_data);
+  g_free (new_data);
+  g_key_file_free (cache->old);
+  g_key_file_free (cache->new);
+  g_free (cache->path);
+  g_free (cache);
+}
+
+static gchar *
+gst_v4l2_probe_cache_identity (const gchar * device_path)
+{
+  struct stat st, sysfs_st;
+  gchar *basename, *link, *sysfs, *identity;
+
+  if (stat (device_path, &st) < 0 || !S_ISCHR (st.st_mode))
+    return NULL;
+
+  basename = g_path_get_basename (device_path);
+  link = g_build_filename ("/sys/class/video4linux", basename, "device",
+      NULL);
+  sysfs = realpath (link, NULL);
+  g_free (link);
+  g_free (basename);
+
+  if (sysfs == NULL || stat (sysfs, &sysfs_st) < 0) {
+    free (sysfs);
+    return NULL;
+  }
+
+  identity = g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT
+      ":%s:%" G_GINT64_FORMAT, (guint64) st.st_rdev, (gint64) st.st_mtime,
+      sysfs, (gint64) sysfs_st.st_mtime);
+  free (sysfs);
+
+  return identity;
+}
 
-    if (vcap.capabilities & V4L2_CAP_DEVICE_CAPS)
-      device_caps = vcap.device_caps;
-    else
-      device_caps = vcap.capabilities;
-
-    if (!((device_caps & (V4L2_CAP_VIDEO_M2M | V4L2_CAP_VIDEO_M2M_MPLANE)) ||
-            /* But legacy driver may expose both CAPTURE and OUTPUT */
-            ((device_caps &
-                    (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE)) &&
-                (device_caps &
-                    (V4L2_CAP_VIDEO_OUTPUT | V4L2_CAP_VIDEO_OUTPUT_MPLANE)))))
+/* Returns TRUE if @device_path is in the cache with the same @identity, the
+ * caps are NULL if the device is not a M2M device */
+static gboolean
+gst_v4l2_probe_cache_lookup (GstV4l2ProbeCache * cache,
+    const gchar * device_path, const gchar * identity, GstCaps ** sink_caps,
+    GstCaps ** src_caps)
+{
+  gchar *id, *sink, *src;
+  gboolean ret = FALSE;
+
+  id = g_key_file_get_string (cache->old, device_path, "identity", NULL);
+  if (g_strcmp0 (id, identity))
+    goto done;
+
+  sink = g_key_file_get_string (cache->old, device_path, "sink-caps", NULL);
+  src = g_key_file_get_string (cache->old, device_path, "src-caps", NULL);
+
+  *sink_caps = sink ? gst_caps_from_string (sink) : NULL;
+  *src_caps = src ? gst_caps_from_string (src) : NULL;
+
+  g_free (sink);
+  g_free (src);
+
+  /* both or none */
+  if (!*sink_caps != !*src_caps) {
+    gst_caps_replace (sink_caps, NULL);
+    gst_caps_replace (src_caps, NULL);
+    goto done;
+  }
+
+  ret = TRUE;
+
+done:
+  g_free (id);
+  return ret;
+}
+
+static void
+gst_v4l2_probe_cache_store (GstV4l2ProbeCache * cache,
+    const gchar * device_path, const gchar * identity, GstCaps * sink_caps,
+    GstCaps * src_caps)
+{
+  g_key_file_set_string (cache->new, device_path, "identity", identity);
+
+  if (sink_caps && src_caps) {
+    gchar *str;
+
+    str = gst_caps_to_string (sink_caps);
+    g_key_file_set_string (cache->new, device_path, "sink-caps", str);
+    g_free (str);
+
+    str = gst_caps_to_string (src_caps);
+    g_key_file_set_string (cache->new, device_path, "src-caps", str);
+    g_free (str);
+  }
+}
+
+/* Software emulated devices listed in the environment are registered as
+ * fake0, fake1, ... so they can be used in tests and benchmarks */
+static gboolean
+gst_v4l2_probe_fake_devices (GstPlugin * plugin)
+{
+  const gchar *env;
+  gchar **devices;
+  gboolean ret = TRUE;
+  gint i, n = 0;
+
+  env = g_getenv (GST_V4L2_FAKE_DEVICES_ENV);
+  if (env == NULL)
+    return TRUE;
+
+  devices = g_strsplit (env, ";", -1);
+
+  for (i = 0; ret && devices[i]; i++) {
+    gchar *basename;
+    gint video_fd;
+
+    if (!gst_v4l2_fake_is_fake_device (devices[i]))
       continue;
 
-    GST_DEBUG ("Probing '%s' located at '%s'",
-        it->device_name ? it->device_name : (const gchar *) vcap.driver,
-        it->device_path);
-
-    /* get sink supported format (no MPLANE for codec) */
-    sink_caps = gst_caps_merge (gst_v4l2_probe_template_caps (it->device_path,
-            video_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT),
-        gst_v4l2_probe_template_caps (it->device_path, video_fd,
-            V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE));
-
-    /* get src supported format */
-    src_caps = gst_caps_merge (gst_v4l2_probe_template_caps (it->device_path,
-            video_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE),
-        gst_v4l2_probe_template_caps (it->device_path, video_fd,
-            V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE));
-
-    /* Skip devices without any supported formats */
-    if (gst_caps_is_empty (sink_caps) || gst_caps_is_empty (src_caps)) {
-      gst_caps_unref (sink_caps);
-      gst_caps_unref (src_caps);
+    video_fd = gst_v4l2_fake_open_device (devices[i]);
+    if (video_fd < 0) {
+      GST_DEBUG ("Failed to open %s: %s", devices[i], g_strerror (errno));
       continue;
     }
 
-    basename = g_path_get_basename (it->device_path);
+    basename = g_strdup_printf ("fake%d", n++);
+    ret = gst_v4l2_probe_device (plugin, devices[i], NULL, basename,
+        video_fd, gst_v4l2_fake_ioctl);
+    g_free (basename);
 
-    if (gst_v4l2_is_video_dec (sink_caps, src_caps))
-      ret = gst_v4l2_video_dec_register (plugin, basename, it->device_path,
-          sink_caps, src_caps);
-    else if (gst_v4l2_is_transform (sink_caps, src_caps))
-      ret = gst_v4l2_transform_register (plugin, basename, it->device_path,
+    gst_v4l2_fake_close (video_fd);
+  }
+
+  g_strfreev (devices);
+
+  return ret;
+}
+
+static gboolean
+gst_v4l2_probe_and_register (GstPlugin * plugin)
+{
+  GstV4l2Iterator *it;
+  GstV4l2ProbeCache *cache;
+  gboolean ret = TRUE;
+
+  it = gst_v4l2_iterator_new ();
+  cache = gst_v4l2_probe_cache_new ();
+
+  while (ret && gst_v4l2_iterator_next (it)) {
+    GstCaps *sink_caps = NULL, *src_caps = NULL;
+    gchar *basename, *identity = NULL;
+    gint video_fd;
+
+    if (cache)
+      identity = gst_v4l2_probe_cache_identity (it->device_path);
+
+    if (identity && gst_v4l2_probe_cache_lookup (cache, it->device_path,
+            identity, &sink_caps, &src_caps)) {
+      GST_DEBUG ("Using cached probe of %s", it->device_path);
+    } else {
+      video_fd = open (it->device_path, O_RDWR | O_CLOEXEC);
+
+      if (video_fd == -1) {
+        GST_DEBUG ("Failed to open %s: %s", it->device_path,
+            g_strerror (errno));
+        g_free (identity);
+        continue;
+      }
+
+      if (!gst_v4l2_probe_device_caps (it->device_path, it->device_name,
+              video_fd, (GstV4l2IoctlFunc) ioctl, &sink_caps, &src_caps))
+        sink_caps = src_caps = NULL;
+
+      close (video_fd);
+    }
+
+    if (identity)
+      gst_v4l2_probe_cache_store (cache, it->device_path, identity,
           sink_caps, src_caps);
-    /* else if ( ... etc. */
 
-    gst_caps_unref (sink_caps);
-    gst_caps_unref (src_caps);
-    g_free (basename);
+    if (sink_caps && src_caps) {
+      basename = g_path_get_basename (it->device_path);
+      ret = gst_v4l2_register_device (plugin, basename, it->device_path,
+          sink_caps, src_caps);
+      g_free (basename);
+    }
 
-    if (!ret)
-      break;
+    gst_caps_replace (&sink_caps, NULL);
+    gst_caps_replace (&src_caps, NULL);
+    g_free (identity);
   }
 
-  if (video_fd >= 0)
-    close (video_fd);
+  if (cache)
+    gst_v4l2_probe_cache_free (cache);
 
   gst_v4l2_iterator_free (it);
 
+  if (ret)
+    ret = gst_v4l2_probe_fake_devices (plugin);
+
   return ret;
 }
 #endif
@@ -212,6 +492,7 @@ plugin_init (GstPlugin * plugin)
 {
   const gchar *paths[] = { "/dev", "/dev/v4l2", NULL };
   const gchar *names[] = { "video", NULL };
+  const gchar *env[] = { GST_V4L2_FAKE_DEVICES_ENV, NULL };
 
   GST_DEBUG_CATEGORY_INIT (v4l2_debug, "v4l2", 0, "V4L2 API calls");
 
@@ -219,6 +500,8 @@ plugin_init (GstPlugin * plugin)
    * /dev/video* */
   gst_plugin_add_dependency (plugin,
       NULL, paths, names, GST_PLUGIN_DEPENDENCY_FLAG_FILE_NAME_IS_PREFIX);
+  gst_plugin_add_dependency (plugin, env, NULL, NULL,
+      GST_PLUGIN_DEPENDENCY_FLAG_NONE);
 
   if (!gst_element_register (plugin, "v4l2src", GST_RANK_PRIMARY,
           GST_TYPE_V4L2SRC) ||
@@ -226,6 +509,8 @@ plugin_init (GstPlugin * plugin)
           GST_TYPE_V4L2SINK) ||
       !gst_element_register (plugin, "v4l2radio", GST_RANK_NONE,
           GST_TYPE_V4L2RADIO) ||
+      !gst_element_register (plugin, "v4l2multisrc", GST_RANK_NONE,
+          GST_TYPE_V4L2_MULTI_SRC) ||
       !gst_device_provider_register (plugin, "v4l2deviceprovider",
           GST_RANK_PRIMARY, GST_TYPE_V4L2_DEVICE_PROVIDER)
       /* etc. */
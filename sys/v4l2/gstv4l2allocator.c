@@ -259,7 +259,7 @@ gst_v4l2_memory_group_new (GstV4l2Allocator * allocator, guint32 index)
     group->n_mem = 1;
   }
 
-  if (v4l2_ioctl (video_fd, VIDIOC_QUERYBUF, &group->buffer) < 0)
+  if (allocator->ioctl (video_fd, VIDIOC_QUERYBUF, &group->buffer) < 0)
     goto querybuf_failed;
 
   if (group->buffer.index != index) {
@@ -387,7 +387,7 @@ gst_v4l2_allocator_free (GstAllocator * gallocator, GstMemory * gmem)
 
     if (allocator->memory == V4L2_MEMORY_MMAP) {
       if (mem->data)
-        v4l2_munmap (mem->data, group->planes[mem->plane].length);
+        allocator->munmap (mem->data, group->planes[mem->plane].length);
     }
 
     /* This apply for both mmap with expbuf, and dmabuf imported memory */
@@ -423,7 +423,7 @@ gst_v4l2_allocator_finalize (GObject * obj)
 
   GST_LOG_OBJECT (obj, "called");
 
-  v4l2_close (allocator->video_fd);
+  allocator->close (allocator->video_fd);
   gst_atomic_queue_unref (allocator->free_queue);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
@@ -484,7 +484,7 @@ gst_v4l2_allocator_probe (GstV4l2Allocator * allocator, guint32 memory,
   breq.count = 0;
   breq.memory = memory;
 
-  if (v4l2_ioctl (allocator->video_fd, VIDIOC_REQBUFS, &breq) == 0) {
+  if (allocator->ioctl (allocator->video_fd, VIDIOC_REQBUFS, &breq) == 0) {
     struct v4l2_create_buffers bcreate = { 0 };
 
     flags |= breq_flag;
@@ -492,7 +492,8 @@ gst_v4l2_allocator_probe (GstV4l2Allocator * allocator, guint32 memory,
     bcreate.memory = memory;
     bcreate.format = allocator->format;
 
-    if ((v4l2_ioctl (allocator->video_fd, VIDIOC_CREATE_BUFS, &bcreate) == 0))
+    if ((allocator->ioctl (allocator->video_fd, VIDIOC_CREATE_BUFS,
+                &bcreate) == 0))
       flags |= bcreate_flag;
   }
 
@@ -517,7 +518,8 @@ gst_v4l2_allocator_create_buf (GstV4l2Allocator * allocator)
   if (!allocator->can_allocate)
     goto done;
 
-  if (v4l2_ioctl (allocator->video_fd, VIDIOC_CREATE_BUFS, &bcreate) < 0)
+  if (allocator->ioctl (allocator->video_fd, VIDIOC_CREATE_BUFS,
+          &bcreate) < 0)
     goto create_bufs_failed;
 
   if (allocator->groups[bcreate.index] != NULL)
@@ -627,9 +629,9 @@ _cleanup_failed_alloc (GstV4l2Allocator * allocator, GstV4l2MemoryGroup * group)
 
 
 GstV4l2Allocator *
-gst_v4l2_allocator_new (GstObject * parent, gint video_fd,
-    struct v4l2_format *format)
+gst_v4l2_allocator_new (GstObject * parent, GstV4l2Object * v4l2object)
 {
+  struct v4l2_format *format = &v4l2object->format;
   GstV4l2Allocator *allocator;
   guint32 flags = 0;
   gchar *name, *parent_name;
@@ -642,7 +644,11 @@ gst_v4l2_allocator_new (GstObject * parent, gint video_fd,
   g_free (name);
 
   /* Save everything */
-  allocator->video_fd = v4l2_dup (video_fd);
+  allocator->close = v4l2object->close;
+  allocator->ioctl = v4l2object->ioctl;
+  allocator->mmap = v4l2object->mmap;
+  allocator->munmap = v4l2object->munmap;
+  allocator->video_fd = v4l2object->dup (v4l2object->video_fd);
   allocator->type = format->type;
   allocator->format = *format;
 
@@ -681,7 +687,12 @@ gst_v4l2_allocator_start (GstV4l2Allocator * allocator, guint32 count,
   if (g_atomic_int_get (&allocator->active))
     goto already_active;
 
-  if (v4l2_ioctl (allocator->video_fd, VIDIOC_REQBUFS, &breq) < 0)
+  memset (allocator->latency_hist, 0, sizeof (allocator->latency_hist));
+  allocator->latency_count = 0;
+  allocator->latency_sum = 0;
+  allocator->latency_max = 0;
+
+  if (allocator->ioctl (allocator->video_fd, VIDIOC_REQBUFS, &breq) < 0)
     goto reqbufs_failed;
 
   if (breq.count < 1)
@@ -779,7 +790,7 @@ gst_v4l2_allocator_stop (GstV4l2Allocator * allocator)
   }
 
   /* Not all drivers support rebufs(0), so warn only */
-  if (v4l2_ioctl (allocator->video_fd, VIDIOC_REQBUFS, &breq) < 0)
+  if (allocator->ioctl (allocator->video_fd, VIDIOC_REQBUFS, &breq) < 0)
     GST_WARNING_OBJECT (allocator,
         "error releasing buffers buffers: %s", g_strerror (errno));
 
@@ -808,8 +819,9 @@ gst_v4l2_allocator_alloc_mmap (GstV4l2Allocator * allocator)
   for (i = 0; i < group->n_mem; i++) {
     if (group->mem[i] == NULL) {
       gpointer data;
-      data = v4l2_mmap (NULL, group->planes[i].length, PROT_READ | PROT_WRITE,
-          MAP_SHARED, allocator->video_fd, group->planes[i].m.mem_offset);
+      data = allocator->mmap (NULL, group->planes[i].length,
+          PROT_READ | PROT_WRITE, MAP_SHARED, allocator->video_fd,
+          group->planes[i].m.mem_offset);
 
       if (data == MAP_FAILED)
         goto mmap_failed;
@@ -873,7 +885,8 @@ gst_v4l2_allocator_alloc_dmabuf (GstV4l2Allocator * allocator,
       expbuf.plane = i;
       expbuf.flags = O_CLOEXEC | O_RDWR;
 
-      if (v4l2_ioctl (allocator->video_fd, VIDIOC_EXPBUF, &expbuf) < 0)
+      if (allocator->ioctl (allocator->video_fd, VIDIOC_EXPBUF,
+              &expbuf) < 0)
         goto expbuf_failed;
 
       GST_LOG_OBJECT (allocator, "exported DMABUF as fd %i plane %d",
@@ -1061,9 +1074,14 @@ gst_v4l2_allocator_alloc_userptr (GstV4l2Allocator * allocator)
   return group;
 }
 
+/* @offset and @size describe each plane within its dmabuf, they default to
+ * the offset and size of the memory when NULL. Several planes can share a
+ * dmabuf, the offsets are then passed as data_offset which only exists in
+ * the multi-planar API. */
 gboolean
 gst_v4l2_allocator_import_dmabuf (GstV4l2Allocator * allocator,
-    GstV4l2MemoryGroup * group, gint n_mem, GstMemory ** dma_mem)
+    GstV4l2MemoryGroup * group, gint n_mem, GstMemory ** dma_mem,
+    const gsize * offset, const gsize * size)
 {
   GstV4l2Memory *mem;
   gint i;
@@ -1075,38 +1093,49 @@ gst_v4l2_allocator_import_dmabuf (GstV4l2Allocator * allocator,
 
   for (i = 0; i < group->n_mem; i++) {
     gint dmafd;
-    gsize size, offset, maxsize;
+    gsize psize, poffset, maxsize;
 
     if (!gst_is_dmabuf_memory (dma_mem[i]))
       goto not_dmabuf;
 
-    size = gst_memory_get_sizes (dma_mem[i], &offset, &maxsize);
+    psize = gst_memory_get_sizes (dma_mem[i], &poffset, &maxsize);
+    if (offset)
+      poffset = offset[i];
+    if (size)
+      psize = size[i];
+
+    if (poffset + psize > maxsize)
+      goto out_of_bounds;
+
+    if (poffset && !V4L2_TYPE_IS_MULTIPLANAR (allocator->type))
+      goto unsupported_offset;
 
     if ((dmafd = dup (gst_dmabuf_memory_get_fd (dma_mem[i]))) < 0)
       goto dup_failed;
 
-    GST_LOG_OBJECT (allocator, "imported DMABUF as fd %i plane %d", dmafd, i);
+    GST_LOG_OBJECT (allocator, "imported DMABUF as fd %i plane %d offset %"
+        G_GSIZE_FORMAT, dmafd, i, poffset);
 
     mem = (GstV4l2Memory *) group->mem[i];
 
     /* Update memory */
     mem->mem.maxsize = maxsize;
-    mem->mem.offset = offset;
-    mem->mem.size = size;
+    mem->mem.offset = poffset;
+    mem->mem.size = psize;
     mem->dmafd = dmafd;
 
-    /* Update v4l2 structure */
+    /* Update v4l2 structure, bytesused includes the data_offset */
     group->planes[i].length = maxsize;
-    group->planes[i].bytesused = size;
+    group->planes[i].bytesused = poffset + psize;
     group->planes[i].m.fd = dmafd;
-    group->planes[i].data_offset = offset;
+    group->planes[i].data_offset = poffset;
   }
 
   /* Copy into buffer structure if not using planes */
   if (!V4L2_TYPE_IS_MULTIPLANAR (allocator->type)) {
     group->buffer.bytesused = group->planes[0].bytesused;
     group->buffer.length = group->planes[0].length;
-    group->buffer.m.fd = group->planes[0].m.userptr;
+    group->buffer.m.fd = group->planes[0].m.fd;
   } else {
     group->buffer.length = group->n_mem;
   }
@@ -1124,6 +1153,17 @@ not_dmabuf:
     GST_ERROR_OBJECT (allocator, "Memory %i is not of DMABUF", i);
     return FALSE;
   }
+out_of_bounds:
+  {
+    GST_ERROR_OBJECT (allocator, "Plane %i does not fit in its DMABUF", i);
+    return FALSE;
+  }
+unsupported_offset:
+  {
+    GST_ERROR_OBJECT (allocator, "Plane %i has an offset, which the single "
+        "planar API cannot express", i);
+    return FALSE;
+  }
 dup_failed:
   {
     GST_ERROR_OBJECT (allocator, "Failed to dup DMABUF descriptor: %s",
@@ -1222,6 +1262,42 @@ done:
   GST_OBJECT_UNLOCK (allocator);
 }
 
+static guint
+gst_v4l2_allocator_latency_bucket (GstClockTime latency)
+{
+  guint64 units = latency / (128 * GST_USECOND);
+  guint i = 0;
+
+  while (units && i < GST_V4L2_LATENCY_BUCKETS - 1) {
+    units >>= 1;
+    i++;
+  }
+
+  return i;
+}
+
+/* Called with the object lock, returns the upper bound of the bucket
+ * holding the given percentile */
+static GstClockTime
+gst_v4l2_allocator_latency_percentile (GstV4l2Allocator * allocator,
+    guint percent)
+{
+  guint64 target, count = 0;
+  guint i;
+
+  target = (allocator->latency_count * percent + 99) / 100;
+  if (target == 0)
+    return 0;
+
+  for (i = 0; i < GST_V4L2_LATENCY_BUCKETS - 1; i++) {
+    count += allocator->latency_hist[i];
+    if (count >= target)
+      return MIN ((128 * GST_USECOND) << i, allocator->latency_max);
+  }
+
+  return allocator->latency_max;
+}
+
 gboolean
 gst_v4l2_allocator_qbuf (GstV4l2Allocator * allocator,
     GstV4l2MemoryGroup * group)
@@ -1244,7 +1320,10 @@ gst_v4l2_allocator_qbuf (GstV4l2Allocator * allocator,
   for (i = 0; i < group->n_mem; i++)
     gst_memory_ref (group->mem[i]);
 
-  if (v4l2_ioctl (allocator->video_fd, VIDIOC_QBUF, &group->buffer) < 0) {
+  allocator->qbuf_time[group->buffer.index] = g_get_monotonic_time ();
+
+  if (allocator->ioctl (allocator->video_fd, VIDIOC_QBUF,
+          &group->buffer) < 0) {
     GST_ERROR_OBJECT (allocator, "failed queueing buffer %i: %s",
         group->buffer.index, g_strerror (errno));
 
@@ -1280,6 +1359,7 @@ gst_v4l2_allocator_dqbuf (GstV4l2Allocator * allocator,
 {
   struct v4l2_buffer buffer = { 0 };
   struct v4l2_plane planes[VIDEO_MAX_PLANES] = { {0} };
+  GstClockTime latency;
   gint i;
 
   GstV4l2MemoryGroup *group = NULL;
@@ -1294,7 +1374,7 @@ gst_v4l2_allocator_dqbuf (GstV4l2Allocator * allocator,
     buffer.m.planes = planes;
   }
 
-  if (v4l2_ioctl (allocator->video_fd, VIDIOC_DQBUF, &buffer) < 0)
+  if (allocator->ioctl (allocator->video_fd, VIDIOC_DQBUF, &buffer) < 0)
     goto error;
 
   group = allocator->groups[buffer.index];
@@ -1305,6 +1385,16 @@ gst_v4l2_allocator_dqbuf (GstV4l2Allocator * allocator,
     return GST_FLOW_ERROR;
   }
 
+  latency = (g_get_monotonic_time () - allocator->qbuf_time[buffer.index]) *
+      GST_USECOND;
+
+  GST_OBJECT_LOCK (allocator);
+  allocator->latency_hist[gst_v4l2_allocator_latency_bucket (latency)]++;
+  allocator->latency_count++;
+  allocator->latency_sum += latency;
+  allocator->latency_max = MAX (allocator->latency_max, latency);
+  GST_OBJECT_UNLOCK (allocator);
+
   group->buffer = buffer;
 
   GST_LOG_OBJECT (allocator, "dequeued buffer %i (flags 0x%X)", buffer.index,
@@ -1422,3 +1512,45 @@ gst_v4l2_allocator_reset_group (GstV4l2Allocator * allocator,
 
   gst_v4l2_allocator_reset_size (allocator, group);
 }
+
+/**
+ * gst_v4l2_allocator_get_latency_stats:
+ * @allocator: a #GstV4l2Allocator
+ * @stats: the structure to fill
+ *
+ * Set the qbuf to dqbuf latency statistics in @stats: the histogram as an
+ * array of %GST_V4L2_LATENCY_BUCKETS counts, the average, the maximum and
+ * an upper bound of the 50th, 90th and 99th percentiles.
+ */
+void
+gst_v4l2_allocator_get_latency_stats (GstV4l2Allocator * allocator,
+    GstStructure * stats)
+{
+  GValue hist = G_VALUE_INIT;
+  GValue v = G_VALUE_INIT;
+  guint i;
+
+  g_value_init (&hist, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_UINT64);
+
+  GST_OBJECT_LOCK (allocator);
+  for (i = 0; i < GST_V4L2_LATENCY_BUCKETS; i++) {
+    g_value_set_uint64 (&v, allocator->latency_hist[i]);
+    gst_value_array_append_value (&hist, &v);
+  }
+
+  gst_structure_set (stats,
+      "latency-average", G_TYPE_UINT64, allocator->latency_count ?
+      allocator->latency_sum / allocator->latency_count : 0,
+      "latency-max", G_TYPE_UINT64, allocator->latency_max,
+      "latency-p50", G_TYPE_UINT64,
+      gst_v4l2_allocator_latency_percentile (allocator, 50),
+      "latency-p90", G_TYPE_UINT64,
+      gst_v4l2_allocator_latency_percentile (allocator, 90),
+      "latency-p99", G_TYPE_UINT64,
+      gst_v4l2_allocator_latency_percentile (allocator, 99), NULL);
+  GST_OBJECT_UNLOCK (allocator);
+
+  gst_structure_take_value (stats, "latency-histogram", &hist);
+  g_value_unset (&v);
+}
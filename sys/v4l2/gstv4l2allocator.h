@@ -27,6 +27,15 @@
 #include <gst/gst.h>
 #include <gst/gstatomicqueue.h>
 
+typedef struct _GstV4l2Allocator GstV4l2Allocator;
+typedef struct _GstV4l2AllocatorClass GstV4l2AllocatorClass;
+typedef struct _GstV4l2MemoryGroup GstV4l2MemoryGroup;
+typedef struct _GstV4l2Memory GstV4l2Memory;
+typedef enum _GstV4l2Capabilities GstV4l2Capabilities;
+typedef enum _GstV4l2Return GstV4l2Return;
+
+#include "gstv4l2object.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_V4L2_ALLOCATOR                 (gst_v4l2_allocator_get_type())
@@ -44,12 +53,9 @@ G_BEGIN_DECLS
 
 #define GST_V4L2_MEMORY_QUARK gst_v4l2_memory_quark ()
 
-typedef struct _GstV4l2Allocator GstV4l2Allocator;
-typedef struct _GstV4l2AllocatorClass GstV4l2AllocatorClass;
-typedef struct _GstV4l2MemoryGroup GstV4l2MemoryGroup;
-typedef struct _GstV4l2Memory GstV4l2Memory;
-typedef enum _GstV4l2Capabilities GstV4l2Capabilities;
-typedef enum _GstV4l2Return GstV4l2Return;
+/* Bucket i of the qbuf to dqbuf latency histogram counts the buffers that
+ * spent less than 128us << i in the driver, the last one counts the rest */
+#define GST_V4L2_LATENCY_BUCKETS 12
 
 enum _GstV4l2AllocatorFlags
 {
@@ -101,6 +107,20 @@ struct _GstV4l2Allocator
   GstAtomicQueue *free_queue;
   GstAtomicQueue *pending_queue;
 
+  /* the syscalls of the object, copied as the memories can outlive it */
+  gint (*close) (gint fd);
+  gint (*ioctl) (gint fd, gulong request, ...);
+  gpointer (*mmap) (gpointer start, gsize length, gint prot, gint flags,
+      gint fd, off_t offset);
+  gint (*munmap) (gpointer _start, gsize length);
+
+  /* qbuf to dqbuf latency, the statistics are protected by the object lock */
+  gint64 qbuf_time[VIDEO_MAX_FRAME];
+  guint64 latency_hist[GST_V4L2_LATENCY_BUCKETS];
+  guint64 latency_count;
+  GstClockTime latency_sum;
+  GstClockTime latency_max;
+
 };
 
 struct _GstV4l2AllocatorClass {
@@ -117,8 +137,7 @@ gboolean             gst_v4l2_allocator_is_active      (GstV4l2Allocator * alloc
 
 guint                gst_v4l2_allocator_get_size       (GstV4l2Allocator * allocator);
 
-GstV4l2Allocator*    gst_v4l2_allocator_new            (GstObject *parent, gint video_fd,
-                                                        struct v4l2_format * format);
+GstV4l2Allocator*    gst_v4l2_allocator_new            (GstObject *parent, GstV4l2Object * obj);
 
 guint                gst_v4l2_allocator_start          (GstV4l2Allocator * allocator,
                                                         guint32 count, guint32 memory);
@@ -136,7 +155,9 @@ GstV4l2MemoryGroup * gst_v4l2_allocator_alloc_userptr  (GstV4l2Allocator * alloc
 
 gboolean             gst_v4l2_allocator_import_dmabuf  (GstV4l2Allocator * allocator,
                                                         GstV4l2MemoryGroup *group,
-                                                        gint n_mem, GstMemory ** dma_mem);
+                                                        gint n_mem, GstMemory ** dma_mem,
+                                                        const gsize * offset,
+                                                        const gsize * size);
 
 gboolean             gst_v4l2_allocator_import_userptr (GstV4l2Allocator * allocator,
                                                         GstV4l2MemoryGroup *group,
@@ -154,6 +175,9 @@ GstFlowReturn        gst_v4l2_allocator_dqbuf          (GstV4l2Allocator * alloc
 void                 gst_v4l2_allocator_reset_group    (GstV4l2Allocator * allocator,
                                                         GstV4l2MemoryGroup * group);
 
+void                 gst_v4l2_allocator_get_latency_stats (GstV4l2Allocator * allocator,
+                                                        GstStructure * stats);
+
 G_END_DECLS
 
 #endif /* __GST_V4L2_ALLOCATOR_H__ */
@@ -31,10 +31,17 @@
 #endif
 #include <fcntl.h>
 
+#include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
 #include <string.h>
 #include <unistd.h>
 
+#ifdef HAVE_LINUX_DMA_BUF_H
+#include <linux/dma-buf.h>
+#endif
+
 #include "gst/video/video.h"
 #include "gst/video/gstvideometa.h"
 #include "gst/video/gstvideopool.h"
@@ -43,6 +50,7 @@
 #include <gstv4l2bufferpool.h>
 
 #include "v4l2_calls.h"
+#include "v4l2-copy.h"
 #include "gst/gst-i18n-plugin.h"
 #include <gst/glib-compat-private.h>
 
@@ -51,6 +59,10 @@ GST_DEBUG_CATEGORY_STATIC (CAT_PERFORMANCE);
 #define GST_CAT_DEFAULT v4l2bufferpool_debug
 
 #define GST_V4L2_IMPORT_QUARK gst_v4l2_buffer_pool_import_quark ()
+#define GST_V4L2_INODE_QUARK gst_v4l2_buffer_pool_inode_quark ()
+
+/* how long to wait for the producer of an imported dmabuf */
+#define GST_V4L2_FENCE_TIMEOUT_MS 1000
 
 
 /*
@@ -63,9 +75,29 @@ enum _GstV4l2BufferPoolAcquireFlags
 {
   GST_V4L2_BUFFER_POOL_ACQUIRE_FLAG_RESURRECT =
       GST_BUFFER_POOL_ACQUIRE_FLAG_LAST,
+  GST_V4L2_BUFFER_POOL_ACQUIRE_FLAG_IMPORT =
+      GST_BUFFER_POOL_ACQUIRE_FLAG_LAST << 1,
   GST_V4L2_BUFFER_POOL_ACQUIRE_FLAG_LAST
 };
 
+/* Passed with GST_V4L2_BUFFER_POOL_ACQUIRE_FLAG_IMPORT to get the free
+ * buffer already bound to the memory about to be imported */
+typedef struct
+{
+  GstBufferPoolAcquireParams parent;
+  const GstV4l2ImportKey *key;
+} GstV4l2ImportAcquireParams;
+
+/* Where each V4L2 plane of an upstream buffer lives, the offsets are from
+ * the start of the dmabuf */
+typedef struct
+{
+  guint n_planes;
+  GstMemory *mem[GST_VIDEO_MAX_PLANES];
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gsize size[GST_VIDEO_MAX_PLANES];
+} GstV4l2DmabufPlanes;
+
 static void gst_v4l2_buffer_pool_release_buffer (GstBufferPool * bpool,
     GstBuffer * buffer);
 
@@ -131,7 +163,8 @@ gst_v4l2_buffer_pool_copy_buffer (GstV4l2BufferPool * pool, GstBuffer * dest,
       goto invalid_buffer;
     }
 
-    gst_video_frame_copy (&dest_frame, &src_frame);
+    if (!gst_v4l2_copy_frame (&dest_frame, &src_frame))
+      gst_video_frame_copy (&dest_frame, &src_frame);
 
     gst_video_frame_unmap (&src_frame);
     gst_video_frame_unmap (&dest_frame);
@@ -152,6 +185,7 @@ gst_v4l2_buffer_pool_copy_buffer (GstV4l2BufferPool * pool, GstBuffer * dest,
   gst_buffer_copy_into (dest, src,
       GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
 
+  g_atomic_int_inc (&pool->num_copies);
   GST_CAT_LOG_OBJECT (CAT_PERFORMANCE, pool, "slow copy into buffer %p", dest);
 
   return GST_FLOW_OK;
@@ -163,12 +197,41 @@ invalid_buffer:
   }
 }
 
+/* Deep copy of a captured buffer, keeping its layout */
+static GstBuffer *
+gst_v4l2_buffer_pool_copy_captured (GstV4l2BufferPool * pool, GstBuffer * buf)
+{
+  GstBuffer *copy;
+  GstMapInfo src_map, dest_map;
+
+  if (gst_buffer_n_memory (buf) != 1 ||
+      !gst_buffer_map (buf, &src_map, GST_MAP_READ))
+    return gst_buffer_copy_region (buf,
+        GST_BUFFER_COPY_ALL | GST_BUFFER_COPY_DEEP, 0, -1);
+
+  copy = gst_buffer_new_allocate (NULL, src_map.size, NULL);
+  gst_buffer_map (copy, &dest_map, GST_MAP_WRITE);
+  gst_v4l2_copy_plane (dest_map.data, 0, src_map.data, 0, src_map.size, 1);
+  gst_buffer_unmap (copy, &dest_map);
+  gst_buffer_unmap (buf, &src_map);
+
+  gst_buffer_copy_into (copy, buf, GST_BUFFER_COPY_METADATA, 0, -1);
+
+  return copy;
+}
+
 struct UserPtrData
 {
   GstBuffer *buffer;
   gboolean is_frame;
   GstVideoFrame frame;
   GstMapInfo map;
+
+  /* what gets imported */
+  gint n_planes;
+  gpointer ptr[GST_VIDEO_MAX_PLANES];
+  gsize size[GST_VIDEO_MAX_PLANES];
+  gsize img_size;
 };
 
 static GQuark
@@ -182,6 +245,17 @@ gst_v4l2_buffer_pool_import_quark (void)
   return quark;
 }
 
+static GQuark
+gst_v4l2_buffer_pool_inode_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (quark == 0)
+    quark = g_quark_from_string ("GstV4l2BufferPoolDmabufInode");
+
+  return quark;
+}
+
 static void
 _unmap_userptr_frame (struct UserPtrData *data)
 {
@@ -196,22 +270,299 @@ _unmap_userptr_frame (struct UserPtrData *data)
   g_slice_free (struct UserPtrData, data);
 }
 
+static gboolean
+gst_v4l2_import_key_equal (const GstV4l2ImportKey * a,
+    const GstV4l2ImportKey * b)
+{
+  guint i;
+
+  if (a->n_mem == 0 || a->n_mem != b->n_mem)
+    return FALSE;
+
+  for (i = 0; i < a->n_mem; i++) {
+    if (a->id[i] != b->id[i] || a->offset[i] != b->offset[i] ||
+        a->size[i] != b->size[i])
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Check that the planes described by @vmeta are where the driver expects
+ * them, as set by the last S_FMT */
+static gboolean
+gst_v4l2_buffer_pool_layout_matches (GstV4l2BufferPool * pool,
+    GstVideoMeta * vmeta)
+{
+  GstVideoInfo *info = &pool->obj->info;
+  guint i;
+
+  if (vmeta->n_planes != GST_VIDEO_INFO_N_PLANES (info))
+    return FALSE;
+
+  for (i = 0; i < vmeta->n_planes; i++) {
+    if (vmeta->stride[i] != GST_VIDEO_INFO_PLANE_STRIDE (info, i))
+      return FALSE;
+
+    /* with a single V4L2 plane, the other planes follow at fixed offsets */
+    if (pool->obj->n_v4l2_planes <= 1 &&
+        vmeta->offset[i] - vmeta->offset[0] !=
+        GST_VIDEO_INFO_PLANE_OFFSET (info, i))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Locate each V4L2 plane of @src. Either every memory holds one plane, or
+ * the planes are spread over fewer memories, found through the video meta
+ * offsets. Returns FALSE if @src cannot be imported as is. */
+static gboolean
+gst_v4l2_buffer_pool_dmabuf_planes (GstV4l2BufferPool * pool,
+    GstBuffer * src, GstV4l2DmabufPlanes * planes)
+{
+  const GstVideoFormatInfo *finfo = pool->caps_info.finfo;
+  GstVideoMeta *vmeta = NULL;
+  guint i, n_mem = gst_buffer_n_memory (src);
+  guint n_planes = MAX (pool->obj->n_v4l2_planes, 1);
+  gboolean is_raw;
+
+  if (n_mem == 0 || n_mem > GST_VIDEO_MAX_PLANES)
+    return FALSE;
+
+  for (i = 0; i < n_mem; i++) {
+    if (!gst_is_dmabuf_memory (gst_buffer_peek_memory (src, i)))
+      return FALSE;
+  }
+
+  is_raw = finfo && finfo->format != GST_VIDEO_FORMAT_UNKNOWN &&
+      finfo->format != GST_VIDEO_FORMAT_ENCODED;
+
+  if (is_raw) {
+    vmeta = gst_buffer_get_video_meta (src);
+    if (vmeta && !gst_v4l2_buffer_pool_layout_matches (pool, vmeta))
+      return FALSE;
+  }
+
+  planes->n_planes = n_planes;
+
+  if (n_mem == n_planes) {
+    for (i = 0; i < n_mem; i++) {
+      GstMemory *mem = gst_buffer_peek_memory (src, i);
+
+      planes->mem[i] = mem;
+      planes->size[i] = gst_memory_get_sizes (mem, &planes->offset[i], NULL);
+    }
+
+    /* a single plane may start further in the memory */
+    if (n_planes == 1 && vmeta && vmeta->offset[0]) {
+      if (vmeta->offset[0] >= planes->size[0])
+        return FALSE;
+      planes->offset[0] += vmeta->offset[0];
+      planes->size[0] -= vmeta->offset[0];
+    }
+
+    return TRUE;
+  }
+
+  if (!is_raw || n_mem > n_planes || GST_VIDEO_FORMAT_INFO_IS_TILED (finfo))
+    return FALSE;
+
+  for (i = 0; i < n_planes; i++) {
+    GstMemory *mem;
+    gsize plane_offset, mem_offset, skip;
+    guint idx, length;
+    gint height;
+
+    height = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, i,
+        GST_VIDEO_INFO_HEIGHT (&pool->caps_info));
+    plane_offset = vmeta ? vmeta->offset[i] :
+        GST_VIDEO_INFO_PLANE_OFFSET (&pool->caps_info, i);
+    planes->size[i] = (gsize) GST_VIDEO_INFO_PLANE_STRIDE (&pool->obj->info,
+        i) * height;
+
+    if (!gst_buffer_find_memory (src, plane_offset, planes->size[i], &idx,
+            &length, &skip) || length != 1)
+      return FALSE;
+
+    mem = gst_buffer_peek_memory (src, idx);
+    gst_memory_get_sizes (mem, &mem_offset, NULL);
+
+    planes->mem[i] = mem;
+    planes->offset[i] = mem_offset + skip;
+  }
+
+  return TRUE;
+}
+
+/* The inode identifies the dmabuf whatever fd it is seen through, it is
+ * kept on the upstream memory so that fstat() is only done once */
+static gboolean
+gst_v4l2_buffer_pool_dmabuf_key (const GstV4l2DmabufPlanes * planes,
+    GstV4l2ImportKey * key)
+{
+  guint i;
+
+  for (i = 0; i < planes->n_planes; i++) {
+    GstMemory *mem = planes->mem[i];
+    guint64 *inode;
+
+    inode = gst_mini_object_get_qdata (GST_MINI_OBJECT (mem),
+        GST_V4L2_INODE_QUARK);
+
+    if (inode == NULL) {
+      struct stat st;
+
+      if (fstat (gst_dmabuf_memory_get_fd (mem), &st) < 0)
+        return FALSE;
+
+      inode = g_new (guint64, 1);
+      *inode = st.st_ino;
+      gst_mini_object_set_qdata (GST_MINI_OBJECT (mem), GST_V4L2_INODE_QUARK,
+          inode, g_free);
+    }
+
+    key->id[i] = *inode;
+    key->offset[i] = planes->offset[i];
+    key->size[i] = planes->size[i];
+  }
+
+  key->n_mem = planes->n_planes;
+
+  return TRUE;
+}
+
+/* V4L2 drivers ignore the implicit fences of a dmabuf, so wait for its
+ * producer, typically a GPU, to be done writing before it gets queued */
+static void
+gst_v4l2_buffer_pool_wait_dmabuf_fences (GstV4l2BufferPool * pool,
+    const GstV4l2DmabufPlanes * planes)
+{
+#ifdef DMA_BUF_IOCTL_EXPORT_SYNC_FILE
+  guint i;
+
+  for (i = 0; i < planes->n_planes && pool->can_export_sync_file; i++) {
+    struct dma_buf_export_sync_file req = { 0, };
+    struct pollfd pfd = { 0, };
+    gint fd = gst_dmabuf_memory_get_fd (planes->mem[i]);
+
+    if (i > 0 && planes->mem[i] == planes->mem[i - 1])
+      continue;
+
+    req.flags = DMA_BUF_SYNC_READ;
+    req.fd = -1;
+
+    if (ioctl (fd, DMA_BUF_IOCTL_EXPORT_SYNC_FILE, &req) < 0) {
+      if (errno == ENOTTY || errno == EINVAL) {
+        GST_DEBUG_OBJECT (pool, "kernel cannot export dmabuf fences");
+        pool->can_export_sync_file = FALSE;
+      }
+      continue;
+    }
+
+    pfd.fd = req.fd;
+    pfd.events = POLLIN;
+
+    if (poll (&pfd, 1, 0) == 0) {
+      g_atomic_int_inc (&pool->num_fence_waits);
+      GST_CAT_LOG_OBJECT (CAT_PERFORMANCE, pool, "waiting for dmabuf fence");
+
+      if (poll (&pfd, 1, GST_V4L2_FENCE_TIMEOUT_MS) == 0)
+        GST_WARNING_OBJECT (pool, "dmabuf fence not signaled after %d ms",
+            GST_V4L2_FENCE_TIMEOUT_MS);
+    }
+
+    close (req.fd);
+  }
+#endif
+}
+
+static void
+gst_v4l2_buffer_pool_userptr_key (struct UserPtrData *data,
+    GstV4l2ImportKey * key)
+{
+  gint i;
+
+  for (i = 0; i < data->n_planes; i++) {
+    key->id[i] = GPOINTER_TO_SIZE (data->ptr[i]);
+    key->offset[i] = 0;
+    key->size[i] = data->size[i];
+  }
+
+  key->n_mem = data->n_planes;
+}
+
+static gboolean
+gst_v4l2_buffer_pool_is_bound (GstV4l2BufferPool * pool,
+    GstV4l2MemoryGroup * group)
+{
+  gboolean ret;
+
+  /* the allocator clears the planes when it takes the memory back */
+  GST_OBJECT_LOCK (pool);
+  ret = pool->import_keys[group->buffer.index].n_mem > 0 &&
+      group->planes[0].length > 0;
+  GST_OBJECT_UNLOCK (pool);
+
+  return ret;
+}
+
+/* Returns TRUE if @group is still bound to the memory described by @key, in
+ * which case the import can be skipped. Otherwise the old binding is
+ * dropped and @key will be recorded, the caller is expected to import. */
+static gboolean
+gst_v4l2_buffer_pool_lookup_import (GstV4l2BufferPool * pool,
+    GstV4l2MemoryGroup * group, const GstV4l2ImportKey * key)
+{
+  guint index = group->buffer.index;
+  gboolean bound = gst_v4l2_buffer_pool_is_bound (pool, group);
+  gboolean hit;
+
+  GST_OBJECT_LOCK (pool);
+  hit = bound && key && gst_v4l2_import_key_equal (&pool->import_keys[index],
+      key);
+
+  if (hit) {
+    pool->num_import_hits++;
+  } else {
+    pool->num_import_misses++;
+    if (key)
+      pool->import_keys[index] = *key;
+    else
+      pool->import_keys[index].n_mem = 0;
+  }
+
+  pool->import_age[index] = ++pool->import_clock;
+  GST_OBJECT_UNLOCK (pool);
+
+  if (hit) {
+    GST_LOG_OBJECT (pool, "buffer %u still bound to the imported memory",
+        index);
+  } else if (bound) {
+    GST_LOG_OBJECT (pool, "rebinding buffer %u", index);
+    gst_v4l2_allocator_reset_group (pool->vallocator, group);
+  }
+
+  return hit;
+}
+
+static void
+gst_v4l2_buffer_pool_unbind (GstV4l2BufferPool * pool,
+    GstV4l2MemoryGroup * group)
+{
+  GST_OBJECT_LOCK (pool);
+  pool->import_keys[group->buffer.index].n_mem = 0;
+  GST_OBJECT_UNLOCK (pool);
+}
+
 static GstFlowReturn
-gst_v4l2_buffer_pool_import_userptr (GstV4l2BufferPool * pool,
-    GstBuffer * dest, GstBuffer * src)
+gst_v4l2_buffer_pool_map_userptr (GstV4l2BufferPool * pool, GstBuffer * src,
+    struct UserPtrData **out)
 {
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstV4l2MemoryGroup *group = NULL;
   GstMapFlags flags;
   const GstVideoFormatInfo *finfo = pool->caps_info.finfo;
   struct UserPtrData *data = NULL;
 
-  GST_LOG_OBJECT (pool, "importing userptr");
-
-  /* get the group */
-  if (!gst_v4l2_is_buffer_valid (dest, &group))
-    goto not_our_buffer;
-
   if (V4L2_TYPE_IS_OUTPUT (pool->obj->type))
     flags = GST_MAP_READ;
   else
@@ -221,7 +572,6 @@ gst_v4l2_buffer_pool_import_userptr (GstV4l2BufferPool * pool,
 
   if (finfo && (finfo->format != GST_VIDEO_FORMAT_UNKNOWN &&
           finfo->format != GST_VIDEO_FORMAT_ENCODED)) {
-    gsize size[GST_VIDEO_MAX_PLANES] = { 0, };
     gint i;
 
     data->is_frame = TRUE;
@@ -241,11 +591,13 @@ gst_v4l2_buffer_pool_import_userptr (GstV4l2BufferPool * pool,
         pheight = GST_VIDEO_TILE_Y_TILES (tinfo) <<
             GST_VIDEO_FORMAT_INFO_TILE_HS (finfo);
 
-        size[i] = pstride * pheight;
+        data->size[i] = pstride * pheight;
       } else {
-        size[i] = GST_VIDEO_FRAME_PLANE_STRIDE (&data->frame, i) *
+        data->size[i] = GST_VIDEO_FRAME_PLANE_STRIDE (&data->frame, i) *
             GST_VIDEO_FRAME_COMP_HEIGHT (&data->frame, i);
       }
+
+      data->ptr[i] = data->frame.data[i];
     }
 
     /* In the single planar API, planes must be contiguous in memory and
@@ -267,38 +619,25 @@ gst_v4l2_buffer_pool_import_userptr (GstV4l2BufferPool * pool,
       }
     }
 
-    if (!gst_v4l2_allocator_import_userptr (pool->vallocator, group,
-            data->frame.info.size, finfo->n_planes, data->frame.data, size))
-      goto import_failed;
+    data->n_planes = finfo->n_planes;
+    data->img_size = data->frame.info.size;
   } else {
-    gpointer ptr[1];
-    gsize size[1];
-
     data->is_frame = FALSE;
 
     if (!gst_buffer_map (src, &data->map, flags))
       goto invalid_buffer;
 
-    ptr[0] = data->map.data;
-    size[0] = data->map.size;
-
-    if (!gst_v4l2_allocator_import_userptr (pool->vallocator, group,
-            data->map.size, 1, ptr, size))
-      goto import_failed;
+    data->n_planes = 1;
+    data->ptr[0] = data->map.data;
+    data->size[0] = data->map.size;
+    data->img_size = data->map.size;
   }
 
   data->buffer = gst_buffer_ref (src);
+  *out = data;
 
-  gst_mini_object_set_qdata (GST_MINI_OBJECT (dest), GST_V4L2_IMPORT_QUARK,
-      data, (GDestroyNotify) _unmap_userptr_frame);
-
-  return ret;
+  return GST_FLOW_OK;
 
-not_our_buffer:
-  {
-    GST_ERROR_OBJECT (pool, "destination buffer invalid or not from our pool");
-    return GST_FLOW_ERROR;
-  }
 invalid_buffer:
   {
     GST_ERROR_OBJECT (pool, "could not map buffer");
@@ -311,9 +650,44 @@ non_contiguous_mem:
     _unmap_userptr_frame (data);
     return GST_FLOW_ERROR;
   }
+}
+
+/* Takes ownership of @data */
+static GstFlowReturn
+gst_v4l2_buffer_pool_import_userptr (GstV4l2BufferPool * pool,
+    GstBuffer * dest, struct UserPtrData *data)
+{
+  GstV4l2MemoryGroup *group = NULL;
+  GstV4l2ImportKey key;
+
+  GST_LOG_OBJECT (pool, "importing userptr");
+
+  /* get the group */
+  if (!gst_v4l2_is_buffer_valid (dest, &group))
+    goto not_our_buffer;
+
+  gst_v4l2_buffer_pool_userptr_key (data, &key);
+
+  if (!gst_v4l2_buffer_pool_lookup_import (pool, group, &key) &&
+      !gst_v4l2_allocator_import_userptr (pool->vallocator, group,
+          data->img_size, data->n_planes, data->ptr, data->size))
+    goto import_failed;
+
+  gst_mini_object_set_qdata (GST_MINI_OBJECT (dest), GST_V4L2_IMPORT_QUARK,
+      data, (GDestroyNotify) _unmap_userptr_frame);
+
+  return GST_FLOW_OK;
+
+not_our_buffer:
+  {
+    GST_ERROR_OBJECT (pool, "destination buffer invalid or not from our pool");
+    _unmap_userptr_frame (data);
+    return GST_FLOW_ERROR;
+  }
 import_failed:
   {
     GST_ERROR_OBJECT (pool, "failed to import data");
+    gst_v4l2_buffer_pool_unbind (pool, group);
     _unmap_userptr_frame (data);
     return GST_FLOW_ERROR;
   }
@@ -324,28 +698,35 @@ gst_v4l2_buffer_pool_import_dmabuf (GstV4l2BufferPool * pool,
     GstBuffer * dest, GstBuffer * src)
 {
   GstV4l2MemoryGroup *group = NULL;
-  GstMemory *dma_mem[GST_VIDEO_MAX_PLANES] = { 0 };
-  guint n_mem = gst_buffer_n_memory (src);
-  gint i;
+  GstV4l2DmabufPlanes planes;
+  GstV4l2ImportKey key;
 
   GST_LOG_OBJECT (pool, "importing dmabuf");
 
   if (!gst_v4l2_is_buffer_valid (dest, &group))
     goto not_our_buffer;
 
-  if (n_mem > GST_VIDEO_MAX_PLANES)
-    goto too_many_mems;
+  if (!gst_v4l2_buffer_pool_dmabuf_planes (pool, src, &planes))
+    goto unsupported_layout;
 
-  for (i = 0; i < n_mem; i++)
-    dma_mem[i] = gst_buffer_peek_memory (src, i);
+  /* Still bound, the fds we dup'ed last time are still valid */
+  if (gst_v4l2_buffer_pool_lookup_import (pool, group,
+          gst_v4l2_buffer_pool_dmabuf_key (&planes, &key) ? &key : NULL))
+    goto done;
 
-  if (!gst_v4l2_allocator_import_dmabuf (pool->vallocator, group, n_mem,
-          dma_mem))
+  if (!gst_v4l2_allocator_import_dmabuf (pool->vallocator, group,
+          planes.n_planes, planes.mem, planes.offset, planes.size))
     goto import_failed;
 
+done:
+  if (V4L2_TYPE_IS_OUTPUT (pool->obj->type))
+    gst_v4l2_buffer_pool_wait_dmabuf_fences (pool, &planes);
+
   gst_mini_object_set_qdata (GST_MINI_OBJECT (dest), GST_V4L2_IMPORT_QUARK,
       gst_buffer_ref (src), (GDestroyNotify) gst_buffer_unref);
 
+  g_atomic_int_inc (&pool->num_imports);
+
   return GST_FLOW_OK;
 
 not_our_buffer:
@@ -353,14 +734,15 @@ not_our_buffer:
     GST_ERROR_OBJECT (pool, "destination buffer invalid or not from our pool");
     return GST_FLOW_ERROR;
   }
-too_many_mems:
+unsupported_layout:
   {
-    GST_ERROR_OBJECT (pool, "could not map buffer");
+    GST_ERROR_OBJECT (pool, "dmabuf layout does not match the format");
     return GST_FLOW_ERROR;
   }
 import_failed:
   {
     GST_ERROR_OBJECT (pool, "failed to import dmabuf");
+    gst_v4l2_buffer_pool_unbind (pool, group);
     return GST_FLOW_ERROR;
   }
 }
@@ -393,8 +775,14 @@ gst_v4l2_buffer_pool_prepare_buffer (GstV4l2BufferPool * pool,
       ret = gst_v4l2_buffer_pool_copy_buffer (pool, dest, src);
       break;
     case GST_V4L2_IO_USERPTR:
-      ret = gst_v4l2_buffer_pool_import_userptr (pool, dest, src);
+    {
+      struct UserPtrData *data;
+
+      ret = gst_v4l2_buffer_pool_map_userptr (pool, src, &data);
+      if (ret == GST_FLOW_OK)
+        ret = gst_v4l2_buffer_pool_import_userptr (pool, dest, data);
       break;
+    }
     case GST_V4L2_IO_DMABUF_IMPORT:
       ret = gst_v4l2_buffer_pool_import_dmabuf (pool, dest, src);
       break;
@@ -448,6 +836,9 @@ gst_v4l2_buffer_pool_alloc_buffer (GstBufferPool * bpool, GstBuffer ** buffer,
 
   if (group != NULL) {
     gint i;
+
+    gst_v4l2_buffer_pool_unbind (pool, group);
+
     newbuf = gst_buffer_new ();
 
     for (i = 0; i < group->n_mem; i++)
@@ -615,7 +1006,7 @@ gst_v4l2_buffer_pool_streamon (GstV4l2BufferPool * pool)
     case GST_V4L2_IO_DMABUF:
     case GST_V4L2_IO_DMABUF_IMPORT:
       if (!pool->streaming) {
-        if (v4l2_ioctl (pool->video_fd, VIDIOC_STREAMON, &obj->type) < 0)
+        if (obj->ioctl (pool->video_fd, VIDIOC_STREAMON, &obj->type) < 0)
           goto streamon_failed;
 
         pool->streaming = TRUE;
@@ -648,7 +1039,7 @@ gst_v4l2_buffer_pool_streamoff (GstV4l2BufferPool * pool)
     case GST_V4L2_IO_DMABUF:
     case GST_V4L2_IO_DMABUF_IMPORT:
       if (pool->streaming) {
-        if (v4l2_ioctl (pool->video_fd, VIDIOC_STREAMOFF, &obj->type) < 0)
+        if (obj->ioctl (pool->video_fd, VIDIOC_STREAMOFF, &obj->type) < 0)
           GST_WARNING_OBJECT (pool, "STREAMOFF failed with errno %d (%s)",
               errno, g_strerror (errno));
 
@@ -686,6 +1077,84 @@ gst_v4l2_buffer_pool_resurect_buffer (GstV4l2BufferPool * pool)
   return ret;
 }
 
+/* Called when downstream holds on our capture buffers, brings back a buffer
+ * we trimmed or allocates a new one using CREATE_BUFS */
+static gboolean
+gst_v4l2_buffer_pool_grow (GstV4l2BufferPool * pool)
+{
+  if (pool->num_parked == 0) {
+    if (!pool->vallocator->can_allocate)
+      return FALSE;
+
+    if (pool->vallocator->count >= pool->num_max_buffers) {
+      GST_TRACE_OBJECT (pool, "capture queue already has %u buffers",
+          pool->vallocator->count);
+      return FALSE;
+    }
+  }
+
+  if (gst_v4l2_buffer_pool_resurect_buffer (pool) != GST_FLOW_OK)
+    return FALSE;
+
+  GST_OBJECT_LOCK (pool);
+  pool->num_grown++;
+  pool->last_resize = gst_util_get_timestamp ();
+  GST_OBJECT_UNLOCK (pool);
+
+  GST_DEBUG_OBJECT (pool, "grew the capture queue, now %u buffers, %u parked",
+      pool->vallocator->count, pool->num_parked);
+
+  return TRUE;
+}
+
+/* V4L2 cannot free a single buffer, so trimming parks an idle capture
+ * buffer in our free list instead of queuing it, where _grow() will find it
+ * again. Returns TRUE if the buffer at @index should be parked. */
+static gboolean
+gst_v4l2_buffer_pool_trim (GstV4l2BufferPool * pool, guint index)
+{
+  GstClockTime period = pool->obj->pool_trim_period;
+  GstClockTime now;
+  gboolean ret = FALSE;
+
+  GST_OBJECT_LOCK (pool);
+
+  /* a parked buffer is being brought back */
+  if (pool->parked & (1U << index)) {
+    pool->parked &= ~(1U << index);
+    pool->num_parked--;
+    goto done;
+  }
+
+  if (period == 0 || !pool->streaming)
+    goto done;
+
+  if (pool->vallocator->count - pool->num_parked <= pool->num_start_buffers)
+    goto done;
+
+  /* keep enough buffers for the next dequeue not to grow the pool again */
+  if (g_atomic_int_get (&pool->num_queued) <= GST_V4L2_MIN_BUFFERS)
+    goto done;
+
+  now = gst_util_get_timestamp ();
+  if (now - pool->last_resize < period)
+    goto done;
+
+  pool->parked |= (1U << index);
+  pool->num_parked++;
+  pool->num_trimmed++;
+  pool->last_resize = now;
+  ret = TRUE;
+
+  GST_DEBUG_OBJECT (pool, "trimmed buffer %u, %u buffers parked", index,
+      pool->num_parked);
+
+done:
+  GST_OBJECT_UNLOCK (pool);
+
+  return ret;
+}
+
 static gboolean
 gst_v4l2_buffer_pool_start (GstBufferPool * bpool)
 {
@@ -717,7 +1186,7 @@ gst_v4l2_buffer_pool_start (GstBufferPool * bpool)
        * queue to be initialized now. We only do this if we have a streaming
        * driver. */
       if (obj->device_caps & V4L2_CAP_STREAMING)
-        v4l2_read (obj->video_fd, NULL, 0);
+        obj->read (obj->video_fd, NULL, 0);
 #endif
       break;
     case GST_V4L2_IO_DMABUF:
@@ -811,6 +1280,30 @@ gst_v4l2_buffer_pool_start (GstBufferPool * bpool)
   pool->min_latency = min_latency;
   pool->num_queued = 0;
 
+  pool->num_start_buffers = min_buffers;
+  /* never grow past what was configured, or a few buffers more than we
+   * started with if there was no maximum */
+  if (max_buffers != 0)
+    pool->num_max_buffers = MAX (max_buffers, min_buffers);
+  else
+    pool->num_max_buffers = min_buffers + min_latency;
+  pool->num_max_buffers = MIN (pool->num_max_buffers, VIDEO_MAX_FRAME);
+  pool->parked = 0;
+  pool->num_parked = 0;
+  pool->num_grown = 0;
+  pool->num_trimmed = 0;
+  pool->last_resize = gst_util_get_timestamp ();
+  pool->import_clock = 0;
+  pool->num_import_hits = 0;
+  pool->num_import_misses = 0;
+  pool->num_latest_dropped = 0;
+  pool->held = 0;
+  pool->num_copies = 0;
+  pool->num_imports = 0;
+  pool->num_fence_waits = 0;
+  pool->num_poll_wakeups = 0;
+  pool->last_stats = gst_util_get_timestamp ();
+
   if (max_buffers != 0 && max_buffers < min_buffers)
     max_buffers = min_buffers;
 
@@ -872,6 +1365,12 @@ gst_v4l2_buffer_pool_stop (GstBufferPool * bpool)
 
   GST_DEBUG_OBJECT (pool, "stopping pool");
 
+  pool->device_ready = FALSE;
+
+  if (pool->num_grown || pool->num_trimmed)
+    GST_INFO_OBJECT (pool, "pool grew %u times and was trimmed %u times",
+        pool->num_grown, pool->num_trimmed);
+
   if (pool->group_released_handler > 0) {
     g_signal_handler_disconnect (pool->vallocator,
         pool->group_released_handler);
@@ -901,6 +1400,26 @@ gst_v4l2_buffer_pool_stop (GstBufferPool * bpool)
     }
   }
 
+  /* give the buffers kept bound back to the pool, dropping the binding */
+  for (i = 0; i < VIDEO_MAX_FRAME; i++) {
+    GstV4l2MemoryGroup *group;
+    GstBuffer *buffer = pool->import_free[i];
+
+    pool->import_free[i] = NULL;
+    pool->import_keys[i].n_mem = 0;
+
+    if (buffer == NULL)
+      continue;
+
+    if (gst_v4l2_is_buffer_valid (buffer, &group))
+      gst_v4l2_allocator_reset_group (pool->vallocator, group);
+    pclass->release_buffer (bpool, buffer);
+  }
+
+  if (pool->num_import_hits || pool->num_import_misses)
+    GST_INFO_OBJECT (pool, "%u imports reused a bound buffer, %u did not",
+        pool->num_import_hits, pool->num_import_misses);
+
   ret = GST_BUFFER_POOL_CLASS (parent_class)->stop (bpool);
 
   if (ret && pool->vallocator) {
@@ -927,6 +1446,7 @@ gst_v4l2_buffer_pool_flush_start (GstBufferPool * bpool)
   gst_poll_set_flushing (pool->poll, TRUE);
 
   GST_OBJECT_LOCK (pool);
+  pool->device_ready = FALSE;
   pool->empty = FALSE;
   g_cond_broadcast (&pool->empty_cond);
   GST_OBJECT_UNLOCK (pool);
@@ -941,6 +1461,7 @@ gst_v4l2_buffer_pool_flush_stop (GstBufferPool * bpool)
   GstV4l2BufferPool *pool = GST_V4L2_BUFFER_POOL (bpool);
   GstV4l2Object *obj = pool->obj;
   GstBuffer *buffers[VIDEO_MAX_FRAME];
+  guint num_parked;
   gint i;
 
   GST_DEBUG_OBJECT (pool, "stop flushing");
@@ -957,6 +1478,11 @@ gst_v4l2_buffer_pool_flush_stop (GstBufferPool * bpool)
   /* Remember buffers to re-enqueue */
   memcpy (buffers, pool->buffers, sizeof (buffers));
   memset (pool->buffers, 0, sizeof (pool->buffers));
+  /* the flush returned every buffer, start over with a full capture queue */
+  num_parked = pool->num_parked;
+  pool->parked = 0;
+  pool->num_parked = 0;
+  pool->last_resize = gst_util_get_timestamp ();
   GST_OBJECT_UNLOCK (pool);
 
   /* Reset our state */
@@ -986,6 +1512,13 @@ gst_v4l2_buffer_pool_flush_stop (GstBufferPool * bpool)
         }
       }
 
+      /* queue back the buffers that were parked in the free list */
+      if (!V4L2_TYPE_IS_OUTPUT (obj->type)) {
+        while (num_parked-- > 0)
+          if (gst_v4l2_buffer_pool_resurect_buffer (pool) != GST_FLOW_OK)
+            break;
+      }
+
       break;
     }
     default:
@@ -1018,6 +1551,12 @@ gst_v4l2_buffer_pool_poll (GstV4l2BufferPool * pool)
   if (!pool->can_poll_device)
     goto done;
 
+  if (pool->device_ready) {
+    GST_LOG_OBJECT (pool, "device already polled");
+    pool->device_ready = FALSE;
+    goto done;
+  }
+
   GST_LOG_OBJECT (pool, "polling device");
 
 again:
@@ -1040,6 +1579,8 @@ again:
     }
   }
 
+  g_atomic_int_inc (&pool->num_poll_wakeups);
+
   if (gst_poll_fd_has_error (pool->poll, &pool->pollfd))
     goto select_error;
 
@@ -1060,6 +1601,60 @@ select_error:
   }
 }
 
+static void
+gst_v4l2_buffer_pool_update_video_meta (GstV4l2BufferPool * pool,
+    GstBuffer * buffer)
+{
+  GstVideoInfo *info = &pool->obj->info;
+  GstVideoMeta *vmeta = gst_buffer_get_video_meta (buffer);
+  guint i;
+
+  if (vmeta == NULL || (vmeta->width == GST_VIDEO_INFO_WIDTH (info) &&
+          vmeta->height == GST_VIDEO_INFO_HEIGHT (info) &&
+          vmeta->stride[0] == GST_VIDEO_INFO_PLANE_STRIDE (info, 0)))
+    return;
+
+  GST_DEBUG_OBJECT (pool, "updating video meta of buffer %p to %ux%u",
+      buffer, GST_VIDEO_INFO_WIDTH (info), GST_VIDEO_INFO_HEIGHT (info));
+
+  vmeta->format = GST_VIDEO_INFO_FORMAT (info);
+  vmeta->width = GST_VIDEO_INFO_WIDTH (info);
+  vmeta->height = GST_VIDEO_INFO_HEIGHT (info);
+  vmeta->n_planes = GST_VIDEO_INFO_N_PLANES (info);
+  for (i = 0; i < vmeta->n_planes; i++) {
+    vmeta->offset[i] = GST_VIDEO_INFO_PLANE_OFFSET (info, i);
+    vmeta->stride[i] = GST_VIDEO_INFO_PLANE_STRIDE (info, i);
+  }
+}
+
+static inline void
+gst_v4l2_buffer_pool_mark_held (GstV4l2BufferPool * pool, guint index,
+    gboolean held)
+{
+  if (held)
+    g_atomic_int_or (&pool->held, 1U << index);
+  else
+    g_atomic_int_and (&pool->held, ~(1U << index));
+}
+
+/* Post the statistics of this queue as an element message every
+ * stats-interval */
+static void
+gst_v4l2_buffer_pool_post_stats (GstV4l2BufferPool * pool)
+{
+  GstElement *element = pool->obj->element;
+  GstClockTime now = gst_util_get_timestamp ();
+
+  if (now - pool->last_stats < pool->obj->stats_interval)
+    return;
+
+  pool->last_stats = now;
+
+  gst_element_post_message (element,
+      gst_message_new_element (GST_OBJECT (element),
+          gst_v4l2_buffer_pool_get_stats (pool)));
+}
+
 static GstFlowReturn
 gst_v4l2_buffer_pool_qbuf (GstV4l2BufferPool * pool, GstBuffer * buf)
 {
@@ -1111,6 +1706,7 @@ gst_v4l2_buffer_pool_qbuf (GstV4l2BufferPool * pool, GstBuffer * buf)
   GST_OBJECT_LOCK (pool);
   g_atomic_int_inc (&pool->num_queued);
   pool->buffers[index] = buf;
+  gst_v4l2_buffer_pool_mark_held (pool, index, FALSE);
 
   if (!gst_v4l2_allocator_qbuf (pool->vallocator, group))
     goto queue_failed;
@@ -1168,6 +1764,7 @@ gst_v4l2_buffer_pool_dqbuf (GstV4l2BufferPool * pool, GstBuffer ** buffer)
 
   /* mark the buffer outstanding */
   pool->buffers[group->buffer.index] = NULL;
+  gst_v4l2_buffer_pool_mark_held (pool, group->buffer.index, TRUE);
   if (g_atomic_int_dec_and_test (&pool->num_queued)) {
     GST_OBJECT_LOCK (pool);
     pool->empty = TRUE;
@@ -1262,6 +1859,10 @@ gst_v4l2_buffer_pool_dqbuf (GstV4l2BufferPool * pool, GstBuffer ** buffer)
   if (group->buffer.flags & V4L2_BUF_FLAG_ERROR)
     GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_CORRUPTED);
 
+  /* the buffers are kept across resolution changes that fit in them */
+  if (pool->add_videometa)
+    gst_v4l2_buffer_pool_update_video_meta (pool, outbuf);
+
   GST_BUFFER_TIMESTAMP (outbuf) = timestamp;
   GST_BUFFER_OFFSET (outbuf) = group->buffer.sequence;
   GST_BUFFER_OFFSET_END (outbuf) = group->buffer.sequence + 1;
@@ -1269,6 +1870,9 @@ gst_v4l2_buffer_pool_dqbuf (GstV4l2BufferPool * pool, GstBuffer ** buffer)
 done:
   *buffer = outbuf;
 
+  if (obj->stats_interval)
+    gst_v4l2_buffer_pool_post_stats (pool);
+
   return GST_FLOW_OK;
 
   /* ERRORS */
@@ -1293,6 +1897,104 @@ no_buffer:
   }
 }
 
+/* Takes the free buffer bound to @key, or the least recently used one if
+ * @key is %NULL */
+static GstBuffer *
+gst_v4l2_buffer_pool_take_import (GstV4l2BufferPool * pool,
+    const GstV4l2ImportKey * key)
+{
+  GstBuffer *buffer = NULL;
+  gint i, index = -1;
+
+  GST_OBJECT_LOCK (pool);
+
+  for (i = 0; i < VIDEO_MAX_FRAME; i++) {
+    if (pool->import_free[i] == NULL)
+      continue;
+
+    if (key) {
+      if (gst_v4l2_import_key_equal (&pool->import_keys[i], key)) {
+        index = i;
+        break;
+      }
+    } else if (index < 0 || pool->import_age[i] < pool->import_age[index]) {
+      index = i;
+    }
+  }
+
+  if (index >= 0) {
+    buffer = pool->import_free[index];
+    pool->import_free[index] = NULL;
+  }
+
+  GST_OBJECT_UNLOCK (pool);
+
+  return buffer;
+}
+
+/* Free output buffers still bound to some imported memory are kept in
+ * import_free[] rather than in the GstBufferPool queue, so that the one bound
+ * to the memory being imported can be picked. Unbound buffers are preferred
+ * over evicting the least recently used binding. Only
+ * gst_v4l2_buffer_pool_process() acquires in these modes, with DONTWAIT. */
+static GstFlowReturn
+gst_v4l2_buffer_pool_acquire_import (GstV4l2BufferPool * pool,
+    GstBuffer ** buffer, GstBufferPoolAcquireParams * params)
+{
+  GstBufferPoolClass *pclass = GST_BUFFER_POOL_CLASS (parent_class);
+  GstFlowReturn ret;
+
+  if (params && params->flags & GST_V4L2_BUFFER_POOL_ACQUIRE_FLAG_IMPORT) {
+    GstV4l2ImportAcquireParams *iparams = (GstV4l2ImportAcquireParams *) params;
+
+    if ((*buffer = gst_v4l2_buffer_pool_take_import (pool, iparams->key)))
+      return GST_FLOW_OK;
+  }
+
+  ret = pclass->acquire_buffer (GST_BUFFER_POOL (pool), buffer, params);
+  if (ret != GST_FLOW_EOS)
+    return ret;
+
+  if ((*buffer = gst_v4l2_buffer_pool_take_import (pool, NULL))) {
+    GST_LOG_OBJECT (pool, "evicting an imported memory");
+    return GST_FLOW_OK;
+  }
+
+  return ret;
+}
+
+/* Latest-frame mode: dequeue every frame the device already completed and
+ * give the older ones back to the driver, so that only the most recent
+ * frame is handed out. Only done when the memory belongs to the pool, the
+ * imported memory of the other modes is owned by downstream. */
+static void
+gst_v4l2_buffer_pool_skip_to_latest (GstV4l2BufferPool * pool,
+    GstBuffer ** buffer)
+{
+  GstBuffer *newer;
+
+  if (!pool->can_poll_device)
+    return;
+
+  if (pool->obj->mode != GST_V4L2_IO_MMAP &&
+      pool->obj->mode != GST_V4L2_IO_DMABUF)
+    return;
+
+  while (g_atomic_int_get (&pool->num_queued) > 0 &&
+      gst_poll_wait (pool->poll, 0) > 0) {
+    if (gst_v4l2_buffer_pool_dqbuf (pool, &newer) != GST_FLOW_OK)
+      break;
+
+    GST_LOG_OBJECT (pool, "dropping frame %" G_GUINT64_FORMAT
+        ", a newer one is ready", GST_BUFFER_OFFSET (*buffer));
+
+    gst_v4l2_buffer_pool_release_buffer (GST_BUFFER_POOL_CAST (pool),
+        *buffer);
+    *buffer = newer;
+    g_atomic_int_inc (&pool->num_latest_dropped);
+  }
+}
+
 static GstFlowReturn
 gst_v4l2_buffer_pool_acquire_buffer (GstBufferPool * bpool, GstBuffer ** buffer,
     GstBufferPoolAcquireParams * params)
@@ -1301,6 +2003,7 @@ gst_v4l2_buffer_pool_acquire_buffer (GstBufferPool * bpool, GstBuffer ** buffer,
   GstV4l2BufferPool *pool = GST_V4L2_BUFFER_POOL (bpool);
   GstBufferPoolClass *pclass = GST_BUFFER_POOL_CLASS (parent_class);
   GstV4l2Object *obj = pool->obj;
+  GstV4l2MemoryGroup *group;
 
   GST_DEBUG_OBJECT (pool, "acquire");
 
@@ -1330,6 +2033,9 @@ gst_v4l2_buffer_pool_acquire_buffer (GstBufferPool * bpool, GstBuffer ** buffer,
            * storage for our buffers. This function does poll first so we can
            * interrupt it fine. */
           ret = gst_v4l2_buffer_pool_dqbuf (pool, buffer);
+
+          if (ret == GST_FLOW_OK && obj->latest_frame)
+            gst_v4l2_buffer_pool_skip_to_latest (pool, buffer);
           break;
         }
         default:
@@ -1351,12 +2057,17 @@ gst_v4l2_buffer_pool_acquire_buffer (GstBufferPool * bpool, GstBuffer ** buffer,
 
         case GST_V4L2_IO_MMAP:
         case GST_V4L2_IO_DMABUF:
-        case GST_V4L2_IO_USERPTR:
-        case GST_V4L2_IO_DMABUF_IMPORT:
           /* get a free unqueued buffer */
           ret = pclass->acquire_buffer (bpool, buffer, params);
           break;
 
+        case GST_V4L2_IO_USERPTR:
+        case GST_V4L2_IO_DMABUF_IMPORT:
+          /* get a free unqueued buffer, preferably one already bound to the
+           * memory we are about to import */
+          ret = gst_v4l2_buffer_pool_acquire_import (pool, buffer, params);
+          break;
+
         default:
           ret = GST_FLOW_ERROR;
           g_assert_not_reached ();
@@ -1369,6 +2080,12 @@ gst_v4l2_buffer_pool_acquire_buffer (GstBufferPool * bpool, GstBuffer ** buffer,
       g_assert_not_reached ();
       break;
   }
+
+  /* the captured buffers were marked when dequeued */
+  if (ret == GST_FLOW_OK && V4L2_TYPE_IS_OUTPUT (obj->type) &&
+      gst_v4l2_is_buffer_valid (*buffer, &group))
+    gst_v4l2_buffer_pool_mark_held (pool, group->buffer.index, TRUE);
+
 done:
   return ret;
 }
@@ -1400,7 +2117,17 @@ gst_v4l2_buffer_pool_release_buffer (GstBufferPool * bpool, GstBuffer * buffer)
         {
           GstV4l2MemoryGroup *group;
           if (gst_v4l2_is_buffer_valid (buffer, &group)) {
-            gst_v4l2_allocator_reset_group (pool->vallocator, group);
+            gst_v4l2_buffer_pool_mark_held (pool, group->buffer.index, FALSE);
+
+            /* keep the imported memory bound, the next import may reuse it */
+            if (!gst_v4l2_buffer_pool_is_bound (pool, group))
+              gst_v4l2_allocator_reset_group (pool->vallocator, group);
+
+            if (gst_v4l2_buffer_pool_trim (pool, group->buffer.index)) {
+              pclass->release_buffer (bpool, buffer);
+              break;
+            }
+
             /* queue back in the device */
             if (pool->other_pool)
               gst_v4l2_buffer_pool_prepare_buffer (pool, buffer, NULL);
@@ -1445,6 +2172,7 @@ gst_v4l2_buffer_pool_release_buffer (GstBufferPool * bpool, GstBuffer * buffer)
           }
 
           index = group->buffer.index;
+          gst_v4l2_buffer_pool_mark_held (pool, index, FALSE);
 
           if (pool->buffers[index] == NULL) {
             GST_LOG_OBJECT (pool, "buffer %u not queued, putting on free list",
@@ -1454,6 +2182,15 @@ gst_v4l2_buffer_pool_release_buffer (GstBufferPool * bpool, GstBuffer * buffer)
             gst_mini_object_set_qdata (GST_MINI_OBJECT (buffer),
                 GST_V4L2_IMPORT_QUARK, NULL, NULL);
 
+            /* keep it aside with its binding for the next import of the
+             * same memory */
+            if (gst_v4l2_buffer_pool_is_bound (pool, group)) {
+              GST_OBJECT_LOCK (pool);
+              pool->import_free[index] = buffer;
+              GST_OBJECT_UNLOCK (pool);
+              break;
+            }
+
             /* reset to default size */
             gst_v4l2_allocator_reset_group (pool->vallocator, group);
 
@@ -1506,7 +2243,7 @@ gst_v4l2_buffer_pool_finalize (GObject * object)
   GstV4l2BufferPool *pool = GST_V4L2_BUFFER_POOL (object);
 
   if (pool->video_fd >= 0)
-    v4l2_close (pool->video_fd);
+    pool->obj->close (pool->video_fd);
 
   gst_poll_free (pool->poll);
 
@@ -1571,7 +2308,7 @@ gst_v4l2_buffer_pool_new (GstV4l2Object * obj, GstCaps * caps)
   gchar *name, *parent_name;
   gint fd;
 
-  fd = v4l2_dup (obj->video_fd);
+  fd = obj->dup (obj->video_fd);
   if (fd < 0)
     goto dup_failed;
 
@@ -1596,9 +2333,9 @@ gst_v4l2_buffer_pool_new (GstV4l2Object * obj, GstCaps * caps)
   pool->video_fd = fd;
   pool->obj = obj;
   pool->can_poll_device = TRUE;
+  pool->can_export_sync_file = TRUE;
 
-  pool->vallocator =
-      gst_v4l2_allocator_new (GST_OBJECT (pool), obj->video_fd, &obj->format);
+  pool->vallocator = gst_v4l2_allocator_new (GST_OBJECT (pool), obj);
   if (pool->vallocator == NULL)
     goto allocator_failed;
 
@@ -1645,7 +2382,7 @@ gst_v4l2_do_read (GstV4l2BufferPool * pool, GstBuffer * buf)
     if ((res = gst_v4l2_buffer_pool_poll (pool)) != GST_FLOW_OK)
       goto poll_error;
 
-    amount = v4l2_read (obj->video_fd, map.data, toread);
+    amount = obj->read (obj->video_fd, map.data, toread);
 
     if (amount == toread) {
       break;
@@ -1749,29 +2486,20 @@ gst_v4l2_buffer_pool_process (GstV4l2BufferPool * pool, GstBuffer ** buf)
             GST_TRACE_OBJECT (pool, "Only %i buffer left in the capture queue.",
                 num_queued);
 
-            /* If we have no more buffer, and can allocate it time to do so */
-            if (num_queued == 0) {
-              if (GST_V4L2_ALLOCATOR_CAN_ALLOCATE (pool->vallocator, MMAP)) {
-                ret = gst_v4l2_buffer_pool_resurect_buffer (pool);
-                if (ret == GST_FLOW_OK)
-                  goto done;
-              }
-            }
+            /* Downstream is holding on our buffers, grow the pool before the
+             * device runs dry */
+            if (num_queued < MAX (pool->copy_threshold, GST_V4L2_MIN_BUFFERS)
+                && gst_v4l2_buffer_pool_grow (pool))
+              goto done;
 
             /* start copying buffers when we are running low on buffers */
             if (num_queued < pool->copy_threshold) {
               GstBuffer *copy;
 
-              if (GST_V4L2_ALLOCATOR_CAN_ALLOCATE (pool->vallocator, MMAP)) {
-                ret = gst_v4l2_buffer_pool_resurect_buffer (pool);
-                if (ret == GST_FLOW_OK)
-                  goto done;
-              }
-
               /* copy the buffer */
-              copy = gst_buffer_copy_region (*buf,
-                  GST_BUFFER_COPY_ALL | GST_BUFFER_COPY_DEEP, 0, -1);
+              copy = gst_v4l2_buffer_pool_copy_captured (pool, *buf);
               GST_LOG_OBJECT (pool, "copy buffer %p->%p", *buf, copy);
+              g_atomic_int_inc (&pool->num_copies);
 
               /* and requeue so that we can continue capturing */
               gst_buffer_unref (*buf);
@@ -1878,19 +2606,48 @@ gst_v4l2_buffer_pool_process (GstV4l2BufferPool * pool, GstBuffer ** buf)
 
         copying:
           if (to_queue == NULL) {
-            GstBufferPoolAcquireParams params = { 0 };
+            GstV4l2ImportAcquireParams params = { {0}, };
+            struct UserPtrData *data = NULL;
+            GstV4l2DmabufPlanes planes;
+            GstV4l2ImportKey key;
 
             GST_LOG_OBJECT (pool, "alloc buffer from our pool");
 
+            params.parent.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+            /* ask for the buffer still bound to this memory if any */
+            if (obj->mode == GST_V4L2_IO_USERPTR) {
+              ret = gst_v4l2_buffer_pool_map_userptr (pool, *buf, &data);
+              if (ret != GST_FLOW_OK)
+                goto prepare_failed;
+
+              gst_v4l2_buffer_pool_userptr_key (data, &key);
+              params.key = &key;
+            } else if (obj->mode == GST_V4L2_IO_DMABUF_IMPORT &&
+                gst_v4l2_buffer_pool_dmabuf_planes (pool, *buf, &planes) &&
+                gst_v4l2_buffer_pool_dmabuf_key (&planes, &key)) {
+              params.key = &key;
+            }
+
+            if (params.key)
+              params.parent.flags |= GST_V4L2_BUFFER_POOL_ACQUIRE_FLAG_IMPORT;
+
             /* this can return EOS if all buffers are outstanding which would
              * be strange because we would expect the upstream element to have
              * allocated them and returned to us.. */
-            params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
-            ret = gst_buffer_pool_acquire_buffer (bpool, &to_queue, &params);
-            if (ret != GST_FLOW_OK)
+            ret = gst_buffer_pool_acquire_buffer (bpool, &to_queue,
+                &params.parent);
+            if (ret != GST_FLOW_OK) {
+              if (data)
+                _unmap_userptr_frame (data);
               goto acquire_failed;
+            }
+
+            if (data)
+              ret = gst_v4l2_buffer_pool_import_userptr (pool, to_queue, data);
+            else
+              ret = gst_v4l2_buffer_pool_prepare_buffer (pool, to_queue, *buf);
 
-            ret = gst_v4l2_buffer_pool_prepare_buffer (pool, to_queue, *buf);
             if (ret != GST_FLOW_OK) {
               gst_buffer_unref (to_queue);
               goto prepare_failed;
@@ -2013,3 +2770,110 @@ gst_v4l2_buffer_pool_copy_at_threshold (GstV4l2BufferPool * pool, gboolean copy)
   pool->enable_copy_threshold = copy;
   GST_OBJECT_UNLOCK (pool);
 }
+
+/**
+ * gst_v4l2_buffer_pool_set_device_ready:
+ * @pool: a streaming capture #GstV4l2BufferPool
+ *
+ * Tell the pool that the caller already polled the device and found it
+ * readable, so the next dequeue does not wait on the pool's own poll. Must
+ * be called from the thread that acquires the buffers.
+ */
+void
+gst_v4l2_buffer_pool_set_device_ready (GstV4l2BufferPool * pool)
+{
+  pool->device_ready = TRUE;
+}
+
+/**
+ * gst_v4l2_buffer_pool_update_caps:
+ * @pool: an active capture #GstV4l2BufferPool
+ * @caps: the new caps
+ *
+ * Called when the driver changed the format of the queue while keeping its
+ * buffers, because the new frames fit in them. The video meta of the
+ * buffers is updated as they are dequeued.
+ */
+void
+gst_v4l2_buffer_pool_update_caps (GstV4l2BufferPool * pool, GstCaps * caps)
+{
+  GST_DEBUG_OBJECT (pool, "caps changed to %" GST_PTR_FORMAT, caps);
+
+  GST_OBJECT_LOCK (pool);
+  gst_video_info_from_caps (&pool->caps_info, caps);
+  GST_OBJECT_UNLOCK (pool);
+}
+
+/**
+ * gst_v4l2_buffer_pool_get_stats:
+ * @pool: a #GstV4l2BufferPool
+ *
+ * Returns: (transfer full): a new structure with the number of buffers of
+ * the pool and where they are (queued in the driver, held downstream or
+ * free), how many it can grow to, how many times it grew or was trimmed,
+ * how many imports could reuse the buffer already bound to the same memory,
+ * how many frames were skipped in latest-frame mode, the number of fallback
+ * copies, dmabuf imports, fence waits and poll wakeups, and the qbuf to
+ * dqbuf latency histogram of the queue
+ */
+GstStructure *
+gst_v4l2_buffer_pool_get_stats (GstV4l2BufferPool * pool)
+{
+  GstStructure *s;
+  guint count, queued, held;
+
+  count = pool->vallocator ? pool->vallocator->count : 0;
+  queued = g_atomic_int_get (&pool->num_queued);
+  held = g_bit_count (g_atomic_int_get (&pool->held));
+
+  GST_OBJECT_LOCK (pool);
+  s = gst_structure_new ("v4l2-buffer-pool-stats",
+      "queue", G_TYPE_STRING,
+      V4L2_TYPE_IS_OUTPUT (pool->obj->type) ? "output" : "capture",
+      "buffers", G_TYPE_UINT, count,
+      "queued", G_TYPE_UINT, queued,
+      "held", G_TYPE_UINT, held,
+      "free", G_TYPE_UINT, count > queued + held ? count - queued - held : 0,
+      "start-buffers", G_TYPE_UINT, pool->num_start_buffers,
+      "max-buffers", G_TYPE_UINT, pool->num_max_buffers,
+      "parked", G_TYPE_UINT, pool->num_parked,
+      "grown", G_TYPE_UINT, pool->num_grown,
+      "trimmed", G_TYPE_UINT, pool->num_trimmed,
+      "import-hits", G_TYPE_UINT, pool->num_import_hits,
+      "import-misses", G_TYPE_UINT, pool->num_import_misses,
+      "latest-dropped", G_TYPE_UINT,
+      g_atomic_int_get (&pool->num_latest_dropped),
+      "copies", G_TYPE_UINT, g_atomic_int_get (&pool->num_copies),
+      "imports", G_TYPE_UINT, g_atomic_int_get (&pool->num_imports),
+      "fence-waits", G_TYPE_UINT, g_atomic_int_get (&pool->num_fence_waits),
+      "poll-wakeups", G_TYPE_UINT, g_atomic_int_get (&pool->num_poll_wakeups),
+      NULL);
+  GST_OBJECT_UNLOCK (pool);
+
+  if (pool->vallocator)
+    gst_v4l2_allocator_get_latency_stats (pool->vallocator, s);
+
+  return s;
+}
+
+/**
+ * gst_v4l2_buffer_pool_can_import_dmabuf:
+ * @pool: a #GstV4l2BufferPool
+ * @buffer: an upstream buffer
+ *
+ * Returns: %TRUE if the driver can import dmabuf and @buffer is made of
+ * dmabuf memory laid out as the driver expects, so that it can be queued
+ * without copy in GST_V4L2_IO_DMABUF_IMPORT mode
+ */
+gboolean
+gst_v4l2_buffer_pool_can_import_dmabuf (GstV4l2BufferPool * pool,
+    GstBuffer * buffer)
+{
+  GstV4l2DmabufPlanes planes;
+
+  if (pool->vallocator == NULL ||
+      !GST_V4L2_ALLOCATOR_CAN_REQUEST (pool->vallocator, DMABUF))
+    return FALSE;
+
+  return gst_v4l2_buffer_pool_dmabuf_planes (pool, buffer, &planes);
+}
@@ -30,6 +30,7 @@
 typedef struct _GstV4l2BufferPool GstV4l2BufferPool;
 typedef struct _GstV4l2BufferPoolClass GstV4l2BufferPoolClass;
 typedef struct _GstV4l2Meta GstV4l2Meta;
+typedef struct _GstV4l2ImportKey GstV4l2ImportKey;
 
 #include "gstv4l2object.h"
 #include "gstv4l2allocator.h"
@@ -54,6 +55,16 @@ G_BEGIN_DECLS
  * simply waiting for next buffer. */
 #define GST_V4L2_FLOW_CORRUPTED_BUFFER GST_FLOW_CUSTOM_SUCCESS_1
 
+/* Identifies the upstream memory imported into a V4L2 buffer, n_mem is 0
+ * when nothing is bound */
+struct _GstV4l2ImportKey
+{
+  guint n_mem;
+  guint64 id[GST_VIDEO_MAX_PLANES];  /* dmabuf inode or userptr address */
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gsize size[GST_VIDEO_MAX_PLANES];
+};
+
 struct _GstV4l2BufferPool
 {
   GstBufferPool parent;
@@ -63,6 +74,7 @@ struct _GstV4l2BufferPool
   GstPoll *poll;             /* a poll for video_fd */
   GstPollFD pollfd;
   gboolean can_poll_device;
+  gboolean device_ready;     /* the owner already polled the device */
 
   gboolean empty;
   GCond empty_cond;
@@ -82,6 +94,33 @@ struct _GstV4l2BufferPool
   guint num_queued;          /* number of buffers queued in the driver */
   guint copy_threshold;      /* when our pool runs lower, start handing out copies */
 
+  guint num_start_buffers;   /* number of buffers allocated at start */
+  guint num_max_buffers;     /* limit when growing the capture queue */
+  guint32 parked;            /* mask of capture buffers taken out by trimming */
+  guint num_parked;
+  GstClockTime last_resize;  /* last time the capture pool grew or shrunk */
+  guint num_grown;           /* statistics */
+  guint num_trimmed;
+
+  /* USERPTR/DMABUF_IMPORT, memory still bound to each buffer index and the
+   * free output buffers kept with their binding */
+  GstV4l2ImportKey import_keys[VIDEO_MAX_FRAME];
+  GstBuffer *import_free[VIDEO_MAX_FRAME];
+  guint64 import_age[VIDEO_MAX_FRAME];
+  guint64 import_clock;
+  guint num_import_hits;     /* statistics */
+  guint num_import_misses;
+
+  guint num_latest_dropped;  /* frames requeued in latest-frame mode */
+
+  guint32 held;              /* mask of the buffers handed out, not queued */
+  guint num_copies;          /* fallback copies */
+  guint num_imports;         /* upstream dmabuf queued without copy */
+  guint num_fence_waits;     /* imports that waited for their producer */
+  gboolean can_export_sync_file;
+  guint num_poll_wakeups;
+  GstClockTime last_stats;   /* time of the last periodic stats message */
+
   gboolean streaming;
   gboolean flushing;
 
@@ -110,6 +149,16 @@ void                gst_v4l2_buffer_pool_set_other_pool (GstV4l2BufferPool * poo
 void                gst_v4l2_buffer_pool_copy_at_threshold (GstV4l2BufferPool * pool,
                                                             gboolean copy);
 
+void                gst_v4l2_buffer_pool_update_caps (GstV4l2BufferPool * pool,
+                                                      GstCaps * caps);
+
+GstStructure *      gst_v4l2_buffer_pool_get_stats (GstV4l2BufferPool * pool);
+
+gboolean            gst_v4l2_buffer_pool_can_import_dmabuf (GstV4l2BufferPool * pool,
+                                                            GstBuffer * buffer);
+
+void                gst_v4l2_buffer_pool_set_device_ready (GstV4l2BufferPool * pool);
+
 G_END_DECLS
 
 #endif /*__GST_V4L2_BUFFER_POOL_H__ */
@@ -0,0 +1,1113 @@
+/* GStreamer
+ *
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * gstv4l2multisrc.c: synchronized capture from several V4L2 devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-v4l2multisrc
+ *
+ * v4l2multisrc captures from several V4L2 devices at once, typically the
+ * cameras of a stereo rig, and pushes the frames that were captured at the
+ * same time together. The devices are polled from a single thread and the
+ * frames are matched using the timestamp the driver put in the V4L2 buffer.
+ * A set is pushed once every device has a frame within
+ * #GstV4l2MultiSrc:tolerance of the others, the oldest frame is dropped
+ * otherwise.
+ *
+ * All the devices are configured with the same format. With the
+ * "separated" layout, the frames are pushed without copy as the memories
+ * of a single buffer, each described by a #GstVideoMeta whose id is the
+ * index of the device. With the "side-by-side" layout, the frames are
+ * copied next to each other into one frame.
+ *
+ * <refsect2>
+ * <title>Example launch lines</title>
+ * |[
+ * gst-launch-1.0 v4l2multisrc devices=/dev/video0,/dev/video1 layout=side-by-side ! videoconvert ! autovideosink
+ * ]| This pipeline shows the frames of two cameras next to each other.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <gst/video/gstvideometa.h>
+
+#include "gstv4l2multisrc.h"
+#include "v4l2_calls.h"
+#include "v4l2-copy.h"
+
+#include "gst/gst-i18n-plugin.h"
+
+GST_DEBUG_CATEGORY_STATIC (v4l2multisrc_debug);
+#define GST_CAT_DEFAULT v4l2multisrc_debug
+
+#define DEFAULT_PROP_DEVICES      "/dev/video0,/dev/video1"
+#define DEFAULT_PROP_LAYOUT       GST_V4L2_MULTI_SRC_LAYOUT_SEPARATED
+#define DEFAULT_PROP_TOLERANCE    (10 * GST_MSECOND)
+#define DEFAULT_PROP_MAX_LATENCY  (100 * GST_MSECOND)
+
+enum
+{
+  PROP_0,
+  PROP_DEVICES,
+  PROP_LAYOUT,
+  PROP_TOLERANCE,
+  PROP_MAX_LATENCY,
+  PROP_STATS,
+};
+
+#define GST_TYPE_V4L2_MULTI_SRC_LAYOUT (gst_v4l2_multi_src_layout_get_type ())
+static GType
+gst_v4l2_multi_src_layout_get_type (void)
+{
+  static GType layout = 0;
+
+  if (!layout) {
+    static const GEnumValue layouts[] = {
+      {GST_V4L2_MULTI_SRC_LAYOUT_SEPARATED,
+          "GST_V4L2_MULTI_SRC_LAYOUT_SEPARATED", "separated"},
+      {GST_V4L2_MULTI_SRC_LAYOUT_SIDE_BY_SIDE,
+          "GST_V4L2_MULTI_SRC_LAYOUT_SIDE_BY_SIDE", "side-by-side"},
+      {0, NULL, NULL}
+    };
+
+    layout = g_enum_register_static ("GstV4l2MultiSrcLayout", layouts);
+  }
+
+  return layout;
+}
+
+#define gst_v4l2_multi_src_parent_class parent_class
+G_DEFINE_TYPE (GstV4l2MultiSrc, gst_v4l2_multi_src, GST_TYPE_PUSH_SRC);
+
+#define DEVICE(self, i) \
+  ((GstV4l2MultiSrcDevice *) g_ptr_array_index ((self)->devices, i))
+
+static void
+gst_v4l2_multi_src_device_free (GstV4l2MultiSrcDevice * device)
+{
+  gst_buffer_replace (&device->pending, NULL);
+  gst_v4l2_object_destroy (device->v4l2object);
+  g_slice_free (GstV4l2MultiSrcDevice, device);
+}
+
+static void
+gst_v4l2_multi_src_finalize (GObject * object)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (object);
+
+  g_ptr_array_unref (self->devices);
+  gst_poll_free (self->poll);
+  g_free (self->device_list);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static GstStructure *
+gst_v4l2_multi_src_get_stats (GstV4l2MultiSrc * self)
+{
+  GstStructure *s;
+  GValue dropped = G_VALUE_INIT;
+  GValue v = G_VALUE_INIT;
+  guint64 total = 0;
+  guint i;
+
+  g_value_init (&dropped, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_UINT64);
+
+  GST_OBJECT_LOCK (self);
+  for (i = 0; i < self->devices->len; i++) {
+    g_value_set_uint64 (&v, DEVICE (self, i)->num_dropped);
+    gst_value_array_append_value (&dropped, &v);
+    total += DEVICE (self, i)->num_dropped;
+  }
+
+  s = gst_structure_new ("v4l2multisrc-stats",
+      "sets", G_TYPE_UINT64, self->num_sets,
+      "dropped", G_TYPE_UINT64, total,
+      "max-skew", G_TYPE_UINT64, self->max_skew, NULL);
+  GST_OBJECT_UNLOCK (self);
+
+  gst_structure_take_value (s, "device-dropped", &dropped);
+  g_value_unset (&v);
+
+  return s;
+}
+
+static void
+gst_v4l2_multi_src_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (object);
+
+  switch (prop_id) {
+    case PROP_DEVICES:
+      GST_OBJECT_LOCK (self);
+      g_free (self->device_list);
+      self->device_list = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_LAYOUT:
+      self->layout = g_value_get_enum (value);
+      break;
+    case PROP_TOLERANCE:
+      self->tolerance = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_LATENCY:
+      self->max_latency = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_v4l2_multi_src_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (object);
+
+  switch (prop_id) {
+    case PROP_DEVICES:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->device_list);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_LAYOUT:
+      g_value_set_enum (value, self->layout);
+      break;
+    case PROP_TOLERANCE:
+      g_value_set_uint64 (value, self->tolerance);
+      break;
+    case PROP_MAX_LATENCY:
+      g_value_set_uint64 (value, self->max_latency);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_v4l2_multi_src_get_stats (self));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_v4l2_multi_src_close (GstV4l2MultiSrc * self)
+{
+  GPtrArray *devices;
+  guint i;
+
+  for (i = 0; i < self->devices->len; i++) {
+    GstV4l2MultiSrcDevice *device = DEVICE (self, i);
+
+    gst_poll_remove_fd (self->poll, &device->pollfd);
+    if (GST_V4L2_IS_OPEN (device->v4l2object))
+      gst_v4l2_object_close (device->v4l2object);
+  }
+
+  GST_OBJECT_LOCK (self);
+  devices = self->devices;
+  self->devices = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_v4l2_multi_src_device_free);
+  GST_OBJECT_UNLOCK (self);
+
+  g_ptr_array_unref (devices);
+}
+
+static gboolean
+gst_v4l2_multi_src_open (GstV4l2MultiSrc * self)
+{
+  gchar **names;
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  names = g_strsplit (self->device_list ? self->device_list : "", ",", -1);
+  GST_OBJECT_UNLOCK (self);
+
+  for (i = 0; names[i]; i++) {
+    GstV4l2MultiSrcDevice *device;
+
+    g_strstrip (names[i]);
+    if (names[i][0] == '\0')
+      continue;
+
+    device = g_slice_new0 (GstV4l2MultiSrcDevice);
+    device->v4l2object = gst_v4l2_object_new (GST_ELEMENT (self),
+        V4L2_BUF_TYPE_VIDEO_CAPTURE, names[i], gst_v4l2_get_input,
+        gst_v4l2_set_input, NULL);
+    gst_poll_fd_init (&device->pollfd);
+
+    GST_OBJECT_LOCK (self);
+    g_ptr_array_add (self->devices, device);
+    GST_OBJECT_UNLOCK (self);
+
+    if (!gst_v4l2_object_open (device->v4l2object))
+      goto open_failed;
+
+    device->pollfd.fd = device->v4l2object->video_fd;
+    gst_poll_add_fd (self->poll, &device->pollfd);
+  }
+
+  g_strfreev (names);
+
+  if (self->devices->len == 0)
+    goto no_devices;
+
+  return TRUE;
+
+open_failed:
+  {
+    g_strfreev (names);
+    gst_v4l2_multi_src_close (self);
+    return FALSE;
+  }
+no_devices:
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND,
+        (_("No device specified.")), (NULL));
+    return FALSE;
+  }
+}
+
+static GstStateChangeReturn
+gst_v4l2_multi_src_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!gst_v4l2_multi_src_open (self))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      gst_v4l2_multi_src_close (self);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+/* Multiply (or divide, when @expand is FALSE) the widths of @caps by the
+ * number of views, going between the caps of one device and the caps of
+ * the side-by-side frame */
+static gboolean
+gst_v4l2_multi_src_scale_width (GstCaps * caps, guint views, gboolean expand)
+{
+  guint i;
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    GstStructure *s = gst_caps_get_structure (caps, i);
+    const GValue *v = gst_structure_get_value (s, "width");
+
+    if (v == NULL)
+      continue;
+
+    if (G_VALUE_HOLDS_INT (v)) {
+      gint width = g_value_get_int (v);
+
+      if (expand) {
+        width = MIN ((gint64) width * views, G_MAXINT);
+      } else {
+        if (width % views)
+          return FALSE;
+        width /= views;
+      }
+
+      gst_structure_set (s, "width", G_TYPE_INT, width, NULL);
+    } else if (GST_VALUE_HOLDS_INT_RANGE (v) && expand) {
+      gint min = gst_value_get_int_range_min (v);
+      gint max = gst_value_get_int_range_max (v);
+
+      gst_structure_set (s, "width", GST_TYPE_INT_RANGE,
+          (gint) MIN ((gint64) min * views, G_MAXINT),
+          (gint) MIN ((gint64) max * views, G_MAXINT), NULL);
+    } else {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static GstCaps *
+gst_v4l2_multi_src_get_caps (GstBaseSrc * src, GstCaps * filter)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (src);
+  GstCaps *caps = NULL;
+  guint i, n_views = self->devices->len;
+
+  if (n_views == 0 || !GST_V4L2_IS_OPEN (DEVICE (self, 0)->v4l2object))
+    return gst_pad_get_pad_template_caps (GST_BASE_SRC_PAD (src));
+
+  for (i = 0; i < n_views; i++) {
+    GstCaps *tmp = gst_v4l2_object_get_caps (DEVICE (self, i)->v4l2object,
+        NULL);
+
+    if (caps) {
+      GstCaps *intersection = gst_caps_intersect (caps, tmp);
+
+      gst_caps_unref (caps);
+      gst_caps_unref (tmp);
+      caps = intersection;
+    } else {
+      caps = tmp;
+    }
+  }
+
+  caps = gst_caps_make_writable (caps);
+
+  if (self->layout == GST_V4L2_MULTI_SRC_LAYOUT_SIDE_BY_SIDE) {
+    if (!gst_v4l2_multi_src_scale_width (caps, n_views, TRUE)) {
+      gst_caps_unref (caps);
+      caps = gst_caps_new_empty ();
+    }
+
+    if (n_views == 2)
+      gst_caps_set_simple (caps, "multiview-mode", G_TYPE_STRING,
+          "side-by-side", NULL);
+  } else if (n_views > 1) {
+    gst_caps_set_simple (caps, "multiview-mode", G_TYPE_STRING, "separated",
+        "views", G_TYPE_INT, n_views, NULL);
+  }
+
+  if (filter) {
+    GstCaps *tmp = caps;
+
+    caps = gst_caps_intersect_full (filter, tmp, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (tmp);
+  }
+
+  GST_DEBUG_OBJECT (self, "caps: %" GST_PTR_FORMAT, caps);
+
+  return caps;
+}
+
+static gboolean
+gst_v4l2_multi_src_activate_pool (GstV4l2MultiSrc * self,
+    GstV4l2Object * obj, GstCaps * caps)
+{
+  GstBufferPool *pool = GST_BUFFER_POOL (obj->pool);
+  GstStructure *config;
+  gint min;
+
+  if (gst_buffer_pool_is_active (pool))
+    return TRUE;
+
+  config = gst_buffer_pool_get_config (pool);
+  min = obj->min_buffers == 0 ? GST_V4L2_MIN_BUFFERS : obj->min_buffers;
+  gst_buffer_pool_config_set_params (config, caps, obj->info.size, min, min);
+
+  /* There is no reason to refuse this config */
+  if (!gst_buffer_pool_set_config (pool, config))
+    goto activate_failed;
+
+  if (!gst_buffer_pool_set_active (pool, TRUE))
+    goto activate_failed;
+
+  return TRUE;
+
+activate_failed:
+  GST_ELEMENT_ERROR (self, RESOURCE, SETTINGS,
+      ("failed to activate bufferpool"), ("failed to activate bufferpool"));
+  return FALSE;
+}
+
+static gboolean
+gst_v4l2_multi_src_set_caps (GstBaseSrc * src, GstCaps * caps)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (src);
+  GstCaps *view_caps;
+  GstStructure *s;
+  guint i, n_views = self->devices->len;
+
+  if (!gst_video_info_from_caps (&self->info, caps))
+    goto invalid_caps;
+
+  view_caps = gst_caps_copy (caps);
+  s = gst_caps_get_structure (view_caps, 0);
+  gst_structure_remove_fields (s, "multiview-mode", "views",
+      "multiview-flags", NULL);
+
+  if (self->layout == GST_V4L2_MULTI_SRC_LAYOUT_SIDE_BY_SIDE) {
+    const GstVideoFormatInfo *finfo = self->info.finfo;
+
+    /* the frames are stitched with a plain copy of each line */
+    if (GST_VIDEO_FORMAT_INFO_IS_TILED (finfo) ||
+        GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, 0) == 0)
+      goto unsupported_layout;
+
+    if (!gst_v4l2_multi_src_scale_width (view_caps, n_views, FALSE))
+      goto invalid_width;
+  }
+
+  GST_DEBUG_OBJECT (self, "setting %" GST_PTR_FORMAT " on %u devices",
+      view_caps, n_views);
+
+  for (i = 0; i < n_views; i++) {
+    GstV4l2Object *obj = DEVICE (self, i)->v4l2object;
+    GstV4l2Error error = GST_V4L2_ERROR_INIT;
+
+    gst_buffer_replace (&DEVICE (self, i)->pending, NULL);
+
+    if (GST_V4L2_IS_ACTIVE (obj) && !gst_v4l2_object_stop (obj))
+      goto stop_failed;
+
+    if (!gst_v4l2_object_set_format (obj, view_caps, &error)) {
+      gst_v4l2_error (self, &error);
+      goto set_format_failed;
+    }
+
+    if (!gst_v4l2_multi_src_activate_pool (self, obj, view_caps))
+      goto set_format_failed;
+  }
+
+  gst_caps_unref (view_caps);
+
+  return TRUE;
+
+invalid_caps:
+  {
+    GST_ERROR_OBJECT (self, "invalid caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+unsupported_layout:
+  {
+    GST_ELEMENT_ERROR (self, CORE, NEGOTIATION,
+        ("Cannot place %s frames side by side.",
+            GST_VIDEO_INFO_NAME (&self->info)), (NULL));
+    gst_caps_unref (view_caps);
+    return FALSE;
+  }
+invalid_width:
+  {
+    GST_ERROR_OBJECT (self, "width %d cannot be split in %u views",
+        GST_VIDEO_INFO_WIDTH (&self->info), n_views);
+    gst_caps_unref (view_caps);
+    return FALSE;
+  }
+stop_failed:
+set_format_failed:
+  {
+    gst_caps_unref (view_caps);
+    return FALSE;
+  }
+}
+
+static gboolean
+gst_v4l2_multi_src_start (GstBaseSrc * src)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (src);
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  self->num_sets = 0;
+  self->max_skew = 0;
+  for (i = 0; i < self->devices->len; i++)
+    DEVICE (self, i)->num_dropped = 0;
+  GST_OBJECT_UNLOCK (self);
+
+  return TRUE;
+}
+
+static gboolean
+gst_v4l2_multi_src_stop (GstBaseSrc * src)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (src);
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; i < self->devices->len; i++) {
+    GstV4l2Object *obj = DEVICE (self, i)->v4l2object;
+
+    gst_buffer_replace (&DEVICE (self, i)->pending, NULL);
+
+    if (GST_V4L2_IS_ACTIVE (obj) && !gst_v4l2_object_stop (obj))
+      ret = FALSE;
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_v4l2_multi_src_unlock (GstBaseSrc * src)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (src);
+  gboolean ret = TRUE;
+  guint i;
+
+  gst_poll_set_flushing (self->poll, TRUE);
+
+  for (i = 0; i < self->devices->len; i++)
+    ret &= gst_v4l2_object_unlock (DEVICE (self, i)->v4l2object);
+
+  return ret;
+}
+
+static gboolean
+gst_v4l2_multi_src_unlock_stop (GstBaseSrc * src)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (src);
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; i < self->devices->len; i++)
+    ret &= gst_v4l2_object_unlock_stop (DEVICE (self, i)->v4l2object);
+
+  gst_poll_set_flushing (self->poll, FALSE);
+
+  return ret;
+}
+
+static gboolean
+gst_v4l2_multi_src_query (GstBaseSrc * src, GstQuery * query)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (src);
+  gboolean res;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:{
+      GstV4l2Object *obj;
+      GstClockTime min_latency, max_latency;
+
+      if (self->devices->len == 0)
+        return FALSE;
+
+      obj = DEVICE (self, 0)->v4l2object;
+
+      /* we must have a framerate */
+      if (!GST_V4L2_IS_ACTIVE (obj) ||
+          !GST_CLOCK_TIME_IS_VALID (obj->duration)) {
+        GST_WARNING_OBJECT (self, "Can't give latency since framerate "
+            "isn't fixated !");
+        return FALSE;
+      }
+
+      /* a frame of latency in the devices, and a set may have to wait for
+       * its last frame for up to max-latency */
+      min_latency = obj->duration;
+      max_latency = min_latency + self->max_latency;
+
+      GST_DEBUG_OBJECT (self, "report latency min %" GST_TIME_FORMAT
+          " max %" GST_TIME_FORMAT, GST_TIME_ARGS (min_latency),
+          GST_TIME_ARGS (max_latency));
+
+      gst_query_set_latency (query, TRUE, min_latency, max_latency);
+      res = TRUE;
+      break;
+    }
+    default:
+      res = GST_BASE_SRC_CLASS (parent_class)->query (src, query);
+      break;
+  }
+
+  return res;
+}
+
+/* Dequeue the next frame of @device, blocking if none is ready. When
+ * @ready is set the device was found readable by our own poll, and the pool
+ * is told so that it does not poll again. */
+static GstFlowReturn
+gst_v4l2_multi_src_capture (GstV4l2MultiSrc * self,
+    GstV4l2MultiSrcDevice * device, gboolean ready)
+{
+  GstV4l2Object *obj = device->v4l2object;
+  GstBufferPool *pool = GST_BUFFER_POOL (obj->pool);
+  GstBuffer *buf = NULL;
+  GstFlowReturn ret;
+
+  do {
+    gst_buffer_replace (&buf, NULL);
+
+    ret = gst_buffer_pool_acquire_buffer (pool, &buf, NULL);
+    if (ret != GST_FLOW_OK)
+      return ret;
+
+    /* only the first dequeue is known not to block */
+    if (ready) {
+      gst_v4l2_buffer_pool_set_device_ready (GST_V4L2_BUFFER_POOL (pool));
+      ready = FALSE;
+    }
+
+    ret = gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL (pool), &buf);
+  } while (ret == GST_V4L2_FLOW_CORRUPTED_BUFFER);
+
+  if (ret != GST_FLOW_OK) {
+    gst_buffer_replace (&buf, NULL);
+    return ret;
+  }
+
+  GST_LOG_OBJECT (self, "%s: frame %" GST_TIME_FORMAT, obj->videodev,
+      GST_TIME_ARGS (GST_BUFFER_PTS (buf)));
+
+  device->pending = buf;
+  device->pending_time = gst_util_get_timestamp ();
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_v4l2_multi_src_drop (GstV4l2MultiSrc * self,
+    GstV4l2MultiSrcDevice * device)
+{
+  GST_DEBUG_OBJECT (self, "%s: dropping frame %" GST_TIME_FORMAT,
+      device->v4l2object->videodev, GST_TIME_ARGS (GST_BUFFER_PTS
+          (device->pending)));
+
+  gst_buffer_replace (&device->pending, NULL);
+
+  GST_OBJECT_LOCK (self);
+  device->num_dropped++;
+  GST_OBJECT_UNLOCK (self);
+}
+
+/* Wait until a frame is pending on every device, only polling the devices
+ * that still miss one. Frames that did not find a match within max-latency
+ * of being dequeued are dropped, the poll timeout is the time left to the
+ * oldest pending frame so that wakeups of the other devices don't extend
+ * it. */
+static GstFlowReturn
+gst_v4l2_multi_src_fill (GstV4l2MultiSrc * self)
+{
+  GstFlowReturn ret;
+  GstClockTime now, oldest, timeout;
+  guint i, n_missing;
+  gint res;
+
+again:
+  n_missing = 0;
+  oldest = GST_CLOCK_TIME_NONE;
+
+  for (i = 0; i < self->devices->len; i++) {
+    GstV4l2MultiSrcDevice *device = DEVICE (self, i);
+    GstV4l2BufferPool *pool =
+        GST_V4L2_BUFFER_POOL (device->v4l2object->pool);
+
+    if (device->pending) {
+      gst_poll_fd_ctl_read (self->poll, &device->pollfd, FALSE);
+      if (!GST_CLOCK_TIME_IS_VALID (oldest) || device->pending_time < oldest)
+        oldest = device->pending_time;
+      continue;
+    }
+
+    /* nothing is queued before the first acquire, and read() devices are
+     * polled by the pool itself */
+    if (!pool->streaming) {
+      ret = gst_v4l2_multi_src_capture (self, device, FALSE);
+      if (ret != GST_FLOW_OK)
+        return ret;
+      goto again;
+    }
+
+    gst_poll_fd_ctl_read (self->poll, &device->pollfd, TRUE);
+    n_missing++;
+  }
+
+  if (n_missing == 0)
+    return GST_FLOW_OK;
+
+  /* with nothing pending there is nothing to expire */
+  timeout = GST_CLOCK_TIME_NONE;
+  if (GST_CLOCK_TIME_IS_VALID (oldest)) {
+    now = gst_util_get_timestamp ();
+    if (now - oldest >= self->max_latency)
+      goto expired;
+    timeout = self->max_latency - (now - oldest);
+  }
+
+  res = gst_poll_wait (self->poll, timeout);
+  if (res < 0) {
+    if (errno == EBUSY)
+      return GST_FLOW_FLUSHING;
+    if (errno == EAGAIN || errno == EINTR)
+      goto again;
+    goto poll_error;
+  }
+
+  if (res == 0)
+    goto expired;
+
+  for (i = 0; i < self->devices->len; i++) {
+    GstV4l2MultiSrcDevice *device = DEVICE (self, i);
+
+    if (device->pending)
+      continue;
+
+    if (gst_poll_fd_has_error (self->poll, &device->pollfd)) {
+      errno = EIO;
+      goto poll_error;
+    }
+
+    if (gst_poll_fd_can_read (self->poll, &device->pollfd)) {
+      ret = gst_v4l2_multi_src_capture (self, device, TRUE);
+      if (ret != GST_FLOW_OK)
+        return ret;
+    }
+  }
+
+  goto again;
+
+expired:
+  {
+    now = gst_util_get_timestamp ();
+
+    GST_WARNING_OBJECT (self, "no matching frames after %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (self->max_latency));
+
+    for (i = 0; i < self->devices->len; i++) {
+      GstV4l2MultiSrcDevice *device = DEVICE (self, i);
+
+      if (device->pending && now - device->pending_time >= self->max_latency)
+        gst_v4l2_multi_src_drop (self, device);
+    }
+
+    goto again;
+  }
+poll_error:
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("poll error %d: %s (%d)", res, g_strerror (errno), errno));
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* Fill and match until the pending frames are within the tolerance. The
+ * oldest frame can only match frames that are even older, so it is dropped
+ * when the set is too skewed. */
+static GstFlowReturn
+gst_v4l2_multi_src_match (GstV4l2MultiSrc * self, GstClockTime * newest)
+{
+  GstFlowReturn ret;
+
+  while (TRUE) {
+    GstV4l2MultiSrcDevice *oldest = NULL;
+    GstClockTime min = GST_CLOCK_TIME_NONE, max = 0, skew;
+    guint i;
+
+    ret = gst_v4l2_multi_src_fill (self);
+    if (ret != GST_FLOW_OK)
+      return ret;
+
+    for (i = 0; i < self->devices->len; i++) {
+      GstV4l2MultiSrcDevice *device = DEVICE (self, i);
+      GstClockTime pts = GST_BUFFER_PTS (device->pending);
+
+      if (!GST_CLOCK_TIME_IS_VALID (pts))
+        pts = 0;
+
+      if (pts < min) {
+        min = pts;
+        oldest = device;
+      }
+      max = MAX (max, pts);
+    }
+
+    skew = max - min;
+    if (skew <= self->tolerance) {
+      GST_OBJECT_LOCK (self);
+      self->num_sets++;
+      self->max_skew = MAX (self->max_skew, skew);
+      GST_OBJECT_UNLOCK (self);
+
+      *newest = max;
+      return GST_FLOW_OK;
+    }
+
+    GST_LOG_OBJECT (self, "skew %" GST_TIME_FORMAT " above tolerance",
+        GST_TIME_ARGS (skew));
+    gst_v4l2_multi_src_drop (self, oldest);
+  }
+}
+
+static GstFlowReturn
+gst_v4l2_multi_src_merge_separated (GstV4l2MultiSrc * self, GstBuffer ** out)
+{
+  GstBuffer *buf = gst_buffer_new ();
+  gsize offset = 0;
+  guint i, p;
+
+  for (i = 0; i < self->devices->len; i++) {
+    GstV4l2MultiSrcDevice *device = DEVICE (self, i);
+    GstVideoInfo *info = &device->v4l2object->info;
+    GstVideoMeta *vmeta, *src_meta;
+    gsize offsets[GST_VIDEO_MAX_PLANES];
+    gint strides[GST_VIDEO_MAX_PLANES];
+
+    src_meta = gst_buffer_get_video_meta (device->pending);
+
+    for (p = 0; p < GST_VIDEO_INFO_N_PLANES (info); p++) {
+      offsets[p] = offset + (src_meta ? src_meta->offset[p] :
+          GST_VIDEO_INFO_PLANE_OFFSET (info, p));
+      strides[p] = src_meta ? src_meta->stride[p] :
+          GST_VIDEO_INFO_PLANE_STRIDE (info, p);
+    }
+
+    gst_buffer_copy_into (buf, device->pending, GST_BUFFER_COPY_MEMORY, 0, -1);
+    offset += gst_buffer_get_size (device->pending);
+
+    vmeta = gst_buffer_add_video_meta_full (buf, GST_VIDEO_FRAME_FLAG_NONE,
+        GST_VIDEO_INFO_FORMAT (info), GST_VIDEO_INFO_WIDTH (info),
+        GST_VIDEO_INFO_HEIGHT (info), GST_VIDEO_INFO_N_PLANES (info),
+        offsets, strides);
+    vmeta->id = i;
+
+    /* keep the V4L2 buffer out of the queue while its memory is in use */
+    gst_buffer_add_parent_buffer_meta (buf, device->pending);
+    gst_buffer_replace (&device->pending, NULL);
+  }
+
+  *out = buf;
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_v4l2_multi_src_merge_side_by_side (GstV4l2MultiSrc * self,
+    GstBuffer ** out)
+{
+  GstVideoFrame dest;
+  GstFlowReturn ret;
+  guint i, p;
+
+  ret = GST_BASE_SRC_CLASS (parent_class)->alloc (GST_BASE_SRC (self), 0,
+      self->info.size, out);
+  if (ret != GST_FLOW_OK)
+    goto drop_all;
+
+  if (!gst_video_frame_map (&dest, &self->info, *out, GST_MAP_WRITE))
+    goto map_failed;
+
+  for (i = 0; i < self->devices->len; i++) {
+    GstV4l2MultiSrcDevice *device = DEVICE (self, i);
+    GstVideoFrame src;
+
+    if (!gst_video_frame_map (&src, &device->v4l2object->info,
+            device->pending, GST_MAP_READ)) {
+      gst_video_frame_unmap (&dest);
+      goto map_failed;
+    }
+
+    for (p = 0; p < GST_VIDEO_FRAME_N_PLANES (&src); p++) {
+      gsize width = GST_VIDEO_FRAME_COMP_WIDTH (&src, p) *
+          GST_VIDEO_FRAME_COMP_PSTRIDE (&src, p);
+
+      gst_v4l2_copy_plane ((guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&dest,
+              p) + i * width, GST_VIDEO_FRAME_PLANE_STRIDE (&dest, p),
+          GST_VIDEO_FRAME_PLANE_DATA (&src, p),
+          GST_VIDEO_FRAME_PLANE_STRIDE (&src, p), width,
+          GST_VIDEO_FRAME_COMP_HEIGHT (&src, p));
+    }
+
+    gst_video_frame_unmap (&src);
+    gst_buffer_replace (&device->pending, NULL);
+  }
+
+  gst_video_frame_unmap (&dest);
+
+  return GST_FLOW_OK;
+
+map_failed:
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, ("Failed to map frames."),
+        (NULL));
+    gst_buffer_replace (out, NULL);
+    ret = GST_FLOW_ERROR;
+    goto drop_all;
+  }
+drop_all:
+  {
+    for (i = 0; i < self->devices->len; i++)
+      gst_buffer_replace (&DEVICE (self, i)->pending, NULL);
+    return ret;
+  }
+}
+
+static GstFlowReturn
+gst_v4l2_multi_src_create (GstPushSrc * src, GstBuffer ** buf)
+{
+  GstV4l2MultiSrc *self = GST_V4L2_MULTI_SRC (src);
+  GstV4l2Object *obj = DEVICE (self, 0)->v4l2object;
+  GstClockTime newest, timestamp, delay, duration = obj->duration;
+  GstClock *clock;
+  GstFlowReturn ret;
+
+  ret = gst_v4l2_multi_src_match (self, &newest);
+  if (ret != GST_FLOW_OK)
+    goto error;
+
+  if (self->layout == GST_V4L2_MULTI_SRC_LAYOUT_SIDE_BY_SIDE)
+    ret = gst_v4l2_multi_src_merge_side_by_side (self, buf);
+  else
+    ret = gst_v4l2_multi_src_merge_separated (self, buf);
+
+  if (ret != GST_FLOW_OK)
+    goto error;
+
+  /* we assume 1 frame latency when the driver timestamps are not usable */
+  delay = GST_CLOCK_TIME_IS_VALID (duration) ? duration : 0;
+
+  if (GST_CLOCK_TIME_IS_VALID (newest) && newest > 0) {
+    struct timespec now;
+    GstClockTime gstnow;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    gstnow = GST_TIMESPEC_TO_TIME (now);
+
+    if (newest <= gstnow && gstnow - newest < 10 * GST_SECOND)
+      delay = gstnow - newest;
+  }
+
+  timestamp = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (self);
+  if ((clock = GST_ELEMENT_CLOCK (self))) {
+    GstClockTime abs_time = gst_clock_get_time (clock);
+    GstClockTime base_time = GST_ELEMENT (self)->base_time;
+
+    timestamp = abs_time - base_time;
+    if (timestamp > delay)
+      timestamp -= delay;
+    else
+      timestamp = 0;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  GST_BUFFER_TIMESTAMP (*buf) = timestamp;
+  GST_BUFFER_DURATION (*buf) = duration;
+
+  GST_LOG_OBJECT (self, "pushing set %" GST_TIME_FORMAT " delay %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (timestamp), GST_TIME_ARGS (delay));
+
+  return GST_FLOW_OK;
+
+error:
+  if (ret == GST_V4L2_FLOW_LAST_BUFFER)
+    ret = GST_FLOW_EOS;
+  else if (ret != GST_FLOW_FLUSHING && ret != GST_FLOW_EOS)
+    GST_DEBUG_OBJECT (self, "error processing buffer %d (%s)", ret,
+        gst_flow_get_name (ret));
+
+  return ret;
+}
+
+static void
+gst_v4l2_multi_src_class_init (GstV4l2MultiSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+  GstPushSrcClass *pushsrc_class = GST_PUSH_SRC_CLASS (klass);
+
+  gobject_class->finalize = gst_v4l2_multi_src_finalize;
+  gobject_class->set_property = gst_v4l2_multi_src_set_property;
+  gobject_class->get_property = gst_v4l2_multi_src_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_DEVICES,
+      g_param_spec_string ("devices", "Devices",
+          "Comma separated list of the devices to capture from",
+          DEFAULT_PROP_DEVICES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LAYOUT,
+      g_param_spec_enum ("layout", "Layout",
+          "How the frames of a set are placed in the output buffer",
+          GST_TYPE_V4L2_MULTI_SRC_LAYOUT, DEFAULT_PROP_LAYOUT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_TOLERANCE,
+      g_param_spec_uint64 ("tolerance", "Tolerance",
+          "Maximum difference between the timestamps of a set (in ns)",
+          0, G_MAXUINT64, DEFAULT_PROP_TOLERANCE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_LATENCY,
+      g_param_spec_uint64 ("max-latency", "Maximum latency",
+          "Maximum time to wait for the frames completing a set (in ns)",
+          1, G_MAXUINT64, DEFAULT_PROP_MAX_LATENCY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstV4l2MultiSrc:stats:
+   *
+   * The number of sets pushed, the frames dropped in total and per device,
+   * and the largest timestamp difference seen in a set.
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Synchronization statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  element_class->change_state = gst_v4l2_multi_src_change_state;
+
+  gst_element_class_set_static_metadata (element_class,
+      "Synchronized Video (video4linux2) Source", "Source/Video",
+      "Captures time aligned frames from several Video4Linux2 devices",
+      "GStreamer maintainers <gstreamer-devel@lists.freedesktop.org>");
+
+  gst_element_class_add_pad_template (element_class,
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_v4l2_object_get_raw_caps ()));
+
+  basesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_v4l2_multi_src_get_caps);
+  basesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_v4l2_multi_src_set_caps);
+  basesrc_class->start = GST_DEBUG_FUNCPTR (gst_v4l2_multi_src_start);
+  basesrc_class->stop = GST_DEBUG_FUNCPTR (gst_v4l2_multi_src_stop);
+  basesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_v4l2_multi_src_unlock);
+  basesrc_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_v4l2_multi_src_unlock_stop);
+  basesrc_class->query = GST_DEBUG_FUNCPTR (gst_v4l2_multi_src_query);
+
+  pushsrc_class->create = GST_DEBUG_FUNCPTR (gst_v4l2_multi_src_create);
+
+  GST_DEBUG_CATEGORY_INIT (v4l2multisrc_debug, "v4l2multisrc", 0,
+      "V4L2 synchronized multi-device source");
+}
+
+static void
+gst_v4l2_multi_src_init (GstV4l2MultiSrc * self)
+{
+  self->devices = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_v4l2_multi_src_device_free);
+  self->poll = gst_poll_new (TRUE);
+  self->device_list = g_strdup (DEFAULT_PROP_DEVICES);
+  self->layout = DEFAULT_PROP_LAYOUT;
+  self->tolerance = DEFAULT_PROP_TOLERANCE;
+  self->max_latency = DEFAULT_PROP_MAX_LATENCY;
+
+  gst_base_src_set_format (GST_BASE_SRC (self), GST_FORMAT_TIME);
+  gst_base_src_set_live (GST_BASE_SRC (self), TRUE);
+}
@@ -0,0 +1,109 @@
+/* GStreamer
+ *
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * gstv4l2multisrc.h: synchronized capture from several V4L2 devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_V4L2_MULTI_SRC_H__
+#define __GST_V4L2_MULTI_SRC_H__
+
+#include <gst/base/gstpushsrc.h>
+#include <gst/video/video.h>
+
+#include <gstv4l2object.h>
+#include <gstv4l2bufferpool.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_V4L2_MULTI_SRC \
+  (gst_v4l2_multi_src_get_type())
+#define GST_V4L2_MULTI_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_V4L2_MULTI_SRC,GstV4l2MultiSrc))
+#define GST_V4L2_MULTI_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_V4L2_MULTI_SRC,GstV4l2MultiSrcClass))
+#define GST_IS_V4L2_MULTI_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_V4L2_MULTI_SRC))
+#define GST_IS_V4L2_MULTI_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_V4L2_MULTI_SRC))
+
+typedef struct _GstV4l2MultiSrc GstV4l2MultiSrc;
+typedef struct _GstV4l2MultiSrcClass GstV4l2MultiSrcClass;
+typedef struct _GstV4l2MultiSrcDevice GstV4l2MultiSrcDevice;
+
+/**
+ * GstV4l2MultiSrcLayout:
+ * @GST_V4L2_MULTI_SRC_LAYOUT_SEPARATED: one buffer holding the frames of all
+ *   the devices, each described by a #GstVideoMeta with the device index as
+ *   id
+ * @GST_V4L2_MULTI_SRC_LAYOUT_SIDE_BY_SIDE: the frames are copied next to
+ *   each other in a single frame
+ */
+typedef enum
+{
+  GST_V4L2_MULTI_SRC_LAYOUT_SEPARATED,
+  GST_V4L2_MULTI_SRC_LAYOUT_SIDE_BY_SIDE,
+} GstV4l2MultiSrcLayout;
+
+struct _GstV4l2MultiSrcDevice
+{
+  GstV4l2Object *v4l2object;
+  GstPollFD pollfd;
+
+  /* the last frame, waiting for the frames of the other devices */
+  GstBuffer *pending;
+  GstClockTime pending_time;   /* when @pending was dequeued */
+
+  guint64 num_dropped;
+};
+
+/**
+ * GstV4l2MultiSrc:
+ *
+ * Opaque object.
+ */
+struct _GstV4l2MultiSrc
+{
+  GstPushSrc pushsrc;
+
+  /*< private >*/
+  GPtrArray *devices;
+  GstPoll *poll;
+  GstVideoInfo info;
+
+  /* properties */
+  gchar *device_list;
+  GstV4l2MultiSrcLayout layout;
+  GstClockTime tolerance;
+  GstClockTime max_latency;
+
+  /* Statistics, protected by the object lock */
+  guint64 num_sets;
+  GstClockTime max_skew;
+};
+
+struct _GstV4l2MultiSrcClass
+{
+  GstPushSrcClass parent_class;
+};
+
+GType gst_v4l2_multi_src_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_V4L2_MULTI_SRC_H__ */
@@ -54,6 +54,7 @@ GST_DEBUG_CATEGORY_EXTERN (v4l2_debug);
 #define DEFAULT_PROP_CHANNEL            NULL
 #define DEFAULT_PROP_FREQUENCY          0
 #define DEFAULT_PROP_IO_MODE            GST_V4L2_IO_AUTO
+#define DEFAULT_PROP_POOL_TRIM_PERIOD   (5 * GST_SECOND)
 
 #define ENCODED_BUFFER_SIZE             (1 * 1024 * 1024)
 
@@ -297,6 +298,28 @@ gst_v4l2_io_mode_get_type (void)
   return v4l2_io_mode;
 }
 
+static void
+gst_v4l2_object_install_stats_properties (GObjectClass * gobject_class)
+{
+  /**
+   * GstV4l2Src:stats:
+   *
+   * The statistics of the buffer pool of the queue, see
+   * gst_v4l2_buffer_pool_get_stats(). When stats-interval is set, the same
+   * structure is posted as an element message while streaming.
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Buffer pool statistics of the V4L2 queues",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint64 ("stats-interval", "Statistics interval",
+          "Interval in nanoseconds between two stats element messages "
+          "(0 = disabled)", 0, G_MAXUINT64, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
 void
 gst_v4l2_object_install_properties_helper (GObjectClass * gobject_class,
     const char *default_device)
@@ -420,6 +443,27 @@ gst_v4l2_object_install_properties_helper (GObjectClass * gobject_class,
           "When enabled, the pixel aspect ratio will be enforced", TRUE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  gst_v4l2_object_install_stats_properties (gobject_class);
+}
+
+/* properties that only matter to elements with a capture queue */
+void
+gst_v4l2_object_install_capture_properties_helper (GObjectClass *
+    gobject_class)
+{
+  /**
+   * GstV4l2Src:pool-trim-period:
+   *
+   * When downstream holds on buffers, the capture pool grows using
+   * VIDIOC_CREATE_BUFS. Buffers that were not needed for this long are
+   * taken out of the capture queue again. 0 disables trimming.
+   */
+  g_object_class_install_property (gobject_class, PROP_POOL_TRIM_PERIOD,
+      g_param_spec_uint64 ("pool-trim-period", "Pool trim period",
+          "Time in nanoseconds after which extra capture buffers are "
+          "trimmed (0 = never)", 0, G_MAXUINT64,
+          DEFAULT_PROP_POOL_TRIM_PERIOD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 void
@@ -455,6 +499,10 @@ gst_v4l2_object_install_m2m_properties_helper (GObjectClass * gobject_class)
       g_param_spec_boxed ("extra-controls", "Extra Controls",
           "Extra v4l2 controls (CIDs) for the device",
           GST_TYPE_STRUCTURE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_v4l2_object_install_capture_properties_helper (gobject_class);
+
+  gst_v4l2_object_install_stats_properties (gobject_class);
 }
 
 GstV4l2Object *
@@ -491,11 +539,14 @@ gst_v4l2_object_new (GstElement * element,
   v4l2object->xwindow_id = 0;
 
   v4l2object->keep_aspect = TRUE;
+  v4l2object->pool_trim_period = DEFAULT_PROP_POOL_TRIM_PERIOD;
 
   v4l2object->n_v4l2_planes = 0;
 
   v4l2object->no_initial_format = FALSE;
 
+  gst_v4l2_reset_io (v4l2object);
+
   return v4l2object;
 }
 
@@ -519,6 +570,10 @@ gst_v4l2_object_destroy (GstV4l2Object * v4l2object)
     gst_caps_unref (v4l2object->probed_caps);
   }
 
+  if (v4l2object->probed_formats) {
+    g_hash_table_unref (v4l2object->probed_formats);
+  }
+
   if (v4l2object->extra_controls) {
     gst_structure_free (v4l2object->extra_controls);
   }
@@ -662,6 +717,12 @@ gst_v4l2_object_set_property_helper (GstV4l2Object * v4l2object,
     case PROP_FORCE_ASPECT_RATIO:
       v4l2object->keep_aspect = g_value_get_boolean (value);
       break;
+    case PROP_POOL_TRIM_PERIOD:
+      v4l2object->pool_trim_period = g_value_get_uint64 (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      v4l2object->stats_interval = g_value_get_uint64 (value);
+      break;
     default:
       return FALSE;
       break;
@@ -762,6 +823,15 @@ gst_v4l2_object_get_property_helper (GstV4l2Object * v4l2object,
     case PROP_FORCE_ASPECT_RATIO:
       g_value_set_boolean (value, v4l2object->keep_aspect);
       break;
+    case PROP_POOL_TRIM_PERIOD:
+      g_value_set_uint64 (value, v4l2object->pool_trim_period);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_v4l2_object_get_stats (v4l2object, NULL));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint64 (value, v4l2object->stats_interval);
+      break;
     default:
       return FALSE;
       break;
@@ -781,7 +851,7 @@ gst_v4l2_get_driver_min_buffers (GstV4l2Object * v4l2object)
   else
     control.id = V4L2_CID_MIN_BUFFERS_FOR_CAPTURE;
 
-  if (v4l2_ioctl (v4l2object->video_fd, VIDIOC_G_CTRL, &control) == 0) {
+  if (v4l2object->ioctl (v4l2object->video_fd, VIDIOC_G_CTRL, &control) == 0) {
     GST_DEBUG_OBJECT (v4l2object->element,
         "driver requires a minimum of %d buffers", control.value);
     v4l2object->min_buffers = control.value;
@@ -875,7 +945,7 @@ gst_v4l2_object_close (GstV4l2Object * v4l2object)
   if (!gst_v4l2_close (v4l2object))
     return FALSE;
 
-  gst_caps_replace (&v4l2object->probed_caps, NULL);
+  gst_v4l2_object_invalidate_caps (v4l2object);
 
   /* reset our copy of the device caps */
   v4l2object->device_caps = 0;
@@ -1119,7 +1189,7 @@ gst_v4l2_object_fill_format_list (GstV4l2Object * v4l2object,
     format->index = n;
     format->type = type;
 
-    if (v4l2_ioctl (v4l2object->video_fd, VIDIOC_ENUM_FMT, format) < 0) {
+    if (v4l2object->ioctl (v4l2object->video_fd, VIDIOC_ENUM_FMT, format) < 0) {
       if (errno == EINVAL) {
         g_free (format);
         break;                  /* end of enumeration */
@@ -1833,7 +1903,7 @@ gst_v4l2_object_add_aspect_ratio (GstV4l2Object * v4l2object, GstStructure * s)
   memset (&cropcap, 0, sizeof (cropcap));
 
   cropcap.type = v4l2object->type;
-  if (v4l2_ioctl (v4l2object->video_fd, VIDIOC_CROPCAP, &cropcap) < 0)
+  if (v4l2object->ioctl (v4l2object->video_fd, VIDIOC_CROPCAP, &cropcap) < 0)
     goto cropcap_failed;
 
   num = cropcap.pixelaspect.numerator;
@@ -2093,7 +2163,7 @@ gst_v4l2_object_try_fmt (GstV4l2Object * v4l2object,
   int r;
 
   memcpy (&fmt, try_fmt, sizeof (fmt));
-  r = v4l2_ioctl (fd, VIDIOC_TRY_FMT, &fmt);
+  r = v4l2object->ioctl (fd, VIDIOC_TRY_FMT, &fmt);
 
   if (r < 0 && errno == ENOTTY) {
     /* The driver might not implement TRY_FMT, in which case we will try
@@ -2102,7 +2172,7 @@ gst_v4l2_object_try_fmt (GstV4l2Object * v4l2object,
       goto error;
 
     memcpy (&fmt, try_fmt, sizeof (fmt));
-    r = v4l2_ioctl (fd, VIDIOC_S_FMT, &fmt);
+    r = v4l2object->ioctl (fd, VIDIOC_S_FMT, &fmt);
   }
   memcpy (try_fmt, &fmt, sizeof (fmt));
   return r;
@@ -2296,7 +2366,7 @@ gst_v4l2_object_probe_caps_for_format_and_size (GstV4l2Object * v4l2object,
 
   /* keep in mind that v4l2 gives us frame intervals (durations); we invert the
    * fraction to get framerate */
-  if (v4l2_ioctl (fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) < 0)
+  if (v4l2object->ioctl (fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) < 0)
     goto enum_frameintervals_failed;
 
   if (ival.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
@@ -2323,7 +2393,7 @@ gst_v4l2_object_probe_caps_for_format_and_size (GstV4l2Object * v4l2object,
       gst_value_list_append_value (&rates, &rate);
 
       ival.index++;
-    } while (v4l2_ioctl (fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) >= 0);
+    } while (v4l2object->ioctl (fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) >= 0);
   } else if (ival.type == V4L2_FRMIVAL_TYPE_STEPWISE) {
     GValue min = { 0, };
     GValue step = { 0, };
@@ -2558,7 +2628,7 @@ gst_v4l2_object_probe_caps_for_format (GstV4l2Object * v4l2object,
       "Enumerating frame sizes for %" GST_FOURCC_FORMAT,
       GST_FOURCC_ARGS (pixelformat));
 
-  if (v4l2_ioctl (fd, VIDIOC_ENUM_FRAMESIZES, &size) < 0)
+  if (v4l2object->ioctl (fd, VIDIOC_ENUM_FRAMESIZES, &size) < 0)
     goto enum_framesizes_failed;
 
   if (size.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
@@ -2579,7 +2649,7 @@ gst_v4l2_object_probe_caps_for_format (GstV4l2Object * v4l2object,
       }
 
       size.index++;
-    } while (v4l2_ioctl (fd, VIDIOC_ENUM_FRAMESIZES, &size) >= 0);
+    } while (v4l2object->ioctl (fd, VIDIOC_ENUM_FRAMESIZES, &size) >= 0);
     GST_DEBUG_OBJECT (v4l2object->element,
         "done iterating discrete frame sizes");
   } else if (size.type == V4L2_FRMSIZE_TYPE_STEPWISE) {
@@ -2833,6 +2903,7 @@ static gboolean
 gst_v4l2_object_setup_pool (GstV4l2Object * v4l2object, GstCaps * caps)
 {
   GstV4l2IOMode mode;
+  GstBufferPool *pool;
 
   GST_DEBUG_OBJECT (v4l2object->element, "initializing the %s system",
       V4L2_TYPE_IS_OUTPUT (v4l2object->type) ? "output" : "capture");
@@ -2851,7 +2922,9 @@ gst_v4l2_object_setup_pool (GstV4l2Object * v4l2object, GstCaps * caps)
 
   if (v4l2object->device_caps & V4L2_CAP_STREAMING) {
     if (v4l2object->req_mode == GST_V4L2_IO_AUTO)
-      mode = GST_V4L2_IO_MMAP;
+      mode = v4l2object->prefer_dmabuf_import &&
+          V4L2_TYPE_IS_OUTPUT (v4l2object->type) ?
+          GST_V4L2_IO_DMABUF_IMPORT : GST_V4L2_IO_MMAP;
   } else if (v4l2object->req_mode == GST_V4L2_IO_MMAP)
     goto method_not_supported;
 
@@ -2870,9 +2943,14 @@ gst_v4l2_object_setup_pool (GstV4l2Object * v4l2object, GstCaps * caps)
   /* Map the buffers */
   GST_LOG_OBJECT (v4l2object->element, "initiating buffer pool");
 
-  if (!(v4l2object->pool = gst_v4l2_buffer_pool_new (v4l2object, caps)))
+  if (!(pool = gst_v4l2_buffer_pool_new (v4l2object, caps)))
     goto buffer_pool_new_failed;
 
+  /* the stats can be read from any thread */
+  GST_OBJECT_LOCK (v4l2object->element);
+  v4l2object->pool = pool;
+  GST_OBJECT_UNLOCK (v4l2object->element);
+
   GST_V4L2_SET_ACTIVE (v4l2object);
 
   return TRUE;
@@ -3376,10 +3454,10 @@ gst_v4l2_object_set_format_full (GstV4l2Object * v4l2object, GstCaps * caps,
   }
 
   if (try_only) {
-    if (v4l2_ioctl (fd, VIDIOC_TRY_FMT, &format) < 0)
+    if (v4l2object->ioctl (fd, VIDIOC_TRY_FMT, &format) < 0)
       goto try_fmt_failed;
   } else {
-    if (v4l2_ioctl (fd, VIDIOC_S_FMT, &format) < 0)
+    if (v4l2object->ioctl (fd, VIDIOC_S_FMT, &format) < 0)
       goto set_fmt_failed;
   }
 
@@ -3432,7 +3510,7 @@ gst_v4l2_object_set_format_full (GstV4l2Object * v4l2object, GstCaps * caps,
     ctl.id = V4L2_CID_ALPHA_COMPONENT;
     ctl.value = 0xff;
 
-    if (v4l2_ioctl (fd, VIDIOC_S_CTRL, &ctl) < 0)
+    if (v4l2object->ioctl (fd, VIDIOC_S_CTRL, &ctl) < 0)
       GST_WARNING_OBJECT (v4l2object->element,
           "Failed to set alpha component value");
   }
@@ -3444,7 +3522,7 @@ gst_v4l2_object_set_format_full (GstV4l2Object * v4l2object, GstCaps * caps,
   memset (&streamparm, 0x00, sizeof (struct v4l2_streamparm));
   streamparm.type = v4l2object->type;
 
-  if (v4l2_ioctl (fd, VIDIOC_G_PARM, &streamparm) < 0)
+  if (v4l2object->ioctl (fd, VIDIOC_G_PARM, &streamparm) < 0)
     goto get_parm_failed;
 
   GST_VIDEO_INFO_FPS_N (&info) =
@@ -3477,7 +3555,7 @@ gst_v4l2_object_set_format_full (GstV4l2Object * v4l2object, GstCaps * caps,
     streamparm.parm.capture.timeperframe.denominator = fps_n;
 
     /* some cheap USB cam's won't accept any change */
-    if (v4l2_ioctl (fd, VIDIOC_S_PARM, &streamparm) < 0)
+    if (v4l2object->ioctl (fd, VIDIOC_S_PARM, &streamparm) < 0)
       goto set_parm_failed;
 
     if (streamparm.parm.capture.timeperframe.numerator > 0 &&
@@ -3643,7 +3721,7 @@ gst_v4l2_object_acquire_format (GstV4l2Object * v4l2object, GstVideoInfo * info)
 
   memset (&fmt, 0x00, sizeof (struct v4l2_format));
   fmt.type = v4l2object->type;
-  if (v4l2_ioctl (v4l2object->video_fd, VIDIOC_G_FMT, &fmt) < 0)
+  if (v4l2object->ioctl (v4l2object->video_fd, VIDIOC_G_FMT, &fmt) < 0)
     goto get_fmt_failed;
 
   fmtdesc = gst_v4l2_object_get_format_from_fourcc (v4l2object,
@@ -3668,13 +3746,13 @@ gst_v4l2_object_acquire_format (GstV4l2Object * v4l2object, GstVideoInfo * info)
   memset (&sel, 0, sizeof (struct v4l2_selection));
   sel.type = v4l2object->type;
   sel.target = V4L2_SEL_TGT_COMPOSE_DEFAULT;
-  if (v4l2_ioctl (v4l2object->video_fd, VIDIOC_G_SELECTION, &sel) >= 0) {
+  if (v4l2object->ioctl (v4l2object->video_fd, VIDIOC_G_SELECTION, &sel) >= 0) {
     r = &sel.r;
   } else {
     /* For ancient kernels, fall back to G_CROP */
     memset (&crop, 0, sizeof (struct v4l2_crop));
     crop.type = v4l2object->type;
-    if (v4l2_ioctl (v4l2object->video_fd, VIDIOC_G_CROP, &crop) >= 0)
+    if (v4l2object->ioctl (v4l2object->video_fd, VIDIOC_G_CROP, &crop) >= 0)
       r = &crop.c;
   }
   if (r) {
@@ -3762,12 +3840,12 @@ gst_v4l2_object_set_crop (GstV4l2Object * obj)
       "Desired cropping left %u, top %u, size %ux%u", crop.c.left, crop.c.top,
       crop.c.width, crop.c.height);
 
-  if (v4l2_ioctl (obj->video_fd, VIDIOC_S_CROP, &crop) < 0) {
+  if (obj->ioctl (obj->video_fd, VIDIOC_S_CROP, &crop) < 0) {
     GST_WARNING_OBJECT (obj->element, "VIDIOC_S_CROP failed");
     return FALSE;
   }
 
-  if (v4l2_ioctl (obj->video_fd, VIDIOC_G_CROP, &crop) < 0) {
+  if (obj->ioctl (obj->video_fd, VIDIOC_G_CROP, &crop) < 0) {
     GST_WARNING_OBJECT (obj->element, "VIDIOC_G_CROP failed");
     return FALSE;
   }
@@ -3779,6 +3857,75 @@ gst_v4l2_object_set_crop (GstV4l2Object * obj)
   return TRUE;
 }
 
+/**
+ * gst_v4l2_object_get_selection:
+ * @obj: a #GstV4l2Object
+ * @target: a V4L2_SEL_TGT_* selection target
+ * @rect: (out): the rectangle
+ *
+ * Returns: %FALSE if the driver does not implement the selection API or
+ * this target
+ */
+gboolean
+gst_v4l2_object_get_selection (GstV4l2Object * obj, guint32 target,
+    struct v4l2_rect * rect)
+{
+  struct v4l2_selection sel = { 0 };
+
+  sel.type = obj->type;
+  sel.target = target;
+
+  if (obj->ioctl (obj->video_fd, VIDIOC_G_SELECTION, &sel) < 0) {
+    GST_DEBUG_OBJECT (obj->element, "VIDIOC_G_SELECTION 0x%x failed: %s",
+        target, g_strerror (errno));
+    return FALSE;
+  }
+
+  *rect = sel.r;
+
+  return TRUE;
+}
+
+/**
+ * gst_v4l2_object_set_selection:
+ * @obj: a #GstV4l2Object
+ * @target: a V4L2_SEL_TGT_* selection target
+ * @rect: (inout): the requested rectangle
+ *
+ * Program a selection rectangle. Drivers may adjust the rectangle to their
+ * alignment constraints, @rect is updated with the one actually in use.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gst_v4l2_object_set_selection (GstV4l2Object * obj, guint32 target,
+    struct v4l2_rect * rect)
+{
+  struct v4l2_selection sel = { 0 };
+
+  sel.type = obj->type;
+  sel.target = target;
+  sel.r = *rect;
+
+  GST_DEBUG_OBJECT (obj->element,
+      "Desired selection 0x%x left %d, top %d, size %ux%u", target,
+      sel.r.left, sel.r.top, sel.r.width, sel.r.height);
+
+  if (obj->ioctl (obj->video_fd, VIDIOC_S_SELECTION, &sel) < 0) {
+    GST_WARNING_OBJECT (obj->element, "VIDIOC_S_SELECTION 0x%x failed: %s",
+        target, g_strerror (errno));
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (obj->element,
+      "Got selection 0x%x left %d, top %d, size %ux%u", target, sel.r.left,
+      sel.r.top, sel.r.width, sel.r.height);
+
+  *rect = sel.r;
+
+  return TRUE;
+}
+
 gboolean
 gst_v4l2_object_caps_equal (GstV4l2Object * v4l2object, GstCaps * caps)
 {
@@ -3828,6 +3975,8 @@ gst_v4l2_object_unlock_stop (GstV4l2Object * v4l2object)
 gboolean
 gst_v4l2_object_stop (GstV4l2Object * v4l2object)
 {
+  GstBufferPool *pool;
+
   GST_DEBUG_OBJECT (v4l2object->element, "stopping");
 
   if (!GST_V4L2_IS_OPEN (v4l2object))
@@ -3835,11 +3984,15 @@ gst_v4l2_object_stop (GstV4l2Object * v4l2object)
   if (!GST_V4L2_IS_ACTIVE (v4l2object))
     goto done;
 
-  if (v4l2object->pool) {
+  GST_OBJECT_LOCK (v4l2object->element);
+  pool = v4l2object->pool;
+  v4l2object->pool = NULL;
+  GST_OBJECT_UNLOCK (v4l2object->element);
+
+  if (pool) {
     GST_DEBUG_OBJECT (v4l2object->element, "deactivating pool");
-    gst_buffer_pool_set_active (v4l2object->pool, FALSE);
-    gst_object_unref (v4l2object->pool);
-    v4l2object->pool = NULL;
+    gst_buffer_pool_set_active (pool, FALSE);
+    gst_object_unref (pool);
   }
 
   GST_V4L2_SET_INACTIVE (v4l2object);
@@ -3848,6 +4001,86 @@ done:
   return TRUE;
 }
 
+/**
+ * gst_v4l2_object_reset_pool:
+ * @v4l2object: an active #GstV4l2Object
+ * @caps: the current caps
+ *
+ * Replace the buffer pool by a new one for the current format, picking the
+ * IO mode again. Unlike gst_v4l2_object_stop() followed by
+ * gst_v4l2_object_set_format(), the format of the device is left untouched,
+ * only the buffers are released.
+ */
+gboolean
+gst_v4l2_object_reset_pool (GstV4l2Object * v4l2object, GstCaps * caps)
+{
+  if (!gst_v4l2_object_stop (v4l2object))
+    return FALSE;
+
+  return gst_v4l2_object_setup_pool (v4l2object, caps);
+}
+
+/* Probe results of one pixelformat. The formats a caps filter cannot match
+ * are rejected using the template alone, so that their frame sizes and
+ * intervals are neither enumerated nor intersected. */
+typedef struct
+{
+  GstStructure *template;       /* NULL for unknown formats */
+  GstCaps *match;               /* the template, without sizes and rates */
+  GstCaps *caps;                /* NULL until enumerated */
+} GstV4l2ProbedFormat;
+
+static void
+gst_v4l2_probed_format_free (GstV4l2ProbedFormat * probed)
+{
+  if (probed->template)
+    gst_structure_free (probed->template);
+  gst_caps_unref (probed->match);
+  if (probed->caps)
+    gst_caps_unref (probed->caps);
+  g_slice_free (GstV4l2ProbedFormat, probed);
+}
+
+static GstV4l2ProbedFormat *
+gst_v4l2_object_get_probed_format (GstV4l2Object * v4l2object,
+    guint32 pixelformat)
+{
+  GstV4l2ProbedFormat *probed;
+  GstStructure *match;
+
+  if (v4l2object->probed_formats == NULL)
+    v4l2object->probed_formats = g_hash_table_new_full (NULL, NULL, NULL,
+        (GDestroyNotify) gst_v4l2_probed_format_free);
+
+  probed = g_hash_table_lookup (v4l2object->probed_formats,
+      GUINT_TO_POINTER (pixelformat));
+  if (probed)
+    return probed;
+
+  probed = g_slice_new0 (GstV4l2ProbedFormat);
+  probed->template = gst_v4l2_object_v4l2fourcc_to_bare_struct (pixelformat);
+
+  if (probed->template) {
+    match = gst_structure_copy (probed->template);
+
+    /* gst_v4l2_object_update_and_append() adds alpha variants of these */
+    if (pixelformat == V4L2_PIX_FMT_RGB32 ||
+        pixelformat == V4L2_PIX_FMT_BGR32)
+      gst_structure_remove_field (match, "format");
+
+    probed->match = gst_caps_new_full (match, NULL);
+  } else {
+    GST_DEBUG_OBJECT (v4l2object->element, "unknown format %u", pixelformat);
+    probed->match = gst_caps_new_empty ();
+    probed->caps = gst_caps_new_empty ();
+  }
+
+  g_hash_table_insert (v4l2object->probed_formats,
+      GUINT_TO_POINTER (pixelformat), probed);
+
+  return probed;
+}
+
 GstCaps *
 gst_v4l2_object_probe_caps (GstV4l2Object * v4l2object, GstCaps * filter)
 {
@@ -3861,25 +4094,24 @@ gst_v4l2_object_probe_caps (GstV4l2Object * v4l2object, GstCaps * filter)
 
   for (walk = formats; walk; walk = walk->next) {
     struct v4l2_fmtdesc *format;
-    GstStructure *template;
+    GstV4l2ProbedFormat *probed;
 
     format = (struct v4l2_fmtdesc *) walk->data;
 
-    template = gst_v4l2_object_v4l2fourcc_to_bare_struct (format->pixelformat);
+    probed = gst_v4l2_object_get_probed_format (v4l2object,
+        format->pixelformat);
 
-    if (template) {
-      GstCaps *tmp;
-
-      tmp = gst_v4l2_object_probe_caps_for_format (v4l2object,
-          format->pixelformat, template);
-      if (tmp)
-        gst_caps_append (ret, tmp);
+    if (filter && !gst_caps_can_intersect (filter, probed->match))
+      continue;
 
-      gst_structure_free (template);
-    } else {
-      GST_DEBUG_OBJECT (v4l2object->element, "unknown format %u",
-          format->pixelformat);
+    if (probed->caps == NULL) {
+      probed->caps = gst_v4l2_object_probe_caps_for_format (v4l2object,
+          format->pixelformat, probed->template);
+      if (probed->caps == NULL)
+        probed->caps = gst_caps_new_empty ();
     }
+
+    gst_caps_append (ret, gst_caps_copy (probed->caps));
   }
 
   if (filter) {
@@ -3898,13 +4130,12 @@ gst_v4l2_object_get_caps (GstV4l2Object * v4l2object, GstCaps * filter)
 {
   GstCaps *ret;
 
-  if (v4l2object->probed_caps == NULL)
-    v4l2object->probed_caps = gst_v4l2_object_probe_caps (v4l2object, NULL);
-
   if (filter) {
-    ret = gst_caps_intersect_full (filter, v4l2object->probed_caps,
-        GST_CAPS_INTERSECT_FIRST);
+    ret = gst_v4l2_object_probe_caps (v4l2object, filter);
   } else {
+    if (v4l2object->probed_caps == NULL)
+      v4l2object->probed_caps = gst_v4l2_object_probe_caps (v4l2object, NULL);
+
     ret = gst_caps_ref (v4l2object->probed_caps);
   }
 
@@ -3913,6 +4144,60 @@ gst_v4l2_object_get_caps (GstV4l2Object * v4l2object, GstCaps * filter)
   return ret;
 }
 
+/**
+ * gst_v4l2_object_invalidate_caps:
+ * @v4l2object: a #GstV4l2Object
+ *
+ * Drop the probed frame sizes and intervals, they will be enumerated again
+ * by the next caps probe. This is needed when the device is reopened or
+ * when the source changed, for example when a decoder parsed a new stream
+ * header.
+ */
+void
+gst_v4l2_object_invalidate_caps (GstV4l2Object * v4l2object)
+{
+  gst_caps_replace (&v4l2object->probed_caps, NULL);
+
+  if (v4l2object->probed_formats)
+    g_hash_table_remove_all (v4l2object->probed_formats);
+}
+
+/**
+ * gst_v4l2_object_get_stats:
+ * @v4l2object: a #GstV4l2Object
+ * @stats: (allow-none): a structure to add the statistics to
+ *
+ * Adds the buffer pool statistics of the queue of @v4l2object as a
+ * "capture" or "output" field of @stats.
+ *
+ * Returns: (transfer full): @stats, or a new "v4l2-stats" structure
+ */
+GstStructure *
+gst_v4l2_object_get_stats (GstV4l2Object * v4l2object, GstStructure * stats)
+{
+  GstBufferPool *pool = NULL;
+
+  if (stats == NULL)
+    stats = gst_structure_new_empty ("v4l2-stats");
+
+  GST_OBJECT_LOCK (v4l2object->element);
+  if (v4l2object->pool)
+    pool = gst_object_ref (v4l2object->pool);
+  GST_OBJECT_UNLOCK (v4l2object->element);
+
+  if (pool) {
+    GstStructure *s;
+
+    s = gst_v4l2_buffer_pool_get_stats (GST_V4L2_BUFFER_POOL (pool));
+    gst_structure_set (stats, V4L2_TYPE_IS_OUTPUT (v4l2object->type) ?
+        "output" : "capture", GST_TYPE_STRUCTURE, s, NULL);
+    gst_structure_free (s);
+    gst_object_unref (pool);
+  }
+
+  return stats;
+}
+
 gboolean
 gst_v4l2_object_decide_allocation (GstV4l2Object * obj, GstQuery * query)
 {
@@ -4206,7 +4491,9 @@ gst_v4l2_object_propose_allocation (GstV4l2Object * obj, GstQuery * query)
   if (caps == NULL)
     goto no_caps;
 
-  if ((pool = obj->pool))
+  /* the buffers of an import pool have no memory upstream could write to */
+  pool = obj->mode == GST_V4L2_IO_DMABUF_IMPORT ? NULL : obj->pool;
+  if (pool)
     gst_object_ref (pool);
 
   if (pool != NULL) {
@@ -27,6 +27,8 @@
 #include "ext/videodev2.h"
 #include "v4l2-utils.h"
 
+#include <sys/types.h>
+
 #include <gst/gst.h>
 #include <gst/base/gstpushsrc.h>
 
@@ -128,6 +130,10 @@ struct _GstV4l2Object {
   /* wanted mode */
   GstV4l2IOMode req_mode;
 
+  /* set by the element when upstream memory can be imported, so that the
+   * auto mode of an output queue picks dmabuf-import over mmap */
+  gboolean prefer_dmabuf_import;
+
   /* optional pool */
   GstBufferPool *pool;
 
@@ -145,6 +151,7 @@ struct _GstV4l2Object {
   /* lists... */
   GSList *formats;              /* list of available capture formats */
   GstCaps *probed_caps;
+  GHashTable *probed_formats;   /* per pixelformat probe results */
 
   GList *colors;
   GList *norms;
@@ -158,6 +165,9 @@ struct _GstV4l2Object {
   GstStructure *extra_controls;
   gboolean keep_aspect;
   GValue *par;
+  GstClockTime pool_trim_period;
+  gboolean latest_frame;
+  GstClockTime stats_interval;
 
   /* X-overlay */
   GstV4l2Xv *xv;
@@ -168,6 +178,17 @@ struct _GstV4l2Object {
   GstV4l2SetInOutFunction  set_in_out_func;
   GstV4l2UpdateFpsFunction update_fps_func;
 
+  /* syscalls, these are libv4l2 or plain system calls by default and are
+   * replaced by the software emulation for fake devices */
+  gint (*fd_open) (gint fd, gint v4l2_flags);
+  gint (*close) (gint fd);
+  gint (*dup) (gint fd);
+  gint (*ioctl) (gint fd, gulong request, ...);
+  gssize (*read) (gint fd, gpointer buffer, gsize n);
+  gpointer (*mmap) (gpointer start, gsize length, gint prot, gint flags,
+      gint fd, off_t offset);
+  gint (*munmap) (gpointer _start, gsize length);
+
   /* Quirks */
   /* Skips interlacing probes */
   gboolean never_interlaced;
@@ -198,7 +219,10 @@ GType gst_v4l2_object_get_type (void);
     PROP_CAPTURE_IO_MODE,     \
     PROP_EXTRA_CONTROLS,      \
     PROP_PIXEL_ASPECT_RATIO,  \
-    PROP_FORCE_ASPECT_RATIO
+    PROP_FORCE_ASPECT_RATIO,  \
+    PROP_POOL_TRIM_PERIOD,    \
+    PROP_STATS,               \
+    PROP_STATS_INTERVAL
 
 /* create/destroy */
 GstV4l2Object*  gst_v4l2_object_new       (GstElement * element,
@@ -217,6 +241,8 @@ void         gst_v4l2_object_install_properties_helper (GObjectClass * gobject_c
 
 void         gst_v4l2_object_install_m2m_properties_helper (GObjectClass * gobject_class);
 
+void         gst_v4l2_object_install_capture_properties_helper (GObjectClass * gobject_class);
+
 gboolean     gst_v4l2_object_set_property_helper       (GstV4l2Object * v4l2object,
                                                         guint prop_id,
                                                         const GValue * value,
@@ -262,17 +288,32 @@ gboolean      gst_v4l2_object_unlock      (GstV4l2Object * v4l2object);
 gboolean      gst_v4l2_object_unlock_stop (GstV4l2Object * v4l2object);
 
 gboolean      gst_v4l2_object_stop        (GstV4l2Object * v4l2object);
+gboolean      gst_v4l2_object_reset_pool  (GstV4l2Object * v4l2object,
+                                           GstCaps * caps);
 
 GstCaps *     gst_v4l2_object_probe_caps  (GstV4l2Object * v4l2object,
                                            GstCaps * filter);
 GstCaps *     gst_v4l2_object_get_caps    (GstV4l2Object * v4l2object,
                                            GstCaps * filter);
 
+void          gst_v4l2_object_invalidate_caps (GstV4l2Object * v4l2object);
+
+GstStructure * gst_v4l2_object_get_stats  (GstV4l2Object * v4l2object,
+                                           GstStructure * stats);
+
 gboolean      gst_v4l2_object_acquire_format (GstV4l2Object * v4l2object,
                                               GstVideoInfo * info);
 
 gboolean      gst_v4l2_object_set_crop    (GstV4l2Object * obj);
 
+gboolean      gst_v4l2_object_get_selection (GstV4l2Object * obj,
+                                             guint32 target,
+                                             struct v4l2_rect * rect);
+
+gboolean      gst_v4l2_object_set_selection (GstV4l2Object * obj,
+                                             guint32 target,
+                                             struct v4l2_rect * rect);
+
 gboolean      gst_v4l2_object_decide_allocation (GstV4l2Object * v4l2object,
                                                  GstQuery * query);
 
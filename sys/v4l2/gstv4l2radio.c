@@ -86,7 +86,7 @@ gst_v4l2radio_fill_channel_list (GstV4l2Radio * radio)
 
   memset (&vc, 0, sizeof (vc));
 
-  res = v4l2_ioctl (v4l2object->video_fd, VIDIOC_QUERYCAP, &vc);
+  res = v4l2object->ioctl (v4l2object->video_fd, VIDIOC_QUERYCAP, &vc);
   if (res < 0)
     goto caps_failed;
 
@@ -102,7 +102,7 @@ gst_v4l2radio_fill_channel_list (GstV4l2Radio * radio)
   memset (&vtun, 0, sizeof (vtun));
   vtun.index = 0;
 
-  res = v4l2_ioctl (v4l2object->video_fd, VIDIOC_G_TUNER, &vtun);
+  res = v4l2object->ioctl (v4l2object->video_fd, VIDIOC_G_TUNER, &vtun);
   if (res < 0)
     goto tuner_failed;
 
@@ -227,7 +227,8 @@ gst_v4l2radio_set_mute_on (GstV4l2Radio * radio, gboolean on)
 
   GST_DEBUG_OBJECT (radio, "radio fd: %d", radio->v4l2object->video_fd);
 
-  res = ioctl (radio->v4l2object->video_fd, VIDIOC_S_CTRL, &vctrl);
+  res = radio->v4l2object->ioctl (radio->v4l2object->video_fd, VIDIOC_S_CTRL,
+      &vctrl);
   GST_DEBUG_OBJECT (radio, "mute state change result: %d", res);
   if (res < 0)
     goto freq_failed;
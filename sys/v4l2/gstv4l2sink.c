@@ -255,7 +255,7 @@ gst_v4l2sink_sync_overlay_fields (GstV4l2Sink * v4l2sink)
     else
       format.type = V4L2_BUF_TYPE_VIDEO_OVERLAY;
 
-    if (v4l2_ioctl (fd, VIDIOC_G_FMT, &format) < 0) {
+    if (v4l2sink->v4l2object->ioctl (fd, VIDIOC_G_FMT, &format) < 0) {
       GST_WARNING_OBJECT (v4l2sink, "VIDIOC_G_FMT failed");
       return;
     }
@@ -275,7 +275,7 @@ gst_v4l2sink_sync_overlay_fields (GstV4l2Sink * v4l2sink)
     if (v4l2sink->overlay_fields_set & RECT_HEIGHT_SET)
       format.fmt.win.w.height = v4l2sink->overlay.height;
 
-    if (v4l2_ioctl (fd, VIDIOC_S_FMT, &format) < 0) {
+    if (v4l2sink->v4l2object->ioctl (fd, VIDIOC_S_FMT, &format) < 0) {
       GST_WARNING_OBJECT (v4l2sink, "VIDIOC_S_FMT failed");
       return;
     }
@@ -299,7 +299,7 @@ gst_v4l2sink_sync_crop_fields (GstV4l2Sink * v4l2sink)
     memset (&crop, 0x00, sizeof (struct v4l2_crop));
     crop.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
 
-    if (v4l2_ioctl (fd, VIDIOC_G_CROP, &crop) < 0) {
+    if (v4l2sink->v4l2object->ioctl (fd, VIDIOC_G_CROP, &crop) < 0) {
       GST_WARNING_OBJECT (v4l2sink, "VIDIOC_G_CROP failed");
       return;
     }
@@ -319,12 +319,12 @@ gst_v4l2sink_sync_crop_fields (GstV4l2Sink * v4l2sink)
     if (v4l2sink->crop_fields_set & RECT_HEIGHT_SET)
       crop.c.height = v4l2sink->crop.height;
 
-    if (v4l2_ioctl (fd, VIDIOC_S_CROP, &crop) < 0) {
+    if (v4l2sink->v4l2object->ioctl (fd, VIDIOC_S_CROP, &crop) < 0) {
       GST_WARNING_OBJECT (v4l2sink, "VIDIOC_S_CROP failed");
       return;
     }
 
-    if (v4l2_ioctl (fd, VIDIOC_G_CROP, &crop) < 0) {
+    if (v4l2sink->v4l2object->ioctl (fd, VIDIOC_G_CROP, &crop) < 0) {
       GST_WARNING_OBJECT (v4l2sink, "VIDIOC_G_CROP failed");
       return;
     }
@@ -458,6 +458,7 @@ gst_v4l2sink_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       if (!gst_v4l2_object_stop (v4l2sink->v4l2object))
         return GST_STATE_CHANGE_FAILURE;
+      v4l2sink->v4l2object->prefer_dmabuf_import = FALSE;
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
       /* we need to call stop here too */
@@ -508,6 +509,9 @@ gst_v4l2sink_set_caps (GstBaseSink * bsink, GstCaps * caps)
   if (gst_v4l2_object_caps_equal (obj, caps))
     return TRUE;
 
+  /* the IO mode is picked again on the first buffer */
+  obj->prefer_dmabuf_import = FALSE;
+
   if (!gst_v4l2_object_stop (obj))
     goto stop_failed;
 
@@ -574,6 +578,56 @@ gst_v4l2sink_propose_allocation (GstBaseSink * bsink, GstQuery * query)
   return TRUE;
 }
 
+/* With io-mode=auto, queue upstream dmabuf directly instead of copying it
+ * into our mmap buffers. The decision is taken on the first buffer, before
+ * our pool gets activated, and reverted if a later buffer cannot be
+ * imported. Only the pool is replaced, the format of the device stays. */
+static gboolean
+gst_v4l2sink_select_io_mode (GstV4l2Sink * v4l2sink, GstBuffer * buf)
+{
+  GstV4l2Object *obj = v4l2sink->v4l2object;
+  GstBufferPool *bpool = GST_BUFFER_POOL (obj->pool);
+  GstCaps *caps;
+  gboolean import, ret;
+
+  if (obj->req_mode != GST_V4L2_IO_AUTO || buf->pool == bpool)
+    return TRUE;
+
+  import = gst_v4l2_buffer_pool_can_import_dmabuf
+      (GST_V4L2_BUFFER_POOL_CAST (bpool), buf);
+
+  if (import == (obj->mode == GST_V4L2_IO_DMABUF_IMPORT))
+    return TRUE;
+
+  /* upstream may be using our buffers already */
+  if (import && gst_buffer_pool_is_active (bpool))
+    return TRUE;
+
+  caps = gst_pad_get_current_caps (GST_BASE_SINK_PAD (v4l2sink));
+  if (caps == NULL)
+    return TRUE;
+
+  GST_INFO_OBJECT (v4l2sink, "switching to %s upstream memory",
+      import ? "importing" : "copying");
+
+  obj->prefer_dmabuf_import = import;
+  ret = gst_v4l2_object_reset_pool (obj, caps);
+  gst_caps_unref (caps);
+
+  if (!ret)
+    goto reset_failed;
+
+  return TRUE;
+
+  /* ERRORS */
+reset_failed:
+  {
+    GST_ELEMENT_ERROR (v4l2sink, RESOURCE, SETTINGS,
+        (_("Failed to change the IO mode.")), ("failed to replace the pool"));
+    return FALSE;
+  }
+}
+
 /* called after A/V sync to render frame */
 static GstFlowReturn
 gst_v4l2sink_show_frame (GstVideoSink * vsink, GstBuffer * buf)
@@ -581,13 +635,18 @@ gst_v4l2sink_show_frame (GstVideoSink * vsink, GstBuffer * buf)
   GstFlowReturn ret;
   GstV4l2Sink *v4l2sink = GST_V4L2SINK (vsink);
   GstV4l2Object *obj = v4l2sink->v4l2object;
-  GstBufferPool *bpool = GST_BUFFER_POOL (obj->pool);
+  GstBufferPool *bpool;
 
   GST_DEBUG_OBJECT (v4l2sink, "render buffer: %p", buf);
 
   if (G_UNLIKELY (obj->pool == NULL))
     goto not_negotiated;
 
+  if (!gst_v4l2sink_select_io_mode (v4l2sink, buf))
+    return GST_FLOW_ERROR;
+
+  bpool = GST_BUFFER_POOL (obj->pool);
+
   if (G_UNLIKELY (!gst_buffer_pool_is_active (bpool))) {
     GstStructure *config;
 
@@ -63,11 +63,13 @@ GST_DEBUG_CATEGORY (v4l2src_debug);
 #define GST_CAT_DEFAULT v4l2src_debug
 
 #define DEFAULT_PROP_DEVICE   "/dev/video0"
+#define DEFAULT_PROP_LATEST_FRAME FALSE
 
 enum
 {
   PROP_0,
   V4L2_STD_OBJECT_PROPS,
+  PROP_LATEST_FRAME,
   PROP_LAST
 };
 
@@ -142,6 +144,21 @@ gst_v4l2src_class_init (GstV4l2SrcClass * klass)
 
   gst_v4l2_object_install_properties_helper (gobject_class,
       DEFAULT_PROP_DEVICE);
+  gst_v4l2_object_install_capture_properties_helper (gobject_class);
+
+  /**
+   * GstV4l2Src:latest-frame:
+   *
+   * Only push the most recent frame. When downstream is slower than the
+   * device, the frames completed meanwhile are given back to the driver
+   * instead of being pushed late. Only used with the mmap and dmabuf
+   * io-modes.
+   */
+  g_object_class_install_property (gobject_class, PROP_LATEST_FRAME,
+      g_param_spec_boolean ("latest-frame", "Latest frame",
+          "Skip to the most recent captured frame (low latency)",
+          DEFAULT_PROP_LATEST_FRAME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   /**
    * GstV4l2Src::prepare-format:
@@ -214,6 +231,25 @@ gst_v4l2src_finalize (GstV4l2Src * v4l2src)
 }
 
 
+static GstStructure *
+gst_v4l2src_get_stats (GstV4l2Src * v4l2src)
+{
+  GstStructure *s;
+
+  GST_OBJECT_LOCK (v4l2src);
+  s = gst_structure_new ("v4l2src-stats",
+      "frames", G_TYPE_UINT64, v4l2src->num_frames,
+      "latest-dropped", G_TYPE_UINT64, v4l2src->num_dropped,
+      "lost", G_TYPE_UINT64, v4l2src->num_lost,
+      "latency-last", G_TYPE_UINT64, v4l2src->latency_last,
+      "latency-average", G_TYPE_UINT64, v4l2src->num_latency ?
+      v4l2src->latency_sum / v4l2src->num_latency : 0,
+      "latency-max", G_TYPE_UINT64, v4l2src->latency_max, NULL);
+  GST_OBJECT_UNLOCK (v4l2src);
+
+  return gst_v4l2_object_get_stats (v4l2src->v4l2object, s);
+}
+
 static void
 gst_v4l2src_set_property (GObject * object,
     guint prop_id, const GValue * value, GParamSpec * pspec)
@@ -223,6 +259,9 @@ gst_v4l2src_set_property (GObject * object,
   if (!gst_v4l2_object_set_property_helper (v4l2src->v4l2object,
           prop_id, value, pspec)) {
     switch (prop_id) {
+      case PROP_LATEST_FRAME:
+        v4l2src->v4l2object->latest_frame = g_value_get_boolean (value);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -236,9 +275,18 @@ gst_v4l2src_get_property (GObject * object,
 {
   GstV4l2Src *v4l2src = GST_V4L2SRC (object);
 
+  /* extends the statistics of the helper */
+  if (prop_id == PROP_STATS) {
+    g_value_take_boxed (value, gst_v4l2src_get_stats (v4l2src));
+    return;
+  }
+
   if (!gst_v4l2_object_get_property_helper (v4l2src->v4l2object,
           prop_id, value, pspec)) {
     switch (prop_id) {
+      case PROP_LATEST_FRAME:
+        g_value_set_boolean (value, v4l2src->v4l2object->latest_frame);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -613,6 +661,17 @@ gst_v4l2src_start (GstBaseSrc * src)
   v4l2src->has_bad_timestamp = FALSE;
   v4l2src->last_timestamp = 0;
 
+  GST_OBJECT_LOCK (v4l2src);
+  v4l2src->num_frames = 0;
+  v4l2src->num_dropped = 0;
+  v4l2src->num_lost = 0;
+  v4l2src->num_dropped_seen = 0;
+  v4l2src->num_latency = 0;
+  v4l2src->latency_last = 0;
+  v4l2src->latency_max = 0;
+  v4l2src->latency_sum = 0;
+  GST_OBJECT_UNLOCK (v4l2src);
+
   return TRUE;
 }
 
@@ -691,8 +750,10 @@ gst_v4l2src_create (GstPushSrc * src, GstBuffer ** buf)
   GstFlowReturn ret;
   GstClock *clock;
   GstClockTime abs_time, base_time, timestamp, duration;
-  GstClockTime delay;
+  GstClockTime delay, latency = GST_CLOCK_TIME_NONE;
   GstMessage *qos_msg;
+  guint dropped, skipped;
+  guint64 lost = 0;
 
   do {
     ret = GST_BASE_SRC_CLASS (parent_class)->alloc (GST_BASE_SRC (src), 0,
@@ -708,6 +769,13 @@ gst_v4l2src_create (GstPushSrc * src, GstBuffer ** buf)
   if (G_UNLIKELY (ret != GST_FLOW_OK))
     goto error;
 
+  /* Frames skipped by the pool in latest-frame mode are not lost */
+  dropped = g_atomic_int_get (&pool->num_latest_dropped);
+  if (dropped < v4l2src->num_dropped_seen)
+    v4l2src->num_dropped_seen = 0;
+  skipped = dropped - v4l2src->num_dropped_seen;
+  v4l2src->num_dropped_seen = dropped;
+
   timestamp = GST_BUFFER_TIMESTAMP (*buf);
   duration = obj->duration;
 
@@ -783,6 +851,7 @@ retry:
 
     /* Save last timestamp for sanity checks */
     v4l2src->last_timestamp = timestamp;
+    latency = delay;
 
     GST_DEBUG_OBJECT (v4l2src, "ts: %" GST_TIME_FORMAT " now %" GST_TIME_FORMAT
         " delay %" GST_TIME_FORMAT, GST_TIME_ARGS (timestamp),
@@ -837,8 +906,9 @@ retry:
     GST_BUFFER_OFFSET_END (*buf) += v4l2src->renegotiation_adjust;
     /* check for frame loss with given (from v4l2 device) buffer offset */
     if ((v4l2src->offset != 0)
-        && (GST_BUFFER_OFFSET (*buf) != (v4l2src->offset + 1))) {
-      guint64 lost_frame_count = GST_BUFFER_OFFSET (*buf) - v4l2src->offset - 1;
+        && (GST_BUFFER_OFFSET (*buf) != (v4l2src->offset + skipped + 1))) {
+      guint64 lost_frame_count =
+          GST_BUFFER_OFFSET (*buf) - v4l2src->offset - skipped - 1;
       GST_WARNING_OBJECT (v4l2src,
           "lost frames detected: count = %" G_GUINT64_FORMAT " - ts: %"
           GST_TIME_FORMAT, lost_frame_count, GST_TIME_ARGS (timestamp));
@@ -849,6 +919,7 @@ retry:
           duration : GST_CLOCK_TIME_NONE);
       gst_element_post_message (GST_ELEMENT_CAST (v4l2src), qos_msg);
 
+      lost = lost_frame_count;
     }
     v4l2src->offset = GST_BUFFER_OFFSET (*buf);
   }
@@ -856,6 +927,18 @@ retry:
   GST_BUFFER_TIMESTAMP (*buf) = timestamp;
   GST_BUFFER_DURATION (*buf) = duration;
 
+  GST_OBJECT_LOCK (v4l2src);
+  v4l2src->num_frames++;
+  v4l2src->num_dropped += skipped;
+  v4l2src->num_lost += lost;
+  if (GST_CLOCK_TIME_IS_VALID (latency)) {
+    v4l2src->num_latency++;
+    v4l2src->latency_last = latency;
+    v4l2src->latency_sum += latency;
+    v4l2src->latency_max = MAX (v4l2src->latency_max, latency);
+  }
+  GST_OBJECT_UNLOCK (v4l2src);
+
   return ret;
 
   /* ERROR */
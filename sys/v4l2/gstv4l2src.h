@@ -69,6 +69,16 @@ struct _GstV4l2Src
   /* Timestamp sanity check */
   GstClockTime last_timestamp;
   gboolean has_bad_timestamp;
+
+  /* Statistics, protected by the object lock */
+  guint64 num_frames;
+  guint64 num_dropped;       /* skipped in latest-frame mode */
+  guint64 num_lost;          /* sequence gaps not caused by the above */
+  guint num_dropped_seen;    /* last num_latest_dropped of the pool */
+  guint64 num_latency;
+  GstClockTime latency_last;
+  GstClockTime latency_max;
+  GstClockTime latency_sum;
 };
 
 struct _GstV4l2SrcClass
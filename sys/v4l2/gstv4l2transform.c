@@ -34,12 +34,19 @@
 
 #include <string.h>
 #include <gst/gst-i18n-plugin.h>
+#include <gst/video/gstvideosink.h>
 
 #define DEFAULT_PROP_DEVICE "/dev/video10"
+#define DEFAULT_PROP_MAX_IN_FLIGHT 0
+#define DEFAULT_PROP_ADD_BORDERS FALSE
+#define DEFAULT_PROP_CROP 0
 
 #define V4L2_TRANSFORM_QUARK \
 	g_quark_from_static_string("gst-v4l2-transform-info")
 
+#define V4L2_BORDERS_QUARK \
+	g_quark_from_static_string("gst-v4l2-transform-borders")
+
 GST_DEBUG_CATEGORY_STATIC (gst_v4l2_transform_debug);
 #define GST_CAT_DEFAULT gst_v4l2_transform_debug
 
@@ -47,7 +54,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_v4l2_transform_debug);
 enum
 {
   PROP_0,
-  V4L2_STD_OBJECT_PROPS
+  V4L2_STD_OBJECT_PROPS,
+  PROP_MAX_IN_FLIGHT,
+  PROP_ADD_BORDERS,
+  PROP_CROP_LEFT,
+  PROP_CROP_RIGHT,
+  PROP_CROP_TOP,
+  PROP_CROP_BOTTOM
 };
 
 typedef struct
@@ -73,9 +86,42 @@ gst_v4l2_transform_set_property (GObject * object,
           pspec);
       break;
     case PROP_CAPTURE_IO_MODE:
+    case PROP_POOL_TRIM_PERIOD:
+      gst_v4l2_object_set_property_helper (self->v4l2capture, prop_id, value,
+          pspec);
+      break;
+    case PROP_STATS_INTERVAL:
+      gst_v4l2_object_set_property_helper (self->v4l2output, prop_id, value,
+          pspec);
       gst_v4l2_object_set_property_helper (self->v4l2capture, prop_id, value,
           pspec);
       break;
+    case PROP_MAX_IN_FLIGHT:
+      self->max_in_flight = g_value_get_uint (value);
+      break;
+    case PROP_ADD_BORDERS:
+      self->add_borders = g_value_get_boolean (value);
+      break;
+    case PROP_CROP_LEFT:
+      GST_OBJECT_LOCK (self);
+      self->crop_left = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CROP_RIGHT:
+      GST_OBJECT_LOCK (self);
+      self->crop_right = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CROP_TOP:
+      GST_OBJECT_LOCK (self);
+      self->crop_top = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CROP_BOTTOM:
+      GST_OBJECT_LOCK (self);
+      self->crop_bottom = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
 
       /* By default, only set on output */
     default:
@@ -99,9 +145,40 @@ gst_v4l2_transform_get_property (GObject * object,
           pspec);
       break;
     case PROP_CAPTURE_IO_MODE:
+    case PROP_POOL_TRIM_PERIOD:
       gst_v4l2_object_get_property_helper (self->v4l2capture, prop_id, value,
           pspec);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_v4l2_object_get_stats (self->v4l2capture,
+              gst_v4l2_object_get_stats (self->v4l2output, NULL)));
+      break;
+    case PROP_MAX_IN_FLIGHT:
+      g_value_set_uint (value, self->max_in_flight);
+      break;
+    case PROP_ADD_BORDERS:
+      g_value_set_boolean (value, self->add_borders);
+      break;
+    case PROP_CROP_LEFT:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->crop_left);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CROP_RIGHT:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->crop_right);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CROP_TOP:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->crop_top);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CROP_BOTTOM:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->crop_bottom);
+      GST_OBJECT_UNLOCK (self);
+      break;
 
       /* By default read from output */
     default:
@@ -176,6 +253,16 @@ gst_v4l2_transform_close (GstV4l2Transform * self)
   gst_caps_replace (&self->probed_sinkcaps, NULL);
 }
 
+static void
+gst_v4l2_transform_clear_pending (GstV4l2Transform * self)
+{
+  g_mutex_lock (&self->lock);
+  g_queue_foreach (&self->pending, (GFunc) gst_mini_object_unref, NULL);
+  g_queue_clear (&self->pending);
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
+
 static gboolean
 gst_v4l2_transform_stop (GstBaseTransform * trans)
 {
@@ -183,6 +270,13 @@ gst_v4l2_transform_stop (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (self, "Stop");
 
+  /* Wait for the capture thread to stop */
+  gst_pad_stop_task (trans->srcpad);
+  gst_v4l2_transform_clear_pending (self);
+  self->output_flow = GST_FLOW_OK;
+
+  g_assert (g_atomic_int_get (&self->processing) == FALSE);
+
   gst_v4l2_object_stop (self->v4l2output);
   gst_v4l2_object_stop (self->v4l2capture);
   gst_caps_replace (&self->incaps, NULL);
@@ -191,12 +285,185 @@ gst_v4l2_transform_stop (GstBaseTransform * trans)
   return TRUE;
 }
 
+/* Letterboxing: the compose rectangle on the capture queue keeps the
+ * display aspect ratio of the cropped input, the device leaves the borders
+ * alone so they are filled once per buffer */
+static gboolean
+gst_v4l2_transform_can_fill_borders (const GstVideoFormatInfo * finfo)
+{
+  guint i;
+
+  if (GST_VIDEO_FORMAT_INFO_IS_COMPLEX (finfo) ||
+      GST_VIDEO_FORMAT_INFO_IS_TILED (finfo))
+    return FALSE;
+
+  for (i = 0; i < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); i++) {
+    if (GST_VIDEO_FORMAT_INFO_DEPTH (finfo, i) != 8 ||
+        GST_VIDEO_FORMAT_INFO_SHIFT (finfo, i) != 0)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static guint8
+gst_v4l2_transform_black (const GstVideoFormatInfo * finfo, guint comp)
+{
+  if (comp == GST_VIDEO_COMP_A)
+    return 0xff;
+
+  if (!GST_VIDEO_FORMAT_INFO_IS_YUV (finfo))
+    return 0x00;
+
+  return comp == GST_VIDEO_COMP_Y ? 0x10 : 0x80;
+}
+
+static void
+gst_v4l2_transform_set_compose (GstV4l2Transform * self)
+{
+  GstVideoInfo *in = &self->v4l2output->info;
+  GstVideoInfo *out = &self->v4l2capture->info;
+  GstVideoRectangle src, dst, result;
+  struct v4l2_rect r;
+
+  /* The cropped input size, in output pixels */
+  src.x = src.y = 0;
+  src.w = gst_util_uint64_scale_int (self->crop.width, in->par_n * out->par_d,
+      in->par_d * out->par_n);
+  src.h = self->crop.height;
+
+  dst.x = dst.y = 0;
+  dst.w = out->width;
+  dst.h = out->height;
+
+  gst_video_sink_center_rect (src, dst, &result, TRUE);
+
+  if (result.x == self->compose.left && result.y == self->compose.top &&
+      result.w == self->compose.width && result.h == self->compose.height)
+    return;
+
+  r.left = result.x;
+  r.top = result.y;
+  r.width = result.w;
+  r.height = result.h;
+
+  if (!gst_v4l2_object_set_selection (self->v4l2capture,
+          V4L2_SEL_TGT_COMPOSE, &r)) {
+    GST_WARNING_OBJECT (self, "Device cannot compose, scaling to full frame");
+    return;
+  }
+
+  self->compose = r;
+  self->letterbox = r.width != dst.w || r.height != dst.h;
+  self->compose_cookie++;
+}
+
+static void
+gst_v4l2_transform_fill_borders (GstV4l2Transform * self, GstBuffer * buffer)
+{
+  const GstVideoFormatInfo *finfo = self->v4l2capture->info.finfo;
+  GstMiniObject *mem = GST_MINI_OBJECT (gst_buffer_peek_memory (buffer, 0));
+  GstVideoFrame frame;
+  guint i, x, y;
+
+  if (!self->letterbox)
+    return;
+
+  if (GPOINTER_TO_UINT (gst_mini_object_get_qdata (mem,
+              V4L2_BORDERS_QUARK)) == self->compose_cookie)
+    return;
+
+  if (!gst_video_frame_map (&frame, &self->v4l2capture->info, buffer,
+          GST_MAP_WRITE)) {
+    GST_WARNING_OBJECT (self, "Failed to map buffer to fill the borders");
+    return;
+  }
+
+  GST_LOG_OBJECT (self, "Filling borders of %" GST_PTR_FORMAT, buffer);
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_COMPONENTS (&frame); i++) {
+    guint8 *data = GST_VIDEO_FRAME_COMP_DATA (&frame, i);
+    gint stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, i);
+    gint pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, i);
+    guint width = GST_VIDEO_FRAME_COMP_WIDTH (&frame, i);
+    guint height = GST_VIDEO_FRAME_COMP_HEIGHT (&frame, i);
+    guint left, right, top, bottom;
+    guint8 black = gst_v4l2_transform_black (finfo, i);
+
+    left = GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, i, self->compose.left);
+    right = GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, i,
+        self->compose.left + self->compose.width);
+    top = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, i, self->compose.top);
+    bottom = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, i,
+        self->compose.top + self->compose.height);
+
+    for (y = 0; y < height; y++) {
+      guint8 *line = data + y * stride;
+
+      if (y < top || y >= bottom) {
+        for (x = 0; x < width; x++)
+          line[x * pstride] = black;
+      } else {
+        for (x = 0; x < left; x++)
+          line[x * pstride] = black;
+        for (x = right; x < width; x++)
+          line[x * pstride] = black;
+      }
+    }
+  }
+
+  gst_video_frame_unmap (&frame);
+
+  gst_mini_object_set_qdata (mem, V4L2_BORDERS_QUARK,
+      GUINT_TO_POINTER (self->compose_cookie), NULL);
+}
+
+/* The crop rectangle of the input frames, from the optional crop meta
+ * and the crop properties */
+static void
+gst_v4l2_transform_get_crop (GstV4l2Transform * self, GstVideoCropMeta * meta,
+    struct v4l2_rect *crop)
+{
+  guint left, right, top, bottom;
+
+  crop->left = self->v4l2output->align.padding_left;
+  crop->top = self->v4l2output->align.padding_top;
+  crop->width = self->v4l2output->info.width;
+  crop->height = self->v4l2output->info.height;
+
+  if (meta) {
+    crop->left += meta->x;
+    crop->top += meta->y;
+    crop->width = meta->width;
+    crop->height = meta->height;
+  }
+
+  GST_OBJECT_LOCK (self);
+  left = self->crop_left;
+  right = self->crop_right;
+  top = self->crop_top;
+  bottom = self->crop_bottom;
+  GST_OBJECT_UNLOCK (self);
+
+  if (left + right >= crop->width || top + bottom >= crop->height) {
+    GST_DEBUG_OBJECT (self, "Ignoring crop properties larger than %ux%u",
+        crop->width, crop->height);
+    return;
+  }
+
+  crop->left += left;
+  crop->top += top;
+  crop->width -= left + right;
+  crop->height -= top + bottom;
+}
+
 static gboolean
 gst_v4l2_transform_set_caps (GstBaseTransform * trans, GstCaps * incaps,
     GstCaps * outcaps)
 {
   GstV4l2Error error = GST_V4L2_ERROR_INIT;
   GstV4l2Transform *self = GST_V4L2_TRANSFORM (trans);
+  struct v4l2_rect bounds;
 
   if (self->incaps && self->outcaps) {
     if (gst_caps_is_equal (incaps, self->incaps) &&
@@ -226,6 +493,37 @@ gst_v4l2_transform_set_caps (GstBaseTransform * trans, GstCaps * incaps,
   if (!gst_v4l2_object_set_crop (self->v4l2capture))
     goto failed;
 
+  self->crop_supported = gst_v4l2_object_get_selection (self->v4l2output,
+      V4L2_SEL_TGT_CROP_BOUNDS, &bounds);
+  gst_v4l2_transform_get_crop (self, NULL, &self->crop);
+
+  /* Program the crop properties now, before streaming */
+  if (self->crop.width != self->v4l2output->info.width ||
+      self->crop.height != self->v4l2output->info.height) {
+    struct v4l2_rect r = self->crop;
+
+    if (!self->crop_supported ||
+        !gst_v4l2_object_set_selection (self->v4l2output, V4L2_SEL_TGT_CROP,
+            &r)) {
+      GST_ELEMENT_WARNING (self, RESOURCE, SETTINGS,
+          ("Device cannot crop, the crop properties are ignored"), (NULL));
+      self->crop_supported = FALSE;
+    }
+  }
+
+  self->compose.left = self->compose.top = 0;
+  self->compose.width = self->v4l2capture->info.width;
+  self->compose.height = self->v4l2capture->info.height;
+  self->letterbox = FALSE;
+
+  if (self->add_borders) {
+    if (gst_v4l2_transform_can_fill_borders (self->v4l2capture->info.finfo))
+      gst_v4l2_transform_set_compose (self);
+    else
+      GST_WARNING_OBJECT (self, "Cannot add borders to %s frames",
+          GST_VIDEO_INFO_NAME (&self->v4l2capture->info));
+  }
+
   return TRUE;
 
 incaps_failed:
@@ -348,6 +646,12 @@ gst_v4l2_transform_propose_allocation (GstBaseTransform * trans,
     ret = GST_BASE_TRANSFORM_CLASS (parent_class)->propose_allocation (trans,
         decide_query, query);
 
+  /* Let upstream crop with a meta instead of copying */
+  if (ret && decide_query && self->crop_supported &&
+      !gst_query_find_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE,
+          NULL))
+    gst_query_add_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE, NULL);
+
   return ret;
 }
 
@@ -873,22 +1177,73 @@ done:
   return othercaps;
 }
 
-static GstFlowReturn
-gst_v4l2_transform_prepare_output_buffer (GstBaseTransform * trans,
-    GstBuffer * inbuf, GstBuffer ** outbuf)
+/* Wait until every queued frame has been pushed or the capture thread
+ * stopped */
+static void
+gst_v4l2_transform_drain (GstV4l2Transform * self)
 {
-  GstV4l2Transform *self = GST_V4L2_TRANSFORM (trans);
-  GstBufferPool *pool = GST_BUFFER_POOL (self->v4l2output->pool);
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstBaseTransformClass *bclass = GST_BASE_TRANSFORM_CLASS (parent_class);
-
-  if (gst_base_transform_is_passthrough (trans)) {
-    GST_DEBUG_OBJECT (self, "Passthrough, no need to do anything");
-    *outbuf = inbuf;
-    goto beach;
+  g_mutex_lock (&self->lock);
+  while (g_atomic_int_get (&self->processing) &&
+      !g_queue_is_empty (&self->pending)) {
+    GST_DEBUG_OBJECT (self, "Draining, %u frames in flight",
+        g_queue_get_length (&self->pending));
+    g_cond_wait (&self->cond, &self->lock);
   }
+  g_mutex_unlock (&self->lock);
+}
+
+/* Follow the GstVideoCropMeta of the input frames, so that cropping and
+ * scaling happen in the same pass on the device */
+static gboolean
+gst_v4l2_transform_update_crop (GstV4l2Transform * self, GstBuffer * inbuf)
+{
+  struct v4l2_rect crop, r;
+
+  if (!self->crop_supported)
+    return TRUE;
+
+  gst_v4l2_transform_get_crop (self, gst_buffer_get_video_crop_meta (inbuf),
+      &crop);
+
+  if (crop.left == self->crop.left && crop.top == self->crop.top &&
+      crop.width == self->crop.width && crop.height == self->crop.height)
+    return TRUE;
+
+  /* The frames already queued must be converted with the previous crop */
+  gst_v4l2_transform_drain (self);
+
+  r = crop;
+  if (!gst_v4l2_object_set_selection (self->v4l2output, V4L2_SEL_TGT_CROP, &r))
+    goto crop_failed;
+
+  self->crop = crop;
+
+  if (self->add_borders &&
+      gst_v4l2_transform_can_fill_borders (self->v4l2capture->info.finfo))
+    gst_v4l2_transform_set_compose (self);
+
+  return TRUE;
+
+  /* Some drivers refuse to change the crop while streaming (EBUSY). Stop
+   * offering the crop meta, upstream will crop in software after
+   * renegotiating, this frame is converted uncropped. */
+crop_failed:
+  GST_ELEMENT_WARNING (self, RESOURCE, SETTINGS,
+      ("Device cannot change the crop rectangle while streaming"),
+      ("failed to crop %ux%u at %d,%d, cropping upstream from now on",
+          crop.width, crop.height, crop.left, crop.top));
+  self->crop_supported = FALSE;
+  gst_pad_push_event (GST_BASE_TRANSFORM_SINK_PAD (self),
+      gst_event_new_reconfigure ());
+  return TRUE;
+}
+
+/* Ensure input internal pool is active */
+static gboolean
+gst_v4l2_transform_activate_output_pool (GstV4l2Transform * self)
+{
+  GstBufferPool *pool = GST_BUFFER_POOL (self->v4l2output->pool);
 
-  /* Ensure input internal pool is active */
   if (!gst_buffer_pool_is_active (pool)) {
     GstStructure *config = gst_buffer_pool_get_config (pool);
     gint min = self->v4l2output->min_buffers == 0 ? GST_V4L2_MIN_BUFFERS :
@@ -904,6 +1259,35 @@ gst_v4l2_transform_prepare_output_buffer (GstBaseTransform * trans,
       goto activate_failed;
   }
 
+  return TRUE;
+
+activate_failed:
+  GST_ELEMENT_ERROR (self, RESOURCE, SETTINGS,
+      ("failed to activate bufferpool"), ("failed to activate bufferpool"));
+  return FALSE;
+}
+
+static GstFlowReturn
+gst_v4l2_transform_prepare_output_buffer (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer ** outbuf)
+{
+  GstV4l2Transform *self = GST_V4L2_TRANSFORM (trans);
+  GstBufferPool *pool = GST_BUFFER_POOL (self->v4l2output->pool);
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBaseTransformClass *bclass = GST_BASE_TRANSFORM_CLASS (parent_class);
+
+  if (gst_base_transform_is_passthrough (trans)) {
+    GST_DEBUG_OBJECT (self, "Passthrough, no need to do anything");
+    *outbuf = inbuf;
+    goto beach;
+  }
+
+  if (!gst_v4l2_transform_activate_output_pool (self))
+    return GST_FLOW_ERROR;
+
+  if (!gst_v4l2_transform_update_crop (self, inbuf))
+    return GST_FLOW_ERROR;
+
   GST_DEBUG_OBJECT (self, "Queue input buffer");
   ret = gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL (pool), &inbuf);
   if (G_UNLIKELY (ret != GST_FLOW_OK))
@@ -930,8 +1314,11 @@ gst_v4l2_transform_prepare_output_buffer (GstBaseTransform * trans,
   if (ret != GST_FLOW_OK) {
     gst_buffer_unref (*outbuf);
     *outbuf = NULL;
+    goto beach;
   }
 
+  gst_v4l2_transform_fill_borders (self, *outbuf);
+
   if (bclass->copy_metadata)
     if (!bclass->copy_metadata (trans, inbuf, *outbuf)) {
       /* something failed, post a warning */
@@ -961,6 +1348,250 @@ gst_v4l2_transform_transform (GstBaseTransform * trans, GstBuffer * inbuf,
   return GST_FLOW_OK;
 }
 
+/* Pipelined mode: the input buffers are queued from the streaming thread
+ * while the capture queue is serviced from a task on the source pad, like
+ * the decoder does. Only the metadata of the queued frames is kept, in
+ * queuing order, to be attached to the converted frames. */
+static void
+gst_v4l2_transform_loop (GstV4l2Transform * self)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (self);
+  GstBaseTransformClass *bclass = GST_BASE_TRANSFORM_CLASS (parent_class);
+  GstV4l2BufferPool *v4l2_pool = GST_V4L2_BUFFER_POOL (self->v4l2capture->pool);
+  GstBufferPool *pool;
+  GstBuffer *buffer = NULL, *frame;
+  GstFlowReturn ret;
+
+  do {
+    pool = gst_base_transform_get_buffer_pool (trans);
+
+    /* Pool may be NULL if we started going to READY state */
+    if (pool == NULL) {
+      ret = GST_FLOW_FLUSHING;
+      goto beach;
+    }
+
+    GST_LOG_OBJECT (self, "Dequeue output buffer");
+    ret = gst_buffer_pool_acquire_buffer (pool, &buffer, NULL);
+    g_object_unref (pool);
+
+    if (ret != GST_FLOW_OK)
+      goto beach;
+
+    ret = gst_v4l2_buffer_pool_process (v4l2_pool, &buffer);
+
+  } while (ret == GST_V4L2_FLOW_CORRUPTED_BUFFER);
+
+  if (ret != GST_FLOW_OK)
+    goto beach;
+
+  /* The frame stays pending until it is pushed, so that draining also
+   * waits for the push in progress */
+  g_mutex_lock (&self->lock);
+  frame = g_queue_peek_head (&self->pending);
+  g_mutex_unlock (&self->lock);
+
+  if (frame == NULL) {
+    GST_WARNING_OBJECT (self, "Converter is producing too many buffers");
+    gst_buffer_unref (buffer);
+    return;
+  }
+
+  gst_v4l2_transform_fill_borders (self, buffer);
+
+  if (bclass->copy_metadata)
+    if (!bclass->copy_metadata (trans, frame, buffer)) {
+      /* something failed, post a warning */
+      GST_ELEMENT_WARNING (self, STREAM, NOT_IMPLEMENTED,
+          ("could not copy metadata"), (NULL));
+    }
+
+  GST_LOG_OBJECT (self, "Pushing %" GST_PTR_FORMAT, buffer);
+  ret = gst_pad_push (trans->srcpad, buffer);
+  buffer = NULL;
+
+  g_mutex_lock (&self->lock);
+  frame = g_queue_pop_head (&self->pending);
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+  if (frame)
+    gst_buffer_unref (frame);
+
+  if (ret != GST_FLOW_OK)
+    goto beach;
+
+  return;
+
+beach:
+  GST_DEBUG_OBJECT (self, "Leaving capture thread: %s",
+      gst_flow_get_name (ret));
+
+  gst_buffer_replace (&buffer, NULL);
+  g_mutex_lock (&self->lock);
+  self->output_flow = ret;
+  g_atomic_int_set (&self->processing, FALSE);
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+  gst_v4l2_object_unlock (self->v4l2output);
+  gst_pad_pause_task (trans->srcpad);
+}
+
+static void
+gst_v4l2_transform_loop_stopped (GstV4l2Transform * self)
+{
+  /* When flushing, the capture thread may never run */
+  g_mutex_lock (&self->lock);
+  if (g_atomic_int_get (&self->processing)) {
+    GST_DEBUG_OBJECT (self, "Early stop of capture thread");
+    self->output_flow = GST_FLOW_FLUSHING;
+    g_atomic_int_set (&self->processing, FALSE);
+    g_cond_broadcast (&self->cond);
+  }
+  g_mutex_unlock (&self->lock);
+
+  GST_DEBUG_OBJECT (self, "Capture task destroyed: %s",
+      gst_flow_get_name (self->output_flow));
+}
+
+static GstFlowReturn
+gst_v4l2_transform_generate_output (GstBaseTransform * trans,
+    GstBuffer ** outbuf)
+{
+  GstV4l2Transform *self = GST_V4L2_TRANSFORM (trans);
+  GstBaseTransformClass *bclass = GST_BASE_TRANSFORM_CLASS (parent_class);
+  GstBufferPool *pool;
+  GstBuffer *inbuf, *frame;
+  GstFlowReturn ret;
+  guint max_in_flight;
+  gboolean active;
+
+  /* Once started, the capture thread owns the capture queue until it is
+   * stopped, even if the property changed meanwhile */
+  if (gst_base_transform_is_passthrough (trans) ||
+      (self->max_in_flight == 0 && !g_atomic_int_get (&self->processing)))
+    return bclass->generate_output (trans, outbuf);
+
+  max_in_flight = MAX (self->max_in_flight, 1);
+
+  *outbuf = NULL;
+  inbuf = trans->queued_buf;
+  trans->queued_buf = NULL;
+
+  if (inbuf == NULL)
+    return GST_FLOW_OK;
+
+  if (!gst_v4l2_transform_activate_output_pool (self)) {
+    ret = GST_FLOW_ERROR;
+    goto drop;
+  }
+
+  pool = gst_base_transform_get_buffer_pool (trans);
+  if (pool == NULL)
+    goto not_negotiated;
+
+  active = gst_buffer_pool_set_active (pool, TRUE);
+  g_object_unref (pool);
+
+  if (!active)
+    goto activate_failed;
+
+  if (!gst_v4l2_transform_update_crop (self, inbuf)) {
+    ret = GST_FLOW_ERROR;
+    goto drop;
+  }
+
+  g_mutex_lock (&self->lock);
+  if (g_atomic_int_get (&self->processing) == FALSE) {
+    /* It's possible that the capture thread stopped due to an error */
+    if (self->output_flow != GST_FLOW_OK &&
+        self->output_flow != GST_FLOW_FLUSHING) {
+      GST_DEBUG_OBJECT (self, "Capture thread stopped with error, leaving");
+      ret = self->output_flow;
+      g_mutex_unlock (&self->lock);
+      goto drop;
+    }
+
+    GST_DEBUG_OBJECT (self, "Starting capture thread");
+
+    self->output_flow = GST_FLOW_OK;
+    g_atomic_int_set (&self->processing, TRUE);
+    if (!gst_pad_start_task (trans->srcpad,
+            (GstTaskFunction) gst_v4l2_transform_loop, self,
+            (GDestroyNotify) gst_v4l2_transform_loop_stopped)) {
+      g_atomic_int_set (&self->processing, FALSE);
+      g_mutex_unlock (&self->lock);
+      goto start_task_failed;
+    }
+  }
+
+  /* Throttle, the capture thread signals each time a frame is pushed */
+  while (g_atomic_int_get (&self->processing) &&
+      g_queue_get_length (&self->pending) >= max_in_flight)
+    g_cond_wait (&self->cond, &self->lock);
+
+  if (g_atomic_int_get (&self->processing) == FALSE) {
+    ret = self->output_flow;
+    g_mutex_unlock (&self->lock);
+    goto drop;
+  }
+
+  frame = gst_buffer_new ();
+  if (bclass->copy_metadata)
+    if (!bclass->copy_metadata (trans, inbuf, frame)) {
+      /* something failed, post a warning */
+      GST_ELEMENT_WARNING (self, STREAM, NOT_IMPLEMENTED,
+          ("could not copy metadata"), (NULL));
+    }
+  g_queue_push_tail (&self->pending, frame);
+
+  GST_LOG_OBJECT (self, "Queue input buffer, %u frames in flight",
+      g_queue_get_length (&self->pending));
+  g_mutex_unlock (&self->lock);
+
+  ret = gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL (self->
+          v4l2output->pool), &inbuf);
+
+  if (ret != GST_FLOW_OK) {
+    g_mutex_lock (&self->lock);
+    if (g_queue_remove (&self->pending, frame))
+      gst_buffer_unref (frame);
+
+    if (ret == GST_FLOW_FLUSHING && !g_atomic_int_get (&self->processing))
+      ret = self->output_flow;
+    g_mutex_unlock (&self->lock);
+  }
+
+  gst_buffer_unref (inbuf);
+  return ret;
+
+  /* ERRORS */
+not_negotiated:
+  {
+    GST_ERROR_OBJECT (self, "not negotiated");
+    ret = GST_FLOW_NOT_NEGOTIATED;
+    goto drop;
+  }
+activate_failed:
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, SETTINGS,
+        ("failed to activate bufferpool"), ("failed to activate bufferpool"));
+    ret = GST_FLOW_ERROR;
+    goto drop;
+  }
+start_task_failed:
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+        (_("Failed to start conversion thread.")), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto drop;
+  }
+drop:
+  {
+    gst_buffer_unref (inbuf);
+    return ret;
+  }
+}
+
 static gboolean
 gst_v4l2_transform_sink_event (GstBaseTransform * trans, GstEvent * event)
 {
@@ -977,16 +1608,28 @@ gst_v4l2_transform_sink_event (GstBaseTransform * trans, GstEvent * event)
       gst_v4l2_object_unlock (self->v4l2output);
       gst_v4l2_object_unlock (self->v4l2capture);
       break;
+    case GST_EVENT_FLUSH_STOP:
+      break;
     default:
+      /* Serialized events must not overtake the frames in flight */
+      if (GST_EVENT_IS_SERIALIZED (event))
+        gst_v4l2_transform_drain (self);
       break;
   }
 
   ret = GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
 
   switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      /* The capture thread should stop now, wait for it */
+      gst_pad_stop_task (trans->srcpad);
+      gst_v4l2_transform_clear_pending (self);
+      GST_DEBUG_OBJECT (self, "flush start done");
+      break;
     case GST_EVENT_FLUSH_STOP:
       /* Buffer should be back now */
       GST_DEBUG_OBJECT (self, "flush stop");
+      self->output_flow = GST_FLOW_OK;
       gst_v4l2_object_unlock_stop (self->v4l2capture);
       gst_v4l2_object_unlock_stop (self->v4l2output);
       break;
@@ -1049,6 +1692,9 @@ gst_v4l2_transform_finalize (GObject * object)
   gst_v4l2_object_destroy (self->v4l2capture);
   gst_v4l2_object_destroy (self->v4l2output);
 
+  g_mutex_clear (&self->lock);
+  g_cond_clear (&self->cond);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -1058,6 +1704,13 @@ gst_v4l2_transform_init (GstV4l2Transform * self)
   /* V4L2 object are created in subinstance_init */
   /* enable QoS */
   gst_base_transform_set_qos_enabled (GST_BASE_TRANSFORM (self), TRUE);
+
+  self->max_in_flight = DEFAULT_PROP_MAX_IN_FLIGHT;
+  self->add_borders = DEFAULT_PROP_ADD_BORDERS;
+  self->output_flow = GST_FLOW_OK;
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+  g_queue_init (&self->pending);
 }
 
 static void
@@ -1122,6 +1775,8 @@ gst_v4l2_transform_class_init (GstV4l2TransformClass * klass)
       GST_DEBUG_FUNCPTR (gst_v4l2_transform_fixate_caps);
   base_transform_class->prepare_output_buffer =
       GST_DEBUG_FUNCPTR (gst_v4l2_transform_prepare_output_buffer);
+  base_transform_class->generate_output =
+      GST_DEBUG_FUNCPTR (gst_v4l2_transform_generate_output);
   base_transform_class->transform =
       GST_DEBUG_FUNCPTR (gst_v4l2_transform_transform);
 
@@ -1131,6 +1786,63 @@ gst_v4l2_transform_class_init (GstV4l2TransformClass * klass)
       GST_DEBUG_FUNCPTR (gst_v4l2_transform_change_state);
 
   gst_v4l2_object_install_m2m_properties_helper (gobject_class);
+
+  /**
+   * GstV4l2Transform:max-in-flight:
+   *
+   * When not 0, input frames are queued to the device without waiting for
+   * the previous ones to be converted, and the converted frames are pushed
+   * from a separate thread. This is the maximum number of frames queued but
+   * not pushed yet.
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_IN_FLIGHT,
+      g_param_spec_uint ("max-in-flight", "Max in flight",
+          "Number of frames converted concurrently (0 = one at a time)",
+          0, VIDEO_MAX_FRAME, DEFAULT_PROP_MAX_IN_FLIGHT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstV4l2Transform:add-borders:
+   *
+   * Keep the display aspect ratio of the (cropped) input by composing it
+   * in the middle of the output frame, the remaining area is filled with
+   * black.
+   */
+  g_object_class_install_property (gobject_class, PROP_ADD_BORDERS,
+      g_param_spec_boolean ("add-borders", "Add Borders",
+          "Add black borders if necessary to keep the display aspect ratio",
+          DEFAULT_PROP_ADD_BORDERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstV4l2Transform:crop-left:
+   *
+   * Pixels to crop at the left of the input frames, on top of the
+   * GstVideoCropMeta. The crop is done by the device, the output size is
+   * still the one of the negotiated caps. The same goes for
+   * #GstV4l2Transform:crop-right, #GstV4l2Transform:crop-top and
+   * #GstV4l2Transform:crop-bottom.
+   */
+  g_object_class_install_property (gobject_class, PROP_CROP_LEFT,
+      g_param_spec_uint ("crop-left", "Crop Left",
+          "Pixels to crop at the left of the input", 0, G_MAXINT,
+          DEFAULT_PROP_CROP, G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_CROP_RIGHT,
+      g_param_spec_uint ("crop-right", "Crop Right",
+          "Pixels to crop at the right of the input", 0, G_MAXINT,
+          DEFAULT_PROP_CROP, G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_CROP_TOP,
+      g_param_spec_uint ("crop-top", "Crop Top",
+          "Pixels to crop at the top of the input", 0, G_MAXINT,
+          DEFAULT_PROP_CROP, G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_CROP_BOTTOM,
+      g_param_spec_uint ("crop-bottom", "Crop Bottom",
+          "Pixels to crop at the bottom of the input", 0, G_MAXINT,
+          DEFAULT_PROP_CROP, G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -63,6 +63,30 @@ struct _GstV4l2Transform
   /* Selected caps */
   GstCaps *incaps;
   GstCaps *outcaps;
+
+  /* properties */
+  guint max_in_flight;
+  gboolean add_borders;
+  guint crop_left;
+  guint crop_right;
+  guint crop_top;
+  guint crop_bottom;
+
+  /* Selection rectangles, the crop follows the input GstVideoCropMeta and
+   * the crop properties */
+  gboolean crop_supported;
+  struct v4l2_rect crop;
+  struct v4l2_rect compose;
+  gboolean letterbox;
+  guint compose_cookie;
+
+  /* Pipelined mode, metadata of the frames queued to the device, protected
+   * by the lock */
+  GMutex lock;
+  GCond cond;
+  GQueue pending;
+  gboolean processing;
+  GstFlowReturn output_flow;
 };
 
 struct _GstV4l2TransformClass
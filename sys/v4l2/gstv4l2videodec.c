@@ -39,6 +39,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_v4l2_video_dec_debug);
 #define GST_CAT_DEFAULT gst_v4l2_video_dec_debug
 
 static gboolean gst_v4l2_video_dec_flush (GstVideoDecoder * decoder);
+static GstFlowReturn gst_v4l2_video_dec_finish (GstVideoDecoder * decoder);
+static gboolean gst_v4l2_video_dec_drain_capture (GstVideoDecoder * decoder);
 
 typedef struct
 {
@@ -69,6 +71,13 @@ gst_v4l2_video_dec_set_property (GObject * object,
           pspec);
       break;
     case PROP_CAPTURE_IO_MODE:
+    case PROP_POOL_TRIM_PERIOD:
+      gst_v4l2_object_set_property_helper (self->v4l2capture, prop_id, value,
+          pspec);
+      break;
+    case PROP_STATS_INTERVAL:
+      gst_v4l2_object_set_property_helper (self->v4l2output, prop_id, value,
+          pspec);
       gst_v4l2_object_set_property_helper (self->v4l2capture, prop_id, value,
           pspec);
       break;
@@ -95,9 +104,14 @@ gst_v4l2_video_dec_get_property (GObject * object,
           pspec);
       break;
     case PROP_CAPTURE_IO_MODE:
+    case PROP_POOL_TRIM_PERIOD:
       gst_v4l2_object_get_property_helper (self->v4l2capture, prop_id, value,
           pspec);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_v4l2_object_get_stats (self->v4l2capture,
+              gst_v4l2_object_get_stats (self->v4l2output, NULL)));
+      break;
 
       /* By default read from output */
     default:
@@ -206,6 +220,7 @@ gst_v4l2_video_dec_stop (GstVideoDecoder * decoder)
 
   GST_VIDEO_DECODER_STREAM_LOCK (decoder);
   self->output_flow = GST_FLOW_OK;
+  self->reconfigure = FALSE;
   GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
 
   /* Should have been flushed already */
@@ -240,10 +255,34 @@ gst_v4l2_video_dec_set_format (GstVideoDecoder * decoder,
       GST_DEBUG_OBJECT (self, "Compatible caps");
       goto done;
     }
+
+    /* Same codec, only the stream properties changed (e.g. a resolution
+     * switch in adaptive streaming). The output queue keeps streaming, the
+     * capture queue is drained and reconfigured with the next frame. */
+    if (GST_V4L2_IS_ACTIVE (self->v4l2capture) &&
+        gst_structure_has_name (gst_caps_get_structure (state->caps, 0),
+            gst_structure_get_name (gst_caps_get_structure (self->
+                    input_state->caps, 0)))
+        && gst_v4l2_video_dec_drain_capture (decoder)) {
+      GST_DEBUG_OBJECT (self, "Capture queue drained for caps change");
+      /* the capture task unlocked the output queue when it stopped */
+      gst_v4l2_object_unlock_stop (self->v4l2output);
+      self->output_flow = GST_FLOW_OK;
+      self->reconfigure = TRUE;
+      gst_video_codec_state_unref (self->input_state);
+      self->input_state = gst_video_codec_state_ref (state);
+      goto done;
+    }
+
     gst_video_codec_state_unref (self->input_state);
     self->input_state = NULL;
 
-    /* FIXME we probably need to do more work if pools are active */
+    /* Otherwise start over with both queues */
+    gst_v4l2_video_dec_finish (decoder);
+    gst_v4l2_object_stop (self->v4l2output);
+    gst_v4l2_object_stop (self->v4l2capture);
+    self->output_flow = GST_FLOW_OK;
+    self->reconfigure = FALSE;
   }
 
   ret = gst_v4l2_object_set_format (self->v4l2output, state->caps, &error);
@@ -288,8 +327,9 @@ gst_v4l2_video_dec_negotiate (GstVideoDecoder * decoder)
 {
   GstV4l2VideoDec *self = GST_V4L2_VIDEO_DEC (decoder);
 
-  /* We don't allow renegotiation without carefull disabling the pool */
-  if (self->v4l2capture->pool &&
+  /* We don't allow renegotiation without carefull disabling the pool, unless
+   * the capture buffers are being kept across a resolution change */
+  if (!self->reconfigure && self->v4l2capture->pool &&
       gst_buffer_pool_is_active (GST_BUFFER_POOL (self->v4l2capture->pool)))
     return TRUE;
 
@@ -309,7 +349,7 @@ gst_v4l2_decoder_cmd (GstV4l2Object * v4l2object, guint cmd, guint flags)
 
   dcmd.cmd = cmd;
   dcmd.flags = flags;
-  if (v4l2_ioctl (v4l2object->video_fd, VIDIOC_DECODER_CMD, &dcmd) < 0)
+  if (v4l2object->ioctl (v4l2object->video_fd, VIDIOC_DECODER_CMD, &dcmd) < 0)
     goto dcmd_failed;
 
   return TRUE;
@@ -378,6 +418,113 @@ done:
   return ret;
 }
 
+/* Drain the capture queue only. V4L2_DEC_CMD_STOP makes the driver return
+ * the pending frames followed by an empty last buffer, which stops the
+ * capture task, while the output queue keeps streaming. */
+static gboolean
+gst_v4l2_video_dec_drain_capture (GstVideoDecoder * decoder)
+{
+  GstV4l2VideoDec *self = GST_V4L2_VIDEO_DEC (decoder);
+  GstTask *task = decoder->srcpad->task;
+  gboolean ret = TRUE;
+
+  if (!g_atomic_int_get (&self->processing))
+    goto done;
+
+  GST_DEBUG_OBJECT (self, "Draining the capture queue");
+
+  GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
+
+  if (gst_v4l2_decoder_cmd (self->v4l2output, V4L2_DEC_CMD_STOP, 0)) {
+    GST_OBJECT_LOCK (task);
+    while (GST_TASK_STATE (task) == GST_TASK_STARTED)
+      GST_TASK_WAIT (task);
+    GST_OBJECT_UNLOCK (task);
+  } else {
+    ret = FALSE;
+  }
+
+  GST_VIDEO_DECODER_STREAM_LOCK (decoder);
+
+done:
+  return ret;
+}
+
+/* Called with the first frame after the capture queue was drained for a caps
+ * change. The capture buffers are kept when the new format fits in them,
+ * otherwise the capture queue is stopped and set up again from scratch. */
+static gboolean
+gst_v4l2_video_dec_reconfigure_capture (GstV4l2VideoDec * self)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstV4l2Object *obj = self->v4l2capture;
+  struct v4l2_format old_fmt = obj->format;
+  GstVideoCodecState *output_state;
+  GstBufferPool *pool;
+  GstVideoInfo info;
+  gboolean fits = FALSE;
+  gint min_buffers;
+  guint i;
+
+  /* Only our own buffers can be kept, a downstream pool was configured for
+   * the old caps */
+  pool = gst_video_decoder_get_buffer_pool (decoder);
+  if (pool == obj->pool && gst_v4l2_object_acquire_format (obj, &info)) {
+    fits = old_fmt.fmt.pix.pixelformat == obj->format.fmt.pix.pixelformat;
+
+    /* The new stream may need more buffers in flight, e.g. more reference
+     * frames, the pool was sized for the previous minimum */
+    if (gst_v4l2_get_attribute (obj, V4L2_CID_MIN_BUFFERS_FOR_CAPTURE,
+            &min_buffers) && min_buffers > 0 &&
+        (guint) min_buffers > obj->min_buffers) {
+      GST_DEBUG_OBJECT (self, "Driver now requires %d buffers instead of %u",
+          min_buffers, obj->min_buffers);
+      obj->min_buffers = min_buffers;
+      fits = FALSE;
+    }
+
+    if (V4L2_TYPE_IS_MULTIPLANAR (obj->type)) {
+      fits &= old_fmt.fmt.pix_mp.num_planes ==
+          obj->format.fmt.pix_mp.num_planes;
+      for (i = 0; fits && i < obj->format.fmt.pix_mp.num_planes; i++)
+        fits = obj->format.fmt.pix_mp.plane_fmt[i].sizeimage <=
+            old_fmt.fmt.pix_mp.plane_fmt[i].sizeimage;
+    } else {
+      fits &= obj->format.fmt.pix.sizeimage <= old_fmt.fmt.pix.sizeimage;
+    }
+  }
+  if (pool)
+    gst_object_unref (pool);
+
+  if (!fits) {
+    GST_DEBUG_OBJECT (self, "New format does not fit, reallocating");
+    gst_v4l2_object_stop (obj);
+    self->reconfigure = FALSE;
+    return TRUE;
+  }
+
+  GST_DEBUG_OBJECT (self, "Keeping the capture buffers for %ux%u",
+      info.width, info.height);
+
+  /* Resume the capture queue after the last buffer */
+  gst_buffer_pool_set_flushing (obj->pool, TRUE);
+  gst_buffer_pool_set_flushing (obj->pool, FALSE);
+
+  output_state = gst_video_decoder_set_output_state (decoder,
+      info.finfo->format, info.width, info.height, self->input_state);
+  output_state->info.interlace_mode = info.interlace_mode;
+  gst_video_codec_state_unref (output_state);
+
+  if (!gst_video_decoder_negotiate (decoder)) {
+    self->reconfigure = FALSE;
+    return FALSE;
+  }
+
+  self->reconfigure = FALSE;
+
+  return TRUE;
+}
+
 static GstVideoCodecFrame *
 gst_v4l2_video_dec_get_oldest_frame (GstVideoDecoder * decoder)
 {
@@ -515,6 +662,42 @@ gst_v4l2_video_remove_padding (GstCapsFeatures * features,
   return TRUE;
 }
 
+/* Queue the stream headers so that the driver can report the capture
+ * format */
+static GstFlowReturn
+gst_v4l2_video_dec_send_header (GstV4l2VideoDec * self,
+    GstVideoCodecFrame * frame, gboolean * processed)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstBuffer *codec_data;
+  GstFlowReturn ret;
+
+  GST_DEBUG_OBJECT (self, "Sending header");
+
+  codec_data = self->input_state->codec_data;
+
+  /* We are running in byte-stream mode, so we don't know the headers, but
+   * we need to send something, otherwise the decoder will refuse to
+   * intialize.
+   */
+  if (codec_data) {
+    gst_buffer_ref (codec_data);
+  } else {
+    codec_data = gst_buffer_ref (frame->input_buffer);
+    *processed = TRUE;
+  }
+
+  GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
+  ret =
+      gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL (self->
+          v4l2output->pool), &codec_data);
+  GST_VIDEO_DECODER_STREAM_LOCK (decoder);
+
+  gst_buffer_unref (codec_data);
+
+  return ret;
+}
+
 static GstFlowReturn
 gst_v4l2_video_dec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
@@ -522,7 +705,7 @@ gst_v4l2_video_dec_handle_frame (GstVideoDecoder * decoder,
   GstV4l2Error error = GST_V4L2_ERROR_INIT;
   GstV4l2VideoDec *self = GST_V4L2_VIDEO_DEC (decoder);
   GstFlowReturn ret = GST_FLOW_OK;
-  gboolean processed = FALSE;
+  gboolean processed = FALSE, header_sent = FALSE;
   GstBuffer *tmp;
 
   GST_DEBUG_OBJECT (self, "Handling frame %d", frame->system_frame_number);
@@ -538,29 +721,29 @@ gst_v4l2_video_dec_handle_frame (GstVideoDecoder * decoder,
       goto not_negotiated;
   }
 
+  if (G_UNLIKELY (self->reconfigure)) {
+    ret = gst_v4l2_video_dec_send_header (self, frame, &processed);
+    if (ret == GST_FLOW_FLUSHING)
+      goto flushing;
+    else if (ret != GST_FLOW_OK)
+      goto process_failed;
+    header_sent = TRUE;
+
+    if (!gst_v4l2_video_dec_reconfigure_capture (self)) {
+      if (GST_PAD_IS_FLUSHING (decoder->srcpad))
+        goto flushing;
+      else
+        goto not_negotiated;
+    }
+  }
+
   if (G_UNLIKELY (!GST_V4L2_IS_ACTIVE (self->v4l2capture))) {
     GstBufferPool *pool = GST_BUFFER_POOL (self->v4l2output->pool);
     GstVideoInfo info;
     GstVideoCodecState *output_state;
-    GstBuffer *codec_data;
     GstCaps *acquired_caps, *available_caps, *caps, *filter;
     GstStructure *st;
 
-    GST_DEBUG_OBJECT (self, "Sending header");
-
-    codec_data = self->input_state->codec_data;
-
-    /* We are running in byte-stream mode, so we don't know the headers, but
-     * we need to send something, otherwise the decoder will refuse to
-     * intialize.
-     */
-    if (codec_data) {
-      gst_buffer_ref (codec_data);
-    } else {
-      codec_data = gst_buffer_ref (frame->input_buffer);
-      processed = TRUE;
-    }
-
     /* Ensure input internal pool is active */
     if (!gst_buffer_pool_is_active (pool)) {
       GstStructure *config = gst_buffer_pool_get_config (pool);
@@ -575,13 +758,14 @@ gst_v4l2_video_dec_handle_frame (GstVideoDecoder * decoder,
         goto activate_failed;
     }
 
-    GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
-    ret =
-        gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL (self->
-            v4l2output->pool), &codec_data);
-    GST_VIDEO_DECODER_STREAM_LOCK (decoder);
-
-    gst_buffer_unref (codec_data);
+    /* Already sent if the capture queue could not be reconfigured */
+    if (!header_sent) {
+      ret = gst_v4l2_video_dec_send_header (self, frame, &processed);
+      if (ret == GST_FLOW_FLUSHING)
+        goto flushing;
+      else if (ret != GST_FLOW_OK)
+        goto process_failed;
+    }
 
     /* For decoders G_FMT returns coded size, G_SELECTION returns visible size
      * in the compose rectangle. gst_v4l2_object_acquire_format() checks both
@@ -595,7 +779,9 @@ gst_v4l2_video_dec_handle_frame (GstVideoDecoder * decoder,
     st = gst_caps_get_structure (acquired_caps, 0);
     gst_structure_remove_field (st, "format");
 
-    /* Probe currently available pixel formats */
+    /* Probe currently available pixel formats, the sizes the capture queue
+     * can produce depend on the stream header that was just parsed */
+    gst_v4l2_object_invalidate_caps (self->v4l2capture);
     available_caps = gst_v4l2_object_probe_caps (self->v4l2capture, NULL);
     available_caps = gst_caps_make_writable (available_caps);
 
@@ -748,6 +934,29 @@ gst_v4l2_video_dec_decide_allocation (GstVideoDecoder * decoder,
   GstClockTime latency;
   gboolean ret = FALSE;
 
+  /* The capture buffers are kept across the resolution change, keep
+   * pushing them */
+  if (self->reconfigure) {
+    GstBufferPool *pool = self->v4l2capture->pool;
+    GstStructure *config;
+    GstCaps *caps;
+    guint size, min, max;
+
+    gst_query_parse_allocation (query, &caps, NULL);
+    gst_v4l2_buffer_pool_update_caps (GST_V4L2_BUFFER_POOL (pool), caps);
+
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_get_params (config, NULL, &size, &min, &max);
+    gst_structure_free (config);
+
+    if (gst_query_get_n_allocation_pools (query) > 0)
+      gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+    else
+      gst_query_add_allocation_pool (query, pool, size, min, max);
+
+    return TRUE;
+  }
+
   if (gst_v4l2_object_decide_allocation (self->v4l2capture, query))
     ret = GST_VIDEO_DECODER_CLASS (parent_class)->decide_allocation (decoder,
         query);
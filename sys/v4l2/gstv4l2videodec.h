@@ -65,6 +65,7 @@ struct _GstV4l2VideoDec
   gboolean active;
   gboolean processing;
   GstFlowReturn output_flow;
+  gboolean reconfigure;         /* capture drained for a resolution change */
 };
 
 struct _GstV4l2VideoDecClass
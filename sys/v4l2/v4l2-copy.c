@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* Copy engine for the frames that cannot be passed downstream as is. The
+ * source is usually mmap'd V4L2 memory, which is often uncached or write
+ * combined, and the destination is not read back before being pushed. Both
+ * sides are accessed with streaming (non-temporal) loads and stores so that
+ * the copy neither pollutes the CPU caches nor reads the destination lines,
+ * except on 32-bit ARM where NEON has no such stores.
+ * The implementation is picked once at runtime from the CPU features.
+ *
+ * Large planes can be split in stripes copied by a few worker threads; set
+ * GST_V4L2_COPY_THREADS to the number of threads to use (default: 1).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "v4l2-copy.h"
+
+#if (defined (__x86_64__) || defined (__i386__)) && \
+    (defined (__clang__) || __GNUC__ > 4 || \
+    (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define V4L2_COPY_X86
+#include <immintrin.h>
+#elif defined (__aarch64__) || defined (__ARM_NEON)
+#define V4L2_COPY_NEON
+#include <arm_neon.h>
+#endif
+
+GST_DEBUG_CATEGORY_EXTERN (v4l2_debug);
+#define GST_CAT_DEFAULT v4l2_debug
+
+/* rows shorter than this are not worth the alignment prologue */
+#define SMALL_ROW 256
+
+/* smallest amount of bytes given to a worker thread */
+#define STRIPE_MIN (512 * 1024)
+
+#define MAX_THREADS 8
+
+typedef void (*CopyPlaneFunc) (guint8 * dest, gint dest_stride,
+    const guint8 * src, gint src_stride, gsize width, guint height);
+
+typedef struct
+{
+  CopyPlaneFunc func;
+  const gchar *name;
+  guint n_threads;
+  GThreadPool *pool;
+} GstV4l2Copy;
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  guint pending;
+} CopyJob;
+
+typedef struct
+{
+  CopyJob *job;
+  guint8 *dest;
+  gint dest_stride;
+  const guint8 *src;
+  gint src_stride;
+  gsize width;
+  guint height;
+} CopyStripe;
+
+static void
+copy_plane_c (guint8 * dest, gint dest_stride, const guint8 * src,
+    gint src_stride, gsize width, guint height)
+{
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    memcpy (dest, src, width);
+    dest += dest_stride;
+    src += src_stride;
+  }
+}
+
+#ifdef V4L2_COPY_X86
+__attribute__ ((target ("sse4.1")))
+static void
+copy_plane_sse41 (guint8 * dest, gint dest_stride, const guint8 * src,
+    gint src_stride, gsize width, guint height)
+{
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    guint8 *d = dest + (gssize) i * dest_stride;
+    const guint8 *s = src + (gssize) i * src_stride;
+    gsize n = width;
+
+    if (n >= SMALL_ROW) {
+      gsize head = (16 - ((guintptr) d & 15)) & 15;
+
+      memcpy (d, s, head);
+      d += head;
+      s += head;
+      n -= head;
+
+      if (((guintptr) s & 15) == 0) {
+        for (; n >= 64; n -= 64, s += 64, d += 64) {
+          __m128i a = _mm_stream_load_si128 ((__m128i *) s);
+          __m128i b = _mm_stream_load_si128 ((__m128i *) (s + 16));
+          __m128i c = _mm_stream_load_si128 ((__m128i *) (s + 32));
+          __m128i e = _mm_stream_load_si128 ((__m128i *) (s + 48));
+
+          _mm_stream_si128 ((__m128i *) d, a);
+          _mm_stream_si128 ((__m128i *) (d + 16), b);
+          _mm_stream_si128 ((__m128i *) (d + 32), c);
+          _mm_stream_si128 ((__m128i *) (d + 48), e);
+        }
+      } else {
+        for (; n >= 64; n -= 64, s += 64, d += 64) {
+          __m128i a = _mm_loadu_si128 ((const __m128i *) s);
+          __m128i b = _mm_loadu_si128 ((const __m128i *) (s + 16));
+          __m128i c = _mm_loadu_si128 ((const __m128i *) (s + 32));
+          __m128i e = _mm_loadu_si128 ((const __m128i *) (s + 48));
+
+          _mm_stream_si128 ((__m128i *) d, a);
+          _mm_stream_si128 ((__m128i *) (d + 16), b);
+          _mm_stream_si128 ((__m128i *) (d + 32), c);
+          _mm_stream_si128 ((__m128i *) (d + 48), e);
+        }
+      }
+    }
+
+    memcpy (d, s, n);
+  }
+
+  /* order the streaming stores before the buffer is handed over */
+  _mm_sfence ();
+}
+
+__attribute__ ((target ("avx2")))
+static void
+copy_plane_avx2 (guint8 * dest, gint dest_stride, const guint8 * src,
+    gint src_stride, gsize width, guint height)
+{
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    guint8 *d = dest + (gssize) i * dest_stride;
+    const guint8 *s = src + (gssize) i * src_stride;
+    gsize n = width;
+
+    if (n >= SMALL_ROW) {
+      gsize head = (32 - ((guintptr) d & 31)) & 31;
+
+      memcpy (d, s, head);
+      d += head;
+      s += head;
+      n -= head;
+
+      if (((guintptr) s & 31) == 0) {
+        for (; n >= 128; n -= 128, s += 128, d += 128) {
+          __m256i a = _mm256_stream_load_si256 ((__m256i *) s);
+          __m256i b = _mm256_stream_load_si256 ((__m256i *) (s + 32));
+          __m256i c = _mm256_stream_load_si256 ((__m256i *) (s + 64));
+          __m256i e = _mm256_stream_load_si256 ((__m256i *) (s + 96));
+
+          _mm256_stream_si256 ((__m256i *) d, a);
+          _mm256_stream_si256 ((__m256i *) (d + 32), b);
+          _mm256_stream_si256 ((__m256i *) (d + 64), c);
+          _mm256_stream_si256 ((__m256i *) (d + 96), e);
+        }
+      } else {
+        for (; n >= 128; n -= 128, s += 128, d += 128) {
+          __m256i a = _mm256_loadu_si256 ((const __m256i *) s);
+          __m256i b = _mm256_loadu_si256 ((const __m256i *) (s + 32));
+          __m256i c = _mm256_loadu_si256 ((const __m256i *) (s + 64));
+          __m256i e = _mm256_loadu_si256 ((const __m256i *) (s + 96));
+
+          _mm256_stream_si256 ((__m256i *) d, a);
+          _mm256_stream_si256 ((__m256i *) (d + 32), b);
+          _mm256_stream_si256 ((__m256i *) (d + 64), c);
+          _mm256_stream_si256 ((__m256i *) (d + 96), e);
+        }
+      }
+    }
+
+    memcpy (d, s, n);
+  }
+
+  _mm_sfence ();
+}
+#endif /* V4L2_COPY_X86 */
+
+#ifdef V4L2_COPY_NEON
+static void
+copy_plane_neon (guint8 * dest, gint dest_stride, const guint8 * src,
+    gint src_stride, gsize width, guint height)
+{
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    guint8 *d = dest + (gssize) i * dest_stride;
+    const guint8 *s = src + (gssize) i * src_stride;
+    gsize n = width;
+
+    if (n >= SMALL_ROW) {
+      for (; n >= 64; n -= 64, s += 64, d += 64) {
+#ifdef __aarch64__
+        /* non-temporal pair loads and stores */
+        __asm__ volatile ("ldnp q0, q1, [%1]\n\t"
+            "ldnp q2, q3, [%1, #32]\n\t"
+            "stnp q0, q1, [%0]\n\t"
+            "stnp q2, q3, [%0, #32]\n\t"
+            ::"r" (d), "r" (s)
+            :"v0", "v1", "v2", "v3", "memory");
+#else
+        /* 32-bit ARM has no non-temporal stores, plain vector copy */
+        uint8x16_t a = vld1q_u8 (s);
+        uint8x16_t b = vld1q_u8 (s + 16);
+        uint8x16_t c = vld1q_u8 (s + 32);
+        uint8x16_t e = vld1q_u8 (s + 48);
+
+        __builtin_prefetch (s + 256);
+        vst1q_u8 (d, a);
+        vst1q_u8 (d + 16, b);
+        vst1q_u8 (d + 32, c);
+        vst1q_u8 (d + 48, e);
+#endif
+      }
+    }
+
+    memcpy (d, s, n);
+  }
+}
+#endif /* V4L2_COPY_NEON */
+
+static void
+copy_stripe (CopyStripe * stripe, const GstV4l2Copy * copy)
+{
+  CopyJob *job = stripe->job;
+
+  copy->func (stripe->dest, stripe->dest_stride, stripe->src,
+      stripe->src_stride, stripe->width, stripe->height);
+
+  g_mutex_lock (&job->lock);
+  if (--job->pending == 0)
+    g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+}
+
+static gpointer
+gst_v4l2_copy_init (gpointer data)
+{
+  static GstV4l2Copy copy = { copy_plane_c, "c", 1, NULL };
+  const gchar *env;
+
+#ifdef V4L2_COPY_X86
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2")) {
+    copy.func = copy_plane_avx2;
+    copy.name = "avx2";
+  } else if (__builtin_cpu_supports ("sse4.1")) {
+    copy.func = copy_plane_sse41;
+    copy.name = "sse4.1";
+  }
+#endif
+#ifdef V4L2_COPY_NEON
+  copy.func = copy_plane_neon;
+  copy.name = "neon";
+#endif
+
+  env = g_getenv (GST_V4L2_COPY_THREADS_ENV);
+  if (env)
+    copy.n_threads = CLAMP (atoi (env), 1, MAX_THREADS);
+
+  /* the calling thread copies one of the stripes */
+  if (copy.n_threads > 1)
+    copy.pool = g_thread_pool_new ((GFunc) copy_stripe, &copy,
+        copy.n_threads - 1, FALSE, NULL);
+
+  if (copy.pool == NULL)
+    copy.n_threads = 1;
+
+  GST_INFO ("using %s frame copy with %u threads", copy.name,
+      copy.n_threads);
+
+  return &copy;
+}
+
+/**
+ * gst_v4l2_copy_plane:
+ * @dest: the destination
+ * @dest_stride: the stride of @dest
+ * @src: the source
+ * @src_stride: the stride of @src
+ * @width: the number of bytes to copy per row
+ * @height: the number of rows
+ *
+ * Copy a plane without polluting the caches, converting the stride.
+ */
+void
+gst_v4l2_copy_plane (guint8 * dest, gint dest_stride, const guint8 * src,
+    gint src_stride, gsize width, guint height)
+{
+  static GOnce once = G_ONCE_INIT;
+  const GstV4l2Copy *copy = g_once (&once, gst_v4l2_copy_init, NULL);
+  CopyStripe stripes[MAX_THREADS];
+  CopyJob job;
+  guint i, n_stripes = 1, rows;
+
+  if (copy->pool)
+    n_stripes = CLAMP (width * height / STRIPE_MIN, 1,
+        MIN (copy->n_threads, height));
+
+  if (n_stripes == 1) {
+    /* a contiguous plane is a single row */
+    if ((gsize) dest_stride == width && (gsize) src_stride == width) {
+      width *= height;
+      height = 1;
+    }
+
+    copy->func (dest, dest_stride, src, src_stride, width, height);
+    return;
+  }
+
+  g_mutex_init (&job.lock);
+  g_cond_init (&job.cond);
+  job.pending = n_stripes;
+
+  rows = height / n_stripes;
+  for (i = 0; i < n_stripes; i++) {
+    stripes[i].job = &job;
+    stripes[i].dest = dest + (gssize) i * rows * dest_stride;
+    stripes[i].dest_stride = dest_stride;
+    stripes[i].src = src + (gssize) i * rows * src_stride;
+    stripes[i].src_stride = src_stride;
+    stripes[i].width = width;
+    stripes[i].height = i == n_stripes - 1 ? height - i * rows : rows;
+
+    if (i > 0)
+      g_thread_pool_push (copy->pool, &stripes[i], NULL);
+  }
+
+  copy_stripe (&stripes[0], copy);
+
+  g_mutex_lock (&job.lock);
+  while (job.pending)
+    g_cond_wait (&job.cond, &job.lock);
+  g_mutex_unlock (&job.lock);
+
+  g_cond_clear (&job.cond);
+  g_mutex_clear (&job.lock);
+}
+
+/**
+ * gst_v4l2_copy_frame:
+ * @dest: the destination frame
+ * @src: the source frame, in the same format
+ *
+ * Copy the planes of @src into @dest with gst_v4l2_copy_plane().
+ *
+ * Returns: %FALSE if the format is tiled or has a palette, in which case
+ * nothing was copied and gst_video_frame_copy() should be used
+ */
+gboolean
+gst_v4l2_copy_frame (GstVideoFrame * dest, const GstVideoFrame * src)
+{
+  const GstVideoFormatInfo *finfo = dest->info.finfo;
+  guint width, height, plane, comp;
+
+  g_return_val_if_fail (finfo->format == src->info.finfo->format, FALSE);
+
+  if (GST_VIDEO_FORMAT_INFO_IS_TILED (finfo) ||
+      GST_VIDEO_FORMAT_INFO_HAS_PALETTE (finfo))
+    return FALSE;
+
+  width = MIN (GST_VIDEO_INFO_WIDTH (&dest->info),
+      GST_VIDEO_INFO_WIDTH (&src->info));
+  height = MIN (GST_VIDEO_INFO_HEIGHT (&dest->info),
+      GST_VIDEO_INFO_HEIGHT (&src->info));
+
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (dest); plane++) {
+    gint dest_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, plane);
+    gint src_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, plane);
+    gsize w;
+    guint h;
+
+    /* the first component stored in this plane gives its size */
+    for (comp = 0; comp < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); comp++)
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, comp) == plane)
+        break;
+
+    w = GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, comp, width) *
+        GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, comp);
+    h = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, comp, height);
+
+    /* complex packed formats like v210 have no pixel stride */
+    if (w == 0)
+      w = MIN (dest_stride, src_stride);
+
+    gst_v4l2_copy_plane (GST_VIDEO_FRAME_PLANE_DATA (dest, plane),
+        dest_stride, GST_VIDEO_FRAME_PLANE_DATA (src, plane), src_stride,
+        w, h);
+  }
+
+  return TRUE;
+}
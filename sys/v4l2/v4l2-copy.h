@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __V4L2_COPY_H__
+#define __V4L2_COPY_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+#define GST_V4L2_COPY_THREADS_ENV "GST_V4L2_COPY_THREADS"
+
+void     gst_v4l2_copy_plane (guint8 * dest, gint dest_stride,
+                              const guint8 * src, gint src_stride,
+                              gsize width, guint height);
+
+gboolean gst_v4l2_copy_frame (GstVideoFrame * dest,
+                              const GstVideoFrame * src);
+
+G_END_DECLS
+
+#endif /* __V4L2_COPY_H__ */
@@ -0,0 +1,1649 @@
+/*
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* Software emulation of V4L2 capture, output and memory-to-memory devices.
+ *
+ * A fake device is selected by setting the device property to a string of
+ * the form "fake:<kind>[,<option>=<value>...]" where kind is one of
+ * "capture", "output", "convert" (raw to raw M2M), "decoder" (H.264 to
+ * NV12 M2M) or "encoder" (NV12/YUYV to H.264 M2M). The supported options
+ * are:
+ *
+ *   latency:  time in microseconds between queuing a buffer and the
+ *             device completing it (default 0)
+ *   width:    default width (default 640)
+ *   height:   default height (default 480)
+ *   align:    bytesperline alignment of raw formats (default 1)
+ *   crop:     selection API on the output queue of "convert" devices, 0
+ *             for none, 1 to accept a new crop rectangle at any time, 2
+ *             to refuse it with EBUSY while streaming (default 0)
+ *
+ * The MMAP, USERPTR and DMABUF memory types are supported. MMAP buffers are
+ * backed by memfd which can also be exported through VIDIOC_EXPBUF. The
+ * device never touches the buffer content, so only the buffer passing cost
+ * of the element is measured. When the streaming is stopped, an element
+ * message named "v4l2-fake-stats" is posted with the number of frames and
+ * the qbuf to dqbuf latency percentiles of that queue.
+ *
+ * The encoder honours the bitrate, GOP size and force key frame controls
+ * through the size and the KEYFRAME/PFRAME flags of the produced buffers.
+ *
+ * The decoder ignores its input, except for buffers starting with the
+ * "FAKESEQ" string and its NUL terminator, followed by the width, the
+ * height and the number of reference frames as native 32-bit integers.
+ * Such a buffer changes the capture format and the minimum number of
+ * capture buffers (4 by default) when it is processed, like a new
+ * sequence header would.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE            /* F_DUPFD_CLOEXEC */
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "ext/videodev2.h"
+#include "v4l2-fake.h"
+
+GST_DEBUG_CATEGORY_EXTERN (v4l2_debug);
+#define GST_CAT_DEFAULT v4l2_debug
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#define FAKE_MIN_SIZE 16
+#define FAKE_MAX_SIZE 4096
+#define FAKE_MAX_LATENCIES (1 << 20)
+#define FAKE_DEFAULT_BITRATE 2000000
+#define FAKE_DEFAULT_GOP_SIZE 30
+#define FAKE_DEFAULT_REFS 4
+#define FAKE_SEQ_MAGIC "FAKESEQ"
+
+/* Not in our copy of the kernel headers yet */
+#ifndef V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME
+#define V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME (V4L2_CID_MPEG_BASE+229)
+#endif
+
+/* The mmap offset is only a cookie for the fake mmap() */
+#define FAKE_MMAP_OFFSET(q,i) ((((q) * VIDEO_MAX_FRAME) + (i)) << 12)
+#define FAKE_MMAP_QUEUE(o) (((o) >> 12) / VIDEO_MAX_FRAME)
+#define FAKE_MMAP_INDEX(o) (((o) >> 12) % VIDEO_MAX_FRAME)
+
+#define IS_QUEUED(buf) ((buf)->vbuf.flags & \
+    (V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE))
+
+typedef enum
+{
+  GST_V4L2_FAKE_CAPTURE,
+  GST_V4L2_FAKE_OUTPUT,
+  GST_V4L2_FAKE_CONVERT,
+  GST_V4L2_FAKE_DECODER,
+  GST_V4L2_FAKE_ENCODER,
+} GstV4l2FakeKind;
+
+typedef struct _GstV4l2FakeBuffer GstV4l2FakeBuffer;
+typedef struct _GstV4l2FakeQueue GstV4l2FakeQueue;
+typedef struct _GstV4l2FakeDevice GstV4l2FakeDevice;
+
+struct _GstV4l2FakeBuffer
+{
+  struct v4l2_buffer vbuf;
+  gint memfd;
+  gint64 qbuf_time;
+  gint64 deadline;
+};
+
+struct _GstV4l2FakeQueue
+{
+  guint id;
+  gboolean enabled;
+  enum v4l2_buf_type type;
+  const guint32 *formats;
+  guint n_formats;
+
+  struct v4l2_format format;
+  struct v4l2_fract timeperframe;
+  struct v4l2_rect crop;
+
+  GstV4l2FakeBuffer buffers[VIDEO_MAX_FRAME];
+  guint32 count;
+  guint32 memory;
+
+  gboolean streaming;
+  gboolean last;
+
+  /* queued by userspace, not yet processed by the device */
+  GQueue pending;
+  /* processed, waiting for VIDIOC_DQBUF */
+  GQueue done;
+
+  guint32 sequence;
+  GArray *latencies;
+};
+
+struct _GstV4l2FakeDevice
+{
+  gint refcount;
+
+  gchar *device;
+  GstV4l2FakeKind kind;
+  gint64 latency;
+  guint width;
+  guint height;
+  guint align;
+  guint crop;
+
+  /* the element posting the statistics, the device can outlive it through
+   * the file descriptors duplicated by the allocators */
+  GWeakRef element;
+
+  /* private duplicate of the eventfd used to wakeup poll() */
+  gint signal_fd;
+  gboolean signaled;
+
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  gboolean running;
+  gboolean draining;
+  /* a decoder stays stopped after its last buffer until the capture queue
+   * is restarted */
+  gboolean stopped;
+
+  /* encoder controls and state */
+  gint bitrate;
+  gint gop_size;
+  gboolean force_key_frame;
+  guint frame_num;
+
+  /* decoder state */
+  gint refs;
+
+  GstV4l2FakeQueue capture;
+  GstV4l2FakeQueue output;
+};
+
+static const guint32 raw_formats[] = {
+  V4L2_PIX_FMT_NV12,
+  V4L2_PIX_FMT_YUYV,
+};
+
+static const guint32 coded_formats[] = {
+  V4L2_PIX_FMT_H264,
+};
+
+G_LOCK_DEFINE_STATIC (fake_devices);
+static GHashTable *fake_devices = NULL;
+
+static gint
+fake_memfd_new (gsize size)
+{
+  gint fd = -1;
+
+#ifdef __NR_memfd_create
+  fd = syscall (__NR_memfd_create, "v4l2-fake", MFD_CLOEXEC);
+#endif
+
+  if (fd < 0) {
+    gchar *path = NULL;
+
+    fd = g_file_open_tmp ("v4l2-fake-XXXXXX", &path, NULL);
+    if (fd < 0)
+      return -1;
+
+    unlink (path);
+    g_free (path);
+  }
+
+  if (ftruncate (fd, size) < 0) {
+    close (fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static gint64
+fake_parse_int (const gchar * value, gint64 min, gint64 max, gint64 def)
+{
+  gchar *end = NULL;
+  gint64 v;
+
+  v = g_ascii_strtoll (value, &end, 10);
+  if (end == value || *end != '\0' || v < min || v > max) {
+    GST_WARNING ("invalid fake device option value '%s'", value);
+    return def;
+  }
+
+  return v;
+}
+
+static gint
+fake_compare_latency (gconstpointer a, gconstpointer b)
+{
+  gint64 la = *(const gint64 *) a;
+  gint64 lb = *(const gint64 *) b;
+
+  return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+static void
+fake_queue_init (GstV4l2FakeQueue * q, guint id, enum v4l2_buf_type type,
+    const guint32 * formats, guint n_formats)
+{
+  q->id = id;
+  q->enabled = (formats != NULL);
+  q->type = type;
+  q->formats = formats;
+  q->n_formats = n_formats;
+  q->timeperframe.numerator = 1;
+  q->timeperframe.denominator = 30;
+  g_queue_init (&q->pending);
+  g_queue_init (&q->done);
+  q->latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+}
+
+static void
+fake_queue_free_buffers (GstV4l2FakeQueue * q)
+{
+  guint i;
+
+  for (i = 0; i < q->count; i++) {
+    if (q->buffers[i].memfd >= 0)
+      close (q->buffers[i].memfd);
+    q->buffers[i].memfd = -1;
+  }
+
+  q->count = 0;
+}
+
+static void
+fake_queue_clear (GstV4l2FakeQueue * q)
+{
+  fake_queue_free_buffers (q);
+  g_queue_clear (&q->pending);
+  g_queue_clear (&q->done);
+  g_array_free (q->latencies, TRUE);
+}
+
+static GstV4l2FakeQueue *
+fake_device_get_queue (GstV4l2FakeDevice * dev, guint32 type)
+{
+  if (type == dev->capture.type && dev->capture.enabled)
+    return &dev->capture;
+
+  if (type == dev->output.type && dev->output.enabled)
+    return &dev->output;
+
+  return NULL;
+}
+
+static gboolean
+fake_queue_has_format (GstV4l2FakeQueue * q, guint32 pixelformat)
+{
+  guint i;
+
+  if (!q->enabled)
+    return FALSE;
+
+  for (i = 0; i < q->n_formats; i++)
+    if (q->formats[i] == pixelformat)
+      return TRUE;
+
+  return FALSE;
+}
+
+static void
+fake_device_fill_format (GstV4l2FakeDevice * dev, GstV4l2FakeQueue * q,
+    struct v4l2_format *fmt)
+{
+  struct v4l2_pix_format *pix = &fmt->fmt.pix;
+  guint32 bpl = 0, size;
+  guint32 width, height;
+
+  if (!fake_queue_has_format (q, pix->pixelformat))
+    pix->pixelformat = q->formats[0];
+
+  width = pix->width ? pix->width : dev->width;
+  height = pix->height ? pix->height : dev->height;
+  width = GST_ROUND_UP_2 (CLAMP (width, FAKE_MIN_SIZE, FAKE_MAX_SIZE));
+  height = GST_ROUND_UP_2 (CLAMP (height, FAKE_MIN_SIZE, FAKE_MAX_SIZE));
+
+  switch (pix->pixelformat) {
+    case V4L2_PIX_FMT_NV12:
+      bpl = (width + dev->align - 1) / dev->align * dev->align;
+      bpl = MAX (bpl, pix->bytesperline);
+      size = bpl * height * 3 / 2;
+      break;
+    case V4L2_PIX_FMT_YUYV:
+      bpl = (width * 2 + dev->align - 1) / dev->align * dev->align;
+      bpl = MAX (bpl, pix->bytesperline);
+      size = bpl * height;
+      break;
+    default:
+      /* worst case for coded data */
+      size = MAX (pix->sizeimage, width * height * 3 / 4);
+      break;
+  }
+
+  fmt->type = q->type;
+  pix->width = width;
+  pix->height = height;
+  pix->bytesperline = bpl;
+  pix->sizeimage = size;
+  pix->field = V4L2_FIELD_NONE;
+  if (pix->colorspace == 0)
+    pix->colorspace = V4L2_COLORSPACE_REC709;
+}
+
+/* Called with the device lock, makes the eventfd readable if there is
+ * something to dequeue from the capture queue */
+static void
+fake_device_update_poll (GstV4l2FakeDevice * dev)
+{
+  GstV4l2FakeQueue *q = &dev->capture;
+  gboolean readable;
+  guint64 v = 1;
+
+  readable = q->enabled && q->streaming &&
+      (!g_queue_is_empty (&q->done) || q->last);
+
+  if (readable && !dev->signaled) {
+    if (write (dev->signal_fd, &v, sizeof (v)) == sizeof (v))
+      dev->signaled = TRUE;
+  } else if (!readable && dev->signaled) {
+    if (read (dev->signal_fd, &v, sizeof (v)) == sizeof (v))
+      dev->signaled = FALSE;
+  }
+}
+
+static void
+fake_buffer_set_timestamp (GstV4l2FakeBuffer * buf, gint64 time)
+{
+  buf->vbuf.timestamp.tv_sec = time / G_USEC_PER_SEC;
+  buf->vbuf.timestamp.tv_usec = time % G_USEC_PER_SEC;
+}
+
+static void
+fake_buffer_done (GstV4l2FakeQueue * q, GstV4l2FakeBuffer * buf)
+{
+  buf->vbuf.flags &= ~V4L2_BUF_FLAG_QUEUED;
+  buf->vbuf.flags |= V4L2_BUF_FLAG_DONE;
+  buf->vbuf.sequence = q->sequence++;
+  g_queue_push_tail (&q->done, buf);
+}
+
+/* Called with the device lock, sizes the coded frame from the bitrate and
+ * flags key frames according to the GOP size */
+static void
+fake_device_encode (GstV4l2FakeDevice * dev, GstV4l2FakeBuffer * cbuf)
+{
+  GstV4l2FakeQueue *in = &dev->output;
+  guint64 size;
+  gboolean key;
+
+  size = gst_util_uint64_scale (dev->bitrate / 8,
+      in->timeperframe.numerator, in->timeperframe.denominator);
+
+  key = dev->force_key_frame || dev->frame_num % dev->gop_size == 0;
+  if (key) {
+    /* key frames are roughly 4 times bigger */
+    size *= 4;
+    dev->frame_num = 0;
+    dev->force_key_frame = FALSE;
+  }
+  dev->frame_num++;
+
+  cbuf->vbuf.bytesused = CLAMP (size, 1, cbuf->vbuf.length);
+  cbuf->vbuf.flags &= ~(V4L2_BUF_FLAG_KEYFRAME | V4L2_BUF_FLAG_PFRAME);
+  cbuf->vbuf.flags |= key ? V4L2_BUF_FLAG_KEYFRAME : V4L2_BUF_FLAG_PFRAME;
+}
+
+/* Apply the sequence header at the start of a decoder input buffer, if
+ * any */
+static void
+fake_device_parse_header (GstV4l2FakeDevice * dev, GstV4l2FakeBuffer * buf)
+{
+  struct v4l2_format *fmt = &dev->capture.format;
+  guint8 data[sizeof (FAKE_SEQ_MAGIC) + 3 * sizeof (guint32)];
+  guint32 header[3];
+  gssize len = -1;
+
+  if (buf->vbuf.bytesused < sizeof (data))
+    return;
+
+  switch (dev->output.memory) {
+    case V4L2_MEMORY_MMAP:
+      len = pread (buf->memfd, data, sizeof (data), 0);
+      break;
+    case V4L2_MEMORY_USERPTR:
+      memcpy (data, (gpointer) buf->vbuf.m.userptr, sizeof (data));
+      len = sizeof (data);
+      break;
+    case V4L2_MEMORY_DMABUF:
+      len = pread (buf->vbuf.m.fd, data, sizeof (data), buf->vbuf.data_offset);
+      break;
+  }
+
+  if (len != sizeof (data) || memcmp (data, FAKE_SEQ_MAGIC,
+          sizeof (FAKE_SEQ_MAGIC)))
+    return;
+
+  memcpy (header, data + sizeof (FAKE_SEQ_MAGIC), sizeof (header));
+
+  fmt->fmt.pix.width = header[0];
+  fmt->fmt.pix.height = header[1];
+  fmt->fmt.pix.bytesperline = 0;
+  fmt->fmt.pix.sizeimage = 0;
+  fake_device_fill_format (dev, &dev->capture, fmt);
+  dev->refs = CLAMP (header[2], 1, VIDEO_MAX_FRAME / 2);
+
+  GST_DEBUG ("new sequence %ux%u with %d reference frames",
+      fmt->fmt.pix.width, fmt->fmt.pix.height, dev->refs);
+}
+
+/* Called with the device lock, completes all buffers that are due and
+ * returns the time at which something need to be done next */
+static gint64
+fake_device_process (GstV4l2FakeDevice * dev, gint64 now)
+{
+  GstV4l2FakeQueue *in, *out;
+  GstV4l2FakeBuffer *buf, *cbuf;
+
+  switch (dev->kind) {
+    case GST_V4L2_FAKE_CAPTURE:
+    case GST_V4L2_FAKE_OUTPUT:
+      in = dev->kind == GST_V4L2_FAKE_CAPTURE ? &dev->capture : &dev->output;
+
+      if (!in->streaming)
+        return G_MAXINT64;
+
+      while ((buf = g_queue_peek_head (&in->pending))) {
+        if (buf->deadline > now)
+          return buf->deadline;
+
+        g_queue_pop_head (&in->pending);
+
+        if (!V4L2_TYPE_IS_OUTPUT (in->type)) {
+          buf->vbuf.bytesused = buf->vbuf.length;
+          buf->vbuf.flags &= ~V4L2_BUF_FLAG_TIMESTAMP_MASK;
+          buf->vbuf.flags |= V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+          fake_buffer_set_timestamp (buf, now);
+        }
+
+        fake_buffer_done (in, buf);
+      }
+      break;
+
+    case GST_V4L2_FAKE_CONVERT:
+    case GST_V4L2_FAKE_DECODER:
+    case GST_V4L2_FAKE_ENCODER:
+      in = &dev->output;
+      out = &dev->capture;
+
+      if (!in->streaming)
+        return G_MAXINT64;
+
+      /* only the sequence header is parsed until the decoder restarts, so
+       * that the new capture format can be read */
+      if (dev->stopped) {
+        if ((buf = g_queue_peek_head (&in->pending)))
+          fake_device_parse_header (dev, buf);
+        return G_MAXINT64;
+      }
+
+      if (!out->streaming)
+        return G_MAXINT64;
+
+      /* every input buffer produce exactly one output buffer */
+      while ((buf = g_queue_peek_head (&in->pending))) {
+        if (buf->deadline > now)
+          return buf->deadline;
+
+        cbuf = g_queue_pop_head (&out->pending);
+        if (cbuf == NULL)
+          return G_MAXINT64;
+
+        g_queue_pop_head (&in->pending);
+
+        if (dev->kind == GST_V4L2_FAKE_DECODER)
+          fake_device_parse_header (dev, buf);
+
+        if (dev->kind == GST_V4L2_FAKE_ENCODER)
+          fake_device_encode (dev, cbuf);
+        else
+          cbuf->vbuf.bytesused = out->format.fmt.pix.sizeimage;
+        cbuf->vbuf.timestamp = buf->vbuf.timestamp;
+        cbuf->vbuf.flags &= ~V4L2_BUF_FLAG_TIMESTAMP_MASK;
+        cbuf->vbuf.flags |= V4L2_BUF_FLAG_TIMESTAMP_COPY;
+
+        fake_buffer_done (in, buf);
+        fake_buffer_done (out, cbuf);
+      }
+
+      /* once drained, return an empty buffer flagged as the last one */
+      if (dev->draining && (cbuf = g_queue_pop_head (&out->pending))) {
+        cbuf->vbuf.bytesused = 0;
+        cbuf->vbuf.flags |= V4L2_BUF_FLAG_LAST;
+        fake_buffer_done (out, cbuf);
+        dev->draining = FALSE;
+        dev->stopped = dev->kind == GST_V4L2_FAKE_DECODER;
+      }
+      break;
+  }
+
+  return G_MAXINT64;
+}
+
+static gpointer
+fake_device_thread (GstV4l2FakeDevice * dev)
+{
+  g_mutex_lock (&dev->lock);
+
+  while (dev->running) {
+    gint64 deadline;
+
+    deadline = fake_device_process (dev, g_get_monotonic_time ());
+
+    /* wake up the threads waiting in DQBUF and poll() */
+    g_cond_broadcast (&dev->cond);
+    fake_device_update_poll (dev);
+
+    if (deadline == G_MAXINT64)
+      g_cond_wait (&dev->cond, &dev->lock);
+    else
+      g_cond_wait_until (&dev->cond, &dev->lock, deadline);
+  }
+
+  g_mutex_unlock (&dev->lock);
+
+  return NULL;
+}
+
+static GstV4l2FakeDevice *
+fake_device_new (const gchar * device)
+{
+  GstV4l2FakeDevice *dev;
+  GstV4l2FakeKind kind;
+  const guint32 *cap_formats = NULL, *out_formats = NULL;
+  guint n_cap_formats = 0, n_out_formats = 0;
+  gchar **opts;
+  gint i;
+
+  opts = g_strsplit (device + strlen (GST_V4L2_FAKE_DEVICE_PREFIX), ",", -1);
+
+  if (!g_strcmp0 (opts[0], "capture")) {
+    kind = GST_V4L2_FAKE_CAPTURE;
+    cap_formats = raw_formats;
+    n_cap_formats = G_N_ELEMENTS (raw_formats);
+  } else if (!g_strcmp0 (opts[0], "output")) {
+    kind = GST_V4L2_FAKE_OUTPUT;
+    out_formats = raw_formats;
+    n_out_formats = G_N_ELEMENTS (raw_formats);
+  } else if (!g_strcmp0 (opts[0], "convert")) {
+    kind = GST_V4L2_FAKE_CONVERT;
+    cap_formats = out_formats = raw_formats;
+    n_cap_formats = n_out_formats = G_N_ELEMENTS (raw_formats);
+  } else if (!g_strcmp0 (opts[0], "decoder")) {
+    kind = GST_V4L2_FAKE_DECODER;
+    cap_formats = raw_formats;
+    n_cap_formats = 1;          /* NV12 only */
+    out_formats = coded_formats;
+    n_out_formats = G_N_ELEMENTS (coded_formats);
+  } else if (!g_strcmp0 (opts[0], "encoder")) {
+    kind = GST_V4L2_FAKE_ENCODER;
+    cap_formats = coded_formats;
+    n_cap_formats = G_N_ELEMENTS (coded_formats);
+    out_formats = raw_formats;
+    n_out_formats = G_N_ELEMENTS (raw_formats);
+  } else {
+    goto unknown_kind;
+  }
+
+  dev = g_new0 (GstV4l2FakeDevice, 1);
+  dev->refcount = 1;
+  dev->device = g_strdup (device);
+  dev->kind = kind;
+  dev->width = 640;
+  dev->height = 480;
+  dev->align = 1;
+  dev->signal_fd = -1;
+  dev->bitrate = FAKE_DEFAULT_BITRATE;
+  dev->gop_size = FAKE_DEFAULT_GOP_SIZE;
+  dev->refs = FAKE_DEFAULT_REFS;
+
+  for (i = 1; opts[i]; i++) {
+    gchar *value = strchr (opts[i], '=');
+
+    if (value == NULL) {
+      GST_WARNING ("ignoring fake device option '%s'", opts[i]);
+      continue;
+    }
+
+    *value++ = '\0';
+
+    if (!g_strcmp0 (opts[i], "latency"))
+      dev->latency = fake_parse_int (value, 0, G_USEC_PER_SEC * 10, 0);
+    else if (!g_strcmp0 (opts[i], "width"))
+      dev->width = fake_parse_int (value, FAKE_MIN_SIZE, FAKE_MAX_SIZE, 640);
+    else if (!g_strcmp0 (opts[i], "height"))
+      dev->height = fake_parse_int (value, FAKE_MIN_SIZE, FAKE_MAX_SIZE, 480);
+    else if (!g_strcmp0 (opts[i], "align"))
+      dev->align = fake_parse_int (value, 1, 4096, 1);
+    else if (!g_strcmp0 (opts[i], "crop"))
+      dev->crop = kind == GST_V4L2_FAKE_CONVERT ?
+          fake_parse_int (value, 0, 2, 0) : 0;
+    else
+      GST_WARNING ("unknown fake device option '%s'", opts[i]);
+  }
+
+  g_strfreev (opts);
+
+  fake_queue_init (&dev->capture, 0, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      cap_formats, n_cap_formats);
+  fake_queue_init (&dev->output, 1, V4L2_BUF_TYPE_VIDEO_OUTPUT,
+      out_formats, n_out_formats);
+
+  if (dev->capture.enabled)
+    fake_device_fill_format (dev, &dev->capture, &dev->capture.format);
+  if (dev->output.enabled) {
+    fake_device_fill_format (dev, &dev->output, &dev->output.format);
+    dev->output.crop.width = dev->output.format.fmt.pix.width;
+    dev->output.crop.height = dev->output.format.fmt.pix.height;
+  }
+
+  g_mutex_init (&dev->lock);
+  g_cond_init (&dev->cond);
+  g_weak_ref_init (&dev->element, NULL);
+  dev->running = TRUE;
+  dev->thread = g_thread_new ("v4l2-fake", (GThreadFunc) fake_device_thread,
+      dev);
+
+  GST_DEBUG ("created fake device %s", device);
+
+  return dev;
+
+unknown_kind:
+  {
+    GST_WARNING ("unknown fake device kind '%s'", opts[0]);
+    g_strfreev (opts);
+    errno = ENOENT;
+    return NULL;
+  }
+}
+
+static void
+fake_device_unref (GstV4l2FakeDevice * dev)
+{
+  if (!g_atomic_int_dec_and_test (&dev->refcount))
+    return;
+
+  g_mutex_lock (&dev->lock);
+  dev->running = FALSE;
+  g_cond_broadcast (&dev->cond);
+  g_mutex_unlock (&dev->lock);
+  g_thread_join (dev->thread);
+
+  fake_queue_clear (&dev->capture);
+  fake_queue_clear (&dev->output);
+
+  if (dev->signal_fd >= 0)
+    close (dev->signal_fd);
+
+  g_weak_ref_clear (&dev->element);
+  g_mutex_clear (&dev->lock);
+  g_cond_clear (&dev->cond);
+  g_free (dev->device);
+  g_free (dev);
+}
+
+static GstV4l2FakeDevice *
+fake_device_lookup (gint fd)
+{
+  GstV4l2FakeDevice *dev = NULL;
+
+  G_LOCK (fake_devices);
+  if (fake_devices)
+    dev = g_hash_table_lookup (fake_devices, GINT_TO_POINTER (fd));
+  if (dev)
+    g_atomic_int_inc (&dev->refcount);
+  G_UNLOCK (fake_devices);
+
+  if (dev == NULL)
+    errno = EBADF;
+
+  return dev;
+}
+
+static void
+fake_device_insert (gint fd, GstV4l2FakeDevice * dev)
+{
+  G_LOCK (fake_devices);
+  if (fake_devices == NULL)
+    fake_devices = g_hash_table_new (NULL, NULL);
+  g_hash_table_insert (fake_devices, GINT_TO_POINTER (fd), dev);
+  G_UNLOCK (fake_devices);
+}
+
+static GstStructure *
+fake_queue_make_stats (GstV4l2FakeDevice * dev, GstV4l2FakeQueue * q)
+{
+  GstStructure *s;
+  GArray *l = q->latencies;
+  guint64 p50 = 0, p90 = 0, p99 = 0;
+
+  if (l->len == 0)
+    return NULL;
+
+  g_array_sort (l, fake_compare_latency);
+  p50 = g_array_index (l, gint64, (l->len - 1) * 50 / 100);
+  p90 = g_array_index (l, gint64, (l->len - 1) * 90 / 100);
+  p99 = g_array_index (l, gint64, (l->len - 1) * 99 / 100);
+
+  s = gst_structure_new ("v4l2-fake-stats",
+      "device", G_TYPE_STRING, dev->device,
+      "queue", G_TYPE_STRING, V4L2_TYPE_IS_OUTPUT (q->type) ?
+      "output" : "capture",
+      "frames", G_TYPE_UINT, l->len,
+      "latency-p50", G_TYPE_UINT64, p50 * GST_USECOND,
+      "latency-p90", G_TYPE_UINT64, p90 * GST_USECOND,
+      "latency-p99", G_TYPE_UINT64, p99 * GST_USECOND, NULL);
+
+  g_array_set_size (l, 0);
+
+  return s;
+}
+
+static gint
+fake_alloc_buffers (GstV4l2FakeQueue * q, guint32 memory, guint32 count,
+    guint32 length)
+{
+  guint32 i;
+
+  for (i = q->count; i < q->count + count; i++) {
+    GstV4l2FakeBuffer *buf = &q->buffers[i];
+
+    memset (buf, 0, sizeof (GstV4l2FakeBuffer));
+    buf->memfd = -1;
+    buf->vbuf.index = i;
+    buf->vbuf.type = q->type;
+    buf->vbuf.memory = memory;
+    buf->vbuf.length = length;
+    buf->vbuf.field = V4L2_FIELD_NONE;
+
+    if (memory == V4L2_MEMORY_MMAP) {
+      buf->memfd = fake_memfd_new (length);
+      if (buf->memfd < 0)
+        goto alloc_failed;
+      buf->vbuf.m.offset = FAKE_MMAP_OFFSET (q->id, i);
+    }
+  }
+
+  return 0;
+
+alloc_failed:
+  {
+    GST_WARNING ("failed to allocate memory: %s", g_strerror (errno));
+    while (i-- > q->count) {
+      close (q->buffers[i].memfd);
+      q->buffers[i].memfd = -1;
+    }
+    return ENOMEM;
+  }
+}
+
+static gint
+fake_ioctl_querycap (GstV4l2FakeDevice * dev, struct v4l2_capability *cap)
+{
+  static const gchar *cards[] = {
+    "Fake Capture", "Fake Output", "Fake Converter", "Fake Decoder",
+    "Fake Encoder"
+  };
+
+  memset (cap, 0, sizeof (struct v4l2_capability));
+  g_strlcpy ((gchar *) cap->driver, "v4l2-fake", sizeof (cap->driver));
+  g_strlcpy ((gchar *) cap->card, cards[dev->kind], sizeof (cap->card));
+  g_strlcpy ((gchar *) cap->bus_info, "platform:v4l2-fake",
+      sizeof (cap->bus_info));
+  cap->version = 0x00040a00;
+
+  cap->device_caps = V4L2_CAP_STREAMING;
+  switch (dev->kind) {
+    case GST_V4L2_FAKE_CAPTURE:
+      cap->device_caps |= V4L2_CAP_VIDEO_CAPTURE;
+      break;
+    case GST_V4L2_FAKE_OUTPUT:
+      cap->device_caps |= V4L2_CAP_VIDEO_OUTPUT;
+      break;
+    default:
+      cap->device_caps |= V4L2_CAP_VIDEO_M2M;
+      break;
+  }
+  cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+
+  return 0;
+}
+
+static gint
+fake_ioctl_enum_fmt (GstV4l2FakeDevice * dev, struct v4l2_fmtdesc *desc)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, desc->type);
+
+  if (q == NULL || desc->index >= q->n_formats)
+    return EINVAL;
+
+  desc->pixelformat = q->formats[desc->index];
+  desc->flags = 0;
+
+  switch (desc->pixelformat) {
+    case V4L2_PIX_FMT_NV12:
+      g_strlcpy ((gchar *) desc->description, "Y/CbCr 4:2:0",
+          sizeof (desc->description));
+      break;
+    case V4L2_PIX_FMT_YUYV:
+      g_strlcpy ((gchar *) desc->description, "YUYV 4:2:2",
+          sizeof (desc->description));
+      break;
+    case V4L2_PIX_FMT_H264:
+      desc->flags = V4L2_FMT_FLAG_COMPRESSED;
+      g_strlcpy ((gchar *) desc->description, "H.264",
+          sizeof (desc->description));
+      break;
+  }
+
+  return 0;
+}
+
+static gint
+fake_ioctl_enum_framesizes (GstV4l2FakeDevice * dev,
+    struct v4l2_frmsizeenum *size)
+{
+  if (size->index > 0 ||
+      !(fake_queue_has_format (&dev->capture, size->pixel_format) ||
+          fake_queue_has_format (&dev->output, size->pixel_format)))
+    return EINVAL;
+
+  size->type = V4L2_FRMSIZE_TYPE_STEPWISE;
+  size->stepwise.min_width = FAKE_MIN_SIZE;
+  size->stepwise.max_width = FAKE_MAX_SIZE;
+  size->stepwise.step_width = 2;
+  size->stepwise.min_height = FAKE_MIN_SIZE;
+  size->stepwise.max_height = FAKE_MAX_SIZE;
+  size->stepwise.step_height = 2;
+
+  return 0;
+}
+
+static gint
+fake_ioctl_enum_frameintervals (GstV4l2FakeDevice * dev,
+    struct v4l2_frmivalenum *ival)
+{
+  /* Only cameras have a frame rate, M2M are driven by the input */
+  if (dev->kind != GST_V4L2_FAKE_CAPTURE)
+    return ENOTTY;
+
+  if (ival->index > 0 ||
+      !fake_queue_has_format (&dev->capture, ival->pixel_format))
+    return EINVAL;
+
+  ival->type = V4L2_FRMIVAL_TYPE_DISCRETE;
+  ival->discrete = dev->capture.timeperframe;
+
+  return 0;
+}
+
+static gint
+fake_ioctl_s_fmt (GstV4l2FakeDevice * dev, struct v4l2_format *fmt,
+    gboolean try_only)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, fmt->type);
+
+  if (q == NULL)
+    return EINVAL;
+
+  fake_device_fill_format (dev, q, fmt);
+
+  if (try_only)
+    return 0;
+
+  if (q->count > 0)
+    return EBUSY;
+
+  q->format = *fmt;
+  q->crop.left = q->crop.top = 0;
+  q->crop.width = fmt->fmt.pix.width;
+  q->crop.height = fmt->fmt.pix.height;
+
+  /* The decoded size follow the coded size */
+  if (dev->kind == GST_V4L2_FAKE_DECODER && q == &dev->output &&
+      dev->capture.count == 0) {
+    struct v4l2_format *cfmt = &dev->capture.format;
+
+    cfmt->fmt.pix.width = fmt->fmt.pix.width;
+    cfmt->fmt.pix.height = fmt->fmt.pix.height;
+    cfmt->fmt.pix.bytesperline = 0;
+    fake_device_fill_format (dev, &dev->capture, cfmt);
+  }
+
+  return 0;
+}
+
+static gint
+fake_ioctl_g_selection (GstV4l2FakeDevice * dev, struct v4l2_selection *sel)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, sel->type);
+
+  if (dev->crop == 0 || q != &dev->output)
+    return EINVAL;
+
+  switch (sel->target) {
+    case V4L2_SEL_TGT_CROP:
+      sel->r = q->crop;
+      return 0;
+    case V4L2_SEL_TGT_CROP_DEFAULT:
+    case V4L2_SEL_TGT_CROP_BOUNDS:
+      sel->r.left = sel->r.top = 0;
+      sel->r.width = q->format.fmt.pix.width;
+      sel->r.height = q->format.fmt.pix.height;
+      return 0;
+    default:
+      return EINVAL;
+  }
+}
+
+static gint
+fake_ioctl_s_selection (GstV4l2FakeDevice * dev, struct v4l2_selection *sel)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, sel->type);
+  struct v4l2_rect *r = &sel->r;
+  guint width, height;
+
+  if (dev->crop == 0 || q != &dev->output || sel->target != V4L2_SEL_TGT_CROP)
+    return EINVAL;
+
+  if (dev->crop == 2 && q->streaming)
+    return EBUSY;
+
+  /* keep the rectangle within the frame */
+  width = q->format.fmt.pix.width;
+  height = q->format.fmt.pix.height;
+  r->left = CLAMP (r->left, 0, (gint) width - FAKE_MIN_SIZE);
+  r->top = CLAMP (r->top, 0, (gint) height - FAKE_MIN_SIZE);
+  r->width = CLAMP (r->width, FAKE_MIN_SIZE, width - r->left);
+  r->height = CLAMP (r->height, FAKE_MIN_SIZE, height - r->top);
+
+  q->crop = *r;
+
+  return 0;
+}
+
+static gint
+fake_ioctl_parm (GstV4l2FakeDevice * dev, struct v4l2_streamparm *parm,
+    gboolean set)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, parm->type);
+  struct v4l2_fract *tpf;
+
+  if (q == NULL)
+    return EINVAL;
+
+  /* capture and output parameter have the same layout */
+  tpf = &parm->parm.capture.timeperframe;
+
+  if (set && tpf->numerator > 0 && tpf->denominator > 0)
+    q->timeperframe = *tpf;
+
+  memset (&parm->parm, 0, sizeof (parm->parm));
+  parm->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+  *tpf = q->timeperframe;
+
+  return 0;
+}
+
+static gint
+fake_ioctl_g_ctrl (GstV4l2FakeDevice * dev, struct v4l2_control *ctrl)
+{
+  switch (ctrl->id) {
+    case V4L2_CID_MIN_BUFFERS_FOR_CAPTURE:
+      if (dev->kind != GST_V4L2_FAKE_DECODER)
+        return EINVAL;
+      /* reference frames */
+      ctrl->value = dev->refs;
+      return 0;
+    case V4L2_CID_MPEG_VIDEO_BITRATE:
+      if (dev->kind != GST_V4L2_FAKE_ENCODER)
+        return EINVAL;
+      ctrl->value = dev->bitrate;
+      return 0;
+    case V4L2_CID_MPEG_VIDEO_GOP_SIZE:
+      if (dev->kind != GST_V4L2_FAKE_ENCODER)
+        return EINVAL;
+      ctrl->value = dev->gop_size;
+      return 0;
+    default:
+      return EINVAL;
+  }
+}
+
+static gint
+fake_ioctl_s_ctrl (GstV4l2FakeDevice * dev, struct v4l2_control *ctrl)
+{
+  if (dev->kind != GST_V4L2_FAKE_ENCODER)
+    return EINVAL;
+
+  switch (ctrl->id) {
+    case V4L2_CID_MPEG_VIDEO_BITRATE:
+      if (ctrl->value <= 0)
+        return ERANGE;
+      dev->bitrate = ctrl->value;
+      return 0;
+    case V4L2_CID_MPEG_VIDEO_GOP_SIZE:
+      if (ctrl->value <= 0)
+        return ERANGE;
+      dev->gop_size = ctrl->value;
+      return 0;
+    case V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME:
+      dev->force_key_frame = TRUE;
+      return 0;
+    default:
+      return EINVAL;
+  }
+}
+
+static gint
+fake_ioctl_reqbufs (GstV4l2FakeDevice * dev, struct v4l2_requestbuffers *req)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, req->type);
+  gint ret;
+
+  if (q == NULL)
+    return EINVAL;
+
+  if (req->memory != V4L2_MEMORY_MMAP && req->memory != V4L2_MEMORY_USERPTR
+      && req->memory != V4L2_MEMORY_DMABUF)
+    return EINVAL;
+
+  if (q->streaming)
+    return EBUSY;
+
+  fake_queue_free_buffers (q);
+
+  q->memory = req->memory;
+  req->count = MIN (req->count, VIDEO_MAX_FRAME);
+
+  ret = fake_alloc_buffers (q, req->memory, req->count,
+      q->format.fmt.pix.sizeimage);
+  if (ret == 0)
+    q->count = req->count;
+
+  return ret;
+}
+
+static gint
+fake_ioctl_create_bufs (GstV4l2FakeDevice * dev,
+    struct v4l2_create_buffers *create)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, create->format.type);
+  guint32 length;
+  gint ret;
+
+  if (q == NULL)
+    return EINVAL;
+
+  if (q->count > 0 && create->memory != q->memory)
+    return EINVAL;
+
+  create->index = q->count;
+
+  /* probing for support */
+  if (create->count == 0)
+    return 0;
+
+  if (q->count == VIDEO_MAX_FRAME)
+    return ENOBUFS;
+
+  create->count = MIN (create->count, VIDEO_MAX_FRAME - q->count);
+  length = MAX (create->format.fmt.pix.sizeimage, q->format.fmt.pix.sizeimage);
+
+  ret = fake_alloc_buffers (q, create->memory, create->count, length);
+  if (ret == 0) {
+    q->memory = create->memory;
+    q->count += create->count;
+  }
+
+  return ret;
+}
+
+static gint
+fake_ioctl_querybuf (GstV4l2FakeDevice * dev, struct v4l2_buffer *vbuf)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, vbuf->type);
+
+  if (q == NULL || vbuf->index >= q->count)
+    return EINVAL;
+
+  *vbuf = q->buffers[vbuf->index].vbuf;
+
+  return 0;
+}
+
+static gint
+fake_ioctl_qbuf (GstV4l2FakeDevice * dev, struct v4l2_buffer *vbuf)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, vbuf->type);
+  GstV4l2FakeBuffer *buf;
+
+  if (q == NULL || vbuf->index >= q->count || vbuf->memory != q->memory)
+    return EINVAL;
+
+  buf = &q->buffers[vbuf->index];
+
+  if (IS_QUEUED (buf))
+    return EINVAL;
+
+  switch (q->memory) {
+    case V4L2_MEMORY_USERPTR:
+      if (vbuf->m.userptr == 0)
+        return EINVAL;
+      if (!V4L2_TYPE_IS_OUTPUT (q->type) &&
+          vbuf->length < q->format.fmt.pix.sizeimage)
+        return EINVAL;
+      buf->vbuf.m.userptr = vbuf->m.userptr;
+      buf->vbuf.length = vbuf->length;
+      break;
+    case V4L2_MEMORY_DMABUF:
+      if (vbuf->m.fd < 0 || fcntl (vbuf->m.fd, F_GETFD) < 0)
+        return EINVAL;
+      buf->vbuf.m.fd = vbuf->m.fd;
+      break;
+    default:
+      break;
+  }
+
+  if (V4L2_TYPE_IS_OUTPUT (q->type)) {
+    buf->vbuf.bytesused = vbuf->bytesused;
+    buf->vbuf.timestamp = vbuf->timestamp;
+  }
+
+  buf->vbuf.flags &= ~(V4L2_BUF_FLAG_DONE | V4L2_BUF_FLAG_LAST);
+  buf->vbuf.flags |= V4L2_BUF_FLAG_QUEUED;
+  buf->qbuf_time = g_get_monotonic_time ();
+  buf->deadline = buf->qbuf_time + dev->latency;
+
+  g_queue_push_tail (&q->pending, buf);
+  g_cond_broadcast (&dev->cond);
+
+  vbuf->flags = buf->vbuf.flags;
+
+  return 0;
+}
+
+static gint
+fake_ioctl_dqbuf (GstV4l2FakeDevice * dev, struct v4l2_buffer *vbuf)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, vbuf->type);
+  GstV4l2FakeBuffer *buf;
+  gint64 latency;
+
+  if (q == NULL || vbuf->memory != q->memory)
+    return EINVAL;
+
+  while ((buf = g_queue_pop_head (&q->done)) == NULL) {
+    if (!q->streaming)
+      return EINVAL;
+
+    if (q->last)
+      return EPIPE;
+
+    g_cond_wait (&dev->cond, &dev->lock);
+  }
+
+  buf->vbuf.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE);
+  *vbuf = buf->vbuf;
+
+  if (buf->vbuf.flags & V4L2_BUF_FLAG_LAST)
+    q->last = TRUE;
+
+  latency = g_get_monotonic_time () - buf->qbuf_time;
+  if (q->latencies->len < FAKE_MAX_LATENCIES)
+    g_array_append_val (q->latencies, latency);
+
+  fake_device_update_poll (dev);
+
+  return 0;
+}
+
+static gint
+fake_ioctl_expbuf (GstV4l2FakeDevice * dev, struct v4l2_exportbuffer *expbuf)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, expbuf->type);
+  gint fd;
+
+  if (q == NULL || expbuf->index >= q->count || expbuf->plane > 0 ||
+      q->memory != V4L2_MEMORY_MMAP)
+    return EINVAL;
+
+  if (expbuf->flags & O_CLOEXEC)
+    fd = fcntl (q->buffers[expbuf->index].memfd, F_DUPFD_CLOEXEC, 0);
+  else
+    fd = dup (q->buffers[expbuf->index].memfd);
+
+  if (fd < 0)
+    return errno;
+
+  expbuf->fd = fd;
+
+  return 0;
+}
+
+static gint
+fake_ioctl_streamon (GstV4l2FakeDevice * dev, gint * type)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, *type);
+
+  if (q == NULL || q->count == 0)
+    return EINVAL;
+
+  q->streaming = TRUE;
+  q->last = FALSE;
+  if (q == &dev->capture)
+    dev->stopped = FALSE;
+  g_cond_broadcast (&dev->cond);
+
+  return 0;
+}
+
+static gint
+fake_ioctl_streamoff (GstV4l2FakeDevice * dev, gint * type,
+    GstStructure ** stats)
+{
+  GstV4l2FakeQueue *q = fake_device_get_queue (dev, *type);
+  guint i;
+
+  if (q == NULL)
+    return EINVAL;
+
+  /* All buffers are returned to userspace */
+  for (i = 0; i < q->count; i++)
+    q->buffers[i].vbuf.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE);
+
+  g_queue_clear (&q->pending);
+  g_queue_clear (&q->done);
+
+  if (q->streaming)
+    *stats = fake_queue_make_stats (dev, q);
+
+  q->streaming = FALSE;
+  q->last = FALSE;
+  q->sequence = 0;
+
+  if (q == &dev->output) {
+    dev->draining = FALSE;
+    dev->frame_num = 0;
+  }
+
+  fake_device_update_poll (dev);
+  g_cond_broadcast (&dev->cond);
+
+  return 0;
+}
+
+static gint
+fake_ioctl_decoder_cmd (GstV4l2FakeDevice * dev, struct v4l2_decoder_cmd *cmd)
+{
+  if (dev->kind != GST_V4L2_FAKE_DECODER)
+    return ENOTTY;
+
+  switch (cmd->cmd) {
+    case V4L2_DEC_CMD_STOP:
+      dev->draining = TRUE;
+      g_cond_broadcast (&dev->cond);
+      return 0;
+    case V4L2_DEC_CMD_START:
+      dev->stopped = FALSE;
+      dev->capture.last = FALSE;
+      g_cond_broadcast (&dev->cond);
+      return 0;
+    default:
+      return EINVAL;
+  }
+}
+
+static gint
+fake_ioctl_encoder_cmd (GstV4l2FakeDevice * dev, struct v4l2_encoder_cmd *cmd)
+{
+  if (dev->kind != GST_V4L2_FAKE_ENCODER)
+    return ENOTTY;
+
+  switch (cmd->cmd) {
+    case V4L2_ENC_CMD_STOP:
+      dev->draining = TRUE;
+      g_cond_broadcast (&dev->cond);
+      return 0;
+    case V4L2_ENC_CMD_START:
+      return 0;
+    default:
+      return EINVAL;
+  }
+}
+
+/* Called with the device lock, returns 0 or an errno value */
+static gint
+fake_device_ioctl (GstV4l2FakeDevice * dev, gulong request, gpointer arg,
+    GstStructure ** stats)
+{
+  switch (request) {
+    case VIDIOC_QUERYCAP:
+      return fake_ioctl_querycap (dev, arg);
+    case VIDIOC_ENUM_FMT:
+      return fake_ioctl_enum_fmt (dev, arg);
+    case VIDIOC_ENUM_FRAMESIZES:
+      return fake_ioctl_enum_framesizes (dev, arg);
+    case VIDIOC_ENUM_FRAMEINTERVALS:
+      return fake_ioctl_enum_frameintervals (dev, arg);
+    case VIDIOC_G_FMT:{
+      struct v4l2_format *fmt = arg;
+      GstV4l2FakeQueue *q = fake_device_get_queue (dev, fmt->type);
+
+      if (q == NULL)
+        return EINVAL;
+
+      *fmt = q->format;
+      return 0;
+    }
+    case VIDIOC_S_FMT:
+      return fake_ioctl_s_fmt (dev, arg, FALSE);
+    case VIDIOC_TRY_FMT:
+      return fake_ioctl_s_fmt (dev, arg, TRUE);
+    case VIDIOC_G_SELECTION:
+      return fake_ioctl_g_selection (dev, arg);
+    case VIDIOC_S_SELECTION:
+      return fake_ioctl_s_selection (dev, arg);
+    case VIDIOC_G_PARM:
+      return fake_ioctl_parm (dev, arg, FALSE);
+    case VIDIOC_S_PARM:
+      return fake_ioctl_parm (dev, arg, TRUE);
+    case VIDIOC_G_CTRL:
+      return fake_ioctl_g_ctrl (dev, arg);
+    case VIDIOC_S_CTRL:
+      return fake_ioctl_s_ctrl (dev, arg);
+    case VIDIOC_REQBUFS:
+      return fake_ioctl_reqbufs (dev, arg);
+    case VIDIOC_CREATE_BUFS:
+      return fake_ioctl_create_bufs (dev, arg);
+    case VIDIOC_QUERYBUF:
+      return fake_ioctl_querybuf (dev, arg);
+    case VIDIOC_QBUF:
+      return fake_ioctl_qbuf (dev, arg);
+    case VIDIOC_DQBUF:
+      return fake_ioctl_dqbuf (dev, arg);
+    case VIDIOC_EXPBUF:
+      return fake_ioctl_expbuf (dev, arg);
+    case VIDIOC_STREAMON:
+      return fake_ioctl_streamon (dev, arg);
+    case VIDIOC_STREAMOFF:
+      return fake_ioctl_streamoff (dev, arg, stats);
+    case VIDIOC_DECODER_CMD:
+      return fake_ioctl_decoder_cmd (dev, arg);
+    case VIDIOC_ENCODER_CMD:
+      return fake_ioctl_encoder_cmd (dev, arg);
+    default:
+      return ENOTTY;
+  }
+}
+
+gint
+gst_v4l2_fake_ioctl (gint fd, gulong request, ...)
+{
+  GstV4l2FakeDevice *dev;
+  GstStructure *stats = NULL;
+  GstElement *element;
+  va_list args;
+  gpointer arg;
+  gint ret;
+
+  va_start (args, request);
+  arg = va_arg (args, gpointer);
+  va_end (args);
+
+  dev = fake_device_lookup (fd);
+  if (dev == NULL)
+    return -1;
+
+  g_mutex_lock (&dev->lock);
+  ret = fake_device_ioctl (dev, request, arg, &stats);
+  g_mutex_unlock (&dev->lock);
+
+  if (stats) {
+    element = g_weak_ref_get (&dev->element);
+    if (element) {
+      gst_element_post_message (element,
+          gst_message_new_element (GST_OBJECT (element), stats));
+      gst_object_unref (element);
+    } else {
+      gst_structure_free (stats);
+    }
+  }
+
+  fake_device_unref (dev);
+
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+
+  return 0;
+}
+
+static gint
+gst_v4l2_fake_dup (gint fd)
+{
+  GstV4l2FakeDevice *dev;
+  gint new_fd;
+
+  dev = fake_device_lookup (fd);
+  if (dev == NULL)
+    return -1;
+
+  new_fd = fcntl (fd, F_DUPFD_CLOEXEC, 0);
+  if (new_fd < 0) {
+    fake_device_unref (dev);
+    return -1;
+  }
+
+  /* the new fd owns the reference */
+  fake_device_insert (new_fd, dev);
+
+  return new_fd;
+}
+
+static gssize
+gst_v4l2_fake_read (gint fd, gpointer buffer, gsize n)
+{
+  /* V4L2_CAP_READWRITE is not advertised */
+  errno = EINVAL;
+  return -1;
+}
+
+static gpointer
+gst_v4l2_fake_mmap (gpointer start, gsize length, gint prot, gint flags,
+    gint fd, off_t offset)
+{
+  GstV4l2FakeDevice *dev;
+  GstV4l2FakeQueue *q;
+  GstV4l2FakeBuffer *buf;
+  gpointer data = MAP_FAILED;
+  guint qid, index;
+
+  dev = fake_device_lookup (fd);
+  if (dev == NULL)
+    return MAP_FAILED;
+
+  qid = FAKE_MMAP_QUEUE (offset);
+  index = FAKE_MMAP_INDEX (offset);
+
+  g_mutex_lock (&dev->lock);
+
+  q = qid == 0 ? &dev->capture : &dev->output;
+  if (qid > 1 || index >= q->count || q->memory != V4L2_MEMORY_MMAP)
+    goto invalid;
+
+  buf = &q->buffers[index];
+  if (length > buf->vbuf.length)
+    goto invalid;
+
+  data = mmap (start, length, prot, flags, buf->memfd, 0);
+
+done:
+  g_mutex_unlock (&dev->lock);
+  fake_device_unref (dev);
+
+  return data;
+
+invalid:
+  {
+    errno = EINVAL;
+    goto done;
+  }
+}
+
+gint
+gst_v4l2_fake_close (gint fd)
+{
+  GstV4l2FakeDevice *dev = NULL;
+
+  G_LOCK (fake_devices);
+  if (fake_devices) {
+    dev = g_hash_table_lookup (fake_devices, GINT_TO_POINTER (fd));
+    g_hash_table_remove (fake_devices, GINT_TO_POINTER (fd));
+  }
+  G_UNLOCK (fake_devices);
+
+  if (dev == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+
+  close (fd);
+  fake_device_unref (dev);
+
+  return 0;
+}
+
+gboolean
+gst_v4l2_fake_is_fake_device (const gchar * device)
+{
+  return device && g_str_has_prefix (device, GST_V4L2_FAKE_DEVICE_PREFIX);
+}
+
+/**
+ * gst_v4l2_fake_open_device:
+ * @device: a fake device string
+ *
+ * Open a new instance of a software emulated device. The returned fd must be
+ * used with gst_v4l2_fake_ioctl() and closed with gst_v4l2_fake_close().
+ *
+ * Returns: a file descriptor or -1 with errno set.
+ */
+gint
+gst_v4l2_fake_open_device (const gchar * device)
+{
+  GstV4l2FakeDevice *dev;
+  gint fd;
+
+  g_return_val_if_fail (gst_v4l2_fake_is_fake_device (device), -1);
+
+  dev = fake_device_new (device);
+  if (dev == NULL)
+    return -1;
+
+  /* The eventfd gives us something that can be polled */
+  fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd < 0)
+    goto eventfd_failed;
+
+  dev->signal_fd = fcntl (fd, F_DUPFD_CLOEXEC, 0);
+  if (dev->signal_fd < 0) {
+    close (fd);
+    goto eventfd_failed;
+  }
+
+  fake_device_insert (fd, dev);
+
+  return fd;
+
+eventfd_failed:
+  {
+    gint err = errno;
+
+    GST_WARNING ("failed to create eventfd: %s", g_strerror (err));
+    fake_device_unref (dev);
+    errno = err;
+    return -1;
+  }
+}
+
+/**
+ * gst_v4l2_fake_open:
+ * @v4l2object: the object
+ *
+ * Open the fake device named by v4l2object->videodev and replace the
+ * object's I/O functions with the emulated ones.
+ *
+ * Returns: a file descriptor or -1 with errno set.
+ */
+gint
+gst_v4l2_fake_open (GstV4l2Object * v4l2object)
+{
+  GstV4l2FakeDevice *dev;
+  gint fd;
+
+  fd = gst_v4l2_fake_open_device (v4l2object->videodev);
+  if (fd < 0)
+    return -1;
+
+  dev = fake_device_lookup (fd);
+  g_weak_ref_set (&dev->element, v4l2object->element);
+  fake_device_unref (dev);
+
+  v4l2object->fd_open = NULL;
+  v4l2object->close = gst_v4l2_fake_close;
+  v4l2object->dup = gst_v4l2_fake_dup;
+  v4l2object->ioctl = gst_v4l2_fake_ioctl;
+  v4l2object->read = gst_v4l2_fake_read;
+  v4l2object->mmap = gst_v4l2_fake_mmap;
+  v4l2object->munmap = munmap;
+
+  return fd;
+}
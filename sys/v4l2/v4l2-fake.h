@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __V4L2_FAKE_H__
+#define __V4L2_FAKE_H__
+
+#include <gst/gst.h>
+
+#include "gstv4l2object.h"
+
+G_BEGIN_DECLS
+
+/* Device strings starting with this prefix select the software emulated
+ * device, e.g. "fake:capture,latency=2000,width=1280,height=720" */
+#define GST_V4L2_FAKE_DEVICE_PREFIX "fake:"
+
+/* ';' separated list of fake device strings to probe on plugin load */
+#define GST_V4L2_FAKE_DEVICES_ENV "GST_V4L2_FAKE_DEVICES"
+
+gboolean   gst_v4l2_fake_is_fake_device (const gchar * device);
+
+gint       gst_v4l2_fake_open           (GstV4l2Object * v4l2object);
+
+gint       gst_v4l2_fake_open_device    (const gchar * device);
+
+gint       gst_v4l2_fake_close          (gint fd);
+
+gint       gst_v4l2_fake_ioctl          (gint fd, gulong request, ...);
+
+G_END_DECLS
+
+#endif /* __V4L2_FAKE_H__ */
@@ -757,6 +757,152 @@ GST_START_TEST (rtp_h264_list_gt_mtu_avc)
 
 GST_END_TEST;
 
+static GstPadProbeReturn
+count_buffer_lists_probe (GstPad * pad, GstPadProbeInfo * info,
+    guint * n_lists)
+{
+  (*n_lists)++;
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (rtp_h264_au_in_one_list)
+{
+  GstHarness *h = gst_harness_new ("rtph264pay");
+  GstPad *srcpad;
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint n_lists = 0;
+  guint8 header[2];
+  gint i;
+
+  g_object_set (h->element, "mtu", 28, NULL);
+  gst_harness_set_src_caps_str (h,
+      "video/x-h264,stream-format=(string)avc,alignment=(string)au,"
+      "codec_data=(buffer)01640014ffe1001867640014acd94141fb0110000003001773594000f142996001000568ebecb22c");
+
+  srcpad = gst_element_get_static_pad (h->element, "src");
+  gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      (GstPadProbeCallback) count_buffer_lists_probe, &n_lists, NULL);
+  gst_object_unref (srcpad);
+
+  /* an SEI that fits in one packet and a slice split in 3 FU-A */
+  buf = gst_buffer_new_allocate (NULL, 4 + 3 + 4 + 40, NULL);
+  gst_buffer_memset (buf, 0, 0, gst_buffer_get_size (buf));
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT32_BE (map.data, 3);
+  map.data[4] = 0x06;
+  GST_WRITE_UINT32_BE (map.data + 7, 40);
+  map.data[11] = 0x41;
+  gst_buffer_unmap (buf, &map);
+  GST_BUFFER_PTS (buf) = 0;
+
+  fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+
+  /* the packets of the access unit are pushed together */
+  fail_unless_equals_int (n_lists, 1);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 4);
+
+  for (i = 0; i < 4; i++) {
+    buf = gst_harness_pull (h);
+    gst_buffer_extract (buf, 0, header, 2);
+    /* only the last packet has the marker bit */
+    fail_unless_equals_int (header[1] >> 7, i == 3);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (rtp_h264depay_shares_payload)
+{
+  GstHarness *h = gst_harness_new ("rtph264depay");
+  GstBuffer *inbuf, *outbuf;
+  GstMapInfo map;
+  GstMemory *mem;
+
+  gst_harness_set_src_caps_str (h, "application/x-rtp,media=(string)video,"
+      "clock-rate=(int)90000,encoding-name=(string)H264");
+  gst_harness_set_sink_caps_str (h,
+      "video/x-h264,stream-format=(string)byte-stream,alignment=(string)nal");
+
+  /* a single NAL unit packet with an IDR slice */
+  inbuf = gst_buffer_new_allocate (NULL, 12 + 100, NULL);
+  gst_buffer_memset (inbuf, 0, 0, 12);
+  gst_buffer_memset (inbuf, 12, 0x11, 100);
+  gst_buffer_map (inbuf, &map, GST_MAP_WRITE);
+  map.data[0] = 0x80;
+  map.data[1] = 0x80 | 96;
+  map.data[12] = 0x65;
+  map.data[13] = 0x88;
+  gst_buffer_unmap (inbuf, &map);
+
+  fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (inbuf)),
+      GST_FLOW_OK);
+
+  /* the NAL unit is a start code followed by the memory of the packet */
+  outbuf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (outbuf), 4 + 100);
+  fail_unless_equals_int (gst_buffer_n_memory (outbuf), 2);
+  fail_unless_equals_int (gst_buffer_memcmp (outbuf, 0, "\0\0\0\1", 4), 0);
+  mem = gst_buffer_peek_memory (outbuf, 1);
+  fail_unless (mem->parent == gst_buffer_peek_memory (inbuf, 0));
+  fail_unless_equals_int (mem->offset, 12);
+
+  gst_buffer_unref (outbuf);
+  gst_buffer_unref (inbuf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* an IDR frame of 4K video, in about 190 packets */
+#define LARGE_FRAME_SIZE (256 * 1024)
+
+GST_START_TEST (rtp_h264_au_assembly_large)
+{
+  GstHarness *h = gst_harness_new_parse ("rtph264pay mtu=1400 ! rtph264depay");
+  GstBuffer *inbuf, *outbuf;
+  GstMapInfo map;
+  gsize shared = 0;
+  guint i;
+
+  gst_harness_set_src_caps_str (h,
+      "video/x-h264,stream-format=(string)byte-stream,alignment=(string)au");
+  gst_harness_set_sink_caps_str (h,
+      "video/x-h264,stream-format=(string)byte-stream,alignment=(string)au");
+
+  inbuf = gst_buffer_new_allocate (NULL, LARGE_FRAME_SIZE, NULL);
+  gst_buffer_memset (inbuf, 0, 0x11, LARGE_FRAME_SIZE);
+  gst_buffer_map (inbuf, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT32_BE (map.data, 1);
+  map.data[4] = 0x65;
+  map.data[5] = 0x88;
+  gst_buffer_unmap (inbuf, &map);
+  GST_BUFFER_PTS (inbuf) = 0;
+
+  fail_unless_equals_int (gst_harness_push (h, inbuf), GST_FLOW_OK);
+
+  /* the frame comes out whole, with more memories than a buffer holds the
+   * biggest ones are still shared with the packets */
+  outbuf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (outbuf), LARGE_FRAME_SIZE);
+  fail_unless (gst_buffer_n_memory (outbuf) <= gst_buffer_get_max_memory ());
+  for (i = 0; i < gst_buffer_n_memory (outbuf); i++) {
+    GstMemory *mem = gst_buffer_peek_memory (outbuf, i);
+
+    if (mem->parent)
+      shared += mem->size;
+  }
+  fail_unless (shared > 0);
+  gst_buffer_unref (outbuf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 static const guint8 rtp_h265_frame_data[] = {
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
@@ -912,6 +1058,142 @@ GST_START_TEST (rtp_h265_list_gt_mtu_hvc1)
 
 GST_END_TEST;
 
+#define RTP_H265_HVC1_CAPS \
+  "video/x-h265,stream-format=(string)hvc1,alignment=(string)au," \
+  "codec_data=(buffer)0101c000000080000000000099f000fcfdf8f800000203a000010" \
+  "01840010c01ffff01c000000300800000030000030099ac0900a10001003042010101c00" \
+  "0000300800000030000030099a00a080f1fe36bbb5377725d602dc040404100000300010" \
+  "00003000a0800a2000100074401c172b02240"
+
+/* a prefix SEI and a slice, length size is 3 bytes */
+static const guint8 rtp_h265_aggregation_au[] = {
+  0x00, 0x00, 0x05, 0x4e, 0x01, 0x05, 0x01, 0x80,
+  0x00, 0x00, 0x04, 0x02, 0x01, 0xd0, 0x11
+};
+
+GST_START_TEST (rtp_h265_aggregation)
+{
+  GstHarness *h = gst_harness_new ("rtph265pay");
+  GstBuffer *buf;
+  GstMapInfo map;
+
+  gst_util_set_object_arg (G_OBJECT (h->element), "aggregate-mode",
+      "zero-latency");
+  gst_harness_set_src_caps_str (h, RTP_H265_HVC1_CAPS);
+
+  buf = gst_buffer_new_allocate (NULL, sizeof (rtp_h265_aggregation_au),
+      NULL);
+  gst_buffer_fill (buf, 0, rtp_h265_aggregation_au,
+      sizeof (rtp_h265_aggregation_au));
+  GST_BUFFER_PTS (buf) = 0;
+  fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+
+  /* both NAL units are sent in one aggregation packet with the marker bit */
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 1);
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf), 12 + 2 + 2 + 5 + 2 + 4);
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.data[1] >> 7, 1);
+  fail_unless_equals_int ((map.data[12] >> 1) & 0x3f, 48);
+  fail_unless_equals_int (GST_READ_UINT16_BE (map.data + 14), 5);
+  fail_unless_equals_int (map.data[16], 0x4e);
+  fail_unless_equals_int (GST_READ_UINT16_BE (map.data + 21), 4);
+  fail_unless_equals_int (map.data[23], 0x02);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (rtp_h265_aggregation_roundtrip)
+{
+  GstHarness *h =
+      gst_harness_new_parse ("rtph265pay aggregate-mode=max ! rtph265depay");
+  GstBuffer *buf;
+  gsize size;
+  gint i;
+  static const guint8 expected[] = {
+    0x00, 0x00, 0x00, 0x01, 0x4e, 0x01, 0x05, 0x01, 0x80,
+    0x00, 0x00, 0x00, 0x01, 0x02, 0x01, 0xd0, 0x11
+  };
+
+  gst_harness_set_src_caps_str (h, RTP_H265_HVC1_CAPS);
+  gst_harness_set_sink_caps_str (h,
+      "video/x-h265,stream-format=(string)byte-stream,alignment=(string)au");
+
+  for (i = 0; i < 2; i++) {
+    buf = gst_buffer_new_allocate (NULL, sizeof (rtp_h265_aggregation_au),
+        NULL);
+    gst_buffer_fill (buf, 0, rtp_h265_aggregation_au,
+        sizeof (rtp_h265_aggregation_au));
+    GST_BUFFER_PTS (buf) = i * 40 * GST_MSECOND;
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+
+  /* each access unit went in one aggregation packet, the marker bit of the
+   * packet only ends the access unit after its last NAL unit */
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 2);
+  for (i = 0; i < 2; i++) {
+    buf = gst_harness_pull (h);
+    size = gst_buffer_get_size (buf);
+    /* the first one also carries the parameter sets from the caps */
+    fail_unless (size >= sizeof (expected));
+    fail_unless_equals_int (gst_buffer_memcmp (buf, size - sizeof (expected),
+            expected, sizeof (expected)), 0);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static GstBuffer *
+create_h265_sei_buffer (GstClockTime pts, gboolean discont)
+{
+  GstBuffer *buf;
+
+  /* a prefix SEI doesn't end the access unit, so it waits in "max" mode */
+  buf = gst_buffer_new_allocate (NULL, 8, NULL);
+  gst_buffer_fill (buf, 0, rtp_h265_aggregation_au, 8);
+  GST_BUFFER_PTS (buf) = pts;
+  if (discont)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+
+  return buf;
+}
+
+GST_START_TEST (rtp_h265_aggregation_max_flush)
+{
+  GstHarness *h = gst_harness_new ("rtph265pay");
+
+  gst_util_set_object_arg (G_OBJECT (h->element), "aggregate-mode", "max");
+  gst_harness_set_src_caps_str (h, RTP_H265_HVC1_CAPS);
+
+  fail_unless_equals_int (gst_harness_push (h, create_h265_sei_buffer (0,
+              FALSE)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 0);
+
+  /* a discontinuity sends the waiting NAL unit even with the same pts */
+  fail_unless_equals_int (gst_harness_push (h, create_h265_sei_buffer (0,
+              TRUE)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 1);
+
+  /* so does a missing pts, the frames can't be told apart */
+  fail_unless_equals_int (gst_harness_push (h,
+          create_h265_sei_buffer (GST_CLOCK_TIME_NONE, FALSE)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 2);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_h265_sei_buffer (GST_CLOCK_TIME_NONE, FALSE)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 3);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 /* KLV data from Day_Flight.mpg */
 static const guint8 rtp_KLV_frame_data[] = {
   0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01, 0x01,
@@ -1360,11 +1642,17 @@ rtp_payloading_suite (void)
   tcase_add_test (tc_chain, rtp_h264_list_lt_mtu_avc);
   tcase_add_test (tc_chain, rtp_h264_list_gt_mtu);
   tcase_add_test (tc_chain, rtp_h264_list_gt_mtu_avc);
+  tcase_add_test (tc_chain, rtp_h264_au_in_one_list);
+  tcase_add_test (tc_chain, rtp_h264depay_shares_payload);
+  tcase_add_test (tc_chain, rtp_h264_au_assembly_large);
   tcase_add_test (tc_chain, rtp_h265);
   tcase_add_test (tc_chain, rtp_h265_list_lt_mtu);
   tcase_add_test (tc_chain, rtp_h265_list_lt_mtu_hvc1);
   tcase_add_test (tc_chain, rtp_h265_list_gt_mtu);
   tcase_add_test (tc_chain, rtp_h265_list_gt_mtu_hvc1);
+  tcase_add_test (tc_chain, rtp_h265_aggregation);
+  tcase_add_test (tc_chain, rtp_h265_aggregation_roundtrip);
+  tcase_add_test (tc_chain, rtp_h265_aggregation_max_flush);
   tcase_add_test (tc_chain, rtp_klv);
   tcase_add_test (tc_chain, rtp_klv_fragmented);
   tcase_add_test (tc_chain, rtp_L16);
@@ -299,6 +299,36 @@ GST_START_TEST (test_push_unordered)
 
 GST_END_TEST;
 
+GST_START_TEST (test_push_unordered_shared_threads)
+{
+  GstElement *jitterbuffer;
+  const guint num_buffers = 4;
+  GstBuffer *buffer;
+
+  jitterbuffer = setup_jitterbuffer (num_buffers);
+  g_object_set (jitterbuffer, "shared-threads", TRUE, NULL);
+  fail_unless (start_jitterbuffer (jitterbuffer)
+      == GST_STATE_CHANGE_SUCCESS, "could not set to playing");
+
+  /* push buffers; 0,2,1,3 */
+  buffer = (GstBuffer *) inbuffers->data;
+  fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+  buffer = g_list_nth_data (inbuffers, 2);
+  fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+  buffer = g_list_nth_data (inbuffers, 1);
+  fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+  buffer = g_list_nth_data (inbuffers, 3);
+  fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+
+  /* check the buffer list */
+  check_jitterbuffer_results (jitterbuffer, num_buffers);
+
+  /* cleanup */
+  cleanup_jitterbuffer (jitterbuffer);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_basetime)
 {
   GstElement *jitterbuffer;
@@ -1917,6 +1947,65 @@ GST_START_TEST (test_rtx_timer_reuse)
 
 GST_END_TEST;
 
+static guint
+pull_rtx_seqnum (GstHarness * h)
+{
+  GstEvent *event;
+  guint seqnum = 0;
+
+  event = gst_harness_pull_upstream_event (h);
+  fail_unless (event != NULL);
+  fail_unless (gst_structure_get_uint (gst_event_get_structure (event),
+          "seqnum", &seqnum));
+  gst_event_unref (event);
+
+  return seqnum;
+}
+
+GST_START_TEST (test_rtx_reorder_scan)
+{
+  GstHarness *h = gst_harness_new ("rtpjitterbuffer");
+  gint latency_ms = 200;
+  guint next_seqnum;
+  guint32 requested = 0;
+  gint i;
+
+  /* a large rtx-delay, so that only the reorder check sends requests while
+   * the clock does not move */
+  g_object_set (h->element, "do-retransmission", TRUE, "rtx-delay", 100,
+      "rtx-delay-reorder", 2, NULL);
+  next_seqnum = construct_deterministic_initial_state (h, latency_ms);
+  fail_unless_equals_int (11, next_seqnum);
+
+  /* 11 and 12 are missing, each packet only moves the scan by one seqnum
+   * and the request for the packet that fell behind goes out at once */
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (h, generate_test_buffer (13)));
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (h, generate_test_buffer (14)));
+  fail_unless_equals_int (11, pull_rtx_seqnum (h));
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (h, generate_test_buffer (15)));
+  fail_unless_equals_int (12, pull_rtx_seqnum (h));
+
+  /* 16 to 19 are missing, their timers are set around the seqnum the scan
+   * stopped at and must still be found */
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (h, generate_test_buffer (20)));
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (h, generate_test_buffer (21)));
+  for (i = 0; i < 3; i++)
+    requested |= 1 << (pull_rtx_seqnum (h) - 16);
+  fail_unless_equals_int (requested, 0x7);
+
+  /* 19 is within rtx-delay-reorder and the others were requested once */
+  fail_unless_equals_int (gst_harness_upstream_events_in_queue (h), 0);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_deadline_ts_offset)
 {
   GstHarness *h = gst_harness_new ("rtpjitterbuffer");
@@ -2009,6 +2098,289 @@ GST_START_TEST (test_push_big_gap)
 
 GST_END_TEST;
 
+static void
+push_ring_buffer (GstHarness * h, guint i, guint16 seqnum)
+{
+  fail_unless_equals_int (GST_FLOW_OK, gst_harness_push (h,
+          generate_test_buffer_full (i * TEST_BUF_DURATION, seqnum,
+              i * TEST_RTP_TS_DURATION)));
+}
+
+GST_START_TEST (test_ring_seqnum_wraparound)
+{
+  GstHarness *h = gst_harness_new ("rtpjitterbuffer");
+  const guint order[] = { 1, 0, 3, 2, 5, 4 };
+  guint i;
+
+  gst_harness_set_src_caps (h, generate_caps ());
+
+  /* 65533 to 2, reordered around the seqnum wraparound */
+  for (i = 0; i < G_N_ELEMENTS (order); i++)
+    push_ring_buffer (h, order[i], 65533 + order[i]);
+
+  fail_unless (gst_harness_crank_single_clock_wait (h));
+
+  for (i = 0; i < G_N_ELEMENTS (order); i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+    fail_unless_equals_int ((guint16) (65533 + i), get_rtp_seq_num (buf));
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_ring_growth)
+{
+  GstHarness *h = gst_harness_new ("rtpjitterbuffer");
+  const guint num_buffers = 1000;
+  guint64 duplicates, out_of_range;
+  GstStructure *stats;
+  guint i;
+
+  /* keep many more packets than the initial size of the ring */
+  gst_harness_set_src_caps (h, generate_caps ());
+  g_object_set (h->element, "latency", 30000, NULL);
+
+  for (i = 0; i < num_buffers; i += 2) {
+    push_ring_buffer (h, i + 1, 60000 + i + 1);
+    push_ring_buffer (h, i, 60000 + i);
+  }
+  /* one more of each is refused as a duplicate */
+  push_ring_buffer (h, 0, 60000);
+  push_ring_buffer (h, num_buffers - 1, 60000 + num_buffers - 1);
+
+  fail_unless (gst_harness_crank_single_clock_wait (h));
+
+  for (i = 0; i < num_buffers; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+    fail_unless_equals_int ((guint16) (60000 + i), get_rtp_seq_num (buf));
+    gst_buffer_unref (buf);
+  }
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "num-duplicates",
+          &duplicates));
+  fail_unless (gst_structure_get_uint64 (stats, "num-out-of-range",
+          &out_of_range));
+  fail_unless_equals_uint64 (duplicates, 2);
+  fail_unless_equals_uint64 (out_of_range, 0);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+record_ring_order (GstPad * pad, GstPadProbeInfo * info, GString * order)
+{
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    g_string_append_printf (order, "%d ",
+        get_rtp_seq_num (GST_PAD_PROBE_INFO_BUFFER (info)));
+  } else if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+      GST_EVENT_CUSTOM_DOWNSTREAM) {
+    g_string_append (order, "E ");
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_ring_event_order)
+{
+  GstHarness *h = gst_harness_new ("rtpjitterbuffer");
+  GString *order = g_string_new (NULL);
+  GstPad *srcpad;
+
+  gst_harness_set_src_caps (h, generate_caps ());
+
+  srcpad = gst_element_get_static_pad (h->element, "src");
+  gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) record_ring_order, order, NULL);
+  gst_object_unref (srcpad);
+
+  /* the event goes after the packets queued before it, and before the
+   * packets that arrive after it even when they are reordered */
+  push_ring_buffer (h, 0, 0);
+  fail_unless (gst_harness_push_event (h,
+          gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM,
+              gst_structure_new_empty ("ring-test"))));
+  push_ring_buffer (h, 2, 2);
+  push_ring_buffer (h, 1, 1);
+
+  fail_unless (gst_harness_crank_single_clock_wait (h));
+  gst_buffer_unref (gst_harness_pull (h));
+  gst_buffer_unref (gst_harness_pull (h));
+  gst_buffer_unref (gst_harness_pull (h));
+
+  fail_unless_equals_string (order->str, "0 E 1 2 ");
+
+  g_string_free (order, TRUE);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_shared_threads_lost_event)
+{
+  GstHarness *h =
+      gst_harness_new_parse ("rtpjitterbuffer shared-threads=1 do-lost=1");
+  GstBuffer *buf;
+  guint next_seqnum;
+
+  next_seqnum = construct_deterministic_initial_state (h, 100);
+
+  /* skip one packet, its lost timer runs as a task of the timer pool */
+  push_test_buffer (h, next_seqnum + 1);
+  gst_harness_crank_single_clock_wait (h);
+  verify_lost_event (h, next_seqnum, next_seqnum * TEST_BUF_DURATION,
+      TEST_BUF_DURATION);
+
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (next_seqnum + 1, get_rtp_seq_num (buf));
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_shared_threads_flush)
+{
+  GstHarness *h = gst_harness_new_parse ("rtpjitterbuffer shared-threads=1");
+  GstSegment segment;
+  GstBuffer *buf;
+  guint next_seqnum;
+
+  next_seqnum = construct_deterministic_initial_state (h, 100);
+
+  /* a packet waiting for a missing one is dropped by the flush */
+  push_test_buffer (h, next_seqnum + 1);
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  /* the tasks were stopped and started again, a new stream goes through */
+  push_test_buffer (h, 1000);
+  fail_unless (gst_harness_crank_single_clock_wait (h));
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (1000, get_rtp_seq_num (buf));
+  gst_buffer_unref (buf);
+
+  fail_unless_equals_int (0, gst_harness_buffers_in_queue (h));
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+count_blocked_probe (GstPad * pad, GstPadProbeInfo * info, gint * blocked)
+{
+  g_atomic_int_inc (blocked);
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_shared_threads_blocked_output)
+{
+  GstHarness *h, **blocked_h;
+  gulong *probes;
+  gint i, num_blocked, blocked = 0;
+
+  /* more blocked streams than the output pool has threads */
+  num_blocked = MAX (g_get_num_processors (), 2) + 1;
+
+  h = gst_harness_new_parse
+      ("rtpjitterbuffer shared-threads=1 do-retransmission=1");
+  fail_unless_equals_int (11, construct_deterministic_initial_state (h, 200));
+
+  blocked_h = g_new0 (GstHarness *, num_blocked);
+  probes = g_new0 (gulong, num_blocked);
+  for (i = 0; i < num_blocked; i++) {
+    blocked_h[i] = gst_harness_new_parse ("rtpjitterbuffer shared-threads=1");
+    gst_harness_set_src_caps (blocked_h[i], generate_caps ());
+    probes[i] = gst_pad_add_probe (blocked_h[i]->sinkpad,
+        GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) count_blocked_probe, &blocked, NULL);
+    push_test_buffer (blocked_h[i], 0);
+    fail_unless (gst_harness_crank_single_clock_wait (blocked_h[i]));
+  }
+
+  /* every output thread is now stuck downstream, the last stream waits for
+   * a free thread */
+  while (g_atomic_int_get (&blocked) < num_blocked - 1)
+    g_usleep (G_USEC_PER_SEC / 100);
+
+  /* the rtx timer of the first stream still fires */
+  gst_harness_crank_single_clock_wait (h);
+  verify_rtx_event (h, 11, 11 * TEST_BUF_DURATION, 10, TEST_BUF_DURATION);
+
+  for (i = 0; i < num_blocked; i++) {
+    gst_pad_remove_probe (blocked_h[i]->sinkpad, probes[i]);
+    gst_harness_teardown (blocked_h[i]);
+  }
+  g_free (probes);
+  g_free (blocked_h);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+count_buffer_lists_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  guint *lengths = user_data;
+  GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+  *lengths += gst_buffer_list_length (list);
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_push_ready_run_as_buffer_list)
+{
+  GstHarness *h = gst_harness_new ("rtpjitterbuffer");
+  GstPad *srcpad;
+  guint in_lists = 0;
+  const gint num_consecutive = 5;
+  gint i;
+
+  gst_harness_set_src_caps (h, generate_caps ());
+
+  srcpad = gst_element_get_static_pad (h->element, "src");
+  gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      count_buffer_lists_probe, &in_lists, NULL);
+  gst_object_unref (srcpad);
+
+  /* the first packet waits for its deadline, the others queue up behind it
+   * and are all ready when it fires */
+  for (i = 0; i < num_consecutive; i++)
+    fail_unless_equals_int (GST_FLOW_OK,
+        gst_harness_push (h, generate_test_buffer (1000 + i)));
+
+  fail_unless (gst_harness_crank_single_clock_wait (h));
+
+  for (i = 0; i < num_consecutive; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+    fail_unless_equals_int (1000 + i, get_rtp_seq_num (buf));
+    gst_buffer_unref (buf);
+  }
+  fail_unless_equals_int (num_consecutive, in_lists);
+
+  /* a packet arriving in order on its own is pushed as a buffer */
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (h, generate_test_buffer (1000 + num_consecutive)));
+  gst_buffer_unref (gst_harness_pull (h));
+  fail_unless_equals_int (num_consecutive, in_lists);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 typedef struct
 {
   guint seqnum_offset;
@@ -2139,6 +2511,7 @@ rtpjitterbuffer_suite (void)
   tcase_add_test (tc_chain, test_push_forward_seq);
   tcase_add_test (tc_chain, test_push_backward_seq);
   tcase_add_test (tc_chain, test_push_unordered);
+  tcase_add_test (tc_chain, test_push_unordered_shared_threads);
   tcase_add_test (tc_chain, test_basetime);
   tcase_add_test (tc_chain, test_clear_pt_map);
 
@@ -2169,9 +2542,17 @@ rtpjitterbuffer_suite (void)
   tcase_add_test (tc_chain, test_rtx_same_delay_and_retry_timeout);
   tcase_add_test (tc_chain, test_rtx_with_backwards_rtptime);
   tcase_add_test (tc_chain, test_rtx_timer_reuse);
+  tcase_add_test (tc_chain, test_rtx_reorder_scan);
 
   tcase_add_test (tc_chain, test_deadline_ts_offset);
   tcase_add_test (tc_chain, test_push_big_gap);
+  tcase_add_test (tc_chain, test_ring_seqnum_wraparound);
+  tcase_add_test (tc_chain, test_ring_growth);
+  tcase_add_test (tc_chain, test_ring_event_order);
+  tcase_add_test (tc_chain, test_shared_threads_lost_event);
+  tcase_add_test (tc_chain, test_shared_threads_flush);
+  tcase_add_test (tc_chain, test_shared_threads_blocked_output);
+  tcase_add_test (tc_chain, test_push_ready_run_as_buffer_list);
 
   tcase_add_loop_test (tc_chain,
       test_considered_lost_packet_in_large_gap_arrives, 0,
@@ -572,6 +572,71 @@ GST_START_TEST (test_rtxsender_max_size_time)
 
 GST_END_TEST;
 
+GST_START_TEST (test_rtxsender_seqnum_wraparound)
+{
+  guint master_ssrc = 1234567;
+  guint master_pt = 96;
+  guint rtx_ssrc = 7654321;
+  guint rtx_pt = 99;
+  guint16 seqnum = G_MAXUINT16 - 5;
+  guint num_rtx_requests, num_rtx_packets;
+  GstHarness *h;
+  GstStructure *pt_map = gst_structure_new ("application/x-rtp-pt-map",
+      "96", G_TYPE_UINT, rtx_pt, NULL);
+  GstStructure *ssrc_map = gst_structure_new ("application/x-rtp-ssrc-map",
+      "1234567", G_TYPE_UINT, rtx_ssrc, NULL);
+  gint i;
+
+  h = gst_harness_new ("rtprtxsend");
+  g_object_set (h->element, "max-size-packets", 10,
+      "payload-type-map", pt_map, "ssrc-map", ssrc_map, NULL);
+  gst_harness_set_src_caps_str (h, "application/x-rtp, "
+      "media = (string)video, payload = (int)96, "
+      "ssrc = (uint)1234567, clock-rate = (int)90000, "
+      "encoding-name = (string)RAW");
+
+  /* seqnums go through 0 and the 3rd packet is lost upstream */
+  for (i = 0; i < 8; i++) {
+    if (i != 2)
+      push_pull_and_verify (h,
+          create_rtp_buffer (master_ssrc, master_pt, (guint16) (seqnum + i)),
+          FALSE, master_ssrc, master_pt, (guint16) (seqnum + i));
+  }
+
+  /* request all of them at once, like a NACK with a bitmask does */
+  for (i = 0; i < 8; i++)
+    gst_harness_push_upstream_event (h,
+        create_rtx_event (master_ssrc, master_pt, (guint16) (seqnum + i)));
+
+  for (i = 0; i < 8; i++) {
+    if (i != 2)
+      pull_and_verify (h, TRUE, rtx_ssrc, rtx_pt, (guint16) (seqnum + i));
+  }
+
+  /* a packet too old for max-size-packets is not retransmitted */
+  for (i = 8; i < 14; i++)
+    push_pull_and_verify (h,
+        create_rtp_buffer (master_ssrc, master_pt, (guint16) (seqnum + i)),
+        FALSE, master_ssrc, master_pt, (guint16) (seqnum + i));
+  gst_harness_push_upstream_event (h,
+      create_rtx_event (master_ssrc, master_pt, (guint16) (seqnum + 3)));
+  gst_harness_push_upstream_event (h,
+      create_rtx_event (master_ssrc, master_pt, (guint16) (seqnum + 4)));
+  pull_and_verify (h, TRUE, rtx_ssrc, rtx_pt, (guint16) (seqnum + 4));
+
+  g_object_get (h->element, "num-rtx-requests", &num_rtx_requests,
+      "num-rtx-packets", &num_rtx_packets, NULL);
+  fail_unless_equals_int (num_rtx_requests, 10);
+  fail_unless_equals_int (num_rtx_packets, 8);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 0);
+
+  gst_structure_free (pt_map);
+  gst_structure_free (ssrc_map);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 static Suite *
 rtprtx_suite (void)
 {
@@ -587,6 +652,7 @@ rtprtx_suite (void)
   tcase_add_test (tc_chain, test_multi_rtxsend_rtxreceive_with_packet_loss);
   tcase_add_test (tc_chain, test_rtxsender_max_size_packets);
   tcase_add_test (tc_chain, test_rtxsender_max_size_time);
+  tcase_add_test (tc_chain, test_rtxsender_seqnum_wraparound);
 
   return s;
 }
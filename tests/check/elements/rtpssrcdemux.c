@@ -0,0 +1,232 @@
+/* GStreamer
+ *
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <gst/rtp/gstrtcpbuffer.h>
+
+#define TEST_BUF_SIZE 64
+#define TEST_SSRC_BASE 0x10000000
+
+typedef struct
+{
+  GstHarness *rtp_h;
+  GstHarness *rtcp_h;
+  gint num_pads;
+  gint rtp_received;
+  gint rtcp_received;
+} TestData;
+
+static GstBuffer *
+generate_rtp_buffer (guint32 ssrc, guint16 seqnum)
+{
+  GstBuffer *buf;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+
+  buf = gst_rtp_buffer_new_allocate (TEST_BUF_SIZE, 0, 0);
+  gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_seq (&rtp, seqnum);
+  gst_rtp_buffer_set_ssrc (&rtp, ssrc);
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buf;
+}
+
+static GstBuffer *
+generate_rtcp_buffer (guint32 ssrc)
+{
+  GstBuffer *buf;
+  GstRTCPBuffer rtcp = GST_RTCP_BUFFER_INIT;
+  GstRTCPPacket packet;
+
+  buf = gst_rtcp_buffer_new (1000);
+  gst_rtcp_buffer_map (buf, GST_MAP_READWRITE, &rtcp);
+  gst_rtcp_buffer_add_packet (&rtcp, GST_RTCP_TYPE_RR, &packet);
+  gst_rtcp_packet_rr_set_ssrc (&packet, ssrc);
+  gst_rtcp_buffer_unmap (&rtcp);
+
+  return buf;
+}
+
+static GstPadProbeReturn
+drop_and_count_probe (GstPad * pad, GstPadProbeInfo * info, gint * received)
+{
+  g_atomic_int_inc (received);
+  return GST_PAD_PROBE_DROP;
+}
+
+static void
+new_ssrc_pad_cb (GstElement * demux, guint ssrc, GstPad * pad,
+    TestData * data)
+{
+  GstPad *rtcp_pad;
+  gchar *name;
+
+  g_atomic_int_inc (&data->num_pads);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) drop_and_count_probe, &data->rtp_received, NULL);
+
+  name = g_strdup_printf ("rtcp_src_%u", ssrc);
+  rtcp_pad = gst_element_get_static_pad (demux, name);
+  g_free (name);
+  gst_pad_add_probe (rtcp_pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) drop_and_count_probe, &data->rtcp_received, NULL);
+  gst_object_unref (rtcp_pad);
+}
+
+static void
+setup_testharness (TestData * data)
+{
+  memset (data, 0, sizeof (TestData));
+
+  data->rtp_h = gst_harness_new_with_padnames ("rtpssrcdemux", "sink", NULL);
+  data->rtcp_h = gst_harness_new_with_element (data->rtp_h->element,
+      "rtcp_sink", NULL);
+  gst_harness_set_src_caps_str (data->rtp_h, "application/x-rtp");
+  gst_harness_set_src_caps_str (data->rtcp_h, "application/x-rtcp");
+
+  g_signal_connect (data->rtp_h->element, "new-ssrc-pad",
+      G_CALLBACK (new_ssrc_pad_cb), data);
+}
+
+static void
+destroy_testharness (TestData * data)
+{
+  gst_harness_teardown (data->rtcp_h);
+  gst_harness_teardown (data->rtp_h);
+}
+
+GST_START_TEST (test_clear_ssrc)
+{
+  TestData data;
+
+  setup_testharness (&data);
+
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (data.rtp_h, generate_rtp_buffer (TEST_SSRC_BASE, 0)));
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (data.rtcp_h, generate_rtcp_buffer (TEST_SSRC_BASE)));
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (data.rtp_h, generate_rtp_buffer (TEST_SSRC_BASE, 1)));
+  fail_unless_equals_int (1, data.num_pads);
+  fail_unless_equals_int (2, data.rtp_received);
+  fail_unless_equals_int (1, data.rtcp_received);
+
+  /* the next packet of a cleared SSRC creates a new pad */
+  g_signal_emit_by_name (data.rtp_h->element, "clear-ssrc", TEST_SSRC_BASE);
+  fail_unless_equals_int (GST_FLOW_OK,
+      gst_harness_push (data.rtp_h, generate_rtp_buffer (TEST_SSRC_BASE, 2)));
+  fail_unless_equals_int (2, data.num_pads);
+  fail_unless_equals_int (3, data.rtp_received);
+
+  destroy_testharness (&data);
+}
+
+GST_END_TEST;
+
+#define RACE_PACKETS 20000
+#define RACE_SSRCS 16
+
+typedef struct
+{
+  TestData *data;
+  volatile gint stop;
+} RaceThreadData;
+
+static gpointer
+push_rtcp_thread (RaceThreadData * tdata)
+{
+  guint i = 0;
+
+  while (!g_atomic_int_get (&tdata->stop)) {
+    guint32 ssrc = TEST_SSRC_BASE + (i++ % RACE_SSRCS);
+
+    gst_harness_push (tdata->data->rtcp_h, generate_rtcp_buffer (ssrc));
+  }
+
+  return NULL;
+}
+
+static gpointer
+clear_ssrc_thread (RaceThreadData * tdata)
+{
+  guint i = 0;
+
+  while (!g_atomic_int_get (&tdata->stop)) {
+    guint32 ssrc = TEST_SSRC_BASE + (i++ % RACE_SSRCS);
+
+    g_signal_emit_by_name (tdata->data->rtp_h->element, "clear-ssrc", ssrc);
+    g_thread_yield ();
+  }
+
+  return NULL;
+}
+
+GST_START_TEST (test_clear_ssrc_race)
+{
+  TestData data;
+  RaceThreadData tdata;
+  GThread *rtcp_thread, *clear_thread;
+  guint i;
+
+  setup_testharness (&data);
+
+  /* the lookups of both chain functions race with the pads being cleared
+   * and created again, which publishes a new table every time */
+  tdata.data = &data;
+  tdata.stop = 0;
+  rtcp_thread = g_thread_new ("rtcp", (GThreadFunc) push_rtcp_thread, &tdata);
+  clear_thread = g_thread_new ("clear", (GThreadFunc) clear_ssrc_thread,
+      &tdata);
+
+  for (i = 0; i < RACE_PACKETS; i++)
+    gst_harness_push (data.rtp_h,
+        generate_rtp_buffer (TEST_SSRC_BASE + (i % RACE_SSRCS), i));
+
+  g_atomic_int_set (&tdata.stop, 1);
+  g_thread_join (rtcp_thread);
+  g_thread_join (clear_thread);
+
+  /* a packet may be dropped when its pad goes away during the push */
+  fail_unless (g_atomic_int_get (&data.num_pads) >= RACE_SSRCS);
+  fail_unless (g_atomic_int_get (&data.rtp_received) > 0);
+  fail_unless (g_atomic_int_get (&data.rtp_received) <= RACE_PACKETS);
+
+  destroy_testharness (&data);
+}
+
+GST_END_TEST;
+
+static Suite *
+rtpssrcdemux_suite (void)
+{
+  Suite *s = suite_create ("rtpssrcdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_clear_ssrc);
+  tcase_add_test (tc_chain, test_clear_ssrc_race);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtpssrcdemux);
@@ -0,0 +1,482 @@
+/* GStreamer
+ *
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* These tests run the v4l2 elements against the software emulated devices
+ * of the plugin, selected with "fake:" device strings. */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/gstvideometa.h>
+
+#define FAKE_CAPTURE "fake:capture,width=320,height=240"
+
+/* The M2M devices are probed when the plugin loads, as v4l2fake0convert,
+ * v4l2fake1dec and v4l2fake2convert */
+#define FAKE_M2M_DEVICES "fake:convert,latency=2000;fake:decoder;" \
+    "fake:convert,crop=2"
+
+#define RAW_CAPS "video/x-raw,format=NV12,width=320,height=240,framerate=30/1"
+#define RAW_SIZE (320 * 240 * 3 / 2)
+
+#define H264_CAPS "video/x-h264,stream-format=byte-stream,alignment=au," \
+    "width=320,height=240"
+
+/* VIDEO_MAX_FRAME of videodev2.h */
+#define MAX_FRAMES 32
+
+static GstHarness *
+setup_v4l2src (const gchar * device)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_padnames ("v4l2src", NULL, "src");
+  g_object_set (h->element, "device", device, "io-mode", 2, NULL);
+
+  return h;
+}
+
+static GstStructure *
+get_queue_stats (GstHarness * h, const gchar * queue)
+{
+  GstStructure *stats, *s = NULL;
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+  fail_unless (gst_structure_get (stats, queue, GST_TYPE_STRUCTURE, &s,
+          NULL));
+  gst_structure_free (stats);
+
+  return s;
+}
+
+static GstStructure *
+get_capture_stats (GstHarness * h)
+{
+  return get_queue_stats (h, "capture");
+}
+
+static guint
+get_stat (GstStructure * s, const gchar * name)
+{
+  guint value = 0;
+
+  fail_unless (gst_structure_get_uint (s, name, &value));
+
+  return value;
+}
+
+GST_START_TEST (test_pool_growth_is_bounded)
+{
+  GstHarness *h = setup_v4l2src (FAKE_CAPTURE);
+  GstStructure *s;
+  GQueue held = G_QUEUE_INIT;
+  guint buffers, max_buffers;
+  gint i;
+
+  gst_harness_play (h);
+
+  /* hold on more buffers than the device could ever allocate, the pool
+   * must grow and then fall back to copies */
+  for (i = 0; i < 2 * MAX_FRAMES; i++)
+    g_queue_push_tail (&held, gst_harness_pull (h));
+
+  s = get_capture_stats (h);
+  buffers = get_stat (s, "buffers");
+  max_buffers = get_stat (s, "max-buffers");
+  fail_unless (get_stat (s, "grown") > 0);
+  fail_unless (get_stat (s, "copies") > 0);
+  fail_unless (max_buffers < MAX_FRAMES);
+  fail_unless (buffers <= max_buffers, "pool grew to %u buffers, limit %u",
+      buffers, max_buffers);
+  gst_structure_free (s);
+
+  g_queue_free_full (&held, (GDestroyNotify) gst_buffer_unref);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pool_trim_flush)
+{
+  GstHarness *h = setup_v4l2src (FAKE_CAPTURE);
+  GstStructure *s;
+  GQueue held = G_QUEUE_INIT;
+  guint trimmed;
+  gint i;
+
+  g_object_set (h->element, "pool-trim-period", GST_MSECOND, NULL);
+  gst_harness_play (h);
+
+  for (i = 0; i < MAX_FRAMES; i++)
+    g_queue_push_tail (&held, gst_harness_pull (h));
+  g_queue_free_full (&held, (GDestroyNotify) gst_buffer_unref);
+
+  /* once downstream stops holding, the extra buffers get parked */
+  for (i = 0; i < 100; i++) {
+    g_usleep (2000);
+    gst_buffer_unref (gst_harness_pull (h));
+  }
+
+  s = get_capture_stats (h);
+  trimmed = get_stat (s, "trimmed");
+  fail_unless (trimmed > 0);
+  gst_structure_free (s);
+
+  fail_unless (gst_harness_push_upstream_event (h,
+          gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_upstream_event (h,
+          gst_event_new_flush_stop (TRUE)));
+
+  /* the flush brought every parked buffer back in the capture queue */
+  s = get_capture_stats (h);
+  fail_unless_equals_int (get_stat (s, "parked"), 0);
+  gst_structure_free (s);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_latest_frame)
+{
+  GstHarness *h = setup_v4l2src (FAKE_CAPTURE);
+  GstStructure *stats, *s;
+  guint64 lost = 0, dropped = 0;
+  gint i;
+
+  g_object_set (h->element, "latest-frame", TRUE, NULL);
+  gst_harness_play (h);
+
+  /* a slow consumer only gets the most recent frames, the skipped ones
+   * are not reported as lost */
+  for (i = 0; i < 10; i++) {
+    gst_buffer_unref (gst_harness_pull (h));
+    g_usleep (20000);
+  }
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "latest-dropped", &dropped));
+  fail_unless (gst_structure_get_uint64 (stats, "lost", &lost));
+  fail_unless (dropped > 0);
+  fail_unless_equals_uint64 (lost, 0);
+
+  fail_unless (gst_structure_get (stats, "capture", GST_TYPE_STRUCTURE, &s,
+          NULL));
+  fail_unless (get_stat (s, "latest-dropped") > 0);
+  gst_structure_free (s);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_sink_io_mode_switch)
+{
+  GstHarness *src = setup_v4l2src (FAKE_CAPTURE);
+  GstHarness *h;
+  GstStructure *s;
+  gint i;
+
+  /* dmabuf exported by the capture device, with the layout of the output
+   * device */
+  g_object_set (src->element, "io-mode", 4, NULL);
+  gst_harness_set_sink_caps_str (src, RAW_CAPS);
+  gst_harness_play (src);
+
+  h = gst_harness_new ("v4l2sink");
+  g_object_set (h->element, "device", "fake:output,width=320,height=240",
+      "sync", FALSE, NULL);
+  gst_harness_set_src_caps_str (h, RAW_CAPS);
+
+  for (i = 0; i < 5; i++)
+    fail_unless_equals_int (gst_harness_push (h, gst_harness_pull (src)),
+        GST_FLOW_OK);
+
+  s = get_queue_stats (h, "output");
+  fail_unless (get_stat (s, "imports") > 0);
+  fail_unless_equals_int (get_stat (s, "copies"), 0);
+  gst_structure_free (s);
+
+  /* system memory can't be imported, the sink replaces its pool and keeps
+   * copying from then on */
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_new_allocate (NULL, RAW_SIZE, NULL)), GST_FLOW_OK);
+  for (i = 0; i < 5; i++)
+    fail_unless_equals_int (gst_harness_push (h, gst_harness_pull (src)),
+        GST_FLOW_OK);
+
+  s = get_queue_stats (h, "output");
+  fail_unless_equals_int (get_stat (s, "imports"), 0);
+  fail_unless (get_stat (s, "copies") >= 6);
+  gst_structure_free (s);
+
+  gst_harness_teardown (h);
+  gst_harness_teardown (src);
+}
+
+GST_END_TEST;
+
+static GstHarness *
+setup_m2m (const gchar * factory)
+{
+  GstElement *element;
+
+  /* GST_V4L2_FAKE_DEVICES is set before the plugin loads, so the devices
+   * must have been probed */
+  element = gst_element_factory_make (factory, NULL);
+  fail_unless (element != NULL, "%s was not registered", factory);
+
+  return gst_harness_new_with_element (element, "sink", "src");
+}
+
+static GstPadProbeReturn
+record_data_order (GstPad * pad, GstPadProbeInfo * info, GString * order)
+{
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+    g_string_append_c (order, 'B');
+  else if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+      GST_EVENT_CUSTOM_DOWNSTREAM)
+    g_string_append_c (order, 'E');
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_transform_pipelined_event_order)
+{
+  GstHarness *h = setup_m2m ("v4l2fake0convert");
+  GString *order, *expected;
+  GstPad *srcpad;
+  gint i;
+
+  order = g_string_new (NULL);
+  expected = g_string_new (NULL);
+
+  g_object_set (h->element, "max-in-flight", 4, NULL);
+  gst_harness_set_src_caps_str (h, RAW_CAPS);
+  gst_harness_set_sink_caps_str (h,
+      "video/x-raw,format=YUYV,width=320,height=240,framerate=30/1");
+  gst_harness_set_drop_buffers (h, TRUE);
+
+  srcpad = gst_element_get_static_pad (h->element, "src");
+  gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) record_data_order, order, NULL);
+  gst_object_unref (srcpad);
+
+  /* with several frames in flight, the serialized events must still be
+   * pushed after the frame that was queued before them */
+  for (i = 0; i < 10; i++) {
+    GstBuffer *buf = gst_harness_create_buffer (h, RAW_SIZE);
+
+    GST_BUFFER_PTS (buf) = i * GST_SECOND / 30;
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+    fail_unless (gst_harness_push_event (h,
+            gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM,
+                gst_structure_new_empty ("test"))));
+    g_string_append (expected, "BE");
+  }
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_string (order->str, expected->str);
+
+  g_string_free (order, TRUE);
+  g_string_free (expected, TRUE);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static gboolean
+proposes_crop_meta (GstHarness * h)
+{
+  GstCaps *caps = gst_caps_from_string (RAW_CAPS);
+  GstQuery *query = gst_query_new_allocation (caps, TRUE);
+  gboolean ret;
+
+  fail_unless (gst_pad_peer_query (h->srcpad, query));
+  ret = gst_query_find_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE,
+      NULL);
+
+  gst_query_unref (query);
+  gst_caps_unref (caps);
+
+  return ret;
+}
+
+GST_START_TEST (test_transform_crop_busy)
+{
+  GstHarness *h = setup_m2m ("v4l2fake2convert");
+  GstBus *bus;
+  GstMessage *msg;
+  GstBuffer *buf;
+  gint i;
+
+  bus = gst_bus_new ();
+  gst_element_set_bus (h->element, bus);
+
+  gst_harness_set_src_caps_str (h, RAW_CAPS);
+  gst_harness_set_sink_caps_str (h,
+      "video/x-raw,format=YUYV,width=160,height=120,framerate=30/1");
+
+  buf = gst_harness_create_buffer (h, RAW_SIZE);
+  fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  gst_buffer_unref (gst_harness_pull (h));
+  fail_unless (proposes_crop_meta (h));
+
+  /* the device refuses to crop while streaming, this must not be fatal and
+   * upstream has to crop from now on */
+  for (i = 0; i < 2; i++) {
+    GstVideoCropMeta *meta;
+
+    buf = gst_harness_create_buffer (h, RAW_SIZE);
+    meta = gst_buffer_add_video_crop_meta (buf);
+    meta->width = 160;
+    meta->height = 120;
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+    gst_buffer_unref (gst_harness_pull (h));
+  }
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_WARNING);
+  fail_unless (msg != NULL);
+  gst_message_unref (msg);
+
+  fail_if (proposes_crop_meta (h));
+
+  gst_element_set_bus (h->element, NULL);
+  gst_object_unref (bus);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* A "coded" frame of the fake decoder, announcing a new sequence if
+ * refs is not 0 */
+static GstBuffer *
+create_coded_frame (GstHarness * h, guint32 width, guint32 height,
+    guint32 refs, gint n)
+{
+  GstBuffer *buf = gst_harness_create_buffer (h, 1024);
+  guint32 header[3] = { width, height, refs };
+  GstMapInfo map;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  memset (map.data, 0, map.size);
+  if (refs) {
+    memcpy (map.data, "FAKESEQ", 8);
+    memcpy (map.data + 8, header, sizeof (header));
+  }
+  gst_buffer_unmap (buf, &map);
+
+  GST_BUFFER_PTS (buf) = n * GST_SECOND / 30;
+  GST_BUFFER_DURATION (buf) = GST_SECOND / 30;
+
+  return buf;
+}
+
+static guint
+decode_sequence (GstHarness * h, guint32 width, guint32 height, guint32 refs,
+    const gchar * framerate, gint * n)
+{
+  GstStructure *s;
+  guint start_buffers;
+  gchar *caps;
+  gint i;
+
+  caps = g_strdup_printf (H264_CAPS ",framerate=%s", framerate);
+  gst_harness_set_src_caps_str (h, caps);
+  g_free (caps);
+
+  for (i = 0; i < 5; i++, (*n)++) {
+    fail_unless_equals_int (gst_harness_push (h, create_coded_frame (h,
+                width, height, i == 0 ? refs : 0, *n)), GST_FLOW_OK);
+    gst_buffer_unref (gst_harness_pull (h));
+  }
+
+  s = get_capture_stats (h);
+  start_buffers = get_stat (s, "start-buffers");
+  gst_structure_free (s);
+
+  return start_buffers;
+}
+
+GST_START_TEST (test_decoder_capture_reconfigure)
+{
+  GstHarness *h = setup_m2m ("v4l2fake1dec");
+  guint first, smaller, more_refs;
+  gint n = 0;
+
+  /* The sequence header is processed before the caps change drains the
+   * capture queue, like with a real stream */
+  first = decode_sequence (h, 320, 240, 4, "30/1", &n);
+
+  /* a smaller frame fits in the current buffers, they are kept */
+  fail_unless_equals_int (gst_harness_push (h,
+          create_coded_frame (h, 160, 120, 4, n++)), GST_FLOW_OK);
+  gst_buffer_unref (gst_harness_pull (h));
+  smaller = decode_sequence (h, 160, 120, 0, "25/1", &n);
+  fail_unless_equals_int (smaller, first);
+
+  /* more reference frames need more buffers, even if the frames fit */
+  fail_unless_equals_int (gst_harness_push (h,
+          create_coded_frame (h, 160, 120, 8, n++)), GST_FLOW_OK);
+  gst_buffer_unref (gst_harness_pull (h));
+  more_refs = decode_sequence (h, 160, 120, 0, "30/1", &n);
+  fail_unless (more_refs >= first + 4, "pool has %u buffers for 8 refs, "
+      "had %u for 4", more_refs, first);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+v4l2fake_suite (void)
+{
+  Suite *s = suite_create ("v4l2fake");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_pool_growth_is_bounded);
+  tcase_add_test (tc_chain, test_pool_trim_flush);
+  tcase_add_test (tc_chain, test_latest_frame);
+  tcase_add_test (tc_chain, test_sink_io_mode_switch);
+  tcase_add_test (tc_chain, test_transform_pipelined_event_order);
+  tcase_add_test (tc_chain, test_transform_crop_busy);
+  tcase_add_test (tc_chain, test_decoder_capture_reconfigure);
+
+  return s;
+}
+
+int
+main (int argc, char **argv)
+{
+  Suite *s;
+
+  /* Must be set before the plugin is loaded */
+  g_setenv ("GST_V4L2_FAKE_DEVICES", FAKE_M2M_DEVICES, TRUE);
+
+  gst_check_init (&argc, &argv);
+  s = v4l2fake_suite ();
+
+  return gst_check_run_suite (s, "v4l2fake", __FILE__);
+}
@@ -0,0 +1,146 @@
+/* GStreamer H.264/H.265 RTP depayloader access unit assembly benchmark
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* Pushes IDR frames through the H.264 and H.265 payloaders and
+ * depayloaders and reports the frame rate, along with the part of the output
+ * data that still shares the memory of the packets instead of being copied.
+ *
+ *   rtp-depay-bench --frames=600 --size=262144 --mtu=1400
+ */
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+static gint opt_frames = 600;
+static gint opt_size = 256 * 1024;
+static gint opt_mtu = 1400;
+
+static GstBuffer *
+create_frame (gboolean h265)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+
+  buf = gst_buffer_new_allocate (NULL, opt_size, NULL);
+  gst_buffer_memset (buf, 0, 0x11, opt_size);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT32_BE (map.data, 1);
+  if (h265) {
+    /* IDR_W_RADL, first slice segment */
+    map.data[4] = 0x26;
+    map.data[5] = 0x01;
+    map.data[6] = 0xaf;
+  } else {
+    map.data[4] = 0x65;
+    map.data[5] = 0x88;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  return buf;
+}
+
+static void
+run_bench (const gchar * codec)
+{
+  gboolean h265 = g_str_equal (codec, "h265");
+  GstHarness *h;
+  GstBuffer *inbuf, *outbuf;
+  gchar *desc, *caps;
+  GTimer *timer;
+  gdouble elapsed;
+  guint64 total = 0, shared = 0;
+  guint i, j;
+
+  desc = g_strdup_printf ("rtp%spay mtu=%d ! rtp%sdepay", codec, opt_mtu,
+      codec);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+
+  caps = g_strdup_printf ("video/x-%s,stream-format=(string)byte-stream,"
+      "alignment=(string)au", codec);
+  gst_harness_set_src_caps_str (h, caps);
+  gst_harness_set_sink_caps_str (h, caps);
+  g_free (caps);
+
+  inbuf = create_frame (h265);
+
+  timer = g_timer_new ();
+  for (i = 0; i < opt_frames; i++) {
+    GstBuffer *buf = gst_buffer_copy (inbuf);
+
+    GST_BUFFER_PTS (buf) = i * GST_SECOND / 60;
+    if (gst_harness_push (h, buf) != GST_FLOW_OK)
+      break;
+
+    while ((outbuf = gst_harness_try_pull (h))) {
+      for (j = 0; j < gst_buffer_n_memory (outbuf); j++) {
+        GstMemory *mem = gst_buffer_peek_memory (outbuf, j);
+
+        if (mem->parent)
+          shared += mem->size;
+      }
+      total += gst_buffer_get_size (outbuf);
+      gst_buffer_unref (outbuf);
+    }
+  }
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_print ("%s: %u frames of %d bytes, %8.1f fps, %5.1f%% shared\n", codec,
+      i, opt_size, i / elapsed, total ? 100.0 * shared / total : 0.0);
+
+  gst_buffer_unref (inbuf);
+  gst_harness_teardown (h);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionEntry options[] = {
+    {"frames", 'n', 0, G_OPTION_ARG_INT, &opt_frames,
+        "Number of frames to push", NULL},
+    {"size", 's', 0, G_OPTION_ARG_INT, &opt_size,
+        "Size of a frame in bytes", NULL},
+    {"mtu", 'm', 0, G_OPTION_ARG_INT, &opt_mtu,
+        "MTU of the payloaders", NULL},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+
+  ctx = g_option_context_new ("- RTP depayloader assembly benchmark");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  run_bench ("h264");
+  run_bench ("h265");
+
+  return 0;
+}
@@ -0,0 +1,198 @@
+/* GStreamer RTP SSRC demuxer lookup benchmark
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* Pushes RTP packets round-robin over 1 to 1024 SSRCs through rtpssrcdemux
+ * while RTCP packets for the same SSRCs are pushed from another thread, and
+ * reports the RTP packets per second.
+ *
+ *   rtpssrcdemux-bench --packets=200000
+ */
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <gst/rtp/gstrtcpbuffer.h>
+
+#define BUF_SIZE 64
+#define SSRC_BASE 0x10000000
+
+static gint opt_packets = 200000;
+
+typedef struct
+{
+  GstHarness *rtp_h;
+  GstHarness *rtcp_h;
+  guint num_ssrcs;
+  gint rtp_received;
+  gint rtcp_received;
+  volatile gint stop;
+} BenchData;
+
+static GstBuffer *
+generate_rtp_buffer (guint32 ssrc)
+{
+  GstBuffer *buf;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+
+  buf = gst_rtp_buffer_new_allocate (BUF_SIZE, 0, 0);
+  gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_ssrc (&rtp, ssrc);
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buf;
+}
+
+static GstBuffer *
+generate_rtcp_buffer (guint32 ssrc)
+{
+  GstBuffer *buf;
+  GstRTCPBuffer rtcp = GST_RTCP_BUFFER_INIT;
+  GstRTCPPacket packet;
+
+  buf = gst_rtcp_buffer_new (1000);
+  gst_rtcp_buffer_map (buf, GST_MAP_READWRITE, &rtcp);
+  gst_rtcp_buffer_add_packet (&rtcp, GST_RTCP_TYPE_RR, &packet);
+  gst_rtcp_packet_rr_set_ssrc (&packet, ssrc);
+  gst_rtcp_buffer_unmap (&rtcp);
+
+  return buf;
+}
+
+static GstPadProbeReturn
+drop_and_count_probe (GstPad * pad, GstPadProbeInfo * info, gint * received)
+{
+  g_atomic_int_inc (received);
+  return GST_PAD_PROBE_DROP;
+}
+
+static void
+new_ssrc_pad_cb (GstElement * demux, guint ssrc, GstPad * pad,
+    BenchData * data)
+{
+  GstPad *rtcp_pad;
+  gchar *name;
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) drop_and_count_probe, &data->rtp_received, NULL);
+
+  name = g_strdup_printf ("rtcp_src_%u", ssrc);
+  rtcp_pad = gst_element_get_static_pad (demux, name);
+  g_free (name);
+  gst_pad_add_probe (rtcp_pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) drop_and_count_probe, &data->rtcp_received, NULL);
+  gst_object_unref (rtcp_pad);
+}
+
+static gpointer
+push_rtcp_thread (BenchData * data)
+{
+  guint i = 0;
+
+  while (!g_atomic_int_get (&data->stop)) {
+    guint32 ssrc = SSRC_BASE + (i++ % data->num_ssrcs);
+
+    gst_harness_push (data->rtcp_h, generate_rtcp_buffer (ssrc));
+  }
+
+  return NULL;
+}
+
+static void
+run_bench (guint num_ssrcs)
+{
+  BenchData data = { NULL, };
+  GstBuffer **bufs;
+  GThread *thread;
+  GTimer *timer;
+  gdouble elapsed;
+  guint i;
+
+  data.num_ssrcs = num_ssrcs;
+  data.rtp_h = gst_harness_new_with_padnames ("rtpssrcdemux", "sink", NULL);
+  data.rtcp_h = gst_harness_new_with_element (data.rtp_h->element,
+      "rtcp_sink", NULL);
+  gst_harness_set_src_caps_str (data.rtp_h, "application/x-rtp");
+  gst_harness_set_src_caps_str (data.rtcp_h, "application/x-rtcp");
+  g_signal_connect (data.rtp_h->element, "new-ssrc-pad",
+      G_CALLBACK (new_ssrc_pad_cb), &data);
+
+  bufs = g_new (GstBuffer *, num_ssrcs);
+  for (i = 0; i < num_ssrcs; i++) {
+    bufs[i] = generate_rtp_buffer (SSRC_BASE + i);
+    /* make the pads before measuring */
+    gst_harness_push (data.rtp_h, gst_buffer_ref (bufs[i]));
+  }
+
+  thread = g_thread_new ("rtcp", (GThreadFunc) push_rtcp_thread, &data);
+
+  timer = g_timer_new ();
+  for (i = 0; i < opt_packets; i++)
+    gst_harness_push (data.rtp_h, gst_buffer_ref (bufs[i % num_ssrcs]));
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_atomic_int_set (&data.stop, 1);
+  g_thread_join (thread);
+
+  g_print ("%5u SSRCs: %10.0f packets/s, %d RTCP packets meanwhile\n",
+      num_ssrcs, opt_packets / elapsed,
+      g_atomic_int_get (&data.rtcp_received));
+
+  for (i = 0; i < num_ssrcs; i++)
+    gst_buffer_unref (bufs[i]);
+  g_free (bufs);
+
+  gst_harness_teardown (data.rtcp_h);
+  gst_harness_teardown (data.rtp_h);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const guint num_ssrcs[] = { 1, 16, 256, 1024 };
+  GOptionEntry options[] = {
+    {"packets", 'n', 0, G_OPTION_ARG_INT, &opt_packets,
+        "Number of RTP packets to push for each SSRC count", NULL},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+  guint i;
+
+  ctx = g_option_context_new ("- rtpssrcdemux lookup benchmark");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  for (i = 0; i < G_N_ELEMENTS (num_ssrcs); i++)
+    run_bench (num_ssrcs[i]);
+
+  return 0;
+}
@@ -0,0 +1,294 @@
+/* GStreamer V4L2 buffer passing benchmark
+ * Copyright (C) 2026 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* Runs v4l2src, v4l2sink, v4l2convert, v4l2 decoder and encoder pipelines
+ * against the software emulated V4L2 devices ("fake:" device strings) and
+ * reports the throughput, the qbuf to dqbuf latency percentiles measured by
+ * the emulated devices and the number of fallback copies made per frame.
+ *
+ *   v4l2-bench --frames=1000 --latency=2000 --io-mode=dmabuf
+ */
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+
+static gint opt_frames = 1000;
+static gint opt_latency = 0;
+static gint opt_width = 1280;
+static gint opt_height = 720;
+static gchar *opt_io_mode = NULL;
+static gchar *opt_test = NULL;
+
+static gint n_frames;
+static gint n_copies;
+static GstClockTime first_ts;
+static GstClockTime last_ts;
+
+static void
+count_copies (GstDebugCategory * category, GstDebugLevel level,
+    const gchar * file, const gchar * function, gint line, GObject * object,
+    GstDebugMessage * message, gpointer user_data)
+{
+  if (strcmp (gst_debug_category_get_name (category), "GST_PERFORMANCE"))
+    return;
+
+  if (g_str_has_prefix (gst_debug_message_get (message), "slow copy"))
+    g_atomic_int_inc (&n_copies);
+}
+
+static GstPadProbeReturn
+count_frames (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+
+  if (g_atomic_int_add (&n_frames, 1) == 0)
+    first_ts = now;
+  last_ts = now;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+print_stats (const GstStructure * s)
+{
+  guint frames = 0;
+  guint64 p50 = 0, p90 = 0, p99 = 0;
+
+  gst_structure_get (s, "frames", G_TYPE_UINT, &frames,
+      "latency-p50", G_TYPE_UINT64, &p50,
+      "latency-p90", G_TYPE_UINT64, &p90,
+      "latency-p99", G_TYPE_UINT64, &p99, NULL);
+
+  g_print ("    %-7s queue: %6u buffers, qbuf->dqbuf p50 %7.3f ms, "
+      "p90 %7.3f ms, p99 %7.3f ms\n", gst_structure_get_string (s, "queue"),
+      frames, (gdouble) p50 / GST_MSECOND, (gdouble) p90 / GST_MSECOND,
+      (gdouble) p99 / GST_MSECOND);
+}
+
+static void
+feed_decoder (GstElement * appsrc, guint size, gpointer user_data)
+{
+  static const guint8 idr[] = { 0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84 };
+  static gint n = 0;
+  GstBuffer *buf;
+  GstFlowReturn ret;
+
+  if (n >= opt_frames) {
+    n = 0;
+    g_signal_emit_by_name (appsrc, "end-of-stream", &ret);
+    return;
+  }
+
+  buf = gst_buffer_new_allocate (NULL, 4096, NULL);
+  gst_buffer_fill (buf, 0, idr, sizeof (idr));
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale (n, GST_SECOND, 30);
+  GST_BUFFER_DURATION (buf) = GST_SECOND / 30;
+  n++;
+
+  g_signal_emit_by_name (appsrc, "push-buffer", buf, &ret);
+  gst_buffer_unref (buf);
+}
+
+static void
+run_bench (const gchar * name, const gchar * description)
+{
+  GstElement *pipeline, *sink, *src;
+  GstMessage *msg;
+  GstBus *bus;
+  GstPad *pad;
+  GError *err = NULL;
+  gdouble elapsed;
+
+  pipeline = gst_parse_launch (description, &err);
+  if (pipeline == NULL) {
+    g_printerr ("%s: could not create pipeline: %s\n", name, err->message);
+    g_clear_error (&err);
+    return;
+  }
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) count_frames, NULL, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  if (src) {
+    g_signal_connect (src, "need-data", G_CALLBACK (feed_decoder), NULL);
+    gst_object_unref (src);
+  }
+
+  n_frames = 0;
+  n_copies = 0;
+  first_ts = last_ts = 0;
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gchar *debug = NULL;
+
+    gst_message_parse_error (msg, &err, &debug);
+    g_printerr ("%s: %s\n%s\n", name, err->message, debug ? debug : "");
+    g_clear_error (&err);
+    g_free (debug);
+  }
+  gst_message_unref (msg);
+
+  /* The emulated devices post their statistics when streaming stops, the bus
+   * is only flushed when going to NULL */
+  gst_element_set_state (pipeline, GST_STATE_READY);
+
+  elapsed = (gdouble) (last_ts - first_ts) / GST_SECOND;
+  g_print ("%-10s %6d frames, %8.1f fps, %5.2f copies/frame\n", name,
+      n_frames, n_frames > 1 && elapsed > 0 ? (n_frames - 1) / elapsed : 0.0,
+      n_frames ? (gdouble) n_copies / n_frames : 0.0);
+
+  while ((msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT))) {
+    const GstStructure *s = gst_message_get_structure (msg);
+
+    if (gst_structure_has_name (s, "v4l2-fake-stats"))
+      print_stats (s);
+    gst_message_unref (msg);
+  }
+
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+int
+main (int argc, char **argv)
+{
+  const GOptionEntry options[] = {
+    {"frames", 'n', 0, G_OPTION_ARG_INT, &opt_frames,
+        "Number of frames per test (default: 1000)", NULL},
+    {"latency", 'l', 0, G_OPTION_ARG_INT, &opt_latency,
+        "Emulated device latency in microseconds (default: 0)", NULL},
+    {"width", 'W', 0, G_OPTION_ARG_INT, &opt_width,
+        "Frame width (default: 1280)", NULL},
+    {"height", 'H', 0, G_OPTION_ARG_INT, &opt_height,
+        "Frame height (default: 720)", NULL},
+    {"io-mode", 'm', 0, G_OPTION_ARG_STRING, &opt_io_mode,
+        "I/O mode: auto, mmap, userptr, dmabuf or dmabuf-import "
+          "(default: auto)", NULL},
+    {"test", 't', 0, G_OPTION_ARG_STRING, &opt_test,
+        "Only run one of: src, sink, convert, dec, enc", NULL},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gchar *devices, *desc;
+  const gchar *io_mode;
+
+  ctx = g_option_context_new ("");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  /* Must be set before the plugin is loaded, the M2M elements are
+   * registered as v4l2fake0convert, v4l2fake1dec and v4l2fake2enc */
+  devices = g_strdup_printf ("fake:convert,latency=%d;fake:decoder,"
+      "latency=%d;fake:encoder,latency=%d", opt_latency, opt_latency,
+      opt_latency);
+  g_setenv ("GST_V4L2_FAKE_DEVICES", devices, TRUE);
+  g_free (devices);
+
+  gst_init (&argc, &argv);
+
+  /* Only count the copies, the default handler would print them */
+  gst_debug_set_active (TRUE);
+  gst_debug_set_threshold_for_name ("GST_PERFORMANCE", GST_LEVEL_LOG);
+  gst_debug_remove_log_function (gst_debug_log_default);
+  gst_debug_add_log_function (count_copies, NULL, NULL);
+
+  io_mode = opt_io_mode ? opt_io_mode : "auto";
+
+  g_print ("%dx%d NV12, %d frames, device latency %d us, io-mode %s\n\n",
+      opt_width, opt_height, opt_frames, opt_latency, io_mode);
+
+  if (!opt_test || !strcmp (opt_test, "src")) {
+    desc = g_strdup_printf ("v4l2src device=\"fake:capture,latency=%d\" "
+        "io-mode=%s num-buffers=%d ! "
+        "video/x-raw,format=NV12,width=%d,height=%d ! "
+        "fakesink name=sink sync=false", opt_latency, io_mode, opt_frames,
+        opt_width, opt_height);
+    run_bench ("v4l2src", desc);
+    g_free (desc);
+  }
+
+  if (!opt_test || !strcmp (opt_test, "sink")) {
+    desc = g_strdup_printf ("videotestsrc pattern=black num-buffers=%d ! "
+        "video/x-raw,format=NV12,width=%d,height=%d ! "
+        "v4l2sink name=sink device=\"fake:output,latency=%d\" io-mode=%s "
+        "sync=false", opt_frames, opt_width, opt_height, opt_latency,
+        io_mode);
+    run_bench ("v4l2sink", desc);
+    g_free (desc);
+  }
+
+  if (!opt_test || !strcmp (opt_test, "convert")) {
+    desc = g_strdup_printf ("videotestsrc pattern=black num-buffers=%d ! "
+        "video/x-raw,format=NV12,width=%d,height=%d ! "
+        "v4l2fake0convert output-io-mode=%s capture-io-mode=%s ! "
+        "video/x-raw,format=YUYV ! fakesink name=sink sync=false",
+        opt_frames, opt_width, opt_height, io_mode, io_mode);
+    run_bench ("v4l2convert", desc);
+    g_free (desc);
+  }
+
+  if (!opt_test || !strcmp (opt_test, "dec")) {
+    desc = g_strdup_printf ("appsrc name=src format=time "
+        "caps=\"video/x-h264,stream-format=byte-stream,alignment=au,"
+        "width=%d,height=%d,framerate=30/1\" ! "
+        "v4l2fake1dec capture-io-mode=%s ! fakesink name=sink sync=false",
+        opt_width, opt_height, io_mode);
+    run_bench ("v4l2dec", desc);
+    g_free (desc);
+  }
+
+  if (!opt_test || !strcmp (opt_test, "enc")) {
+    desc = g_strdup_printf ("videotestsrc pattern=black num-buffers=%d ! "
+        "video/x-raw,format=NV12,width=%d,height=%d,framerate=30/1 ! "
+        "v4l2fake2enc output-io-mode=%s ! fakesink name=sink sync=false",
+        opt_frames, opt_width, opt_height, io_mode);
+    run_bench ("v4l2enc", desc);
+    g_free (desc);
+  }
+
+  g_free (opt_io_mode);
+  g_free (opt_test);
+
+  return 0;
+}